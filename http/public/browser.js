@@ -4,6 +4,16 @@ var browserPanel;
 var browserDirectory = "";
 var browserSelectedItem = null;
 var browserFormInput;
+var browserPageSize = 200;
+var browserNext = null;
+var browserLoading = false;
+var browserRequest = 0;
+var browserSearchInput;
+var browserSearchTimer = null;
+var browserSearchDelay = 250;
+var browserSearchLimit = 50;
+var browserThumbnailFormat = "webp";
+var browserThumbnailQuality = 70;
 
 
 
@@ -25,6 +35,7 @@ function browserSubmit() {
 
 
 function browserSetHome() {
+  browserSearchInput.value = "";
   while(browserPanel.firstChild) {
     browserPanel.firstChild.remove();
   }
@@ -33,6 +44,9 @@ function browserSetHome() {
     = "<i class='fas fa-folder'></i> " + browserDirectory;
   browserSelectedItem = null;
   browserFormInput.value = "";
+  browserNext = null;
+  browserLoading = false;
+  browserRequest++;
   
   const folders = [
     {name: "Uploads", path: "uploads", image: "images/folder-dropbox.png"},
@@ -97,8 +111,28 @@ function browserSetHome() {
 
 
 function browserBrowse(path) {
+  browserLoadPage(path, null);
+}
+
+function browserThumbnailVariant() {
+  // The thumbnails are rendered as wide as the items on the screen
+  let item = browserPanel.querySelector(".browser-item");
+  let width = item ? item.clientWidth : browserPanel.clientWidth / 2;
+  width = Math.ceil(width * (window.devicePixelRatio || 1));
+  return "&width=" + width + "&format=" + browserThumbnailFormat
+    + "&quality=" + browserThumbnailQuality;
+}
+
+function browserLoadPage(path, cursor) {
+  let variant = browserThumbnailVariant();
+  let url = "browse?path=" + encodeURIComponent(path)
+    + "&sort=name&limit=" + browserPageSize + variant;
+  if(cursor)
+    url += "&cursor=" + encodeURIComponent(cursor);
+  let request = ++browserRequest;
+  browserLoading = true;
   fetch(
-    "browse?path=" + path,
+    url,
     {
       method: "GET",
       credentials: "same-origin",
@@ -112,16 +146,25 @@ function browserBrowse(path) {
         return Promise.reject(new Error("Error browsing"));
     })
     .then(data => {
-      while(browserPanel.firstChild) {
-        browserPanel.firstChild.remove();
+      // A later directory has been opened meanwhile
+      if(request != browserRequest)
+        return;
+      browserLoading = false;
+      if(!cursor) {
+        while(browserPanel.firstChild) {
+          browserPanel.firstChild.remove();
+        }
+        browserDirectory = path;
+        browserSearchInput.value = "";
+        browserDirectoryLabel.innerHTML
+          = "<i class='fas fa-folder'></i> " + browserDirectory;
+        browserSelectedItem = null;
+        browserFormInput.value = "";
+        browserPanel.scrollTop = 0;
       }
-      browserDirectory = path;
-      browserDirectoryLabel.innerHTML
-        = "<i class='fas fa-folder'></i> " + browserDirectory;
-      browserSelectedItem = null;
-      browserFormInput.value = "";
       
       let files = data.files;
+      let thumbs = new Map();
       for(let i=0; i<files.length; i++) {
         let name = files[i].name;
         let type = files[i].type;
@@ -140,11 +183,12 @@ function browserBrowse(path) {
           if(type == "video") {
             img.src = "images/file-video.png";
             let thumb = document.createElement("img");
-            thumb.src = "thumbnail?file=" + browserDirectory + "/" + name;
+            thumb.loading = "lazy";
             thumb.classList.add("thumbnail");
-            thumb.onload = ((event) => event.target.nextSibling.remove());
+            thumb.onload = browserOnThumbnailLoad;
             thumb.onerror = ((event) => event.target.remove());
             elem.appendChild(thumb);
+            thumbs.set(name, thumb);
           }
           else if(type == "audio")
             img.src = "images/file-audio.png";
@@ -155,6 +199,157 @@ function browserBrowse(path) {
         elem.appendChild(label);
         browserPanel.appendChild(elem);
       }
+      
+      if(thumbs.size > 0)
+        browserLoadThumbnails(url.replace("browse?", "thumbnails?"), path,
+                              variant, thumbs);
+      
+      // Fills the panel until it can scroll
+      browserNext = data.next ? data.next : null;
+      browserOnScroll();
+    })
+    .catch((error) => {
+      if(request == browserRequest)
+        browserLoading = false;
+      console.error(error);
+    });
+}
+
+function browserLoadThumbnails(url, path, variant, thumbs) {
+  // The thumbnails rendered of the page come in one sprite
+  fetch(url, {method: "GET", credentials: "same-origin"})
+    .then(response => {
+      if(response.status == 200)
+        return Promise.resolve(response.arrayBuffer());
+      else
+        return Promise.reject(new Error("Error loading thumbnails"));
+    })
+    .then(buffer => {
+      if(path != browserDirectory)
+        return;
+      let bytes = new Uint8Array(buffer);
+      let end = bytes.indexOf(10);
+      let map = JSON.parse(new TextDecoder().decode(bytes.subarray(0, end)));
+      for(const entry of map.thumbnails) {
+        let thumb = thumbs.get(entry.name);
+        if(!thumb)
+          continue;
+        let start = end + 1 + entry.offset;
+        let blob = new Blob([bytes.subarray(start, start + entry.length)],
+                            {type: map.type});
+        thumb.src = URL.createObjectURL(blob);
+        thumbs.delete(entry.name);
+      }
+      browserRequestThumbnails(path, variant, thumbs);
+    })
+    .catch((error) => {
+      browserRequestThumbnails(path, variant, thumbs);
+      console.error(error);
+    });
+}
+
+function browserRequestThumbnails(path, variant, thumbs) {
+  // The thumbnails not rendered yet are asked for one by one
+  if(path != browserDirectory)
+    return;
+  for(const [name, thumb] of thumbs)
+    thumb.src = "thumbnail?file=" + path + "/" + name + variant;
+}
+
+function browserOnThumbnailLoad(event) {
+  if(event.target.src.startsWith("blob:"))
+    URL.revokeObjectURL(event.target.src);
+  event.target.nextSibling.remove();
+}
+
+function browserOnScroll(event) {
+  if(!browserNext || browserLoading || browserDirectory == "")
+    return;
+  let bottom = browserPanel.scrollTop + browserPanel.clientHeight;
+  if(bottom >= browserPanel.scrollHeight - browserPanel.clientHeight)
+    browserLoadPage(browserDirectory, browserNext);
+}
+
+
+
+
+function browserOnSearchInput(event) {
+  if(browserSearchTimer)
+    clearTimeout(browserSearchTimer);
+  browserSearchTimer = setTimeout(browserSearch, browserSearchDelay);
+}
+
+function browserOnSearchKey(event) {
+  // Searching does not submit the form
+  if(event.key == "Enter") {
+    event.preventDefault();
+    browserOnSearchInput(event);
+  }
+}
+
+function browserSearch() {
+  browserSearchTimer = null;
+  let query = browserSearchInput.value.trim();
+  if(query == "") {
+    if(browserDirectory == "")
+      browserSetHome();
+    else
+      browserBrowse(browserDirectory);
+    return;
+  }
+  
+  let url = "search?q=" + encodeURIComponent(query)
+    + "&limit=" + browserSearchLimit;
+  let request = ++browserRequest;
+  browserNext = null;
+  browserLoading = false;
+  fetch(
+    url,
+    {
+      method: "GET",
+      credentials: "same-origin",
+      headers: {"Accepts":"application/json"}
+    }
+  )
+    .then(response => {
+      if(response.status == 200)
+        return Promise.resolve(response.json());
+      else
+        return Promise.reject(new Error("Error searching"));
+    })
+    .then(data => {
+      // The query has changed meanwhile
+      if(request != browserRequest)
+        return;
+      while(browserPanel.firstChild) {
+        browserPanel.firstChild.remove();
+      }
+      browserSelectedItem = null;
+      browserFormInput.value = "";
+      browserPanel.scrollTop = 0;
+      
+      let results = data.results;
+      for(let i=0; i<results.length; i++) {
+        let elem, img, label;
+        elem = document.createElement("div");
+        elem.classList.add("browser-item");
+        elem.title = results[i].path;
+        img = document.createElement("img");
+        if(results[i].type == "video")
+          img.src = "images/file-video.png";
+        else
+          img.src = "images/file-audio.png";
+        label = document.createElement("p");
+        label.textContent = results[i].name;
+        elem.appendChild(img);
+        elem.appendChild(label);
+        let path = results[i].path;
+        elem.onclick = function(event) {
+          browserSelectResult(this, path);
+        };
+        elem.ondblclick = ((event) => browserSubmit());
+        browserPanel.appendChild(elem);
+      }
     })
     .catch((error) => console.error(error));
 }
@@ -186,6 +381,14 @@ function browserSelectItem(elem) {
   browserFormInput.value = browserDirectory + "/" + p;
 }
 
+function browserSelectResult(elem, path) {
+  if(browserSelectedItem)
+    browserSelectedItem.classList.remove("selected");
+  elem.classList.add("selected");
+  browserSelectedItem = elem;
+  browserFormInput.value = path;
+}
+
 function browserSelectDirectory(elem) {
   if(browserSelectedItem)
     browserSelectedItem.classList.remove("selected");
@@ -211,7 +414,11 @@ window.addEventListener(
       browserWindow = document.getElementById("media-loader-browser-win");
       browserDirectoryLabel = document.getElementById("browser-navi-directory");
       browserPanel = document.getElementById("browser-panel");
-      browserFormInput = browserWindow.getElementsByTagName("input")[0];
+      browserPanel.onscroll = browserOnScroll;
+      browserFormInput = browserWindow.querySelector("input[name='url']");
+      browserSearchInput = document.getElementById("browser-search");
+      browserSearchInput.oninput = browserOnSearchInput;
+      browserSearchInput.onkeydown = browserOnSearchKey;
       let open = document.getElementById("media-loader-buttons").children[0];
       open.onclick = browserOpen;
       let upHome = document.getElementById("browser-navi-home");
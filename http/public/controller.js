@@ -7,6 +7,12 @@ var controllerTimer1 = -1;
 var controllerTimer2 = -1;
 var controllerTimeLabel;
 var controllerLoaded = false;
+var controllerClock = {time: 0, timestamp: 0, speed: 1, offset: 0};
+var controllerEvents = null;
+var controllerSocket = null;
+var controllerSocketStatus = null;
+var controllerSocketId = 0;
+var controllerSocketAcks = {};
 
 
 
@@ -37,6 +43,29 @@ function controllerClientSetEnabled(en) {
 
 
 
+function controllerClockNow() {
+  return performance.now() / 1000 + controllerClock.offset;
+}
+
+function controllerClockPosition() {
+  if(controllerPaused)
+    return controllerClock.time;
+  let elapsed = controllerClockNow() - controllerClock.timestamp;
+  return controllerClock.time + elapsed * controllerClock.speed;
+}
+
+function controllerClockRebase(time) {
+  controllerClock.time = time;
+  controllerClock.timestamp = controllerClockNow();
+}
+
+function controllerTick() {
+  controllerClientSetTime(controllerClockPosition());
+}
+
+
+
+
 function controllerClientSetTime(time, moveSlider=true) {
   if(time > controllerDuration)
     controllerTime = controllerDuration;
@@ -62,6 +91,8 @@ function controllerClientSetTime(time, moveSlider=true) {
 
 
 function controllerClientSetPaused(paused) {
+  if(paused != controllerPaused)
+    controllerClockRebase(controllerClockPosition());
   controllerPaused = paused;
   
   if(paused) {
@@ -75,11 +106,33 @@ function controllerClientSetPaused(paused) {
   else {
     controllerPauseButton.children[0].className = "fa fa-pause";
     controllerPauseButton.onclick = ((event) => controllerSetPaused(true));
-    if(controllerTimer1 == -1) {
-      var func = ((event) => controllerClientSetTime(controllerTime + 1));
-      controllerTimer1 = window.setInterval(func, 1000);
+    if(controllerTimer1 == -1)
+      controllerTimer1 = window.setInterval(controllerTick, 250);
+  }
+}
+
+
+
+
+function controllerClientSetTargets(targets) {
+  let select = document.getElementById("media-target");
+  if(targets <= 1) {
+    select.style.display = "none";
+    return;
+  }
+  
+  if(select.options.length != targets) {
+    while(select.firstChild)
+      select.firstChild.remove();
+    for(let i=0; i<targets; i++) {
+      let option = document.createElement("option");
+      option.value = String(i);
+      option.innerHTML = "Screen " + (i + 1);
+      select.appendChild(option);
     }
   }
+  select.value = remoteTarget;
+  select.style.display = "block";
 }
 
 
@@ -87,7 +140,7 @@ function controllerClientSetPaused(paused) {
 
 function controllerSync() {
   fetch(
-    "status",
+    "status?target=" + remoteTarget,
     {
       method: "GET",
       credentials: "same-origin",
@@ -95,12 +148,25 @@ function controllerSync() {
     }
   )
     .then(response => {
-      if(response.status == 200)
-        return Promise.resolve(response.json());
-      else
+      if(response.status != 200)
         return Promise.reject(new Error("Error syncing"));
+      
+      // Relates the server clock to the local one
+      let clock = parseFloat(response.headers.get("X-Remote-Clock"));
+      if(!isNaN(clock))
+        controllerClock.offset = clock - performance.now() / 1000;
+      return Promise.resolve(response.json());
     })
-    .then(data => {
+    .then(data => controllerOnStatus(data))
+    .catch((error) => console.error(error));
+}
+
+
+
+
+function controllerOnStatus(data) {
+      if(data.targets)
+        controllerClientSetTargets(data.targets);
       controllerLoaded = data.loaded;
       controllerClientSetEnabled(data.loaded);
       if(data.loaded) {
@@ -120,24 +186,64 @@ function controllerSync() {
         let str = timeLabel.innerHTML.substr(0, 10);
         timeLabel.innerHTML = str + hr + ":" + min + ":" + sec;
         
-        controllerClientSetTime(data.time);
+        controllerPaused = data.paused;
+        controllerClock.time = data.time;
+        controllerClock.timestamp = data.timestamp;
+        controllerClock.speed = data.speed;
         controllerClientSetPaused(data.paused);
+        controllerTick();
       }
-    })
-    .catch((error) => console.error(error));
 }
 
 
 
 
-function controllerSetPaused(paused) {
-  if(controllerLoaded == false)
-    controllerSync();
+function controllerListen() {
+  if(controllerEvents != null)
+    controllerEvents.close();
+  if(typeof EventSource === "undefined")
+    return;
+  
+  // Status changes are pushed so the periodic sync is not needed
+  controllerEvents = new EventSource("events?target=" + remoteTarget);
+  controllerEvents.onopen = function(event) {
+    if(controllerTimer2 != -1) {
+      window.clearInterval(controllerTimer2);
+      controllerTimer2 = -1;
+    }
+  };
+  controllerEvents.onerror = function(event) {
+    if(controllerTimer2 == -1)
+      controllerTimer2 = window.setInterval(controllerSync, 5000);
+  };
+  controllerEvents.addEventListener("status", function(event) {
+    let data = JSON.parse(event.data);
+    controllerClock.offset = data.clock - performance.now() / 1000;
+    controllerOnStatus(data.status);
+  });
+  controllerEvents.addEventListener("log", function(event) {
+    let status = document.getElementById("media-loader-status");
+    status.innerHTML = "";
+    status.appendChild(document.createTextNode(event.data));
+  });
+}
+
+
+
+
+function controllerCommand(command) {
+  // Goes through the control connection when it is open
+  if(controllerSocket != null && controllerSocket.readyState == WebSocket.OPEN) {
+    let id = ++controllerSocketId;
+    controllerSocket.send(JSON.stringify({id: id, command: command}));
+    return new Promise(resolve => controllerSocketAcks[id] = resolve);
+  }
   
   let formData = new FormData();
-  formData.append("command", "pause " + (paused ? "1" : "0"));
+  formData.append("command", command);
+  formData.append("target", remoteTarget);
   
-  fetch(
+  return fetch(
     "command",
     {
       method: "POST",
@@ -145,8 +251,79 @@ function controllerSetPaused(paused) {
       credentials: "same-origin"
     }
   )
-    .then(response => {
-      if(response.status == 200)
+    .then(response => response.status == 200);
+}
+
+
+
+
+function controllerConnect() {
+  if(controllerSocket != null) {
+    controllerSocket.onclose = null;
+    controllerSocket.close();
+    controllerSocket = null;
+  }
+  if(typeof WebSocket === "undefined") {
+    controllerListen();
+    return;
+  }
+  
+  let protocol = (location.protocol == "https:") ? "wss://" : "ws://";
+  let path = location.pathname.replace(/[^\/]*$/, "");
+  let socket = new WebSocket(
+    protocol + location.host + path + "control?target=" + remoteTarget
+  );
+  controllerSocket = socket;
+  controllerSocketStatus = null;
+  
+  // Status changes come through the socket so the other channels can rest
+  socket.onopen = function(event) {
+    if(controllerEvents != null) {
+      controllerEvents.close();
+      controllerEvents = null;
+    }
+    if(controllerTimer2 != -1) {
+      window.clearInterval(controllerTimer2);
+      controllerTimer2 = -1;
+    }
+  };
+  socket.onmessage = function(event) {
+    let msg = JSON.parse(event.data);
+    if(msg.type == "ack") {
+      let resolve = controllerSocketAcks[msg.id];
+      delete controllerSocketAcks[msg.id];
+      if(resolve)
+        resolve(msg.ok);
+    }
+    else if(msg.type == "status") {
+      // Only the changed members are sent after the first status
+      controllerSocketStatus = Object.assign(controllerSocketStatus || {},
+                                             msg.status);
+      controllerClock.offset = msg.clock - performance.now() / 1000;
+      controllerOnStatus(controllerSocketStatus);
+    }
+  };
+  socket.onclose = function(event) {
+    if(controllerSocket != socket)
+      return;
+    controllerSocket = null;
+    for(let id in controllerSocketAcks)
+      controllerSocketAcks[id](false);
+    controllerSocketAcks = {};
+    controllerListen();
+  };
+}
+
+
+
+
+function controllerSetPaused(paused) {
+  if(controllerLoaded == false)
+    controllerSync();
+  
+  controllerCommand("pause " + (paused ? "1" : "0"))
+    .then(ok => {
+      if(ok)
         controllerClientSetPaused(paused);
       else
         controllerClientSetEnabled(false);
@@ -161,20 +338,12 @@ function controllerMove(time) {
   if(controllerLoaded == false)
     controllerSync();
   
-  let formData = new FormData();
-  formData.append("command", "move " + time);
-  
-  fetch(
-    "command",
-    {
-      method: "POST",
-      body: formData,
-      credentials: "same-origin"
-    }
-  )
-    .then(response => {
-      if(response.status == 200)
-        controllerClientSetTime(controllerTime + time);
+  controllerCommand("move " + time)
+    .then(ok => {
+      if(ok) {
+        controllerClockRebase(controllerClockPosition() + time);
+        controllerTick();
+      }
       else
         controllerClientSetEnabled(false);
     })
@@ -188,20 +357,12 @@ function controllerSeek(time) {
   if(controllerLoaded == false)
     controllerSync();
   
-  let formData = new FormData();
-  formData.append("command", "seek " + time);
-  
-  fetch(
-    "command",
-    {
-      method: "POST",
-      body: formData,
-      credentials: "same-origin"
-    }
-  )
-    .then(response => {
-      if(response.status == 200)
+  controllerCommand("seek " + time)
+    .then(ok => {
+      if(ok) {
+        controllerClockRebase(time);
         controllerClientSetTime(time, false);
+      }
       else
         controllerClientSetEnabled(false);
     })
@@ -241,18 +402,21 @@ window.addEventListener(
         },
         
         onSlideEnd: (val, percent, pos) =>  {
-          if(controllerPaused == true && controllerTimer1 == -1) {
-            var func = ((event) => {
-              controllerClientSetTime(controllerTime + 1);
-            });
-            controllerTimer1 = window.setInterval(func, 1000);
-          }
+          if(controllerPaused == false && controllerTimer1 == -1)
+            controllerTimer1 = window.setInterval(controllerTick, 250);
         }
       }
     );
     
+    document.getElementById("media-target").onchange = function(event) {
+      remoteTarget = event.target.value;
+      controllerSync();
+      controllerConnect();
+    };
+    
     controllerSync();
     var func = ((event) => controllerSync());
     controllerTimer2 = window.setInterval(func, 5000);
+    controllerConnect();
   }
 );
@@ -5,17 +5,55 @@ var loaderFileInput;
 var loaderStatus;
 var loaderTimer;
 var loaderStartTime;
+var loaderStartClock = 0;
+var loaderProgress;
 var loaderLoading = false;
+var loaderEvents = null;
 var loaderError = {code: 0, message: "", time: 0}
+var remoteTarget
+  = new URLSearchParams(window.location.search).get("target") || "0";
 
 
 
 
-function loaderOnLoaded(data) {
-  loaderStatus.innerHTML = "";
+function loaderOnProgress(progress) {
+  // Ignores the stage left over from the previous media
+  if(progress.timestamp < loaderStartClock)
+    return;
+  
+  let labels = {
+    "resolve": "Resolving",
+    "connect": "Connecting",
+    "probe": "Probing",
+    "cache": "Buffering",
+    "first-frame": "Starting"
+  };
+  let text = labels[progress.stage] || "";
+  if(progress.stage == "cache")
+    text += " " + progress.percent + "%";
+  loaderProgress.innerHTML = text;
+}
+
+
+
+
+function loaderStop() {
   window.clearInterval(loaderTimer);
+  if(loaderEvents != null) {
+    loaderEvents.close();
+    loaderEvents = null;
+  }
   loaderLoading = false;
   loaderLoadingScreen.style.display = "none";
+}
+
+
+
+
+function loaderOnLoaded(data) {
+  loaderStatus.innerHTML = "";
+  loaderProgress.innerHTML = "";
+  loaderStop();
   
   let name = document.getElementById("media-name");
   name.innerHTML = (data.name.trim() != "") ? data.name : "Untitled";
@@ -42,18 +80,40 @@ function loaderOnLoaded(data) {
 
 
 
+function loaderOnStatus(data) {
+  // The loader stays until the first frame of the new media is shown
+  let progress = data.progress;
+  let fresh = progress && progress.timestamp >= loaderStartClock;
+  if(data.loaded && fresh && progress.stage == "first-frame")
+    loaderOnLoaded(data);
+  else if(progress)
+    loaderOnProgress(progress);
+  
+  if(data.error.code != 0) {
+    if(loaderError.time != data.error.time) {
+      loaderStatus.innerHTML = data.error.message;
+      loaderStop();
+    }
+  }
+  loaderError = data.error;
+}
+
+
+
+
 function loaderOnIdle(event) {
   let t = new Date().getTime();
   if(t - loaderStartTime > 31000) {
     loaderStatus.innerHTML = "Sever not responding";
-    window.clearInterval(loaderTimer);
-    loaderLoading = false;
-    loaderLoadingScreen.style.display = "none";
+    loaderStop();
     return;
   }
   
+  // The events bring the stages as they happen, polling is the fallback
+  if(loaderEvents != null)
+    return;
   fetch(
-    "status",
+    "status?target=" + remoteTarget,
     {
       method: "GET",
       credentials: "same-origin",
@@ -67,18 +127,8 @@ function loaderOnIdle(event) {
         return Promise.reject(new Error("Error syncing"));
     })
     .then(data => {
-      if(data.loaded)
-        loaderOnLoaded(data);
-      
-      if(data.error.code != 0) {
-        if(loaderError.time != data.error.time) {
-          loaderStatus.innerHTML = data.error.message;
-          window.clearInterval(loaderTimer);
-          loaderLoading = false;
-          loaderLoadingScreen.style.display = "none";
-        }
-      }
-      loaderError = data.error;
+      if(loaderLoading)
+        loaderOnStatus(data);
     })
     .catch((error) => console.error(error));
 }
@@ -86,12 +136,33 @@ function loaderOnIdle(event) {
 
 
 
+function loaderListen() {
+  if(typeof EventSource === "undefined")
+    return;
+  loaderEvents = new EventSource("events?target=" + remoteTarget);
+  loaderEvents.addEventListener("status", function(event) {
+    if(loaderLoading)
+      loaderOnStatus(JSON.parse(event.data).status);
+  });
+  loaderEvents.onerror = function(event) {
+    // Polls instead while the events are down
+    if(loaderEvents != null) {
+      loaderEvents.close();
+      loaderEvents = null;
+    }
+  };
+}
+
+
+
+
 function loaderLoad(url) {
   if(loaderLoading)
     return;
   
   let formData = new FormData();
   formData.append("command", 'open "' + url + '" --pause');
+  formData.append("target", remoteTarget);
   loaderStatus.innerHTML = "";
   
   fetch(
@@ -104,10 +175,14 @@ function loaderLoad(url) {
   )
     .then(response => {
       if(response.status == 200) {
+        let clock = parseFloat(response.headers.get("X-Remote-Clock"));
+        loaderStartClock = isNaN(clock) ? 0 : clock;
         loaderStartTime = new Date().getTime();
         loaderLoading = true;
+        loaderProgress.innerHTML = "";
         loaderLoadingScreen.style.display = "block";
-        loaderTimer = window.setInterval(loaderOnIdle, 100);
+        loaderListen();
+        loaderTimer = window.setInterval(loaderOnIdle, 250);
       }
       else if(response.status == 401) {
         loaderStatus.innerHTML = "Error 401 (Unauthorized)";
@@ -198,6 +273,7 @@ window.addEventListener(
     loaderBrowserWindow = document.getElementById("media-loader-browser-win");
     loaderURLWindow = document.getElementById("media-loader-url-win");
     loaderStatus = document.getElementById("media-loader-status");
+    loaderProgress = document.getElementById("loading-progress");
     
     loaderBrowserWindow.onsubmit = loaderOnBrowserSubmit;
     loaderURLWindow.onsubmit = loaderOnURLSubmit;
@@ -20,6 +20,9 @@
 
 #include "command.h"
 
+#include "target.h"
+#include "thread.h"
+
 #include <assert.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -74,10 +77,10 @@ static int command_tokenize(char *line, char *tokens[], int max) {
 }
 
 
-static void *options[4];
-static int int1;
-static char urlRequest[PATH_MAX];
-static double timeRequest = 0.0;
+static REMOTE_THREAD_LOCAL void *options[4];
+static REMOTE_THREAD_LOCAL int int1;
+static REMOTE_THREAD_LOCAL char urlRequest[PATH_MAX];
+static REMOTE_THREAD_LOCAL double timeRequest = 0.0;
 
 
 /**
@@ -86,17 +89,15 @@ static double timeRequest = 0.0;
  * Writes the given string in a temporary file. This function is usually
  * called by the remote program. The file the remote program writes is
  * read by the display program and the communication is done this way.
+ * Every playback context has its own file chosen by the target selected
+ * with remote_target_select().
  * 
  * @param fmt Command string
  * @param ... Additional variables to be printed in the format like printf()
  */
 REMOTE_EXPORT void remote_command_write(const char* fmt, ...) {
-    #ifdef _WIN32
     char cmdFile[PATH_MAX];
-    snprintf(cmdFile, PATH_MAX, "%s\\mpv-command", getenv("TEMP"));
-    #else
-    const char *cmdFile = "/tmp/mpv-command";
-    #endif
+    remote_target_file(cmdFile, "mpv-command", "");
     
     FILE *fp = fopen(cmdFile, "w");
     if(fp == NULL)
@@ -120,26 +121,45 @@ REMOTE_EXPORT void remote_command_write(const char* fmt, ...) {
  *         REMOTE_COMMAND_KILL)
  */
 REMOTE_EXPORT int remote_command_read() {
-    #ifdef _WIN32
     char cmdFile[PATH_MAX];
-    snprintf(cmdFile, PATH_MAX, "%s\\mpv-command", getenv("TEMP"));
-    #else
-    const char *cmdFile = "/tmp/mpv-command";
-    #endif
+    remote_target_file(cmdFile, "mpv-command", "");
     FILE *fp = fopen(cmdFile, "r");
     if(fp == NULL)
         return REMOTE_COMMAND_NONE;
     
     // Loads the line
     char cmd[MESSAGE_MAX];
-    fgets(cmd, MESSAGE_MAX, fp);
+    if(fgets(cmd, MESSAGE_MAX, fp) == NULL)
+        cmd[0] = '\0';
     fclose(fp);
     remove(cmdFile);
     
+    return remote_command_parse(cmd);
+}
+
+/**
+ * @brief Parses a command line
+ * 
+ * Interprets the same command strings that remote_command_write() sends
+ * without going through the file. The options are retrieved afterwards by
+ * remote_command_get_options() on the same thread.
+ * 
+ * @param line Command string
+ * 
+ * @return Command number
+ */
+REMOTE_EXPORT int remote_command_parse(const char *line) {
+    char cmd[MESSAGE_MAX];
+    strncpy(cmd, line, MESSAGE_MAX-1);
+    cmd[MESSAGE_MAX-1] = '\0';
+    cmd[strcspn(cmd, "\r\n")] = '\0';
+    
     // Tokenizes the command line
     char *tokens[4];
     int tokenCount = command_tokenize(cmd, tokens, 4);
     options[0] = NULL;
+    if(tokenCount == 0)
+        return REMOTE_COMMAND_NONE;
     
     // Sees the command checking the first token
     if(strcmp(tokens[0], "open") == 0) {
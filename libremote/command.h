@@ -46,6 +46,8 @@ extern "C" {
  * Writes the given string in a temporary file. This function is usually
  * called by the remote program. The file the remote program writes is
  * read by the display program and the communication is done this way.
+ * Every playback context has its own file chosen by the target selected
+ * with remote_target_select().
  * 
  * @param fmt Command string
  * @param ... Additional variables to be printed in the format like printf()
@@ -64,6 +66,19 @@ REMOTE_EXPORT void remote_command_write(const char *fmt, ...);
  */
 REMOTE_EXPORT int remote_command_read();
 
+/**
+ * @brief Parses a command line
+ * 
+ * Interprets the same command strings that remote_command_write() sends
+ * without going through the file. The options are retrieved afterwards by
+ * remote_command_get_options() on the same thread.
+ * 
+ * @param line Command string
+ * 
+ * @return Command number
+ */
+REMOTE_EXPORT int remote_command_parse(const char *line);
+
 /**
  * @brief Gets the command options
  * 
@@ -0,0 +1,259 @@
+/**
+ * @file instance.c
+ * @brief Single-instance lock and liveness of the display program
+ * 
+ * The running display program holds an advisory lock on a file in the
+ * temporary directory for its whole lifetime and writes its process ID in
+ * it. The operating system releases the lock when the process ends in any
+ * way, so the other programs can tell at once whether the player is alive
+ * without trusting the status file a crashed player left behind.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifdef _WIN32
+#define REMOTE_EXPORT __declspec(dllexport)
+#else
+#define REMOTE_EXPORT
+#endif
+
+#include "instance.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#define PATH_MAX _MAX_PATH
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/limits.h>
+#endif
+
+
+#ifdef _WIN32
+static HANDLE lockHandle = INVALID_HANDLE_VALUE;
+#else
+static int lockFd = -1;
+#endif
+
+
+static void get_lock_file(char *path) {
+    #ifdef _WIN32
+    snprintf(path, PATH_MAX, "%s\\mpv-play.lock", getenv("TEMP"));
+    #else
+    snprintf(path, PATH_MAX, "/tmp/mpv-play.lock");
+    #endif
+}
+
+
+/**
+ * @brief Takes the single-instance lock for the calling process
+ * 
+ * @return 0 on success and 1 if another process holds the lock
+ */
+REMOTE_EXPORT int remote_instance_lock() {
+    char path[PATH_MAX];
+    get_lock_file(path);
+    char pid[24];
+    
+    #ifdef _WIN32
+    if(lockHandle != INVALID_HANDLE_VALUE)
+        return 0;
+    // Denies the write access to everyone else while the handle is open
+    lockHandle = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                             OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(lockHandle == INVALID_HANDLE_VALUE)
+        return 1;
+    snprintf(pid, 24, "%lu\n", GetCurrentProcessId());
+    DWORD written;
+    SetEndOfFile(lockHandle);
+    WriteFile(lockHandle, pid, (DWORD) strlen(pid), &written, NULL);
+    FlushFileBuffers(lockHandle);
+    return 0;
+    
+    #else
+    if(lockFd >= 0)
+        return 0;
+    lockFd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(lockFd < 0)
+        return 1;
+    if(flock(lockFd, LOCK_EX | LOCK_NB) != 0) {
+        close(lockFd);
+        lockFd = -1;
+        return 1;
+    }
+    snprintf(pid, 24, "%ld\n", (long) getpid());
+    if(ftruncate(lockFd, 0) != 0 ||
+       pwrite(lockFd, pid, strlen(pid), 0) != (ssize_t) strlen(pid))
+    {
+        flock(lockFd, LOCK_UN);
+        close(lockFd);
+        lockFd = -1;
+        return 1;
+    }
+    return 0;
+    #endif
+}
+
+/**
+ * @brief Releases the single-instance lock held by the calling process
+ */
+REMOTE_EXPORT void remote_instance_unlock() {
+    #ifdef _WIN32
+    if(lockHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(lockHandle);
+        lockHandle = INVALID_HANDLE_VALUE;
+    }
+    #else
+    if(lockFd >= 0) {
+        flock(lockFd, LOCK_UN);
+        close(lockFd);
+        lockFd = -1;
+    }
+    #endif
+}
+
+/**
+ * @brief Checks whether a display program holds the lock
+ * 
+ * @return 1 if the display program is alive and 0 otherwise
+ */
+REMOTE_EXPORT int remote_instance_is_running() {
+    char path[PATH_MAX];
+    get_lock_file(path);
+    
+    #ifdef _WIN32
+    if(lockHandle != INVALID_HANDLE_VALUE)
+        return 1;
+    HANDLE h = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(h != INVALID_HANDLE_VALUE) {
+        CloseHandle(h);
+        return 0;
+    }
+    return GetLastError() == ERROR_SHARING_VIOLATION;
+    
+    #else
+    if(lockFd >= 0)
+        return 1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return 0;
+    int running = 0;
+    if(flock(fd, LOCK_SH | LOCK_NB) != 0)
+        running = (errno == EWOULDBLOCK);
+    close(fd);
+    return running;
+    #endif
+}
+
+/**
+ * @brief Gets the process ID of the display program holding the lock
+ * 
+ * @return Process ID or 0 if there is no running display program
+ */
+REMOTE_EXPORT long remote_instance_get_pid() {
+    if(!remote_instance_is_running())
+        return 0;
+    
+    char path[PATH_MAX];
+    get_lock_file(path);
+    char buffer[24];
+    size_t len = 0;
+    
+    #ifdef _WIN32
+    HANDLE h = CreateFileA(path, GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(h == INVALID_HANDLE_VALUE)
+        return 0;
+    DWORD read;
+    if(ReadFile(h, buffer, 23, &read, NULL))
+        len = read;
+    CloseHandle(h);
+    #else
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return 0;
+    ssize_t read = pread(fd, buffer, 23, 0);
+    if(read > 0)
+        len = (size_t) read;
+    close(fd);
+    #endif
+    
+    buffer[len] = '\0';
+    return atol(buffer);
+}
+
+/**
+ * @brief Waits until the display program holding the lock exits
+ * 
+ * @param timeout Maximum time to wait in seconds
+ * 
+ * @return 0 if the display program has exited and 1 on timeout
+ */
+REMOTE_EXPORT int remote_instance_wait_exit(double timeout) {
+    #ifdef _WIN32
+    long pid = remote_instance_get_pid();
+    if(pid == 0)
+        return 0;
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD) pid);
+    if(process != NULL) {
+        DWORD res = WaitForSingleObject(process, (DWORD) (timeout * 1000));
+        CloseHandle(process);
+        if(res != WAIT_OBJECT_0)
+            return 1;
+    }
+    // The lock file handle is released together with the process
+    for(int i=0; i<50 && remote_instance_is_running(); i++)
+        Sleep(10);
+    return remote_instance_is_running();
+    
+    #else
+    // The lock is released by the kernel as the process exits
+    struct timespec step = {0, 5000000L};
+    int k = (int) (timeout / 0.005);
+    for(int i=0; i<=k; i++) {
+        if(!remote_instance_is_running())
+            return 0;
+        nanosleep(&step, NULL);
+    }
+    return 1;
+    #endif
+}
+
+/**
+ * @brief Terminates the display program holding the lock
+ * 
+ * The process is killed without a chance to clean up, as it has stopped
+ * responding.
+ * 
+ * @return 0 if the termination request was delivered
+ */
+REMOTE_EXPORT int remote_instance_terminate() {
+    long pid = remote_instance_get_pid();
+    if(pid == 0)
+        return 1;
+    
+    #ifdef _WIN32
+    HANDLE process = OpenProcess(PROCESS_TERMINATE, FALSE, (DWORD) pid);
+    if(process == NULL)
+        return 1;
+    BOOL res = TerminateProcess(process, 1);
+    CloseHandle(process);
+    return !res;
+    #else
+    // SIGTERM would only raise the flag the ignored kill command has set
+    return kill((pid_t) pid, SIGKILL) != 0;
+    #endif
+}
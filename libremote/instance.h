@@ -0,0 +1,85 @@
+/**
+ * @file instance.h
+ * @brief Single-instance lock and liveness of the display program
+ * 
+ * The running display program holds an advisory lock on a file in the
+ * temporary directory for its whole lifetime and writes its process ID in
+ * it. The operating system releases the lock when the process ends in any
+ * way, so the other programs can tell at once whether the player is alive
+ * without trusting the status file a crashed player left behind.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_INSTANCE_H__
+#define __MPV_REMOTE_INSTANCE_H__ ///< Header guard
+
+#ifndef REMOTE_EXPORT
+#ifdef _WIN32
+#define REMOTE_EXPORT __declspec(dllimport)
+#else
+#define REMOTE_EXPORT
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Takes the single-instance lock for the calling process
+ * 
+ * The lock is kept until remote_instance_unlock() is called or the process
+ * exits.
+ * 
+ * @return 0 on success and 1 if another process holds the lock
+ */
+REMOTE_EXPORT int remote_instance_lock();
+
+/**
+ * @brief Releases the single-instance lock held by the calling process
+ */
+REMOTE_EXPORT void remote_instance_unlock();
+
+/**
+ * @brief Checks whether a display program holds the lock
+ * 
+ * @return 1 if the display program is alive and 0 otherwise
+ */
+REMOTE_EXPORT int remote_instance_is_running();
+
+/**
+ * @brief Gets the process ID of the display program holding the lock
+ * 
+ * @return Process ID or 0 if there is no running display program
+ */
+REMOTE_EXPORT long remote_instance_get_pid();
+
+/**
+ * @brief Waits until the display program holding the lock exits
+ * 
+ * @param timeout Maximum time to wait in seconds
+ * 
+ * @return 0 if the display program has exited and 1 on timeout
+ */
+REMOTE_EXPORT int remote_instance_wait_exit(double timeout);
+
+/**
+ * @brief Terminates the display program holding the lock
+ * 
+ * Used when the display program does not respond to the kill command.
+ * The process is killed with SIGKILL since a hung player would only
+ * handle SIGTERM like the kill command.
+ * 
+ * @return 0 if the termination request was delivered
+ */
+REMOTE_EXPORT int remote_instance_terminate();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -27,8 +27,10 @@
 
 #include "config.h"
 #include "command.h"
+#include "instance.h"
 #include "logger.h"
 #include "status.h"
+#include "target.h"
 
 #include "cmd_rsp/cmd_rsp.h"
 
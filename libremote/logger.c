@@ -21,6 +21,7 @@
 #include "logger.h"
 
 #include "status.h"
+#include "target.h"
 
 #include <assert.h>
 #include <stdarg.h>
@@ -42,6 +43,8 @@
 
 static char logMessage[MESSAGE_MAX];
 static long logFilePos = 0L;
+static remote_log_listener logListener = NULL;
+static void *logListenerArg = NULL;
 
 
 /**
@@ -71,6 +74,14 @@ REMOTE_EXPORT void remote_log_write(const char *fmt, ...) {
     vprintf(fmt, args);
     va_end(args);
     fclose(fp);
+    
+    if(logListener != NULL) {
+        char msg[MESSAGE_MAX];
+        va_start(args, fmt);
+        vsnprintf(msg, MESSAGE_MAX, fmt, args);
+        va_end(args);
+        logListener(remote_target_get(), msg, logListenerArg);
+    }
 }
 
 /**
@@ -183,3 +194,18 @@ REMOTE_EXPORT int remote_log_wait_response(double timeout) {
     
     return status;
 }
+
+/**
+ * @brief Sets the function called on every log written by this process
+ * 
+ * The listener runs on the thread writing the log.
+ * 
+ * @param listener The function or NULL to remove it
+ * @param arg Argument passed to the listener
+ */
+REMOTE_EXPORT void remote_log_set_listener(remote_log_listener listener,
+                                           void *arg)
+{
+    logListenerArg = arg;
+    logListener = listener;
+}
@@ -76,6 +76,26 @@ REMOTE_EXPORT void remote_log_clear();
  */
 REMOTE_EXPORT int remote_log_wait_response(double timeout);
 
+/**
+ * @brief Receives every log written by this process
+ * 
+ * @param target Target ID selected by the thread writing the log
+ * @param msg Log message
+ * @param arg Argument given along with the listener
+ */
+typedef void (*remote_log_listener)(int target, const char *msg, void *arg);
+
+/**
+ * @brief Sets the function called on every log written by this process
+ * 
+ * The listener runs on the thread writing the log.
+ * 
+ * @param listener The function or NULL to remove it
+ * @param arg Argument passed to the listener
+ */
+REMOTE_EXPORT void remote_log_set_listener(remote_log_listener listener,
+                                           void *arg);
+
 #ifdef __cplusplus
 }
 #endif
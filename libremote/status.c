@@ -19,12 +19,16 @@
 
 #include "status.h"
 
+#include "instance.h"
+#include "target.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #ifdef _WIN32
+#include <Windows.h>
 #define PATH_MAX _MAX_PATH
 #else
 #include <linux/limits.h>
@@ -35,18 +39,60 @@
 #include <json.h>
 
 
-static char name[PATH_MAX];
-static char url[PATH_MAX];
-static int mediaType = REMOTE_MEDIA_LOCAL;
-static double pTime = 0.0;
-static double duration = 0.0;
-static int paused = 0;
-static int loaded = 1;
-static int running = 0;
-static int errorCode = 0;
-static char errorMessage[MESSAGE_MAX];
-static clock_t errorTime = 0;
+/**
+ * @brief Status attributes of one playback context
+ */
+struct StatusRecord {
+    char name[PATH_MAX];
+    char url[PATH_MAX];
+    int mediaType;
+    double pTime;
+    double timestamp;
+    double speed;
+    double duration;
+    int paused;
+    int loaded;
+    int running;
+    int errorCode;
+    char errorMessage[MESSAGE_MAX];
+    clock_t errorTime;
+    int progressStage;
+    int progressPercent;
+    double progressTime;
+};
+
+static const char *progressNames[] = {
+    "failed", "none", "resolve", "connect", "probe", "cache", "first-frame"
+};
+
+static struct StatusRecord records[REMOTE_TARGET_MAX];
+static int targetCount = 1;
+static remote_status_listener statusListener = NULL;
+static void *statusListenerArg = NULL;
+
+
+static struct StatusRecord *status_record() {
+    return &records[remote_target_get()];
+}
+
 
+/**
+ * @brief Reads the monotonic clock shared by the processes on the host
+ * 
+ * @return Clock reading in seconds
+ */
+REMOTE_EXPORT double remote_status_clock() {
+    #ifdef _WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (double) count.QuadPart / (double) freq.QuadPart;
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+    #endif
+}
 
 /**
  * @brief Syncs the status attributes with the JSON file
@@ -54,49 +100,44 @@ static clock_t errorTime = 0;
  * Pulls the data saved in the JSON file into the respective members.
  * The process is done by the use of a JSON parser. After calling this
  * function, the data can be accessed by calling the get functions like
- * remote_status_get_url().
+ * remote_status_get_url(). The running status is cross-checked with the
+ * instance lock so that a stale file is detected at once.
  */
 REMOTE_EXPORT void remote_status_pull() {
-    #ifdef _WIN32
+    struct StatusRecord *st = status_record();
     char jsonFile[PATH_MAX];
-    snprintf(jsonFile, PATH_MAX, "%s\\mpv-status.json", getenv("TEMP"));
-    #else
-    const char *jsonFile = "/tmp/mpv-status.json";
-    #endif
+    remote_target_file(jsonFile, "mpv-status", ".json");
     FILE *fp = fopen(jsonFile, "r");
     char content[JSON_FILE_MAX];
     if(fp == NULL) {
         remote_status_set_default();
         return;
     }
-    int i;
-    i = 0;
-    char ch = getc(fp);
-    while(ch != EOF) {
-        content[i] = ch;
-        ch = getc(fp);
-        i++;
-    }
-    content[i] = '\0';
+    size_t len = fread(content, 1, JSON_FILE_MAX - 1, fp);
+    content[len] = '\0';
     fclose(fp);
     
+    // A file which cannot be read keeps the status pulled last, the file
+    // being replaced whole by the next push
     struct json_object *jobj, *jdata, *jerr;
     json_bool res;
     jobj = json_tokener_parse(content);
+    if(jobj == NULL)
+        return;
     
     // Gets name
     res = json_object_object_get_ex(jobj, "name", &jdata);
     if(!res) {
-        remove(jsonFile);
+        json_object_put(jobj);
         return;
     }
     const char* jname_str = json_object_get_string(jdata);
-    strcpy(name, jname_str);
+    strcpy(st->name, jname_str);
     
     // Gets URL
     res = json_object_object_get_ex(jobj, "url", &jdata);
     if(!res) {
-        remove(jsonFile);
+        json_object_put(jobj);
         return;
     }
     const char* jurl_str = json_object_get_string(jdata);
@@ -107,60 +148,98 @@ REMOTE_EXPORT void remote_status_pull() {
     // Gets time
     res = json_object_object_get_ex(jobj, "time", &jdata);
     if(!res) {
-        remove(jsonFile);
+        json_object_put(jobj);
         return;
     }
-    pTime = json_object_get_double(jdata);
+    st->pTime = json_object_get_double(jdata);
+    
+    // Gets the playback clock the time was sampled with
+    res = json_object_object_get_ex(jobj, "timestamp", &jdata);
+    st->timestamp = res ? json_object_get_double(jdata) : remote_status_clock();
+    res = json_object_object_get_ex(jobj, "speed", &jdata);
+    st->speed = res ? json_object_get_double(jdata) : 1.0;
+    
     res = json_object_object_get_ex(jobj, "duration", &jdata);
     if(!res) {
-        remove(jsonFile);
+        json_object_put(jobj);
         return;
     }
-    duration = json_object_get_double(jdata);
+    st->duration = json_object_get_double(jdata);
     
     // Gets pause/play status
     res = json_object_object_get_ex(jobj, "paused", &jdata);
     if(!res) {
-        remove(jsonFile);
+        json_object_put(jobj);
         return;
     }
-    paused = json_object_get_boolean(jdata);
+    st->paused = json_object_get_boolean(jdata);
     
     // Gets loaded status
     res = json_object_object_get_ex(jobj, "loaded", &jdata);
     if(!res) {
-        remove(jsonFile);
+        json_object_put(jobj);
         return;
     }
-    loaded = json_object_get_boolean(jdata);
+    st->loaded = json_object_get_boolean(jdata);
     
     // Gets running status
     res = json_object_object_get_ex(jobj, "running", &jdata);
     if(!res) {
-        remove(jsonFile);
+        json_object_put(jobj);
         return;
     }
-    running = json_object_get_boolean(jdata);
+    st->running = json_object_get_boolean(jdata);
+    
+    // A crashed display program leaves its status behind
+    if(st->running && !remote_instance_is_running()) {
+        st->running = 0;
+        st->loaded = 0;
+        st->paused = 0;
+    }
+    
+    // Gets the number of playback contexts
+    res = json_object_object_get_ex(jobj, "targets", &jdata);
+    if(res)
+        targetCount = json_object_get_int(jdata);
+    
+    // Gets the progress of opening the media
+    res = json_object_object_get_ex(jobj, "progress", &jerr);
+    if(res) {
+        st->progressStage = REMOTE_PROGRESS_NONE;
+        if(json_object_object_get_ex(jerr, "stage", &jdata)) {
+            const char *stage = json_object_get_string(jdata);
+            for(int i=REMOTE_PROGRESS_FAILED;
+                i<=REMOTE_PROGRESS_FIRST_FRAME; i++)
+            {
+                if(strcmp(stage, remote_status_progress_name(i)) == 0)
+                    st->progressStage = i;
+            }
+        }
+        if(json_object_object_get_ex(jerr, "percent", &jdata))
+            st->progressPercent = json_object_get_int(jdata);
+        if(json_object_object_get_ex(jerr, "timestamp", &jdata))
+            st->progressTime = json_object_get_double(jdata);
+    }
     
     // Gets error code and message
     res = json_object_object_get_ex(jobj, "error", &jerr);
     if(!res) {
-        remove(jsonFile);
+        json_object_put(jobj);
         return;
     }
     res = json_object_object_get_ex(jerr, "code", &jdata);
     if(!res) {
-        remove(jsonFile);
+        json_object_put(jobj);
         return;
     }
-    errorCode = json_object_get_int(jdata);
+    st->errorCode = json_object_get_int(jdata);
     res = json_object_object_get_ex(jerr, "message", &jdata);
     if(!res) {
-        remove(jsonFile);
+        json_object_put(jobj);
         return;
     }
     const char *msg = json_object_get_string(jdata);
-    strcpy(errorMessage, msg);
+    strcpy(st->errorMessage, msg);
     json_object_put(jobj);
 }
 
@@ -169,56 +248,152 @@ REMOTE_EXPORT void remote_status_pull() {
  * 
  * @return Name string
  */
-REMOTE_EXPORT const char* remote_status_get_name() { return name; }
+REMOTE_EXPORT const char* remote_status_get_name() {
+    return status_record()->name;
+}
 
 /**
  * @brief Gets the media URL being played
  * 
  * @return URL string
  */
-REMOTE_EXPORT const char* remote_status_get_url() { return url; }
+REMOTE_EXPORT const char* remote_status_get_url() {
+    return status_record()->url;
+}
 
 /**
  * @brief Gets the type of media being played
  * 
  * @return REMOTE_MEDIA_LOCAL or REMOTE_MEDIA_HTTP
  */
-REMOTE_EXPORT int remote_status_get_media_type() { return mediaType; }
+REMOTE_EXPORT int remote_status_get_media_type() {
+    return status_record()->mediaType;
+}
 
 /**
  * @brief Gets the playback time of the media
  * 
  * @return Time in seconds
  */
-REMOTE_EXPORT double remote_status_get_time() { return pTime; }
+REMOTE_EXPORT double remote_status_get_time() {
+    return status_record()->pTime;
+}
+
+/**
+ * @brief Gets the playback time extrapolated to the present
+ * 
+ * Advances the sampled time by the playback speed for the time passed
+ * since it was sampled. The result stays at the sampled time while the
+ * media is paused or not loaded.
+ * 
+ * @return Time in seconds
+ */
+REMOTE_EXPORT double remote_status_get_time_now() {
+    struct StatusRecord *st = status_record();
+    double t = st->pTime;
+    if(st->loaded && !st->paused) {
+        t += (remote_status_clock() - st->timestamp) * st->speed;
+        if(st->duration > 0.0 && t > st->duration)
+            t = st->duration;
+        if(t < 0.0)
+            t = 0.0;
+    }
+    return t;
+}
+
+/**
+ * @brief Gets the monotonic clock reading at which the time was sampled
+ * 
+ * @return Clock reading in seconds
+ */
+REMOTE_EXPORT double remote_status_get_timestamp() {
+    return status_record()->timestamp;
+}
+
+/**
+ * @brief Gets the playback speed of the media
+ * 
+ * @return Speed factor where 1.0 is the normal speed
+ */
+REMOTE_EXPORT double remote_status_get_speed() {
+    return status_record()->speed;
+}
 
 /**
  * @brief Gets the playback duration of the media
  * 
  * @return Time in seconds
  */
-REMOTE_EXPORT double remote_status_get_duration() { return duration; }
+REMOTE_EXPORT double remote_status_get_duration() {
+    return status_record()->duration;
+}
 
 /**
  * @brief Checks whether the media is paused
  * 
  * @return 1 if the media is paused and 0 if it is playing
  */
-REMOTE_EXPORT int remote_status_get_paused() { return paused; }
+REMOTE_EXPORT int remote_status_get_paused() {
+    return status_record()->paused;
+}
 
 /**
  * @brief Checks whether the media is loaded
  * 
  * @return 1 if the media is loaded and 0 if it is playing
  */
-REMOTE_EXPORT int remote_status_get_loaded() { return loaded; }
+REMOTE_EXPORT int remote_status_get_loaded() {
+    return status_record()->loaded;
+}
 
 /**
  * @brief Checks whether the display program is running
  * 
  * @return 1 if the display program is active
  */
-REMOTE_EXPORT int remote_status_get_running() { return running; }
+REMOTE_EXPORT int remote_status_get_running() {
+    return status_record()->running;
+}
+
+/**
+ * @brief Gets the progress of opening the media
+ * 
+ * @param percent Pointer to which the cache fill percentage is written or
+ *                NULL
+ * @param timestamp Pointer to which the monotonic clock reading of the last
+ *                  progress change is written or NULL
+ * 
+ * @return Progress stage like REMOTE_PROGRESS_CONNECT
+ */
+REMOTE_EXPORT int remote_status_get_progress(int *percent, double *timestamp)
+{
+    struct StatusRecord *st = status_record();
+    if(percent != NULL)
+        *percent = st->progressPercent;
+    if(timestamp != NULL)
+        *timestamp = st->progressTime;
+    return st->progressStage;
+}
+
+/**
+ * @brief Gets the name of a progress stage used in the JSON file
+ * 
+ * @param stage Progress stage like REMOTE_PROGRESS_CONNECT
+ * 
+ * @return Stage name like "connect"
+ */
+REMOTE_EXPORT const char *remote_status_progress_name(int stage) {
+    if(stage < REMOTE_PROGRESS_FAILED || stage > REMOTE_PROGRESS_FIRST_FRAME)
+        stage = REMOTE_PROGRESS_NONE;
+    return progressNames[stage - REMOTE_PROGRESS_FAILED];
+}
+
+/**
+ * @brief Gets the number of playback contexts the display program runs
+ * 
+ * @return Number of targets
+ */
+REMOTE_EXPORT int remote_status_get_targets() { return targetCount; }
 
 /**
  * @brief Gets the current error code and message
@@ -228,38 +403,45 @@ REMOTE_EXPORT int remote_status_get_running() { return running; }
  * @return Error code
  */
 REMOTE_EXPORT int remote_status_get_error(char* msg) {
-    strcpy(msg, errorMessage);
-    return errorCode;
+    struct StatusRecord *st = status_record();
+    strcpy(msg, st->errorMessage);
+    return st->errorCode;
 }
 
 /**
  * @brief Prints all the attributes of the remote media player
  */
 REMOTE_EXPORT void remote_status_print() {
+    struct StatusRecord *st = status_record();
+    double now = remote_status_get_time_now();
     printf(
         "MPV Remote Player status:\n"
+        "    target: %d\n"
         "    name: %s\n"
         "    url: %s\n"
         "    time: %d:%d:%d\n"
+        "    speed: %.2f\n"
         "    duration: %d:%d:%d\n"
         "    paused: %d\n"
         "    loaded: %d\n"
         "    running: %d\n",
-        name,
-        url,
-        (int)pTime / 3600,
-        ((int)pTime / 60) % 60,
-        (int)pTime % 60,
-        (int)duration / 3600,
-        ((int)duration / 60) % 60,
-        (int)duration % 60,
-        paused,
-        loaded,
-        running
+        remote_target_get(),
+        st->name,
+        st->url,
+        (int)now / 3600,
+        ((int)now / 60) % 60,
+        (int)now % 60,
+        st->speed,
+        (int)st->duration / 3600,
+        ((int)st->duration / 60) % 60,
+        (int)st->duration % 60,
+        st->paused,
+        st->loaded,
+        st->running
     );
-    if(errorCode != 0) {
+    if(st->errorCode != 0) {
         char buff[MESSAGE_MAX];
-        strcpy(buff, errorMessage);
+        strcpy(buff, st->errorMessage);
         size_t len = strlen(buff);
         if(buff[len-1] == '\n')
             buff[len-1] = '\0';
@@ -267,7 +449,7 @@ REMOTE_EXPORT void remote_status_print() {
             "    error:\n"
             "        code: %d\n"
             "        message: %s\n",
-            errorCode,
+            st->errorCode,
             buff
         );
     }
@@ -282,63 +464,139 @@ REMOTE_EXPORT void remote_status_print() {
  * Pushes the updated attributes creating a new JSON file.
  */
 REMOTE_EXPORT void remote_status_push() {
+    struct StatusRecord *st = status_record();
+    
     // Creates JSON object
     struct json_object *jobj = json_object_new_object();
-    json_object_object_add(jobj, "name", json_object_new_string(name));
-    json_object_object_add(jobj, "url", json_object_new_string(url));
-    json_object_object_add(jobj, "time", json_object_new_double(pTime));
-    json_object_object_add(jobj, "duration", json_object_new_double(duration));
-    json_object_object_add(jobj, "paused", json_object_new_boolean(paused));
-    json_object_object_add(jobj, "loaded", json_object_new_boolean(loaded));
-    json_object_object_add(jobj, "running", json_object_new_boolean(running));
+    json_object_object_add(jobj, "target",
+                           json_object_new_int(remote_target_get()));
+    json_object_object_add(jobj, "targets", json_object_new_int(targetCount));
+    json_object_object_add(jobj, "name", json_object_new_string(st->name));
+    json_object_object_add(jobj, "url", json_object_new_string(st->url));
+    json_object_object_add(jobj, "time", json_object_new_double(st->pTime));
+    json_object_object_add(jobj, "timestamp",
+                           json_object_new_double(st->timestamp));
+    json_object_object_add(jobj, "speed", json_object_new_double(st->speed));
+    json_object_object_add(jobj, "duration",
+                           json_object_new_double(st->duration));
+    json_object_object_add(jobj, "paused",
+                           json_object_new_boolean(st->paused));
+    json_object_object_add(jobj, "loaded",
+                           json_object_new_boolean(st->loaded));
+    json_object_object_add(jobj, "running",
+                           json_object_new_boolean(st->running));
+    
+    struct json_object *jprog = json_object_new_object();
+    json_object_object_add(jprog, "stage", json_object_new_string(
+                           remote_status_progress_name(st->progressStage)));
+    json_object_object_add(jprog, "percent",
+                           json_object_new_int(st->progressPercent));
+    json_object_object_add(jprog, "timestamp",
+                           json_object_new_double(st->progressTime));
+    json_object_object_add(jobj, "progress", jprog);
     
     struct json_object *jerr = json_object_new_object();
-    json_object_object_add(jerr, "code", json_object_new_int(errorCode));
+    json_object_object_add(jerr, "code", json_object_new_int(st->errorCode));
     json_object_object_add(jerr, "message",
-                           json_object_new_string(errorMessage));
-    json_object_object_add(jerr, "time", json_object_new_int64(errorTime));
+                           json_object_new_string(st->errorMessage));
+    json_object_object_add(jerr, "time",
+                           json_object_new_int64(st->errorTime));
     json_object_object_add(jobj, "error", jerr);
     
     // Writes JSON file
     const char *content = json_object_to_json_string_ext(
         jobj,
-        JSON_C_TO_STRING_PRETTY
+        JSON_C_TO_STRING_PLAIN
     );
-    #ifdef _WIN32
-    char jsonFile[PATH_MAX];
-    snprintf(jsonFile, PATH_MAX, "%s\\mpv-status.json", getenv("TEMP"));
-    #else
-    const char *jsonFile = "/tmp/mpv-status.json";
-    #endif
-    FILE *fp = fopen(jsonFile, "w");
-    fprintf(fp, "%s", content);
-    fclose(fp);
+    // Readers polling the file never see it half written
+    char jsonFile[PATH_MAX], temp[PATH_MAX];
+    remote_target_file(jsonFile, "mpv-status", ".json");
+    snprintf(temp, PATH_MAX, "%s.tmp", jsonFile);
+    FILE *fp = fopen(temp, "w");
+    if(fp != NULL) {
+        int failed = (fputs(content, fp) == EOF);
+        failed = (fclose(fp) != 0) || failed;
+        #ifdef _WIN32
+        if(failed || !MoveFileExA(temp, jsonFile, MOVEFILE_REPLACE_EXISTING))
+            remove(temp);
+        #else
+        if(failed || rename(temp, jsonFile) != 0)
+            remove(temp);
+        #endif
+    }
+    
+    if(statusListener != NULL)
+        statusListener(remote_target_get(), content, statusListenerArg);
     
     json_object_put(jobj);
 }
 
+/**
+ * @brief Sets the function called on every status push of this process
+ * 
+ * Lets the display program publish the status to its own clients without
+ * reading the file back. The listener runs on the thread pushing the status.
+ * 
+ * @param listener The function or NULL to remove it
+ * @param arg Argument passed to the listener
+ */
+REMOTE_EXPORT void remote_status_set_listener(remote_status_listener listener,
+                                              void *arg)
+{
+    statusListenerArg = arg;
+    statusListener = listener;
+}
+
 /**
  * @brief Reset the status attributes to the default
  */
 REMOTE_EXPORT void remote_status_set_default() {
-    name[0] = '\0';
-    url[0] = '\0';
-    pTime = 0.0;
-    duration = 0.0;
-    paused = 0;
-    loaded = 0;
-    running = 0;
-    errorCode = 0;
-    errorMessage[0] = '\0';
-    errorTime = 0;
+    struct StatusRecord *st = status_record();
+    st->name[0] = '\0';
+    st->url[0] = '\0';
+    st->pTime = 0.0;
+    st->timestamp = 0.0;
+    st->speed = 1.0;
+    st->duration = 0.0;
+    st->paused = 0;
+    st->loaded = 0;
+    st->running = 0;
+    st->errorCode = 0;
+    st->errorMessage[0] = '\0';
+    st->errorTime = 0;
+    st->progressStage = REMOTE_PROGRESS_NONE;
+    st->progressPercent = 0;
+    st->progressTime = 0.0;
 }
 
+/**
+ * @brief Updates the progress of opening the media
+ * 
+ * @param stage Progress stage like REMOTE_PROGRESS_CONNECT
+ * @param percent Cache fill percentage of the stage
+ */
+REMOTE_EXPORT void remote_status_set_progress(int stage, int percent) {
+    struct StatusRecord *st = status_record();
+    st->progressStage = stage;
+    st->progressPercent = percent;
+    st->progressTime = remote_status_clock();
+}
+
+/**
+ * @brief Updates the number of playback contexts the display program runs
+ * 
+ * @param n Number of targets
+ */
+REMOTE_EXPORT void remote_status_set_targets(int n) { targetCount = n; }
+
 /**
  * @brief Updates the media name tag
  * 
  * @param s Media name tag
  */
-REMOTE_EXPORT void remote_status_set_name(const char *s) { strcpy(name, s); }
+REMOTE_EXPORT void remote_status_set_name(const char *s) {
+    strcpy(status_record()->name, s);
+}
 
 /**
  * @brief Updates the media URL
@@ -349,47 +607,71 @@ REMOTE_EXPORT void remote_status_set_name(const char *s) { strcpy(name, s); }
  * @param s Media URL
  */
 REMOTE_EXPORT void remote_status_set_url(const char *s) {
+    struct StatusRecord *st = status_record();
+    
     // Copies the string
-    strcpy(url, s);
+    strcpy(st->url, s);
     
     // Checks the media type
-    mediaType = REMOTE_MEDIA_LOCAL;
-    if(strlen(url) > 20) {
+    st->mediaType = REMOTE_MEDIA_LOCAL;
+    if(strlen(st->url) > 20) {
         char buff[9];
-        memcpy(buff, url, 8);
+        memcpy(buff, st->url, 8);
         buff[8] = '\0';
         if(strcmp(buff, "https://") == 0)
-            mediaType = REMOTE_MEDIA_HTTP;
+            st->mediaType = REMOTE_MEDIA_HTTP;
     }
 }
 
 /**
  * @brief Updates the playback time of the media
  * 
+ * The monotonic clock reading is saved together with the time so that the
+ * readers can extrapolate the playback position.
+ * 
  * @param t Time in seconds
  */
-REMOTE_EXPORT void remote_status_set_time(double t) { pTime = t;}
+REMOTE_EXPORT void remote_status_set_time(double t) {
+    struct StatusRecord *st = status_record();
+    st->pTime = t;
+    st->timestamp = remote_status_clock();
+}
+
+/**
+ * @brief Updates the playback speed of the media
+ * 
+ * @param speed Speed factor where 1.0 is the normal speed
+ */
+REMOTE_EXPORT void remote_status_set_speed(double speed) {
+    status_record()->speed = speed;
+}
 
 /**
  * @brief Updates the playback duration of the media
  * 
  * @param t Time in seconds
  */
-REMOTE_EXPORT void remote_status_set_duration(double t) { duration = t;}
+REMOTE_EXPORT void remote_status_set_duration(double t) {
+    status_record()->duration = t;
+}
 
 /**
  * @brief Updates the pause/play status
  * 
  * @param b 1 for pause and 0 for play
  */
-REMOTE_EXPORT void remote_status_set_paused(int b) { paused = b; }
+REMOTE_EXPORT void remote_status_set_paused(int b) {
+    status_record()->paused = b;
+}
 
 /**
  * @brief Updates the loaded status
  * 
  * @param b 1 if the media is loaded
  */
-REMOTE_EXPORT void remote_status_set_loaded(int b) { loaded = b; }
+REMOTE_EXPORT void remote_status_set_loaded(int b) {
+    status_record()->loaded = b;
+}
 
 /**
  * @brief Updates the running status
@@ -399,7 +681,9 @@ REMOTE_EXPORT void remote_status_set_loaded(int b) { loaded = b; }
  * 
  * @param b 1 if the display program is running
  */
-REMOTE_EXPORT void remote_status_set_running(int b) { running = b; }
+REMOTE_EXPORT void remote_status_set_running(int b) {
+    status_record()->running = b;
+}
 
 /**
  * @brief Updates the error code and message
@@ -408,7 +692,8 @@ REMOTE_EXPORT void remote_status_set_running(int b) { running = b; }
  * @param msg Error message
  */
 REMOTE_EXPORT void remote_status_set_error(int code, const char *msg) {
-    errorCode = code;
-    strcpy(errorMessage, msg);
-    errorTime = clock();
+    struct StatusRecord *st = status_record();
+    st->errorCode = code;
+    strcpy(st->errorMessage, msg);
+    st->errorTime = clock();
 }
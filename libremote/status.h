@@ -3,7 +3,9 @@
  * @brief Tracks and updates the remote media player status
  * 
  * Functions track and update the status attributes. To sync multiple
- * key-value pairs at once, JSON file system is used.
+ * key-value pairs at once, JSON file system is used. Each playback context
+ * has its own record and the functions operate on the one selected by
+ * remote_target_select().
  * 
  * @copyright Copyright (c) 2021 Khant Kyaw Khaung
  * 
@@ -29,18 +31,38 @@ extern "C" {
 #define REMOTE_MEDIA_LOCAL 0 ///< Local file on the host device
 #define REMOTE_MEDIA_HTTP  1 ///< File on web
 
+#define REMOTE_PROGRESS_FAILED     -1 ///< Opening the media has failed
+#define REMOTE_PROGRESS_NONE        0 ///< No media is being opened
+#define REMOTE_PROGRESS_RESOLVE     1 ///< Resolving the media URL
+#define REMOTE_PROGRESS_CONNECT     2 ///< Connecting to the media source
+#define REMOTE_PROGRESS_PROBE       3 ///< Probing the media streams
+#define REMOTE_PROGRESS_CACHE       4 ///< Filling the cache before playing
+#define REMOTE_PROGRESS_FIRST_FRAME 5 ///< The first frame is shown
+
 #ifndef REMOTE_MESSAGE_MAX
 #define REMOTE_MESSAGE_MAX 1024 ///< Maximum size of a log message
 #endif
 
 
+/**
+ * @brief Reads the monotonic clock shared by the processes on the host
+ * 
+ * The status time is sampled against this clock. A reader extrapolates the
+ * playback position as `time + (clock - timestamp) * speed` while the media
+ * is playing.
+ * 
+ * @return Clock reading in seconds
+ */
+REMOTE_EXPORT double remote_status_clock();
+
 /**
  * @brief Syncs the status attributes with the JSON file
  * 
  * Pulls the data saved in the JSON file into the respective members.
  * The process is done by the use of a JSON parser. After calling this
  * function, the data can be accessed by calling the get functions like
- * remote_status_get_url().
+ * remote_status_get_url(). The running status is cross-checked with the
+ * instance lock so that a stale file is detected at once.
  */
 REMOTE_EXPORT void remote_status_pull();
 
@@ -72,6 +94,31 @@ REMOTE_EXPORT int remote_status_get_media_type();
  */
 REMOTE_EXPORT double remote_status_get_time();
 
+/**
+ * @brief Gets the playback time extrapolated to the present
+ * 
+ * Advances the sampled time by the playback speed for the time passed
+ * since it was sampled. The result stays at the sampled time while the
+ * media is paused or not loaded.
+ * 
+ * @return Time in seconds
+ */
+REMOTE_EXPORT double remote_status_get_time_now();
+
+/**
+ * @brief Gets the monotonic clock reading at which the time was sampled
+ * 
+ * @return Clock reading in seconds
+ */
+REMOTE_EXPORT double remote_status_get_timestamp();
+
+/**
+ * @brief Gets the playback speed of the media
+ * 
+ * @return Speed factor where 1.0 is the normal speed
+ */
+REMOTE_EXPORT double remote_status_get_speed();
+
 /**
  * @brief Gets the playback duration of the media
  * 
@@ -100,6 +147,34 @@ REMOTE_EXPORT int remote_status_get_loaded();
  */
 REMOTE_EXPORT int remote_status_get_running();
 
+/**
+ * @brief Gets the progress of opening the media
+ * 
+ * @param percent Pointer to which the cache fill percentage is written or
+ *                NULL
+ * @param timestamp Pointer to which the monotonic clock reading of the last
+ *                  progress change is written or NULL
+ * 
+ * @return Progress stage like REMOTE_PROGRESS_CONNECT
+ */
+REMOTE_EXPORT int remote_status_get_progress(int *percent, double *timestamp);
+
+/**
+ * @brief Gets the name of a progress stage used in the JSON file
+ * 
+ * @param stage Progress stage like REMOTE_PROGRESS_CONNECT
+ * 
+ * @return Stage name like "connect"
+ */
+REMOTE_EXPORT const char *remote_status_progress_name(int stage);
+
+/**
+ * @brief Gets the number of playback contexts the display program runs
+ * 
+ * @return Number of targets
+ */
+REMOTE_EXPORT int remote_status_get_targets();
+
 /**
  * @brief Gets the current error code and message
  * 
@@ -120,15 +195,55 @@ REMOTE_EXPORT void remote_status_print();
 /**
  * @brief Updates the status attributes into the JSON file
  * 
- * Pushes the updated attributes creating a new JSON file.
+ * Pushes the updated attributes creating a new JSON file. The listener
+ * set by remote_status_set_listener() receives the same JSON.
  */
 REMOTE_EXPORT void remote_status_push();
 
+/**
+ * @brief Receives the status of a playback context whenever it is pushed
+ * 
+ * @param target Target ID of the playback context
+ * @param json Status JSON written in the file
+ * @param arg Argument given along with the listener
+ */
+typedef void (*remote_status_listener)(int target, const char *json,
+                                       void *arg);
+
+/**
+ * @brief Sets the function called on every status push of this process
+ * 
+ * Lets the display program publish the status to its own clients without
+ * reading the file back. The listener runs on the thread pushing the status.
+ * 
+ * @param listener The function or NULL to remove it
+ * @param arg Argument passed to the listener
+ */
+REMOTE_EXPORT void remote_status_set_listener(remote_status_listener listener,
+                                              void *arg);
+
 /**
  * @brief Reset the status attributes to the default
  */
 REMOTE_EXPORT void remote_status_set_default();
 
+/**
+ * @brief Updates the progress of opening the media
+ * 
+ * @param stage Progress stage like REMOTE_PROGRESS_CONNECT
+ * @param percent Cache fill percentage of the stage
+ */
+REMOTE_EXPORT void remote_status_set_progress(int stage, int percent);
+
+/**
+ * @brief Updates the number of playback contexts the display program runs
+ * 
+ * The value is shared by all the records.
+ * 
+ * @param n Number of targets
+ */
+REMOTE_EXPORT void remote_status_set_targets(int n);
+
 /**
  * @brief Updates the media name tag
  * 
@@ -149,10 +264,20 @@ REMOTE_EXPORT void remote_status_set_url(const char *s);
 /**
  * @brief Updates the playback time of the media
  * 
+ * The monotonic clock reading is saved together with the time so that the
+ * readers can extrapolate the playback position.
+ * 
  * @param t Time in seconds
  */
 REMOTE_EXPORT void remote_status_set_time(double t);
 
+/**
+ * @brief Updates the playback speed of the media
+ * 
+ * @param speed Speed factor where 1.0 is the normal speed
+ */
+REMOTE_EXPORT void remote_status_set_speed(double speed);
+
 /**
  * @brief Updates the playback duration of the media
  * 
@@ -0,0 +1,107 @@
+/**
+ * @file target.c
+ * @brief Selects the playback context a thread talks to
+ * 
+ * A display program can run several playback contexts, one per display or
+ * audio zone. Each of them is addressed by a target ID and owns its own
+ * status record and command file. The selection is kept per thread so that
+ * every playback thread keeps working with the plain status and command
+ * functions.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifdef _WIN32
+#define REMOTE_EXPORT __declspec(dllexport)
+#else
+#define REMOTE_EXPORT
+#endif
+
+#include "target.h"
+
+#include "thread.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define PATH_MAX _MAX_PATH
+#else
+#include <linux/limits.h>
+#endif
+
+
+static REMOTE_THREAD_LOCAL int selected = 0;
+
+
+/**
+ * @brief Selects the playback context for the calling thread
+ * 
+ * The status and command functions called afterwards from the same thread
+ * operate on the selected context. Out of range IDs select the context 0.
+ * 
+ * @param target Target ID
+ */
+REMOTE_EXPORT void remote_target_select(int target) {
+    if(target < 0 || target >= REMOTE_TARGET_MAX)
+        target = 0;
+    selected = target;
+}
+
+/**
+ * @brief Parses a target ID given by a user
+ * 
+ * Unlike remote_target_select(), nothing is mapped to the context 0 so that
+ * a mistyped ID never acts on another context.
+ * 
+ * @param str Target ID string, may be NULL for the context 0
+ * @param count Number of playback contexts running
+ * 
+ * @return Target ID or -1 if it is not a number of a running context
+ */
+REMOTE_EXPORT int remote_target_parse(const char *str, int count) {
+    if(str == NULL)
+        return 0;
+    char *end;
+    errno = 0;
+    long target = strtol(str, &end, 10);
+    if(end == str || *end != '\0' || errno != 0 || target < 0 ||
+       target >= REMOTE_TARGET_MAX || target >= count)
+        return -1;
+    return (int) target;
+}
+
+/**
+ * @brief Gets the playback context selected by the calling thread
+ * 
+ * @return Target ID
+ */
+REMOTE_EXPORT int remote_target_get() { return selected; }
+
+/**
+ * @brief Makes the path of a file owned by a playback context
+ * 
+ * @param dest Output string of at least PATH_MAX bytes
+ * @param name File name without the extension
+ * @param ext Extension including the dot or an empty string
+ */
+REMOTE_EXPORT void remote_target_file(char *dest, const char *name,
+                                      const char *ext)
+{
+    #ifdef _WIN32
+    const char *dir = getenv("TEMP");
+    const char *sep = "\\";
+    #else
+    const char *dir = "/tmp";
+    const char *sep = "/";
+    #endif
+    
+    if(selected == 0)
+        snprintf(dest, PATH_MAX, "%s%s%s%s", dir, sep, name, ext);
+    else
+        snprintf(dest, PATH_MAX, "%s%s%s-%d%s", dir, sep, name, selected, ext);
+}
@@ -0,0 +1,82 @@
+/**
+ * @file target.h
+ * @brief Selects the playback context a thread talks to
+ * 
+ * A display program can run several playback contexts, one per display or
+ * audio zone. Each of them is addressed by a target ID and owns its own
+ * status record and command file. The selection is kept per thread so that
+ * every playback thread keeps working with the plain status and command
+ * functions.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_TARGET_H__
+#define __MPV_REMOTE_TARGET_H__ ///< Header guard
+
+#ifndef REMOTE_EXPORT
+#ifdef _WIN32
+#define REMOTE_EXPORT __declspec(dllimport)
+#else
+#define REMOTE_EXPORT
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef REMOTE_TARGET_MAX
+#define REMOTE_TARGET_MAX 8 ///< Maximum number of playback contexts
+#endif
+
+
+/**
+ * @brief Selects the playback context for the calling thread
+ * 
+ * The status and command functions called afterwards from the same thread
+ * operate on the selected context. Out of range IDs select the context 0.
+ * 
+ * @param target Target ID
+ */
+REMOTE_EXPORT void remote_target_select(int target);
+
+/**
+ * @brief Parses a target ID given by a user
+ * 
+ * @param str Target ID string, may be NULL for the context 0
+ * @param count Number of playback contexts running
+ * 
+ * @return Target ID or -1 if it is not a number of a running context
+ */
+REMOTE_EXPORT int remote_target_parse(const char *str, int count);
+
+/**
+ * @brief Gets the playback context selected by the calling thread
+ * 
+ * @return Target ID
+ */
+REMOTE_EXPORT int remote_target_get();
+
+/**
+ * @brief Makes the path of a file owned by a playback context
+ * 
+ * The context 0 uses the plain name in the temporary directory so that the
+ * files stay the same as with a single context. The others get their ID
+ * appended like `mpv-status-1.json`.
+ * 
+ * @param dest Output string of at least PATH_MAX bytes
+ * @param name File name without the extension
+ * @param ext Extension including the dot or an empty string
+ */
+REMOTE_EXPORT void remote_target_file(char *dest, const char *name,
+                                      const char *ext);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,261 @@
+/**
+ * @file thread.h
+ * @brief Portable threading primitives for MPV Remote
+ * 
+ * Thin inline wrappers over POSIX threads and the Win32 threading API.
+ * Both the library and the display program use them so that the code
+ * running multiple playback contexts stays free of platform checks.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_THREAD_H__
+#define __MPV_REMOTE_THREAD_H__ ///< Header guard
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef _MSC_VER
+#define REMOTE_THREAD_LOCAL __declspec(thread) ///< Thread-local storage
+#else
+#define REMOTE_THREAD_LOCAL _Thread_local ///< Thread-local storage
+#endif
+
+
+/**
+ * @brief Entry point of a thread
+ */
+typedef void *(*remote_thread_func)(void *arg);
+
+#ifdef _WIN32
+typedef HANDLE remote_thread_t; ///< Thread handle
+typedef CRITICAL_SECTION remote_mutex_t; ///< Mutual exclusion lock
+typedef CONDITION_VARIABLE remote_cond_t; ///< Condition variable
+
+struct RemoteThreadStart {
+    remote_thread_func func;
+    void *arg;
+};
+
+static DWORD WINAPI remote_thread_trampoline(LPVOID param) {
+    struct RemoteThreadStart start = *(struct RemoteThreadStart*) param;
+    free(param);
+    start.func(start.arg);
+    return 0;
+}
+#else
+typedef pthread_t remote_thread_t; ///< Thread handle
+typedef pthread_mutex_t remote_mutex_t; ///< Mutual exclusion lock
+typedef pthread_cond_t remote_cond_t; ///< Condition variable
+#endif
+
+
+/**
+ * @brief Starts a new thread
+ * 
+ * @param thread Receives the thread handle
+ * @param func Entry point
+ * @param arg Argument passed to the entry point
+ * 
+ * @return 0 on success
+ */
+static inline int remote_thread_create(remote_thread_t *thread,
+                                       remote_thread_func func, void *arg)
+{
+    #ifdef _WIN32
+    struct RemoteThreadStart *start = malloc(sizeof(struct RemoteThreadStart));
+    if(start == NULL)
+        return 1;
+    start->func = func;
+    start->arg = arg;
+    *thread = CreateThread(NULL, 0, remote_thread_trampoline, start, 0, NULL);
+    if(*thread == NULL) {
+        free(start);
+        return 1;
+    }
+    return 0;
+    #else
+    return pthread_create(thread, NULL, func, arg);
+    #endif
+}
+
+/**
+ * @brief Waits for a thread to finish and releases its handle
+ * 
+ * @param thread Thread handle
+ */
+static inline void remote_thread_join(remote_thread_t thread) {
+    #ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    #else
+    pthread_join(thread, NULL);
+    #endif
+}
+
+/**
+ * @brief Initializes a mutex
+ * 
+ * @param mutex The mutex
+ */
+static inline void remote_mutex_init(remote_mutex_t *mutex) {
+    #ifdef _WIN32
+    InitializeCriticalSection(mutex);
+    #else
+    pthread_mutex_init(mutex, NULL);
+    #endif
+}
+
+/**
+ * @brief Destroys a mutex
+ * 
+ * @param mutex The mutex
+ */
+static inline void remote_mutex_destroy(remote_mutex_t *mutex) {
+    #ifdef _WIN32
+    DeleteCriticalSection(mutex);
+    #else
+    pthread_mutex_destroy(mutex);
+    #endif
+}
+
+/**
+ * @brief Locks a mutex
+ * 
+ * @param mutex The mutex
+ */
+static inline void remote_mutex_lock(remote_mutex_t *mutex) {
+    #ifdef _WIN32
+    EnterCriticalSection(mutex);
+    #else
+    pthread_mutex_lock(mutex);
+    #endif
+}
+
+/**
+ * @brief Unlocks a mutex
+ * 
+ * @param mutex The mutex
+ */
+static inline void remote_mutex_unlock(remote_mutex_t *mutex) {
+    #ifdef _WIN32
+    LeaveCriticalSection(mutex);
+    #else
+    pthread_mutex_unlock(mutex);
+    #endif
+}
+
+/**
+ * @brief Initializes a condition variable
+ * 
+ * @param cond The condition variable
+ */
+static inline void remote_cond_init(remote_cond_t *cond) {
+    #ifdef _WIN32
+    InitializeConditionVariable(cond);
+    #else
+    pthread_cond_init(cond, NULL);
+    #endif
+}
+
+/**
+ * @brief Destroys a condition variable
+ * 
+ * @param cond The condition variable
+ */
+static inline void remote_cond_destroy(remote_cond_t *cond) {
+    #ifdef _WIN32
+    (void) cond;
+    #else
+    pthread_cond_destroy(cond);
+    #endif
+}
+
+/**
+ * @brief Waits on a condition variable
+ * 
+ * @param cond The condition variable
+ * @param mutex The locked mutex released during the wait
+ */
+static inline void remote_cond_wait(remote_cond_t *cond,
+                                    remote_mutex_t *mutex)
+{
+    #ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+    #else
+    pthread_cond_wait(cond, mutex);
+    #endif
+}
+
+/**
+ * @brief Waits on a condition variable for a limited amount of time
+ * 
+ * @param cond The condition variable
+ * @param mutex The locked mutex released during the wait
+ * @param ms Timeout in milliseconds
+ * 
+ * @return 0 if signaled and 1 if timed out
+ */
+static inline int remote_cond_timedwait(remote_cond_t *cond,
+                                        remote_mutex_t *mutex, long ms)
+{
+    #ifdef _WIN32
+    return !SleepConditionVariableCS(cond, mutex, (DWORD) ms);
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000L;
+    if(ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(cond, mutex, &ts) == ETIMEDOUT;
+    #endif
+}
+
+/**
+ * @brief Wakes one thread waiting on a condition variable
+ * 
+ * @param cond The condition variable
+ */
+static inline void remote_cond_signal(remote_cond_t *cond) {
+    #ifdef _WIN32
+    WakeConditionVariable(cond);
+    #else
+    pthread_cond_signal(cond);
+    #endif
+}
+
+/**
+ * @brief Wakes all threads waiting on a condition variable
+ * 
+ * @param cond The condition variable
+ */
+static inline void remote_cond_broadcast(remote_cond_t *cond) {
+    #ifdef _WIN32
+    WakeAllConditionVariable(cond);
+    #else
+    pthread_cond_broadcast(cond);
+    #endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * @file assets.c
+ * @brief Static files of the web page embedded in the display program
+ * 
+ * The table itself is generated at build time by the bundler.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "assets.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define strncasecmp _strnicmp
+#else
+#include <strings.h>
+#endif
+
+
+static int compare_asset(const void *key, const void *elem) {
+    const struct RemoteAsset *asset = elem;
+    return strcmp((const char*) key, asset->path);
+}
+
+
+/**
+ * @brief Looks up a bundled file
+ * 
+ * @param path URL path starting with a slash
+ * 
+ * @return The file or NULL if it is not bundled
+ */
+const struct RemoteAsset *remote_http_find_asset(const char *path) {
+    return bsearch(path, remote_http_assets, remote_http_asset_count,
+                   sizeof(struct RemoteAsset), compare_asset);
+}
+
+/**
+ * @brief Checks whether a content coding is acceptable to the client
+ * 
+ * @param accept Value of the Accept-Encoding header, may be NULL
+ * @param coding Content coding such as "gzip" or "br"
+ * 
+ * @return 1 if the coding is accepted with a nonzero quality and 0 otherwise
+ */
+int remote_http_accepts_encoding(const char *accept, const char *coding) {
+    if(accept == NULL)
+        return 0;
+    size_t len = strlen(coding);
+    const char *p = accept;
+    while(*p != '\0') {
+        // Compares the name of each listed coding
+        while(*p == ' ' || *p == ',')
+            p++;
+        const char *end = p + strcspn(p, ",");
+        size_t nameLen = strcspn(p, " ;,");
+        int match = (nameLen == len && strncasecmp(p, coding, len) == 0);
+        
+        // Refuses the coding given a zero quality like "gzip;q=0"
+        if(match) {
+            const char *q = strstr(p, "q=");
+            if(q != NULL && q < end && atof(q+2) <= 0.0)
+                return 0;
+            return 1;
+        }
+        p = end;
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks whether the client already has the content
+ * 
+ * @param if_none_match Value of the If-None-Match header, may be NULL
+ * @param etag Entity tag of the current content
+ * 
+ * @return 1 if the content has not been modified and 0 otherwise
+ */
+int remote_http_etag_matches(const char *if_none_match, const char *etag) {
+    if(if_none_match == NULL)
+        return 0;
+    while(isspace((unsigned char) *if_none_match))
+        if_none_match++;
+    if(strcmp(if_none_match, "*") == 0)
+        return 1;
+    
+    // The weak comparison also accepts W/"..." of the same tag
+    return strstr(if_none_match, etag) != NULL;
+}
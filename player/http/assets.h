@@ -0,0 +1,95 @@
+/**
+ * @file assets.h
+ * @brief Static files of the web page embedded in the display program
+ * 
+ * The files under the public HTTP directory are bundled at build time into
+ * an immutable table holding the identity body of each file along with its
+ * precompressed gzip and brotli bodies and a strong entity tag. The web
+ * server answers the static requests from the table without any disk I/O.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_ASSETS_H__
+#define __MPV_REMOTE_HTTP_ASSETS_H__ ///< Header guard
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Cache-Control of the bundled files
+ * 
+ * The URLs of the files are not versioned so the browsers are asked to
+ * revalidate them with the entity tag after a week.
+ */
+#define ASSET_CACHE_CONTROL "public, max-age=604800"
+
+/**
+ * @brief Cache-Control of the pages rendered from the bundled templates
+ */
+#define PAGE_CACHE_CONTROL "no-cache"
+
+
+/**
+ * @brief Static file of the web page
+ * 
+ * A compressed body is NULL when compressing does not pay off, like for
+ * images and web fonts, or when the bundler was built without the library.
+ */
+struct RemoteAsset {
+    const char *path; ///< URL path starting with a slash
+    const char *content_type; ///< MIME type
+    const char *etag; ///< Strong entity tag with the quotes
+    const unsigned char *identity; ///< Uncompressed body ending with a NUL
+    size_t identity_length; ///< The number of bytes of the body
+    const unsigned char *gzip; ///< Body compressed by gzip
+    size_t gzip_length; ///< The number of bytes of the gzip body
+    const unsigned char *brotli; ///< Body compressed by brotli
+    size_t brotli_length; ///< The number of bytes of the brotli body
+};
+
+
+extern const struct RemoteAsset remote_http_assets[]; ///< Sorted by path
+extern const size_t remote_http_asset_count; ///< Number of bundled files
+
+
+/**
+ * @brief Looks up a bundled file
+ * 
+ * @param path URL path starting with a slash
+ * 
+ * @return The file or NULL if it is not bundled
+ */
+const struct RemoteAsset *remote_http_find_asset(const char *path);
+
+/**
+ * @brief Checks whether a content coding is acceptable to the client
+ * 
+ * @param accept Value of the Accept-Encoding header, may be NULL
+ * @param coding Content coding such as "gzip" or "br"
+ * 
+ * @return 1 if the coding is accepted with a nonzero quality and 0 otherwise
+ */
+int remote_http_accepts_encoding(const char *accept, const char *coding);
+
+/**
+ * @brief Checks whether the client already has the content
+ * 
+ * @param if_none_match Value of the If-None-Match header, may be NULL
+ * @param etag Entity tag of the current content
+ * 
+ * @return 1 if the content has not been modified and 0 otherwise
+ */
+int remote_http_etag_matches(const char *if_none_match, const char *etag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
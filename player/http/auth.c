@@ -10,6 +10,8 @@
 
 #include "auth.h"
 
+#include "../../libremote/thread.h"
+
 #include <string.h>
 #include <stdlib.h>
 
@@ -169,6 +171,8 @@ static void gcrypt_hash(const char *in, char *out) {
 
 
 static uint32_t admin_addr = 0;
+static remote_mutex_t auth_lock;
+static int auth_initialized = 0;
 
 
 static int authenticate(const char *pswd) {
@@ -203,6 +207,20 @@ static int authenticate(const char *pswd) {
     return auth;
 }
 
+/**
+ * @brief Prepares the authentication before the server threads start
+ */
+void remote_http_auth_init() {
+    if(auth_initialized)
+        return;
+    
+    // The requests share the password file and the hash settings
+    remote_mutex_init(&auth_lock);
+    get_password_file();
+    crypt_hash_init();
+    auth_initialized = 1;
+}
+
 /**
  * @brief Authenticates the access to special services
  *
@@ -214,12 +232,12 @@ static int authenticate(const char *pswd) {
 int remote_http_authenticate(struct RemoteConnection* con_info,
                              const char *pswd)
 {
-    if(authenticate(pswd)) {
+    remote_mutex_lock(&auth_lock);
+    int auth = authenticate(pswd);
+    if(auth)
         admin_addr = con_info->address;
-        return 1;
-    }
-    else
-        return 0;
+    remote_mutex_unlock(&auth_lock);
+    return auth;
 }
 
 /**
@@ -230,7 +248,10 @@ int remote_http_authenticate(struct RemoteConnection* con_info,
  * @return 1 if authenticated and 0 otherwise
  */
 int remote_http_is_authenticated(struct RemoteConnection* con_info) {
-    return con_info->address == admin_addr;
+    remote_mutex_lock(&auth_lock);
+    int auth = (con_info->address == admin_addr);
+    remote_mutex_unlock(&auth_lock);
+    return auth;
 }
 
 /**
@@ -248,15 +269,16 @@ int remote_http_change_password(const char* old_pswd, const char* new_pswd) {
         return 0;
     dlen = crypt_dlen;
 
-    if(authenticate(old_pswd)) {
+    remote_mutex_lock(&auth_lock);
+    int auth = authenticate(old_pswd);
+    if(auth) {
         FILE* fp = fopen(get_password_file(), "wb");
         char* x = malloc(dlen);
         crypt_hash(new_pswd, x);
         for(unsigned int i=0; i<dlen; i++)
             fputc(x[i], fp);
         fclose(fp);
-        return 1;
     }
-    else
-        return 0;
+    remote_mutex_unlock(&auth_lock);
+    return auth;
 }
@@ -17,6 +17,11 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Prepares the authentication before the server threads start
+ */
+void remote_http_auth_init();
+
 /**
  * @brief Authenticates the access to special services
  * 
@@ -0,0 +1,261 @@
+/**
+ * @file bundler.c
+ * @brief Build-time tool embedding the static files of the web page
+ * 
+ * Reads the files under the public HTTP directory and writes a C source
+ * file defining the table of assets.h. Every file is stored as is along
+ * with its gzip and brotli bodies when compressing it pays off. The
+ * compressors are only used when the tool is built with the libraries.
+ * 
+ * Usage: mpv-remote-bundler [output] [directory] [file]...
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "etag.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#define MIN_SAVING 0.9 ///< Compressed body has to be smaller than this ratio
+
+
+/**
+ * @brief File to be bundled
+ */
+struct BundleFile {
+    char path[256]; ///< URL path
+    const char *content_type; ///< MIME type
+    unsigned char *identity; ///< Content of the file
+    size_t identity_length; ///< Size of the file
+    unsigned char *gzip; ///< Body compressed by gzip or NULL
+    size_t gzip_length; ///< Size of the gzip body
+    unsigned char *brotli; ///< Body compressed by brotli or NULL
+    size_t brotli_length; ///< Size of the brotli body
+    char etag[ETAG_SIZE]; ///< Strong entity tag
+};
+
+
+struct MimeType {
+    const char *ext;
+    const char *content_type;
+};
+
+static const struct MimeType mimetypes[] = {
+    {"html", "text/html"},
+    {"css", "text/css"},
+    {"js", "text/javascript"},
+    {"png", "image/png"},
+    {"ico", "image/x-icon"},
+    {"svg", "image/svg+xml"},
+    {"ttf", "font/ttf"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+};
+
+
+static const char *find_content_type(const char *path) {
+    const char *ext = strrchr(path, '.');
+    if(ext == NULL)
+        return NULL;
+    ext++;
+    for(size_t i=0; i<sizeof(mimetypes)/sizeof(mimetypes[0]); i++) {
+        if(strcmp(ext, mimetypes[i].ext) == 0)
+            return mimetypes[i].content_type;
+    }
+    return NULL;
+}
+
+
+static unsigned char *load_file(const char *file, size_t *len) {
+    FILE *fp = fopen(file, "rb");
+    if(fp == NULL)
+        return NULL;
+    fseek(fp, 0L, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0L, SEEK_SET);
+    unsigned char *buffer = malloc(size > 0 ? size : 1);
+    *len = fread(buffer, 1, size, fp);
+    fclose(fp);
+    return buffer;
+}
+
+
+static void compress_gzip(struct BundleFile *file) {
+    #ifdef HAVE_ZLIB
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if(deflateInit2(&strm, Z_BEST_COMPRESSION, Z_DEFLATED, 15+16, 9,
+                    Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return;
+    }
+    size_t bound = deflateBound(&strm, file->identity_length);
+    unsigned char *out = malloc(bound);
+    strm.next_in = file->identity;
+    strm.avail_in = (uInt) file->identity_length;
+    strm.next_out = out;
+    strm.avail_out = (uInt) bound;
+    if(deflate(&strm, Z_FINISH) == Z_STREAM_END) {
+        file->gzip = out;
+        file->gzip_length = strm.total_out;
+    }
+    else
+        free(out);
+    deflateEnd(&strm);
+    #else
+    (void) file;
+    #endif
+}
+
+
+static void compress_brotli(struct BundleFile *file) {
+    #ifdef HAVE_BROTLI
+    size_t len = BrotliEncoderMaxCompressedSize(file->identity_length);
+    if(len == 0)
+        return;
+    unsigned char *out = malloc(len);
+    if(BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW,
+                             BROTLI_MODE_GENERIC, file->identity_length,
+                             file->identity, &len, out))
+    {
+        file->brotli = out;
+        file->brotli_length = len;
+    }
+    else
+        free(out);
+    #else
+    (void) file;
+    #endif
+}
+
+
+static void write_array(FILE *fp, const char *name, int index,
+                        const unsigned char *data, size_t len)
+{
+    fprintf(fp, "static const unsigned char asset%d_%s[] = {", index, name);
+    for(size_t i=0; i<len; i++) {
+        if(i % 16 == 0)
+            fprintf(fp, "\n   ");
+        fprintf(fp, " %u,", data[i]);
+    }
+    
+    // Terminates the body so that a text file can be used as a string
+    fprintf(fp, "\n    0\n};\n\n");
+}
+
+
+static int compare_file(const void *a, const void *b) {
+    const struct BundleFile *fa = a;
+    const struct BundleFile *fb = b;
+    return strcmp(fa->path, fb->path);
+}
+
+
+
+
+int main(int argc, char *argv[]) {
+    if(argc < 3) {
+        printf("Usage: mpv-remote-bundler [output] [directory] [file]...\n");
+        return 1;
+    }
+    
+    int count = argc - 3;
+    struct BundleFile *files = calloc(count > 0 ? count : 1,
+                                      sizeof(struct BundleFile));
+    
+    // Loads and compresses every file
+    for(int i=0; i<count; i++) {
+        struct BundleFile *file = &files[i];
+        const char *name = argv[i+3];
+        snprintf(file->path, sizeof(file->path), "/%s", name);
+        file->content_type = find_content_type(name);
+        if(file->content_type == NULL) {
+            printf("Unsupported file type `%s`\n", name);
+            return 1;
+        }
+        
+        char source[1024];
+        snprintf(source, sizeof(source), "%s/%s", argv[2], name);
+        file->identity = load_file(source, &file->identity_length);
+        if(file->identity == NULL) {
+            printf("Failed to read `%s`\n", source);
+            return 1;
+        }
+        remote_http_etag(file->identity, file->identity_length, file->etag);
+        
+        // Keeps the compressed bodies worth sending
+        size_t limit = (size_t) (file->identity_length * MIN_SAVING);
+        compress_gzip(file);
+        if(file->gzip != NULL && file->gzip_length >= limit) {
+            free(file->gzip);
+            file->gzip = NULL;
+        }
+        compress_brotli(file);
+        if(file->brotli != NULL && file->brotli_length >= limit) {
+            free(file->brotli);
+            file->brotli = NULL;
+        }
+    }
+    qsort(files, count, sizeof(struct BundleFile), compare_file);
+    
+    // Writes the table
+    FILE *fp = fopen(argv[1], "w");
+    if(fp == NULL) {
+        printf("Failed to write `%s`\n", argv[1]);
+        return 1;
+    }
+    fprintf(fp, "/* Generated by mpv-remote-bundler. Do not edit. */\n\n");
+    fprintf(fp, "#include \"assets.h\"\n\n");
+    for(int i=0; i<count; i++) {
+        write_array(fp, "identity", i, files[i].identity,
+                    files[i].identity_length);
+        if(files[i].gzip != NULL)
+            write_array(fp, "gzip", i, files[i].gzip, files[i].gzip_length);
+        if(files[i].brotli != NULL) {
+            write_array(fp, "brotli", i, files[i].brotli,
+                        files[i].brotli_length);
+        }
+    }
+    
+    fprintf(fp, "const struct RemoteAsset remote_http_assets[] = {\n");
+    for(int i=0; i<count; i++) {
+        struct BundleFile *file = &files[i];
+        fprintf(fp, "    {\"%s\", \"%s\", \"\\\"%.16s\\\"\",\n",
+                file->path, file->content_type, file->etag+1);
+        fprintf(fp, "     asset%d_identity, %zu,\n", i, file->identity_length);
+        if(file->gzip != NULL)
+            fprintf(fp, "     asset%d_gzip, %zu,\n", i, file->gzip_length);
+        else
+            fprintf(fp, "     NULL, 0,\n");
+        if(file->brotli != NULL)
+            fprintf(fp, "     asset%d_brotli, %zu},\n", i, file->brotli_length);
+        else
+            fprintf(fp, "     NULL, 0},\n");
+    }
+    if(count == 0)
+        fprintf(fp, "    {NULL}\n");
+    fprintf(fp, "};\n\n");
+    fprintf(fp, "const size_t remote_http_asset_count = %d;\n", count);
+    fclose(fp);
+    
+    for(int i=0; i<count; i++) {
+        free(files[i].identity);
+        free(files[i].gzip);
+        free(files[i].brotli);
+    }
+    free(files);
+    return 0;
+}
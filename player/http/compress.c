@@ -0,0 +1,139 @@
+/**
+ * @file compress.c
+ * @brief Content coding of the dynamic HTTP responses
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "compress.h"
+#include "assets.h"
+#include "pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+
+#ifdef HAVE_ZLIB
+static char *deflate_reply(const char *data, size_t len, int windowBits,
+                           size_t *out_len)
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if(deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8,
+                    Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return NULL;
+    }
+    
+    size_t bound = deflateBound(&strm, len);
+    char *out = malloc(bound);
+    if(out == NULL) {
+        deflateEnd(&strm);
+        return NULL;
+    }
+    strm.next_in = (Bytef*) data;
+    strm.avail_in = (uInt) len;
+    strm.next_out = (Bytef*) out;
+    strm.avail_out = (uInt) bound;
+    if(deflate(&strm, Z_FINISH) != Z_STREAM_END) {
+        free(out);
+        out = NULL;
+    }
+    else
+        *out_len = strm.total_out;
+    deflateEnd(&strm);
+    return out;
+}
+#endif
+
+
+static int is_compressible(const char *content_type) {
+    return strncmp(content_type, "text/", 5) == 0 ||
+           strcmp(content_type, "application/json") == 0;
+}
+
+
+/**
+ * @brief Compresses the reply of a connection if the client accepts it
+ * 
+ * Only successful text and JSON replies of at least COMPRESS_THRESHOLD
+ * bytes are compressed. The reply is replaced by the compressed body and
+ * an entity tag set on the connection becomes weak. Does nothing when
+ * the program is built without zlib.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_compress_reply(struct MHD_Connection *connection,
+                                struct RemoteConnection *con_info)
+{
+    #ifdef HAVE_ZLIB
+    if(con_info->reply == NULL || con_info->reply_persistent ||
+       con_info->status != MHD_HTTP_OK ||
+       con_info->reply_length < COMPRESS_THRESHOLD ||
+       !is_compressible(con_info->content_type))
+    {
+        return;
+    }
+    
+    // Picks the coding, gzip has a header and deflate a zlib wrapper
+    const char *accept = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        MHD_HTTP_HEADER_ACCEPT_ENCODING
+    );
+    const char *coding;
+    int windowBits;
+    if(remote_http_accepts_encoding(accept, "gzip")) {
+        coding = "gzip";
+        windowBits = 15 + 16;
+    }
+    else if(remote_http_accepts_encoding(accept, "deflate")) {
+        coding = "deflate";
+        windowBits = 15;
+    }
+    else {
+        remote_http_add_header(con_info, "Vary", "Accept-Encoding");
+        return;
+    }
+    
+    size_t len;
+    char *body = deflate_reply(con_info->reply, con_info->reply_length,
+                               windowBits, &len);
+    if(body == NULL)
+        return;
+    if(len >= con_info->reply_length) {
+        free(body);
+        return;
+    }
+    free(con_info->reply);
+    con_info->reply = body;
+    con_info->reply_length = len;
+    remote_http_add_header(con_info, "Content-Encoding", coding);
+    remote_http_add_header(con_info, "Vary", "Accept-Encoding");
+    
+    // The tag of the identity body only weakly names the compressed one
+    for(int i=0; i<con_info->header_count; i++) {
+        struct RemoteHeader *header = &con_info->headers[i];
+        if(strcmp(header->name, "ETag") == 0 && header->value[0] == '"') {
+            size_t len = strlen(header->value);
+            char *weak = remote_http_alloc(con_info, len+3);
+            if(weak != NULL) {
+                memcpy(weak, "W/", 2);
+                memcpy(weak+2, header->value, len+1);
+                header->value = weak;
+            }
+        }
+    }
+    #else
+    (void) connection;
+    (void) con_info;
+    #endif
+}
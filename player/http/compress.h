@@ -0,0 +1,47 @@
+/**
+ * @file compress.h
+ * @brief Content coding of the dynamic HTTP responses
+ * 
+ * Compresses the replies built at request time, like the directory
+ * listings and the status, with gzip or deflate as the client accepts.
+ * The static files are compressed at build time instead.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_COMPRESS_H__
+#define __MPV_REMOTE_HTTP_COMPRESS_H__ ///< Header guard
+
+#include "con_type.h"
+
+#include <microhttpd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COMPRESS_THRESHOLD 1024 ///< Smallest reply worth compressing
+
+
+/**
+ * @brief Compresses the reply of a connection if the client accepts it
+ * 
+ * Only successful text and JSON replies of at least COMPRESS_THRESHOLD
+ * bytes are compressed. The reply is replaced by the compressed body and
+ * an entity tag set on the connection becomes weak. Does nothing when
+ * the program is built without zlib.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_compress_reply(struct MHD_Connection *connection,
+                                struct RemoteConnection *con_info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
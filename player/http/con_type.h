@@ -20,12 +20,29 @@
 extern "C" {
 #endif
 
-#define PARAM_SIZE 256 ///< Maximum length of each param
+#define HEADER_COUNT 8 ///< Maximum number of extra response headers
+#define ARENA_SIZE 1024 ///< Bytes of request memory kept with a connection
 
 #define GET_METHOD 1 ///< The GET method
 #define POST_METHOD 2 ///< The POST method
 #define UNKNOWN_METHOD -1 ///< Unknown method
 
+#define JOB_NONE 0 ///< The request is answered by the server thread
+#define JOB_RUNNING 1 ///< A worker prepares the reply while suspended
+#define JOB_DONE 2 ///< The worker has prepared the reply
+
+
+/**
+ * @brief Extra header of an HTTP response
+ */
+struct RemoteHeader {
+    const char *name; ///< Header name
+    const char *value; ///< Header value in the request memory
+};
+
+struct RemoteArenaChunk;
+struct RemoteRoute;
+
 
 /**
  * @brief HTTP connection
@@ -33,20 +50,43 @@ extern "C" {
 struct RemoteConnection {
     uint32_t address; ///< IP address
     int method; ///< GET or POST
-    char url[128]; ///< The address of a web page
-    char content_type[24]; ///< The type of media the sever returns
+    const char *url; ///< The address of a web page
+    const struct RemoteRoute *route; ///< Service of the URL or NULL
+    const char *content_type; ///< The type of media the sever returns
     int status; ///< Connection status
     char *reply; ///< The body of the content
     size_t reply_length; ///< The number of bytes of the content
+    int reply_persistent; ///< The content is not owned and must not be freed
     FILE *fp; ///< File pointer which only involves in file uploading
-    char param1[PARAM_SIZE]; // Param 1
-    char param2[PARAM_SIZE]; // Param 2
-    char param3[PARAM_SIZE]; // Param 3
-    char param4[PARAM_SIZE]; // Param 4
+    int stream_fd; ///< File streamed as the content or -1
+    uint64_t stream_offset; ///< Offset of the streamed part of the file
+    uint64_t stream_length; ///< The number of bytes streamed
+    struct MHD_Response *response; ///< Response prepared by the handler
+    struct RemoteHeader headers[HEADER_COUNT]; ///< Extra response headers
+    int header_count; ///< The number of extra response headers
+    volatile int job_state; ///< State of the work handed to a worker
+    void *job_data; ///< Data of the work in the request memory or NULL
+    char *param1; // Param 1
+    char *param2; // Param 2
     struct MHD_PostProcessor* postprocessor; ///< To handle the POST requests
+    char *arena; ///< Request memory kept with the connection
+    size_t arena_used; ///< The number of bytes of the request memory used
+    struct RemoteArenaChunk *arena_chunks; ///< Request memory beyond it
+    struct RemoteConnection *next_free; ///< Next pooled connection
 };
 
 
+/**
+ * @brief Adds a header to the response of the connection
+ * 
+ * @param con_info The connection
+ * @param name Header name which has to be a string constant
+ * @param value Header value
+ */
+void remote_http_add_header(struct RemoteConnection *con_info,
+                            const char *name, const char *value);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,53 @@
+/**
+ * @file etag.h
+ * @brief Entity tags of the HTTP responses
+ * 
+ * Shared by the web server and the build-time asset bundler so that an
+ * entity tag computed at either place names the same content.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_ETAG_H__
+#define __MPV_REMOTE_HTTP_ETAG_H__ ///< Header guard
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ETAG_SIZE 20 ///< Buffer size of an entity tag with the quotes
+
+
+/**
+ * @brief Computes the strong entity tag of a content
+ * 
+ * The tag is the 64-bit FNV-1a hash of the content in quoted hexadecimal.
+ * 
+ * @param data The content
+ * @param len The number of bytes of the content
+ * @param etag Receives the tag, at least ETAG_SIZE bytes
+ */
+static inline void remote_http_etag(const void *data, size_t len,
+                                    char *etag)
+{
+    const unsigned char *p = data;
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i=0; i<len; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    snprintf(etag, ETAG_SIZE, "\"%016llx\"", (unsigned long long) hash);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,424 @@
+/**
+ * @file events.c
+ * @brief Pushes the status and the log to the clients as Server-Sent Events
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "events.h"
+
+#include "../../libremote/libremote.h"
+#include "../../libremote/thread.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * @brief Event stream of a connection
+ */
+struct EventStream {
+    struct MHD_Connection *connection; ///< The connection to the client
+    int target; ///< Target ID of the playback context
+    uint64_t statusSeq; ///< Sequence number of the last status sent
+    uint64_t logSeq; ///< Sequence number of the last log line sent
+    double lastWrite; ///< Clock reading of the last write
+    char *pending; ///< Formatted events not sent yet
+    size_t pendingLength; ///< The number of bytes formatted
+    size_t pendingPos; ///< The number of bytes sent
+    size_t pendingSize; ///< Capacity of the buffer
+    int suspended; ///< The connection waits for the next event
+    struct EventStream *next; ///< Next suspended stream
+};
+
+/**
+ * @brief Log line published to the streams
+ */
+struct EventLog {
+    uint64_t seq; ///< Sequence number
+    int target; ///< Target ID of the playback context writing the log
+    char msg[REMOTE_MESSAGE_MAX]; ///< Log message
+};
+
+
+static remote_mutex_t hubLock;
+static remote_cond_t hubCond;
+static remote_cond_t hubChanged;
+static remote_thread_t hubThread;
+static int hubInitialized = 0;
+static int hubRunning = 0;
+static int hubClosing = 0;
+static char *statusJson[REMOTE_TARGET_MAX];
+static uint64_t statusSeq[REMOTE_TARGET_MAX];
+static struct EventLog logs[EVENT_LOG_COUNT];
+static uint64_t logSeq = 0;
+static struct EventStream *suspended = NULL;
+
+
+// Resumes every suspended stream, called with the hub locked
+static void resume_streams() {
+    while(suspended != NULL) {
+        struct EventStream *stream = suspended;
+        suspended = stream->next;
+        stream->next = NULL;
+        stream->suspended = 0;
+        MHD_resume_connection(stream->connection);
+    }
+}
+
+
+static void on_status(int target, const char *json, void *arg) {
+    (void) arg;
+    if(target < 0 || target >= REMOTE_TARGET_MAX)
+        return;
+    char *copy = malloc(strlen(json)+1);
+    if(copy == NULL)
+        return;
+    strcpy(copy, json);
+    
+    remote_mutex_lock(&hubLock);
+    free(statusJson[target]);
+    statusJson[target] = copy;
+    statusSeq[target]++;
+    resume_streams();
+    remote_cond_broadcast(&hubChanged);
+    remote_mutex_unlock(&hubLock);
+}
+
+
+static void on_log(int target, const char *msg, void *arg) {
+    (void) arg;
+    remote_mutex_lock(&hubLock);
+    logSeq++;
+    struct EventLog *log = &logs[logSeq % EVENT_LOG_COUNT];
+    log->seq = logSeq;
+    log->target = target;
+    strncpy(log->msg, msg, REMOTE_MESSAGE_MAX-1);
+    log->msg[REMOTE_MESSAGE_MAX-1] = '\0';
+    resume_streams();
+    remote_mutex_unlock(&hubLock);
+}
+
+
+// Wakes the idle streams now and then to send the keepalive comments
+static void *keepalive_loop(void *arg) {
+    (void) arg;
+    remote_mutex_lock(&hubLock);
+    while(!hubClosing) {
+        remote_cond_timedwait(&hubCond, &hubLock, EVENT_KEEPALIVE * 1000L);
+        resume_streams();
+    }
+    remote_mutex_unlock(&hubLock);
+    return NULL;
+}
+
+
+/**
+ * @brief Starts publishing the status and the log to the event streams
+ * 
+ * Has to be called before the web server starts.
+ */
+void remote_http_events_start() {
+    if(hubRunning)
+        return;
+    
+    // The lock outlives the server since the streams are freed on its stop
+    if(!hubInitialized) {
+        remote_mutex_init(&hubLock);
+        remote_cond_init(&hubCond);
+        remote_cond_init(&hubChanged);
+        hubInitialized = 1;
+    }
+    hubClosing = 0;
+    for(int i=0; i<REMOTE_TARGET_MAX; i++) {
+        free(statusJson[i]);
+        statusJson[i] = NULL;
+        statusSeq[i] = 0;
+    }
+    logSeq = 0;
+    suspended = NULL;
+    if(remote_thread_create(&hubThread, keepalive_loop, NULL) != 0)
+        return;
+    hubRunning = 1;
+    remote_status_set_listener(on_status, NULL);
+    remote_log_set_listener(on_log, NULL);
+}
+
+/**
+ * @brief Ends every event stream
+ * 
+ * Has to be called before the web server stops so that no connection is
+ * left suspended.
+ */
+void remote_http_events_stop() {
+    if(!hubRunning)
+        return;
+    remote_status_set_listener(NULL, NULL);
+    remote_log_set_listener(NULL, NULL);
+    
+    remote_mutex_lock(&hubLock);
+    hubClosing = 1;
+    resume_streams();
+    remote_cond_signal(&hubCond);
+    remote_cond_broadcast(&hubChanged);
+    remote_mutex_unlock(&hubLock);
+    remote_thread_join(hubThread);
+    hubRunning = 0;
+}
+
+/**
+ * @brief Waits for a newer status of a playback context
+ * 
+ * Returns at once if the status already differs from the one seen last.
+ * 
+ * @param target Target ID of the playback context
+ * @param seq Sequence number of the status seen last, updated on return
+ * @param json Receives a copy of the status to be freed by the caller
+ * @param ms Timeout in milliseconds
+ * 
+ * @return 1 for a new status, 0 on timeout or wakeup and -1 once the
+ *         events have stopped
+ */
+int remote_http_events_wait(int target, uint64_t *seq, char **json, long ms) {
+    *json = NULL;
+    if(!hubInitialized || target < 0 || target >= REMOTE_TARGET_MAX)
+        return -1;
+    
+    remote_mutex_lock(&hubLock);
+    if(!hubClosing && (statusJson[target] == NULL ||
+                       statusSeq[target] == *seq))
+    {
+        remote_cond_timedwait(&hubChanged, &hubLock, ms);
+    }
+    int ret = 0;
+    if(hubClosing || !hubRunning)
+        ret = -1;
+    else if(statusJson[target] != NULL && statusSeq[target] != *seq) {
+        *json = malloc(strlen(statusJson[target])+1);
+        if(*json != NULL) {
+            strcpy(*json, statusJson[target]);
+            *seq = statusSeq[target];
+            ret = 1;
+        }
+    }
+    remote_mutex_unlock(&hubLock);
+    return ret;
+}
+
+/**
+ * @brief Copies the status pushed last by a playback context
+ * 
+ * @param target Target ID of the playback context
+ * @param len Receives the number of bytes of the status
+ * 
+ * @return The status to free or NULL if none has been pushed yet
+ */
+char *remote_http_events_status(int target, size_t *len) {
+    if(!hubInitialized || target < 0 || target >= REMOTE_TARGET_MAX)
+        return NULL;
+    char *json = NULL;
+    remote_mutex_lock(&hubLock);
+    if(statusJson[target] != NULL) {
+        *len = strlen(statusJson[target]);
+        json = malloc(*len + 1);
+        if(json != NULL)
+            memcpy(json, statusJson[target], *len + 1);
+    }
+    remote_mutex_unlock(&hubLock);
+    return json;
+}
+
+/**
+ * @brief Wakes every thread waiting in remote_http_events_wait()
+ */
+void remote_http_events_wake() {
+    if(!hubInitialized)
+        return;
+    remote_mutex_lock(&hubLock);
+    remote_cond_broadcast(&hubChanged);
+    remote_mutex_unlock(&hubLock);
+}
+
+
+
+
+static void stream_write(struct EventStream *stream, const char *data,
+                         size_t len)
+{
+    if(stream->pendingLength + len > stream->pendingSize) {
+        size_t size = stream->pendingSize * 2;
+        while(size < stream->pendingLength + len)
+            size *= 2;
+        char *buffer = realloc(stream->pending, size);
+        if(buffer == NULL)
+            return;
+        stream->pending = buffer;
+        stream->pendingSize = size;
+    }
+    memcpy(stream->pending + stream->pendingLength, data, len);
+    stream->pendingLength += len;
+}
+
+
+// Formats the events the stream has not seen, called with the hub locked
+static void stream_collect(struct EventStream *stream) {
+    int t = stream->target;
+    if(statusJson[t] != NULL && statusSeq[t] != stream->statusSeq) {
+        char head[96];
+        int len = snprintf(head, 96,
+                           "event: status\ndata: {\"clock\":%.6f,\"status\":",
+                           remote_status_clock());
+        stream_write(stream, head, len);
+        stream_write(stream, statusJson[t], strlen(statusJson[t]));
+        stream_write(stream, "}\n\n", 3);
+        stream->statusSeq = statusSeq[t];
+    }
+    
+    // Skips the lines already overwritten in the ring
+    uint64_t first = stream->logSeq + 1;
+    if(logSeq >= EVENT_LOG_COUNT && first <= logSeq - EVENT_LOG_COUNT)
+        first = logSeq - EVENT_LOG_COUNT + 1;
+    for(uint64_t seq=first; seq<=logSeq; seq++) {
+        struct EventLog *log = &logs[seq % EVENT_LOG_COUNT];
+        if(log->target != t)
+            continue;
+        
+        // Every line of a message gets its own data field
+        stream_write(stream, "event: log\n", 11);
+        const char *line = log->msg;
+        while(*line != '\0') {
+            size_t len = strcspn(line, "\n");
+            if(len > 0) {
+                stream_write(stream, "data: ", 6);
+                stream_write(stream, line, len);
+                stream_write(stream, "\n", 1);
+            }
+            line += len;
+            if(*line == '\n')
+                line++;
+        }
+        stream_write(stream, "\n", 1);
+    }
+    stream->logSeq = logSeq;
+}
+
+
+static ssize_t read_events(void *cls, uint64_t pos, char *buf, size_t max) {
+    (void) pos;
+    struct EventStream *stream = cls;
+    
+    if(stream->pendingPos >= stream->pendingLength) {
+        stream->pendingPos = 0;
+        stream->pendingLength = 0;
+        
+        remote_mutex_lock(&hubLock);
+        if(hubClosing) {
+            remote_mutex_unlock(&hubLock);
+            return MHD_CONTENT_READER_END_OF_STREAM;
+        }
+        stream_collect(stream);
+        double now = remote_status_clock();
+        if(stream->pendingLength == 0 &&
+           now - stream->lastWrite >= EVENT_KEEPALIVE)
+        {
+            stream_write(stream, ": keepalive\n\n", 13);
+        }
+        
+        // Waits for the next publication without holding a thread
+        if(stream->pendingLength == 0) {
+            stream->suspended = 1;
+            stream->next = suspended;
+            suspended = stream;
+            MHD_suspend_connection(stream->connection);
+            remote_mutex_unlock(&hubLock);
+            return 0;
+        }
+        remote_mutex_unlock(&hubLock);
+        stream->lastWrite = now;
+    }
+    
+    size_t len = stream->pendingLength - stream->pendingPos;
+    if(len > max)
+        len = max;
+    memcpy(buf, stream->pending + stream->pendingPos, len);
+    stream->pendingPos += len;
+    return (ssize_t) len;
+}
+
+
+static void free_events(void *cls) {
+    struct EventStream *stream = cls;
+    remote_mutex_lock(&hubLock);
+    if(stream->suspended) {
+        struct EventStream **p = &suspended;
+        while(*p != NULL && *p != stream)
+            p = &(*p)->next;
+        if(*p != NULL)
+            *p = stream->next;
+    }
+    remote_mutex_unlock(&hubLock);
+    free(stream->pending);
+    free(stream);
+}
+
+
+/**
+ * @brief Answers a request for the event stream of a playback context
+ * 
+ * Sets the response of the connection. The stream starts with the current
+ * status followed by the changes and the log lines of the context.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ * @param target Target ID of the playback context
+ */
+void remote_http_answer_events(struct MHD_Connection *connection,
+                               struct RemoteConnection *con_info,
+                               int target)
+{
+    if(!hubRunning || target < 0 || target >= REMOTE_TARGET_MAX) {
+        con_info->status = MHD_HTTP_NOT_FOUND;
+        return;
+    }
+    struct EventStream *stream = calloc(1, sizeof(struct EventStream));
+    if(stream == NULL) {
+        con_info->status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+        return;
+    }
+    stream->connection = connection;
+    stream->target = target;
+    stream->pendingSize = 1024;
+    stream->pending = malloc(stream->pendingSize);
+    if(stream->pending == NULL) {
+        free(stream);
+        con_info->status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+        return;
+    }
+    stream->lastWrite = remote_status_clock();
+    
+    // Starts from the current status but not from the old log lines
+    remote_mutex_lock(&hubLock);
+    stream->logSeq = logSeq;
+    remote_mutex_unlock(&hubLock);
+    
+    con_info->response = MHD_create_response_from_callback(
+        MHD_SIZE_UNKNOWN,
+        4096,
+        read_events,
+        stream,
+        free_events
+    );
+    if(con_info->response == NULL) {
+        free(stream->pending);
+        free(stream);
+        con_info->status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+        return;
+    }
+    con_info->content_type = "text/event-stream";
+    con_info->status = MHD_HTTP_OK;
+}
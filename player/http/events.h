@@ -0,0 +1,95 @@
+/**
+ * @file events.h
+ * @brief Pushes the status and the log to the clients as Server-Sent Events
+ * 
+ * The display program publishes every status push and log line to a hub.
+ * Each /events connection streams what it has not seen yet and stays
+ * suspended in between, so an idle client costs no request and no thread.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_EVENTS_H__
+#define __MPV_REMOTE_HTTP_EVENTS_H__ ///< Header guard
+
+#include "con_type.h"
+
+#include <stdint.h>
+
+#include <microhttpd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EVENT_LOG_COUNT 64 ///< Number of log lines kept for the streams
+#define EVENT_KEEPALIVE 15 ///< Seconds between the keepalive comments
+
+
+/**
+ * @brief Starts publishing the status and the log to the event streams
+ * 
+ * Has to be called before the web server starts.
+ */
+void remote_http_events_start();
+
+/**
+ * @brief Ends every event stream
+ * 
+ * Has to be called before the web server stops so that no connection is
+ * left suspended.
+ */
+void remote_http_events_stop();
+
+/**
+ * @brief Waits for a newer status of a playback context
+ * 
+ * Returns at once if the status already differs from the one seen last.
+ * 
+ * @param target Target ID of the playback context
+ * @param seq Sequence number of the status seen last, updated on return
+ * @param json Receives a copy of the status to be freed by the caller
+ * @param ms Timeout in milliseconds
+ * 
+ * @return 1 for a new status, 0 on timeout or wakeup and -1 once the
+ *         events have stopped
+ */
+int remote_http_events_wait(int target, uint64_t *seq, char **json, long ms);
+
+/**
+ * @brief Copies the status pushed last by a playback context
+ * 
+ * @param target Target ID of the playback context
+ * @param len Receives the number of bytes of the status
+ * 
+ * @return The status to free or NULL if none has been pushed yet
+ */
+char *remote_http_events_status(int target, size_t *len);
+
+/**
+ * @brief Wakes every thread waiting in remote_http_events_wait()
+ */
+void remote_http_events_wake();
+
+/**
+ * @brief Answers a request for the event stream of a playback context
+ * 
+ * Sets the response of the connection. The stream starts with the current
+ * status followed by the changes and the log lines of the context.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ * @param target Target ID of the playback context
+ */
+void remote_http_answer_events(struct MHD_Connection *connection,
+                               struct RemoteConnection *con_info,
+                               int target);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
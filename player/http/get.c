@@ -9,8 +9,21 @@
 
 
 #include "../../libremote/libremote.h"
+#include "../player.h"
+#include "assets.h"
 #include "auth.h"
-#include "config.h"
+#include "compress.h"
+#include "etag.h"
+#include "events.h"
+#include "jsonwriter.h"
+#include "library.h"
+#include "listing.h"
+#include "pool.h"
+#include "route.h"
+#include "stream.h"
+#include "thumbnail.h"
+#include "websocket.h"
+#include "worker.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -23,6 +36,7 @@
 #else
 #include <dirent.h>
 #include <linux/limits.h>
+#include <unistd.h>
 #endif
 
 #include <json.h>
@@ -38,7 +52,7 @@ static char *load_file(const char *file, const char *mode, size_t *len) {
     fseek(fp, 0L, SEEK_SET);
     char *buffer = malloc(file_size+1);
     size_t i = 0;
-
+    
     if(strncmp(mode, "r", 2) == 0) {
         char c;
         while((c = getc(fp)) != EOF)
@@ -53,150 +67,282 @@ static char *load_file(const char *file, const char *mode, size_t *len) {
     
     if(len != NULL)
         *len = i;
-
+    
     return buffer;
 }
 
 
 
 
+// Error pages are constant so that answering an error allocates nothing
+#define ERROR_HTML(title, message) \
+    "<!DOCTYPE html>" \
+    "<html>" \
+    "<head>" \
+    "  <title>" title "</title>" \
+    "</head>" \
+    "<body>" \
+    "  <h1>" message "</h1>" \
+    "</body>" \
+    "</html>"
+
 static void error_answer(struct RemoteConnection *con_info, int error_code) {
+    static const char not_found_html[] =
+        ERROR_HTML("404 Not Found", "This URL isn't available.");
+    static const char unauthorized_html[] =
+        ERROR_HTML("Unauthorized",
+                   "You need to be authenticated to proceed the request.");
+    static const char unsupported_html[] =
+        ERROR_HTML("Unsupported Media", "This media type isn't supported.");
+    static const char server_error_html[] =
+        ERROR_HTML("Error 500", "Sorry, an internal server error occured.");
     static const char error_html[] =
-        "<!DOCTYPE html>"
-        "<html>"
-        "<head>"
-        "  <title>%s</title>"
-        "</head>"
-        "<body>"
-        "  <h1>%s</h1>"
-        "</body>"
-        "</html>";
+        ERROR_HTML("Error", "An error occured.");
     
-    // Constructs an error message
-    strcpy(con_info->content_type, "text/html");
+    // Drops a reply prepared before the error
+    if(con_info->reply != NULL && !con_info->reply_persistent)
+        free(con_info->reply);
+    
+    // Picks the error message
+    const char *page;
+    if(error_code == MHD_HTTP_NOT_FOUND)
+        page = not_found_html;
+    else if (error_code == MHD_HTTP_UNAUTHORIZED)
+        page = unauthorized_html;
+    else if(error_code == MHD_HTTP_UNSUPPORTED_MEDIA_TYPE)
+        page = unsupported_html;
+    else if(error_code == MHD_HTTP_INTERNAL_SERVER_ERROR)
+        page = server_error_html;
+    else
+        page = error_html;
+    con_info->content_type = "text/html";
     con_info->status = error_code;
-    con_info->reply = malloc(512);
-    size_t len;
-    if(error_code == MHD_HTTP_NOT_FOUND) {
-        len = sprintf(con_info->reply, error_html, "404 Not Found",
-                      "This URL isn't available.");
+    con_info->reply = (char*) page;
+    con_info->reply_length = strlen(page);
+    con_info->reply_persistent = 1;
+}
+
+
+
+
+/**
+ * @brief Property readable through GET /property
+ */
+struct PropertyType {
+    const char *name; ///< Property name
+    mpv_format format; ///< Format the property is read in
+};
+
+static const struct PropertyType properties[] = {
+    {"time-pos", MPV_FORMAT_DOUBLE},
+    {"duration", MPV_FORMAT_DOUBLE},
+    {"percent-pos", MPV_FORMAT_DOUBLE},
+    {"speed", MPV_FORMAT_DOUBLE},
+    {"volume", MPV_FORMAT_DOUBLE},
+    {"demuxer-cache-duration", MPV_FORMAT_DOUBLE},
+    {"cache-buffering-state", MPV_FORMAT_INT64},
+    {"chapter", MPV_FORMAT_INT64},
+    {"pause", MPV_FORMAT_FLAG},
+    {"mute", MPV_FORMAT_FLAG},
+    {"media-title", MPV_FORMAT_STRING},
+};
+
+
+static struct json_object *read_property(int target, const char *name) {
+    const struct PropertyType *prop = NULL;
+    for(size_t i=0; i<sizeof(properties)/sizeof(properties[0]); i++) {
+        if(strcmp(name, properties[i].name) == 0) {
+            prop = &properties[i];
+            break;
+        }
     }
-    else if (error_code == MHD_HTTP_UNAUTHORIZED) {
-        len = sprintf(con_info->reply, error_html, "Unauthorized",
-                      "You need to be authenticated to proceed the request.");
+    if(prop == NULL)
+        return NULL;
+    
+    int res;
+    struct json_object *value = NULL;
+    if(prop->format == MPV_FORMAT_DOUBLE) {
+        double d;
+        res = remote_player_client_get_property(target, name, prop->format, &d);
+        if(res == 0)
+            value = json_object_new_double(d);
     }
-    else if(error_code == MHD_HTTP_UNSUPPORTED_MEDIA_TYPE) {
-        len = sprintf(con_info->reply, error_html, "Unsupported Media",
-                      "This media type isn't supported.");
+    else if(prop->format == MPV_FORMAT_INT64) {
+        int64_t n;
+        res = remote_player_client_get_property(target, name, prop->format, &n);
+        if(res == 0)
+            value = json_object_new_int64(n);
     }
-    else if(error_code == MHD_HTTP_INTERNAL_SERVER_ERROR) {
-        len = sprintf(con_info->reply, error_html, "Error 500",
-                      "Sorry, an internal server error occured.");
+    else if(prop->format == MPV_FORMAT_FLAG) {
+        int flag;
+        res = remote_player_client_get_property(target, name, prop->format,
+                                                &flag);
+        if(res == 0)
+            value = json_object_new_boolean(flag);
     }
     else {
-        len = sprintf(con_info->reply, error_html, "Error",
-                      "An error occured.");
+        char *str;
+        res = remote_player_client_get_property(target, name, prop->format,
+                                                &str);
+        if(res == 0) {
+            value = json_object_new_string(str);
+            mpv_free(str);
+        }
     }
-    con_info->reply_length = len;
+    
+    // Unavailable properties like the time before loading read as null
+    struct json_object *root = json_object_new_object();
+    json_object_object_add(root, "name", json_object_new_string(name));
+    json_object_object_add(root, "value", value);
+    return root;
 }
 
 
 
 
-struct MimeType {
-    char ext[6];
-    char alt[16];
-    char mediatype[12];
-    int binary;
+/**
+ * @brief Listing or thumbnails asked for, living in the request memory
+ *        until the worker is done
+ */
+struct RemoteThumbnailRequest {
+    struct RemoteListingQuery query; ///< The page of the directory
+    struct RemoteThumbnailVariant variant; ///< The size and format asked for
+    const char *match; ///< Value of the If-None-Match header or NULL
 };
 
 
-static void answer_to_get_special(
-    struct MHD_Connection *connection,
-    const char *url,
-    const char *upload_data,
-    size_t *upload_data_size,
-    void **con_cls
-);
+static char *list_drives(const struct RemoteListingQuery *query,
+                         size_t *len);
 
-static char *browse_directory(const char *path, size_t *len);
-static char *list_drives(size_t *len);
-static char *get_thumbnail(const char *file, size_t *len);
+
+// Compresses the reply of a service and tells how it may be cached
+static void finish_reply(struct MHD_Connection *connection,
+                         struct RemoteConnection *con_info)
+{
+    remote_http_compress_reply(connection, con_info);
+    int cacheable = (con_info->status == MHD_HTTP_OK ||
+                     con_info->status == MHD_HTTP_PARTIAL_CONTENT ||
+                     con_info->status == MHD_HTTP_NOT_MODIFIED);
+    if(cacheable && con_info->route->cache_control != NULL) {
+        remote_http_add_header(con_info, "Cache-Control",
+                               con_info->route->cache_control);
+    }
+}
 
 
+// Lists a directory or the drives on a worker since the disk may be slow
+static void browse_job(struct RemoteConnection *con_info, const char *path) {
+    struct RemoteThumbnailRequest *request = con_info->job_data;
+    struct RemoteListingQuery *query = &request->query;
+    size_t json_length = 0;
+    if(path == NULL)
+        con_info->reply = list_drives(query, &json_length);
+    else {
+        // The videos of the page are rendered ahead of their requests
+        struct RemoteThumbnailBatch *batch;
+        batch = remote_http_thumbnail_batch(path, &request->variant);
+        query->visit = remote_http_thumbnail_add;
+        query->visit_data = batch;
+        con_info->reply = remote_http_listing_json(path, query, &json_length);
+        remote_http_thumbnail_queue(batch);
+    }
+    if(con_info->reply == NULL) {
+        error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+    con_info->reply_length = json_length;
+    con_info->status = MHD_HTTP_OK;
+    con_info->content_type = "application/json";
+}
 
 
-void remote_http_handle_get(
-    struct MHD_Connection *connection,
-    const char *url,
-    const char *upload_data,
-    size_t *upload_data_size,
-    void **con_cls
-)
-{
-    struct RemoteConnection *con_info = *con_cls;
-    
-    // Checks if the url is a special GET request
-    answer_to_get_special(connection, url, upload_data,
-                          upload_data_size, con_cls);
-    if(con_info->reply || con_info->status != 0)
+// Packs the thumbnails of a page on a worker, answering revalidations
+// from the map before the thumbnails are read
+static void sprite_job(struct RemoteConnection *con_info, const char *path) {
+    struct RemoteThumbnailRequest *request = con_info->job_data;
+    struct RemoteThumbnailBatch *batch;
+    batch = remote_http_thumbnail_batch(path, &request->variant);
+    if(batch == NULL) {
+        error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
         return;
-    
-    char file_path[128];
-    snprintf(file_path, 127, HTTP_PREFIX "%s", url);
-    char *ext = strrchr(url, '.');
-    if(ext == NULL) {
-        error_answer(con_info, MHD_HTTP_UNSUPPORTED_MEDIA_TYPE);
+    }
+    request->query.visit = remote_http_thumbnail_add;
+    request->query.visit_data = batch;
+    size_t json_length = 0;
+    char *json = remote_http_listing_json(path, &request->query,
+                                          &json_length);
+    if(json == NULL) {
+        remote_http_thumbnail_queue(batch);
+        error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
         return;
     }
-    ext += 1;
+    free(json);
     
-    // Checks the extensions to determine the mimetype
-    static const struct MimeType mimetypes[] = {
-        {"html", "html", "text", 0},
-        {"css", "css", "text", 0},
-        {"js", "javascript", "text", 0},
-        {"png", "png", "image", 1},
-        {"ico", "icon", "image", 1},
-        {"svg", "svg", "image", 0},
-        {"ttf", "ttf", "font", 1},
-        {"woff", "woff", "font", 1},
-        {"woff2", "woff2", "font", 1},
-    };
-    int binary = 0;
-    int isSupported = 0;
-
-    for(int i=0; i<9; i++) {
-        if(strncmp(ext, mimetypes[i].ext, 5) == 0) {
-            const char *alt = mimetypes[i].alt;
-            const char *mediatype = mimetypes[i].mediatype;
-            snprintf(con_info->content_type, 23, "%s/%s", mediatype, alt);
-            binary = mimetypes[i].binary;
-            isSupported = 1;
-            break;
-        }
+    char etag[ETAG_SIZE];
+    if(remote_http_thumbnail_map(batch, THUMBNAIL_SPRITE_WAIT, etag) != 0) {
+        remote_http_thumbnail_queue(batch);
+        error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+    if(remote_http_etag_matches(request->match, etag)) {
+        remote_http_thumbnail_queue(batch);
+        remote_http_add_header(con_info, "ETag", etag);
+        con_info->content_type = "";
+        con_info->status = MHD_HTTP_NOT_MODIFIED;
+        return;
+    }
+    size_t len = 0;
+    con_info->reply = remote_http_thumbnail_sprite(batch, etag, &len);
+    remote_http_thumbnail_queue(batch);
+    if(con_info->reply == NULL) {
+        error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
+        return;
     }
+    remote_http_add_header(con_info, "ETag", etag);
+    con_info->reply_length = len;
+    con_info->status = MHD_HTTP_OK;
+    con_info->content_type = "application/octet-stream";
+}
+
 
-    if(!isSupported) {
-        error_answer(con_info, MHD_HTTP_UNSUPPORTED_MEDIA_TYPE);
+// Serves a thumbnail from the cache on a worker, rendering it first if
+// it is not kept since ffmpeg takes a while
+static void thumbnail_job(struct RemoteConnection *con_info,
+                          const char *file)
+{
+    const struct RemoteThumbnailRequest *request = con_info->job_data;
+    char etag[ETAG_SIZE];
+    if(remote_http_thumbnail_tag(file, &request->variant, etag) != 0) {
+        error_answer(con_info, MHD_HTTP_NOT_FOUND);
+        return;
+    }
+    remote_http_add_header(con_info, "ETag", etag);
+    if(remote_http_etag_matches(request->match, etag)) {
+        con_info->content_type = "";
+        con_info->status = MHD_HTTP_NOT_MODIFIED;
         return;
     }
     
-    // Reads the file and loads the content to a buffer
-    size_t file_size = 0;
-    con_info->reply = load_file(file_path, binary?"rb":"r", &file_size);
-    if(con_info->reply == NULL) {
+    uint64_t size = 0;
+    int fd = remote_http_thumbnail_open(file, &request->variant, etag,
+                                        &size);
+    if(fd < 0) {
         error_answer(con_info, MHD_HTTP_NOT_FOUND);
         return;
     }
-    con_info->reply_length = file_size;
+    con_info->stream_fd = fd;
+    con_info->stream_offset = 0;
+    con_info->stream_length = size;
     con_info->status = MHD_HTTP_OK;
+    con_info->content_type = remote_http_thumbnail_type(
+        request->variant.format
+    );
 }
 
 
 
 
-static void answer_to_get_special(
+void remote_http_handle_get(
     struct MHD_Connection *connection,
     const char *url,
     const char *upload_data,
@@ -204,275 +350,519 @@ static void answer_to_get_special(
     void **con_cls
 )
 {
-    if(strcmp(url, "/") == 0)
-        url = "/index.html";
-    char file_path[128];
-    snprintf(file_path, 127, HTTP_PREFIX "%s", url);
+    struct RemoteConnection *con_info = *con_cls;
+    const struct RemoteRoute *route = con_info->route;
     
-    // Prepares the page footer
-    static char footer_content[4096];
-    static size_t footer_content_size = 0;
-    static int footer_read = 0;
-    if(!footer_read) {
-        size_t file_size;
-        char *buffer = load_file(HTTP_PREFIX "/footer.html", "r", &file_size);
-        if(buffer != NULL) {
-            int ret = snprintf(footer_content, 4095, buffer,
-                               REMOTE_VERSION_STRING);
-            free(buffer);
-            if(ret == -1) {
-                footer_content[0] = '\0';
-                footer_content_size = 0;
-            }
-            else {
-                footer_content_size = ret;
-            }
+    // The reply prepared by a worker is only finished on resuming
+    if(con_info->job_state == JOB_DONE) {
+        finish_reply(connection, con_info);
+        return;
+    }
+    
+    // Answers the services
+    if(route != NULL) {
+        if((route->flags & ROUTE_AUTH) &&
+           !remote_http_is_authenticated(con_info))
+        {
+            error_answer(con_info, MHD_HTTP_UNAUTHORIZED);
+            return;
         }
-        else
-            footer_content[0] = '\0';
-        footer_read = 1;
+        route->handler(connection, con_info);
+        if(con_info->job_state != JOB_RUNNING)
+            finish_reply(connection, con_info);
+        return;
     }
     
-    struct RemoteConnection *con_info = *con_cls;
-    strcpy(con_info->content_type, "text/html");
+    // Serves the static files from the embedded bundle
+    const struct RemoteAsset *asset = remote_http_find_asset(url);
+    if(asset == NULL) {
+        error_answer(con_info, MHD_HTTP_NOT_FOUND);
+        return;
+    }
+    remote_http_add_header(con_info, "ETag", asset->etag);
+    remote_http_add_header(con_info, "Cache-Control", ASSET_CACHE_CONTROL);
+    remote_http_add_header(con_info, "Vary", "Accept-Encoding");
+    
+    const char *match = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        MHD_HTTP_HEADER_IF_NONE_MATCH
+    );
+    if(remote_http_etag_matches(match, asset->etag)) {
+        con_info->content_type = "";
+        con_info->status = MHD_HTTP_NOT_MODIFIED;
+        return;
+    }
     
-    // Serves the special URLs
-    if(strcmp(url, "/index.html") == 0 || strcmp(url, "/settings.html") == 0)
+    // Picks the smallest body the client can decode
+    const char *accept = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        MHD_HTTP_HEADER_ACCEPT_ENCODING
+    );
+    const unsigned char *body = asset->identity;
+    size_t length = asset->identity_length;
+    if(asset->brotli != NULL && remote_http_accepts_encoding(accept, "br")) {
+        body = asset->brotli;
+        length = asset->brotli_length;
+        remote_http_add_header(con_info, "Content-Encoding", "br");
+    }
+    else if(asset->gzip != NULL &&
+            remote_http_accepts_encoding(accept, "gzip"))
     {
-        size_t file_size;
-        char *buffer = load_file(file_path, "r", &file_size);
-        if(buffer == NULL) {
-            error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
-            return;
-        }
-        con_info->reply = malloc(file_size+footer_content_size);
-        size_t len = snprintf(con_info->reply, file_size+footer_content_size,
-                              buffer, footer_content);
-        con_info->reply_length = len;
-        con_info->status = MHD_HTTP_OK;
-        free(buffer);
+        body = asset->gzip;
+        length = asset->gzip_length;
+        remote_http_add_header(con_info, "Content-Encoding", "gzip");
     }
-    else if(strcmp(url, "/browse") == 0) {
-        if(!remote_http_is_authenticated(con_info)) {
-            error_answer(con_info, MHD_HTTP_UNAUTHORIZED);
-            return;
-        }
-        
-        const char *p = MHD_lookup_connection_value(
-            connection,
-            MHD_GET_ARGUMENT_KIND,
-            "path"
-        );
+    
+    con_info->content_type = asset->content_type;
+    con_info->reply = (char*) body;
+    con_info->reply_length = length;
+    con_info->reply_persistent = 1;
+    con_info->status = MHD_HTTP_OK;
+}
 
-        size_t json_length = 0;
 
-        if(p == NULL) {
-            con_info->reply = list_drives(&json_length);
-        }
-        else {
-            char path[PATH_MAX];
-            remote_environment_process_variables(p, path);
-            con_info->reply = browse_directory(path, &json_length);
-        }
 
-        con_info->reply_length = json_length;
-        con_info->status = MHD_HTTP_OK;
-        strcpy(con_info->content_type, "application/json");
+
+/**
+ * @brief Answers GET / with the main page and GET /settings.html
+ * 
+ * The pages are rendered from the bundled templates with the version and
+ * the footer.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_page(struct MHD_Connection *connection,
+                          struct RemoteConnection *con_info)
+{
+    const char *url = con_info->url;
+    if(strcmp(url, "/") == 0)
+        url = "/index.html";
+    const struct RemoteAsset *page = remote_http_find_asset(url);
+    const struct RemoteAsset *footer;
+    footer = remote_http_find_asset("/footer.html");
+    if(page == NULL || footer == NULL) {
+        error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
+        return;
     }
-    else if(strcmp(url, "/thumbnail") == 0) {
-        if(!remote_http_is_authenticated(con_info)) {
-            error_answer(con_info, MHD_HTTP_UNAUTHORIZED);
-            return;
-        }
+    
+    // Fills the templates bundled with the version and the footer
+    char footer_content[4096];
+    int ret = snprintf(footer_content, 4096,
+                       (const char*) footer->identity,
+                       REMOTE_VERSION_STRING);
+    if(ret < 0)
+        footer_content[0] = '\0';
+    size_t size = page->identity_length + strlen(footer_content) + 1;
+    con_info->reply = malloc(size);
+    ret = snprintf(con_info->reply, size, (const char*) page->identity,
+                   footer_content);
+    con_info->reply_length = (ret < 0) ? 0 : ret;
+    
+    // The page is always revalidated since it is rendered
+    char etag[ETAG_SIZE];
+    remote_http_etag(con_info->reply, con_info->reply_length, etag);
+    remote_http_add_header(con_info, "ETag", etag);
+    const char *match = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        MHD_HTTP_HEADER_IF_NONE_MATCH
+    );
+    if(remote_http_etag_matches(match, etag)) {
+        free(con_info->reply);
+        con_info->reply = NULL;
+        con_info->reply_length = 0;
+        con_info->content_type = "";
+        con_info->status = MHD_HTTP_NOT_MODIFIED;
+        return;
+    }
+    con_info->status = MHD_HTTP_OK;
+}
 
-        const char* p = MHD_lookup_connection_value(
-            connection,
-            MHD_GET_ARGUMENT_KIND,
-            "file"
-        );
+// Reads a parameter of the query string
+static const char *get_argument(struct MHD_Connection *connection,
+                                const char *key)
+{
+    return MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND,
+                                       key);
+}
 
-        size_t file_size = 0;
 
-        if(p == NULL) {
-            error_answer(con_info, MHD_HTTP_BAD_REQUEST);
-            return;
-        }
-        else {
-            char file_path[PATH_MAX];
-            remote_environment_process_variables(p, file_path);
-            con_info->reply = get_thumbnail(file_path, &file_size);
-        }
+// Parses the listing and thumbnail parameters into the request memory,
+// returns NULL if out of memory
+static struct RemoteThumbnailRequest *parse_request(
+    struct MHD_Connection *connection,
+    struct RemoteConnection *con_info
+)
+{
+    struct RemoteThumbnailRequest *request;
+    request = remote_http_alloc(con_info,
+                                sizeof(struct RemoteThumbnailRequest));
+    if(request == NULL)
+        return NULL;
+    remote_http_listing_query(
+        &request->query,
+        get_argument(connection, "sort"),
+        get_argument(connection, "order"),
+        get_argument(connection, "type"),
+        get_argument(connection, "offset"),
+        get_argument(connection, "limit")
+    );
+    const char *cursor = get_argument(connection, "cursor");
+    if(cursor != NULL) {
+        request->query.cursor = remote_http_strdup(con_info, cursor);
+        if(request->query.cursor == NULL)
+            return NULL;
+    }
+    remote_http_thumbnail_variant(
+        &request->variant,
+        get_argument(connection, "width"),
+        get_argument(connection, "format"),
+        get_argument(connection, "quality")
+    );
+    
+    // The worker answers the revalidations without rendering anything
+    const char *match = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        MHD_HTTP_HEADER_IF_NONE_MATCH
+    );
+    request->match = NULL;
+    if(match != NULL)
+        request->match = remote_http_strdup(con_info, match);
+    return request;
+}
 
-        if(con_info->reply == NULL) {
-            error_answer(con_info, MHD_HTTP_NOT_FOUND);
-            return;
-        }
+/**
+ * @brief Answers GET /browse with the listing of a directory
+ * 
+ * Lists the drives without the path parameter. The entries are sorted by
+ * the sort and order parameters, filtered by the type parameter and paged
+ * by the offset, limit and cursor parameters. The thumbnails of the videos
+ * listed are rendered ahead in the variant of the width, format and
+ * quality parameters.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_browse(struct MHD_Connection *connection,
+                            struct RemoteConnection *con_info)
+{
+    const char *p = get_argument(connection, "path");
+    
+    struct RemoteThumbnailRequest *request;
+    request = parse_request(connection, con_info);
+    if(request == NULL) {
+        error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+    con_info->job_data = request;
+    
+    if(p == NULL)
+        remote_http_worker_submit(connection, con_info, browse_job, NULL);
+    else {
+        char path[PATH_MAX];
+        remote_environment_process_variables(p, path);
+        remote_http_worker_submit(connection, con_info, browse_job, path);
+    }
+}
 
-        con_info->reply_length = file_size;
-        con_info->status = MHD_HTTP_OK;
-        strcpy(con_info->content_type, "image/png");
-    }
-    else if(strcmp(url, "/is-authenticated") == 0) {
-        strcpy(con_info->content_type, "");
-        int auth = remote_http_is_authenticated(con_info);
-        con_info->status = auth ? MHD_HTTP_OK : MHD_HTTP_UNAUTHORIZED;
-    }
-    else if(strcmp(url, "/status") == 0) {
-        strcpy(con_info->content_type, "application/json");
-        #ifdef _WIN32
-        char jsonFile[PATH_MAX];
-        snprintf(jsonFile, PATH_MAX, "%s\\mpv-status.json", getenv("TEMP"));
-        #else
-        const char *jsonFile = "/tmp/mpv-status.json";
-        #endif
-        
-        if(remote_http_is_authenticated(con_info)) {
-            size_t file_size;
-            char *json = load_file(jsonFile, "r", &file_size);
-            if(json == NULL) {
-                error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
-                return;
-            }
-            con_info->reply = json;
-            con_info->reply_length = file_size;
-            con_info->status = MHD_HTTP_OK;
-        }
-        else
-            error_answer(con_info, MHD_HTTP_UNAUTHORIZED);
+/**
+ * @brief Answers GET /thumbnail with a frame of a video
+ * 
+ * The thumbnail is sized by the width parameter, up to THUMBNAIL_WIDTH,
+ * and encoded in the format parameter, png, jpeg or webp, at the quality
+ * parameter.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_thumbnail(struct MHD_Connection *connection,
+                               struct RemoteConnection *con_info)
+{
+    const char* p = MHD_lookup_connection_value(
+        connection,
+        MHD_GET_ARGUMENT_KIND,
+        "file"
+    );
+    
+    if(p == NULL) {
+        error_answer(con_info, MHD_HTTP_BAD_REQUEST);
+        return;
+    }
+    
+    con_info->job_data = parse_request(connection, con_info);
+    if(con_info->job_data == NULL) {
+        error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
+        return;
     }
+    char file_path[PATH_MAX];
+    remote_environment_process_variables(p, file_path);
+    remote_http_worker_submit(connection, con_info, thumbnail_job,
+                              file_path);
 }
 
+/**
+ * @brief Answers GET /thumbnails with the thumbnails of a page as a sprite
+ * 
+ * The page and the variant are picked by the same parameters as GET
+ * /browse. The sprite is the JSON map of the thumbnails, a line feed and
+ * the thumbnails packed one after another. The sprite waits a while for
+ * the videos of the page queued to render. The videos left out of the map
+ * have no thumbnail yet and are queued to render ahead.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_thumbnails(struct MHD_Connection *connection,
+                                struct RemoteConnection *con_info)
+{
+    const char *p = get_argument(connection, "path");
+    if(p == NULL) {
+        error_answer(con_info, MHD_HTTP_BAD_REQUEST);
+        return;
+    }
+    
+    con_info->job_data = parse_request(connection, con_info);
+    if(con_info->job_data == NULL) {
+        error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+    
+    char path[PATH_MAX];
+    remote_environment_process_variables(p, path);
+    remote_http_worker_submit(connection, con_info, sprite_job, path);
+}
 
+/**
+ * @brief Answers GET /events with the event stream of a playback context
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_events(struct MHD_Connection *connection,
+                            struct RemoteConnection *con_info)
+{
+    const char *t = MHD_lookup_connection_value(
+        connection,
+        MHD_GET_ARGUMENT_KIND,
+        "target"
+    );
+    int target = remote_target_parse(t, remote_status_get_targets());
+    if(target < 0) {
+        error_answer(con_info, MHD_HTTP_BAD_REQUEST);
+        return;
+    }
+    remote_http_answer_events(connection, con_info, target);
+    if(con_info->status != MHD_HTTP_OK)
+        error_answer(con_info, con_info->status);
+}
 
+/**
+ * @brief Answers GET /control by upgrading to a WebSocket
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_control(struct MHD_Connection *connection,
+                             struct RemoteConnection *con_info)
+{
+    const char *t = MHD_lookup_connection_value(
+        connection,
+        MHD_GET_ARGUMENT_KIND,
+        "target"
+    );
+    int target = remote_target_parse(t, remote_status_get_targets());
+    if(target < 0) {
+        error_answer(con_info, MHD_HTTP_BAD_REQUEST);
+        return;
+    }
+    remote_http_answer_websocket(connection, con_info, target);
+    if(con_info->status != MHD_HTTP_SWITCHING_PROTOCOLS)
+        error_answer(con_info, con_info->status);
+}
 
-static char *browse_directory(const char *path, size_t *len) {
-    #ifdef _WIN32
-    WIN32_FIND_DATA ffd;
-    TCHAR szDir[PATH_MAX];
-    HANDLE hFind = INVALID_HANDLE_VALUE;
-    DWORD dwError = 0;
-    _stprintf(szDir, "%s\\*", path);
-    hFind = FindFirstFile(szDir, &ffd);
-    #else
-    DIR *d;
-    struct dirent *dir;
-    d = opendir(path);
-    #endif
+/**
+ * @brief Answers GET /stream with a media file
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_stream(struct MHD_Connection *connection,
+                            struct RemoteConnection *con_info)
+{
+    const char *p = MHD_lookup_connection_value(
+        connection,
+        MHD_GET_ARGUMENT_KIND,
+        "file"
+    );
+    if(p == NULL) {
+        error_answer(con_info, MHD_HTTP_BAD_REQUEST);
+        return;
+    }
     
-    struct json_object* jobj = json_object_new_object();
-    struct json_object* jarray = json_object_new_array();
-    json_object_object_add(jobj, "files", jarray);
+    // Hands the file itself to the response without reading it
+    char file_path[PATH_MAX];
+    remote_environment_process_variables(p, file_path);
+    remote_http_answer_stream(connection, con_info, file_path);
+    if(con_info->status == MHD_HTTP_NOT_FOUND)
+        error_answer(con_info, MHD_HTTP_NOT_FOUND);
+}
 
-    #ifdef _WIN32
-    if(hFind == INVALID_HANDLE_VALUE) {
-    #else
-    if(d) {
-        dir = readdir(d);
+/**
+ * @brief Answers GET /search with the library files matching a query
+ * 
+ * The words of the q parameter are looked for in the names of the media
+ * files indexed, filtered by the type parameter. The limit parameter
+ * bounds the matches listed.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_search(struct MHD_Connection *connection,
+                            struct RemoteConnection *con_info)
+{
+    const char *q = get_argument(connection, "q");
+    const char *limit = get_argument(connection, "limit");
+    if(q == NULL) {
+        error_answer(con_info, MHD_HTTP_BAD_REQUEST);
+        return;
     }
-    else {
-    #endif
-        const char* content = json_object_to_json_string_ext(
-            jobj,
-            JSON_C_TO_STRING_PRETTY
-        );
-        size_t reply_length = strlen(content);
-        *len = reply_length;
-        char* reply = malloc(reply_length+1);
-        reply[reply_length] = '\0';
-        memcpy(reply, content, reply_length);
-        json_object_put(jobj);
-        return reply;
-    }
-
-    static const char *video_ext[] = {
-        "mp4", "mov", "wmv", "flv", "avi", "avchd", "webm", "mkv"
-    };
-    static const char *audio_ext[] = {
-        "m4a", "flac", "mp3", "wav", "mwa", "aac"
-    };
-
-    do {
-        const char *filename;
-        #ifdef _WIN32
-        filename = ffd.cFileName;
-        #else
-        filename = dir->d_name;
-        #endif
-        
-        if(strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0)
-            continue;
-        
-        const char *type = NULL;
-        #ifdef _WIN32
-        if(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-        #else
-        if(dir->d_type == DT_DIR) {
-        #endif
-            type = "directory";
-        }
-        else {
-            char *ext = strrchr(filename, '.');
-            while(ext != NULL) {
-                ext += 1;
-                for(int i=0; i<8; i++) {
-                    if(strncmp(ext, video_ext[i], 5) == 0) {
-                        type = "video";
-                        break;
-                    }
-                }
-                if(type != NULL)
-                    break;
-                for(int i=0; i<6; i++) {
-                    if(strncmp(ext, audio_ext[i], 5) == 0) {
-                        type = "audio";
-                        break;
-                    }
-                }
-                break;
-            }
-        }
-
-        if(type != NULL) {
-            struct json_object *jfile = json_object_new_object();
-            json_object_object_add(jfile, "name",
-                                   json_object_new_string(filename));
-            json_object_object_add(jfile, "type",
-                                   json_object_new_string(type));
-            json_object_array_add(jarray, jfile);
-        }
-    #ifdef _WIN32
-    } while(FindNextFile(hFind, &ffd) != 0);
-    #else
-    } while((dir = readdir(d)) != NULL);
-    #endif
+    size_t max = (limit != NULL) ? strtoul(limit, NULL, 10) : LIBRARY_LIMIT;
+    if(max == 0 || max > LIBRARY_LIMIT_MAX)
+        max = LIBRARY_LIMIT_MAX;
     
-    #ifdef _WIN32
-    FindClose(hFind);
-    #else
-    closedir(d);
-    #endif
+    // The index is in memory so the search is answered right away
+    int types = remote_http_listing_types(get_argument(connection, "type"));
+    con_info->reply = remote_http_library_search(q, types, max,
+                                                 &con_info->reply_length);
+    if(con_info->reply == NULL) {
+        error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+    con_info->status = MHD_HTTP_OK;
+}
+
+/**
+ * @brief Answers GET /property with a property read from the player
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_property(struct MHD_Connection *connection,
+                              struct RemoteConnection *con_info)
+{
+    const char *name = MHD_lookup_connection_value(
+        connection,
+        MHD_GET_ARGUMENT_KIND,
+        "name"
+    );
+    const char *t = MHD_lookup_connection_value(
+        connection,
+        MHD_GET_ARGUMENT_KIND,
+        "target"
+    );
+    int target = remote_target_parse(t, remote_status_get_targets());
+    if(name == NULL || target < 0) {
+        error_answer(con_info, MHD_HTTP_BAD_REQUEST);
+        return;
+    }
     
-    const char *content = json_object_to_json_string_ext(
-        jobj,
-        JSON_C_TO_STRING_PRETTY
+    // Reads the property straight from the player
+    struct json_object *root = read_property(target, name);
+    if(root == NULL) {
+        error_answer(con_info, MHD_HTTP_NOT_FOUND);
+        return;
+    }
+    const char *json = json_object_to_json_string_ext(
+        root,
+        JSON_C_TO_STRING_PLAIN
     );
-    size_t reply_length = strlen(content);
-    *len = reply_length;
-    char* reply = malloc(reply_length);
-    memcpy(reply, content, reply_length);
-    json_object_put(jobj);
-    return reply;
+    con_info->reply_length = strlen(json);
+    con_info->reply = malloc(con_info->reply_length+1);
+    strcpy(con_info->reply, json);
+    json_object_put(root);
+    con_info->status = MHD_HTTP_OK;
 }
 
+/**
+ * @brief Answers GET /is-authenticated with 200 or 401
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_is_authenticated(struct MHD_Connection *connection,
+                                      struct RemoteConnection *con_info)
+{
+    (void) connection;
+    int auth = remote_http_is_authenticated(con_info);
+    con_info->status = auth ? MHD_HTTP_OK : MHD_HTTP_UNAUTHORIZED;
+}
+
+/**
+ * @brief Answers GET /status with the status of a playback context
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_get_status(struct MHD_Connection *connection,
+                            struct RemoteConnection *con_info)
+{
+    const char *t = MHD_lookup_connection_value(
+        connection,
+        MHD_GET_ARGUMENT_KIND,
+        "target"
+    );
+    int target = remote_target_parse(t, remote_status_get_targets());
+    if(target < 0) {
+        error_answer(con_info, MHD_HTTP_BAD_REQUEST);
+        return;
+    }
+    
+    if(remote_http_is_authenticated(con_info)) {
+        // The status pushed last is in memory, the file is only read
+        // before the first push
+        size_t file_size = 0;
+        char *json = remote_http_events_status(target, &file_size);
+        if(json == NULL) {
+            char jsonFile[PATH_MAX];
+            remote_target_select(target);
+            remote_target_file(jsonFile, "mpv-status", ".json");
+            json = load_file(jsonFile, "r", &file_size);
+        }
+        if(json == NULL) {
+            error_answer(con_info, MHD_HTTP_INTERNAL_SERVER_ERROR);
+            return;
+        }
+        con_info->reply = json;
+        con_info->reply_length = file_size;
+        con_info->status = MHD_HTTP_OK;
+        
+        // Lets the client relate the status timestamp to its own clock
+        char clock[32];
+        snprintf(clock, 32, "%.6f", remote_status_clock());
+        remote_http_add_header(con_info, "X-Remote-Clock", clock);
+    }
+    else
+        error_answer(con_info, MHD_HTTP_UNAUTHORIZED);
+}
 
 
 
-static char *list_drives(size_t *len) {
-    #ifdef _WIN32
-    struct json_object* jobj = json_object_new_object();
-    struct json_object* jarray = json_object_new_array();
-    json_object_object_add(jobj, "files", jarray);
 
+static char *list_drives(const struct RemoteListingQuery *query,
+                         size_t *len)
+{
+    #ifdef _WIN32
+    (void) query;
+    struct RemoteJsonWriter writer;
+    remote_http_json_init(&writer, 0);
+    remote_http_json_begin_object(&writer);
+    remote_http_json_key(&writer, "files");
+    remote_http_json_begin_array(&writer);
+    
     for(TCHAR drive='D'; drive<='H'; drive++) {
         WIN32_FIND_DATA ffd;
         TCHAR szDir[PATH_MAX];
@@ -481,78 +871,22 @@ static char *list_drives(size_t *len) {
         _stprintf(szDir, "%c:\\*", drive);
         hFind = FindFirstFile(szDir, &ffd);
         if(hFind != INVALID_HANDLE_VALUE) {
-            struct json_object* jfile = json_object_new_object();
             char label[3] = {drive, ':', '\0'};
-            json_object_object_add(jfile, "name",
-                                   json_object_new_string(label));
-            json_object_object_add(jfile, "type",
-                                   json_object_new_string("directory"));
-            json_object_array_add(jarray, jfile);
+            remote_http_json_begin_object(&writer);
+            remote_http_json_member(&writer, "name", label);
+            remote_http_json_member(&writer, "type", "directory");
+            remote_http_json_end_object(&writer);
         }
         FindClose(hFind);
     }
-
-    const char *content = json_object_to_json_string_ext(
-        jobj,
-        JSON_C_TO_STRING_PRETTY
-    );
-    size_t reply_length = strlen(content);
-    *len = reply_length;
-    char *reply = malloc(reply_length);
-    memcpy(reply, content, reply_length);
-    json_object_put(jobj);
-    return reply;
+    
+    remote_http_json_end_array(&writer);
+    remote_http_json_end_object(&writer);
+    return remote_http_json_finish(&writer, len);
     
     #else
     char media_path[PATH_MAX] = "/media/";
     strcat(media_path, getenv("USER"));
-    return browse_directory(media_path, len);
+    return remote_http_listing_json(media_path, query, len);
     #endif
 }
-
-
-
-
-static char *get_thumbnail(const char *file, size_t *len) {
-    char cmd[512];
-    snprintf(cmd, 511, "ffprobe -i \"%s\" -show_entries format=duration -v "
-                       "quiet -of csv=\"p = 0\"", file);
-    
-    char *read = {0};
-    read = calloc(16, 1);
-    cmd_rsp(cmd, &read, 16);
-    if(read[0] == '\0') {
-        free(read);
-        return NULL;
-    }
-    double duration = atof(read);
-    free(read);
-    
-    #ifdef _WIN32
-    char thumbnail[PATH_MAX];
-    snprintf(thumbnail, PATH_MAX-1, "%s\\mpv-thumbnail.png", getenv("TEMP"));
-    #else
-    const char *thumbnail = "/tmp/mpv-thumbnail.png";
-    #endif
-    
-    snprintf(
-        cmd,
-        511 - 25,
-        "ffmpeg -ss %lf -i \"%s\" -vf select=\"eq(pict_type\\, I), scale = "
-        "320:180\" -vframes 1 \"%s\"",
-        duration / 2,
-        file,
-        thumbnail
-    );
-    #ifdef _WIN32
-    strcat(cmd, " >nul 2>nul");
-    #else
-    strcat(cmd, " >>/dev/null 2>>/dev/null");
-    #endif
-    
-    remove(thumbnail);
-    system(cmd);
-    char *content = load_file(thumbnail, "rb", len);
-    remove(thumbnail);
-    return content;
-}
@@ -16,6 +16,15 @@
 
 #include "config.h"
 #include "con_type.h"
+#include "auth.h"
+#include "events.h"
+#include "library.h"
+#include "listing.h"
+#include "pool.h"
+#include "route.h"
+#include "thumbnail.h"
+#include "websocket.h"
+#include "worker.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -23,9 +32,12 @@
 #ifdef _WIN32
 #include <winsock2.h>
 #include <iphlpapi.h>
+#include <io.h>
+#define close _close
 #else
 #include <ifaddrs.h>
 #include <netdb.h>
+#include <unistd.h>
 #endif
 
 #define POST_BUFFER_SIZE 8192 ///< The size of one packet for POST requests
@@ -49,19 +61,6 @@ extern int remote_http_handle_post(
 );
 
 
-extern int remote_http_iterate_post(
-    void* coninfo_cls,
-    enum MHD_ValueKind kind,
-    const char* key,
-    const char* filename,
-    const char* content_type,
-    const char* transfer_encoding,
-    const char* data,
-    uint64_t off,
-    size_t size
-);
-
-
 static int answer_to_connection(
     void* cls,
     struct MHD_Connection *connection,
@@ -92,26 +91,42 @@ static int answer_to_connection(
         );
         struct sockaddr_in *sa = (struct sockaddr_in*) info->client_addr;
         
-        struct RemoteConnection *con_info;
-        con_info = malloc(sizeof(struct RemoteConnection));
+        struct RemoteConnection *con_info = remote_http_pool_acquire();
+        if(con_info == NULL)
+            return MHD_NO;
         con_info->address = sa->sin_addr.s_addr;
         con_info->method = met;
         con_info->status = 0;
         con_info->reply_length = 0;
         con_info->reply = NULL;
+        con_info->reply_persistent = 0;
         con_info->fp = NULL;
-        strncpy(con_info->url, url, 128);
-        strcpy(con_info->content_type, "");
-        strcpy(con_info->param1, "");
-        strcpy(con_info->param2, "");
-        strcpy(con_info->param3, "");
-        strcpy(con_info->param4, "");
+        con_info->stream_fd = -1;
+        con_info->stream_offset = 0;
+        con_info->stream_length = 0;
+        con_info->response = NULL;
+        con_info->header_count = 0;
+        con_info->job_state = JOB_NONE;
+        con_info->job_data = NULL;
+        con_info->url = remote_http_strdup(con_info, url);
+        con_info->route = remote_http_find_route(met, url);
+        con_info->content_type = "";
+        if(con_info->route != NULL)
+            con_info->content_type = con_info->route->content_type;
+        con_info->param1 = NULL;
+        con_info->param2 = NULL;
+        con_info->postprocessor = NULL;
+        if(con_info->url == NULL) {
+            remote_http_pool_release(con_info);
+            return MHD_NO;
+        }
         
-        if(met == POST_METHOD) {
+        // Only the services reading fields get a post processor
+        if(con_info->route != NULL && con_info->route->iterator != NULL) {
             con_info->postprocessor = MHD_create_post_processor(
                 connection,
                 POST_BUFFER_SIZE, 
-                remote_http_iterate_post,
+                con_info->route->iterator,
                 (void*) con_info
             );
         }
@@ -134,16 +149,42 @@ static int answer_to_connection(
     
     struct RemoteConnection *con_info = *con_cls;
     
-    // Creates a response from the reply
+    // The connection is suspended until a worker prepares the reply
+    if(con_info->job_state == JOB_RUNNING)
+        return MHD_YES;
+    
+    // Creates a response from the reply or the streamed file
     if(con_info->reply || con_info->status != 0) {
         struct MHD_Response *response;
-        response = MHD_create_response_from_buffer(con_info->reply_length,
-                                                   con_info->reply,
-                                                   MHD_RESPMEM_PERSISTENT);
-        if(strlen(con_info->content_type)) {
+        if(con_info->response != NULL) {
+            response = con_info->response;
+            con_info->response = NULL;
+        }
+        else if(con_info->stream_fd >= 0) {
+            response = MHD_create_response_from_fd_at_offset64(
+                con_info->stream_length,
+                con_info->stream_fd,
+                con_info->stream_offset
+            );
+            if(response == NULL)
+                return MHD_NO;
+            con_info->stream_fd = -1;
+        }
+        else {
+            response = MHD_create_response_from_buffer(
+                con_info->reply_length,
+                con_info->reply,
+                MHD_RESPMEM_PERSISTENT
+            );
+        }
+        if(con_info->content_type[0] != '\0') {
             MHD_add_response_header(response, "Content-Type",
                                     con_info->content_type);
         }
+        for(int i=0; i<con_info->header_count; i++) {
+            MHD_add_response_header(response, con_info->headers[i].name,
+                                    con_info->headers[i].value);
+        }
         int ret = MHD_queue_response(connection, con_info->status, response);
         MHD_destroy_response(response);
         return ret;
@@ -153,6 +194,26 @@ static int answer_to_connection(
 }
 
 
+/**
+ * @brief Adds a header to the response of the connection
+ * 
+ * @param con_info The connection
+ * @param name Header name which has to be a string constant
+ * @param value Header value
+ */
+void remote_http_add_header(struct RemoteConnection *con_info,
+                            const char *name, const char *value)
+{
+    if(con_info->header_count >= HEADER_COUNT)
+        return;
+    struct RemoteHeader *header = &con_info->headers[con_info->header_count];
+    header->name = name;
+    header->value = remote_http_strdup(con_info, value);
+    if(header->value != NULL)
+        con_info->header_count++;
+}
+
+
 void request_completed(void *cls, struct MHD_Connection *connection, 
      		           void **con_cls, enum MHD_RequestTerminationCode toe)
 {
@@ -161,17 +222,23 @@ void request_completed(void *cls, struct MHD_Connection *connection,
     if(con_info == NULL)
         return;
     
-    if(con_info->method == POST_METHOD)
-        MHD_destroy_post_processor(con_info->postprocessor);        
+    if(con_info->postprocessor != NULL)
+        MHD_destroy_post_processor(con_info->postprocessor);
     
-    if(con_info->reply != NULL)
+    if(con_info->reply != NULL && !con_info->reply_persistent)
         free(con_info->reply);
-
+    
     if(con_info->fp != NULL)
         fclose(con_info->fp);
     
-    free(con_info);
-    *con_cls = NULL;   
+    // The file is only left open if no response took it over
+    if(con_info->stream_fd >= 0)
+        close(con_info->stream_fd);
+    if(con_info->response != NULL)
+        MHD_destroy_response(con_info->response);
+    
+    remote_http_pool_release(con_info);
+    *con_cls = NULL;
 }
 
 
@@ -182,6 +249,9 @@ void request_completed(void *cls, struct MHD_Connection *connection,
 
 
 static struct MHD_Daemon *http_daemon = NULL;
+static unsigned int http_threads = HTTP_THREADS;
+static unsigned int http_connection_limit = HTTP_CONNECTION_LIMIT;
+static unsigned int http_connection_timeout = HTTP_CONNECTION_TIMEOUT;
 
 static void get_ip_address(char *addr) {
     #ifdef _WIN32
@@ -189,21 +259,21 @@ static void get_ip_address(char *addr) {
     PIP_ADAPTER_INFO pAdapt;
     DWORD AdapterInfoSize;
     PIP_ADDR_STRING pAddrStr;
-
+    
     if((Err = GetAdaptersInfo(NULL, &AdapterInfoSize)) != 0) {
         if(Err != ERROR_BUFFER_OVERFLOW)
             return;
     }
-
+    
     pAdapt = (PIP_ADAPTER_INFO)GlobalAlloc(GPTR, AdapterInfoSize);
     if(pAdapt == NULL) {
         return;
     }
-
+    
     if((Err = GetAdaptersInfo(pAdapt, &AdapterInfoSize)) != 0) {
         return;
     }
-
+    
     if(pAdapt) {
         pAddrStr = &(pAdapt->IpAddressList);
         if(pAddrStr) {
@@ -216,7 +286,7 @@ static void get_ip_address(char *addr) {
     struct ifaddrs *ifa;
     int family, s;
     char host[NI_MAXHOST];
-
+    
     if(getifaddrs(&ifa) == -1)
         return;
     
@@ -233,7 +303,7 @@ static void get_ip_address(char *addr) {
             0,
             NI_NUMERICHOST
         );
-
+        
         if(ifa->ifa_addr->sa_family==AF_INET) {
             if(s != 0) {
                 return;
@@ -247,34 +317,120 @@ static void get_ip_address(char *addr) {
 }
 
 /**
- * @brief Starts running a web server on a parallel thread
+ * @brief Sets how the web server serves the requests
+ * 
+ * Takes effect on the next start of the server. With one thread, every
+ * request is served by the same thread. With more, the connections are
+ * spread over a pool of threads each polling its own connections with
+ * epoll where available, so that a slow request does not hold up the
+ * others. As many workers run the listings, thumbnails and uploads which
+ * block on the disk or a child process. Zero keeps the current value of a
+ * setting.
+ * 
+ * @param threads Number of threads serving the requests
+ * @param connections Maximum number of concurrent connections
+ * @param timeout Seconds after which an idle connection is closed
+ */
+void remote_http_set_threading(unsigned int threads,
+                               unsigned int connections,
+                               unsigned int timeout)
+{
+    if(threads > 0)
+        http_threads = threads;
+    if(connections > 0)
+        http_connection_limit = connections;
+    if(timeout > 0)
+        http_connection_timeout = timeout;
+    
+    // Idle event streams only write a keepalive now and then
+    if(http_connection_timeout <= EVENT_KEEPALIVE)
+        http_connection_timeout = EVENT_KEEPALIVE * 2;
+}
+
+/**
+ * @brief Adds a directory to the media library searched by the web page
+ * 
+ * Has to be called before the server starts. The directory may hold
+ * variables such as ${Videos}. Without any, the media folders and the
+ * removable drives are indexed.
+ * 
+ * @param root The directory
+ */
+void remote_http_add_library_root(const char *root) {
+    remote_http_library_add_root(root);
+}
+
+/**
+ * @brief Starts running a web server on parallel threads
  * 
  * @return Error code
  */
 int remote_http_start_daemon() {
     remote_http_stop_daemon();
+    remote_http_pool_init();
+    remote_http_routes_init();
+    remote_http_auth_init();
+    remote_http_listing_start();
+    remote_http_thumbnail_start();
+    remote_http_events_start();
+    remote_http_websocket_start();
+    remote_http_worker_start(http_threads);
+    remote_http_library_start();
     
+    // The event streams suspend their connections while idle and the
+    // control connections upgrade to WebSocket. MHD_USE_AUTO picks epoll
+    // on Linux and the best polling function elsewhere.
+    unsigned int flags = MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_AUTO |
+                         MHD_ALLOW_SUSPEND_RESUME | MHD_ALLOW_UPGRADE;
+    unsigned int pool = (http_threads > 1) ? http_threads : 0;
     http_daemon = MHD_start_daemon(
-        MHD_USE_INTERNAL_POLLING_THREAD, HTTP_PORT, NULL, NULL,
+        flags,
+        HTTP_PORT, NULL, NULL,
         &answer_to_connection, NULL,
-        MHD_OPTION_NOTIFY_COMPLETED, &request_completed,
-        NULL, MHD_OPTION_END
+        MHD_OPTION_NOTIFY_COMPLETED, &request_completed, NULL,
+        MHD_OPTION_THREAD_POOL_SIZE, pool,
+        MHD_OPTION_CONNECTION_LIMIT, http_connection_limit,
+        MHD_OPTION_CONNECTION_TIMEOUT, http_connection_timeout,
+        MHD_OPTION_END
     );
-
-    char ip_addr[16] = "0.0.0.0";
-    get_ip_address(ip_addr);
-    printf("HTTP services can be used at http://%s:%d\n", ip_addr, HTTP_PORT);
     
-    if(http_daemon == NULL)
+    // The helper threads do not outlive a server which failed to start
+    if(http_daemon == NULL) {
+        remote_http_stop_daemon();
         return 1;
+    }
     
+    char ip_addr[16] = "0.0.0.0";
+    get_ip_address(ip_addr);
+    printf("HTTP services can be used at http://%s:%d\n", ip_addr, HTTP_PORT);
     return 0;
 }
 
 /**
  * @brief Terminates the thread running the web server
+ * 
+ * No new connection is accepted from the start. The modules used by the
+ * requests are only stopped once the server has stopped, since the jobs
+ * run on the server threads after the workers have stopped.
  */
 void remote_http_stop_daemon() {
+    if(http_daemon != NULL) {
+        MHD_socket listen = MHD_quiesce_daemon(http_daemon);
+        if(listen != MHD_INVALID_SOCKET) {
+            #ifdef _WIN32
+            closesocket(listen);
+            #else
+            close(listen);
+            #endif
+        }
+    }
+    remote_http_events_stop();
+    remote_http_websocket_stop();
+    remote_http_worker_stop();
     if(http_daemon != NULL)
         MHD_stop_daemon(http_daemon);
+    http_daemon = NULL;
+    remote_http_listing_stop();
+    remote_http_thumbnail_stop();
+    remote_http_library_stop();
 }
@@ -20,7 +20,37 @@ extern "C" {
 #endif
 
 /**
- * @brief Starts running a web server on a parallel thread
+ * @brief Sets how the web server serves the requests
+ * 
+ * Takes effect on the next start of the server. With one thread, every
+ * request is served by the same thread. With more, the connections are
+ * spread over a pool of threads each polling its own connections with
+ * epoll where available, so that a slow request does not hold up the
+ * others. As many workers run the listings, thumbnails and uploads which
+ * block on the disk or a child process. Zero keeps the current value of a
+ * setting.
+ * 
+ * @param threads Number of threads serving the requests
+ * @param connections Maximum number of concurrent connections
+ * @param timeout Seconds after which an idle connection is closed
+ */
+void remote_http_set_threading(unsigned int threads,
+                               unsigned int connections,
+                               unsigned int timeout);
+
+/**
+ * @brief Adds a directory to the media library searched by the web page
+ * 
+ * Has to be called before the server starts. The directory may hold
+ * variables such as ${Videos}. Without any, the media folders and the
+ * removable drives are indexed.
+ * 
+ * @param root The directory
+ */
+void remote_http_add_library_root(const char *root);
+
+/**
+ * @brief Starts running a web server on parallel threads
  * 
  * @return Error code
  */
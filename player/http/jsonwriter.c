@@ -0,0 +1,297 @@
+/**
+ * @file jsonwriter.c
+ * @brief Writes the JSON replies of the HTTP services
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "jsonwriter.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_WRITER_MIN 256 ///< Smallest buffer allocated
+
+
+// Makes room for more bytes and the NUL terminator
+static int reserve(struct RemoteJsonWriter *writer, size_t size) {
+    if(writer->failed)
+        return 1;
+    if(writer->length + size + 1 <= writer->capacity)
+        return 0;
+    
+    // Doubles the buffer so that writing stays linear
+    size_t capacity = writer->capacity;
+    if(capacity < JSON_WRITER_MIN)
+        capacity = JSON_WRITER_MIN;
+    while(writer->length + size + 1 > capacity)
+        capacity *= 2;
+    char *data = realloc(writer->data, capacity);
+    if(data == NULL) {
+        writer->failed = 1;
+        return 1;
+    }
+    writer->data = data;
+    writer->capacity = capacity;
+    return 0;
+}
+
+
+static void append(struct RemoteJsonWriter *writer, const char *str,
+                   size_t len)
+{
+    if(reserve(writer, len) != 0)
+        return;
+    memcpy(writer->data + writer->length, str, len);
+    writer->length += len;
+    writer->data[writer->length] = '\0';
+}
+
+
+// Writes the comma before a value unless it is the first or follows a key
+static void separate(struct RemoteJsonWriter *writer) {
+    if(writer->after_key) {
+        writer->after_key = 0;
+        return;
+    }
+    if(writer->depth == 0)
+        return;
+    if(writer->first[writer->depth-1])
+        writer->first[writer->depth-1] = 0;
+    else
+        append(writer, ",", 1);
+}
+
+
+static void write_string(struct RemoteJsonWriter *writer, const char *str) {
+    static const char hex[] = "0123456789abcdef";
+    
+    append(writer, "\"", 1);
+    while(*str != '\0') {
+        // Copies the runs needing no escape at once
+        const char *run = str;
+        while((unsigned char) *str >= 0x20 && *str != '"' && *str != '\\')
+            str++;
+        if(str > run)
+            append(writer, run, str - run);
+        if(*str == '\0')
+            break;
+        
+        char escape[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t len = 2;
+        switch(*str) {
+            case '"': escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\b': escape[1] = 'b'; break;
+            case '\f': escape[1] = 'f'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hex[(*str >> 4) & 0xF];
+                escape[5] = hex[*str & 0xF];
+                len = 6;
+        }
+        append(writer, escape, len);
+        str++;
+    }
+    append(writer, "\"", 1);
+}
+
+
+static void open_value(struct RemoteJsonWriter *writer, char c) {
+    separate(writer);
+    append(writer, &c, 1);
+    if(writer->depth >= JSON_WRITER_DEPTH) {
+        writer->failed = 1;
+        return;
+    }
+    writer->first[writer->depth++] = 1;
+}
+
+
+static void close_value(struct RemoteJsonWriter *writer, char c) {
+    if(writer->depth == 0) {
+        writer->failed = 1;
+        return;
+    }
+    writer->depth--;
+    append(writer, &c, 1);
+}
+
+
+
+
+/**
+ * @brief Starts a JSON text
+ * 
+ * @param writer The writer
+ * @param capacity The number of bytes allocated at first
+ */
+void remote_http_json_init(struct RemoteJsonWriter *writer, size_t capacity) {
+    if(capacity < JSON_WRITER_MIN)
+        capacity = JSON_WRITER_MIN;
+    writer->data = malloc(capacity);
+    writer->length = 0;
+    writer->capacity = capacity;
+    writer->depth = 0;
+    writer->after_key = 0;
+    writer->failed = (writer->data == NULL);
+    if(writer->data != NULL)
+        writer->data[0] = '\0';
+}
+
+/**
+ * @brief Ends the JSON text and hands its buffer over
+ * 
+ * The buffer is freed on failure.
+ * 
+ * @param writer The writer
+ * @param len The number of bytes of the text, may be NULL
+ * 
+ * @return The NUL-terminated text to free or NULL on failure
+ */
+char *remote_http_json_finish(struct RemoteJsonWriter *writer, size_t *len) {
+    char *data = writer->data;
+    if(writer->failed || writer->depth != 0) {
+        free(data);
+        data = NULL;
+    }
+    if(len != NULL)
+        *len = (data != NULL) ? writer->length : 0;
+    writer->data = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+    return data;
+}
+
+/**
+ * @brief Opens an object
+ * 
+ * @param writer The writer
+ */
+void remote_http_json_begin_object(struct RemoteJsonWriter *writer) {
+    open_value(writer, '{');
+}
+
+/**
+ * @brief Closes the object opened last
+ * 
+ * @param writer The writer
+ */
+void remote_http_json_end_object(struct RemoteJsonWriter *writer) {
+    close_value(writer, '}');
+}
+
+/**
+ * @brief Opens an array
+ * 
+ * @param writer The writer
+ */
+void remote_http_json_begin_array(struct RemoteJsonWriter *writer) {
+    open_value(writer, '[');
+}
+
+/**
+ * @brief Closes the array opened last
+ * 
+ * @param writer The writer
+ */
+void remote_http_json_end_array(struct RemoteJsonWriter *writer) {
+    close_value(writer, ']');
+}
+
+/**
+ * @brief Writes the key of the next member of an object
+ * 
+ * @param writer The writer
+ * @param key The key
+ */
+void remote_http_json_key(struct RemoteJsonWriter *writer, const char *key) {
+    separate(writer);
+    write_string(writer, key);
+    append(writer, ":", 1);
+    writer->after_key = 1;
+}
+
+/**
+ * @brief Writes a string
+ * 
+ * @param writer The writer
+ * @param str The string in UTF-8, NULL writes null
+ */
+void remote_http_json_string(struct RemoteJsonWriter *writer,
+                             const char *str)
+{
+    separate(writer);
+    if(str == NULL)
+        append(writer, "null", 4);
+    else
+        write_string(writer, str);
+}
+
+/**
+ * @brief Writes an integer
+ * 
+ * @param writer The writer
+ * @param value The integer
+ */
+void remote_http_json_int(struct RemoteJsonWriter *writer, int64_t value) {
+    char number[24];
+    int len = snprintf(number, 24, "%lld", (long long) value);
+    separate(writer);
+    append(writer, number, len);
+}
+
+/**
+ * @brief Writes a number
+ * 
+ * @param writer The writer
+ * @param value The number, written as null if it is not finite
+ */
+void remote_http_json_double(struct RemoteJsonWriter *writer, double value) {
+    separate(writer);
+    if(!isfinite(value)) {
+        append(writer, "null", 4);
+        return;
+    }
+    char number[32];
+    int len = snprintf(number, 32, "%.17g", value);
+    append(writer, number, len);
+}
+
+/**
+ * @brief Writes true or false
+ * 
+ * @param writer The writer
+ * @param value The boolean
+ */
+void remote_http_json_bool(struct RemoteJsonWriter *writer, int value) {
+    separate(writer);
+    if(value)
+        append(writer, "true", 4);
+    else
+        append(writer, "false", 5);
+}
+
+/**
+ * @brief Writes a member with a string value
+ * 
+ * @param writer The writer
+ * @param key The key
+ * @param str The string in UTF-8, NULL writes null
+ */
+void remote_http_json_member(struct RemoteJsonWriter *writer,
+                             const char *key, const char *str)
+{
+    remote_http_json_key(writer, key);
+    remote_http_json_string(writer, str);
+}
@@ -0,0 +1,146 @@
+/**
+ * @file jsonwriter.h
+ * @brief Writes the JSON replies of the HTTP services
+ * 
+ * The JSON text is appended straight to a growable reply buffer instead of
+ * building a tree of objects first, so a reply costs one buffer however
+ * many entries it holds. The separators between the values are written by
+ * the writer itself.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_JSONWRITER_H__
+#define __MPV_REMOTE_HTTP_JSONWRITER_H__ ///< Header guard
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JSON_WRITER_DEPTH 32 ///< Maximum nesting of objects and arrays
+
+
+/**
+ * @brief JSON text being written
+ */
+struct RemoteJsonWriter {
+    char *data; ///< The text which is always NUL-terminated
+    size_t length; ///< The number of bytes of the text
+    size_t capacity; ///< The number of bytes allocated
+    int depth; ///< Nesting of the value being written
+    int failed; ///< Out of memory or misnested
+    uint8_t first[JSON_WRITER_DEPTH]; ///< No value written yet at the depth
+    int after_key; ///< A key has just been written
+};
+
+
+/**
+ * @brief Starts a JSON text
+ * 
+ * @param writer The writer
+ * @param capacity The number of bytes allocated at first
+ */
+void remote_http_json_init(struct RemoteJsonWriter *writer, size_t capacity);
+
+/**
+ * @brief Ends the JSON text and hands its buffer over
+ * 
+ * The buffer is freed on failure.
+ * 
+ * @param writer The writer
+ * @param len The number of bytes of the text, may be NULL
+ * 
+ * @return The NUL-terminated text to free or NULL on failure
+ */
+char *remote_http_json_finish(struct RemoteJsonWriter *writer, size_t *len);
+
+/**
+ * @brief Opens an object
+ * 
+ * @param writer The writer
+ */
+void remote_http_json_begin_object(struct RemoteJsonWriter *writer);
+
+/**
+ * @brief Closes the object opened last
+ * 
+ * @param writer The writer
+ */
+void remote_http_json_end_object(struct RemoteJsonWriter *writer);
+
+/**
+ * @brief Opens an array
+ * 
+ * @param writer The writer
+ */
+void remote_http_json_begin_array(struct RemoteJsonWriter *writer);
+
+/**
+ * @brief Closes the array opened last
+ * 
+ * @param writer The writer
+ */
+void remote_http_json_end_array(struct RemoteJsonWriter *writer);
+
+/**
+ * @brief Writes the key of the next member of an object
+ * 
+ * @param writer The writer
+ * @param key The key
+ */
+void remote_http_json_key(struct RemoteJsonWriter *writer, const char *key);
+
+/**
+ * @brief Writes a string
+ * 
+ * @param writer The writer
+ * @param str The string in UTF-8, NULL writes null
+ */
+void remote_http_json_string(struct RemoteJsonWriter *writer,
+                             const char *str);
+
+/**
+ * @brief Writes an integer
+ * 
+ * @param writer The writer
+ * @param value The integer
+ */
+void remote_http_json_int(struct RemoteJsonWriter *writer, int64_t value);
+
+/**
+ * @brief Writes a number
+ * 
+ * @param writer The writer
+ * @param value The number, written as null if it is not finite
+ */
+void remote_http_json_double(struct RemoteJsonWriter *writer, double value);
+
+/**
+ * @brief Writes true or false
+ * 
+ * @param writer The writer
+ * @param value The boolean
+ */
+void remote_http_json_bool(struct RemoteJsonWriter *writer, int value);
+
+/**
+ * @brief Writes a member with a string value
+ * 
+ * @param writer The writer
+ * @param key The key
+ * @param str The string in UTF-8, NULL writes null
+ */
+void remote_http_json_member(struct RemoteJsonWriter *writer,
+                             const char *key, const char *str);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,2353 @@
+/**
+ * @file library.c
+ * @brief Media library index searched through GET /search
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "library.h"
+
+#include "../../libremote/libremote.h"
+#include "../../libremote/thread.h"
+#include "jsonwriter.h"
+#include "listing.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Shlobj.h>
+#include <tchar.h>
+#define PATH_MAX _MAX_PATH
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define LIBRARY_TABLE_MIN 4096 ///< First number of slots of the trigrams
+#define LIBRARY_QUERY_MAX 256 ///< Longest query looked for
+#define LIBRARY_REPLY_SIZE 8192 ///< First buffer of the matches
+#define LIBRARY_DELTA_MIN 256 ///< Changes always kept aside the index
+#define LIBRARY_DELTA_MAX 4096 ///< Most changes kept aside the index
+#define LIBRARY_NONE UINT32_MAX ///< No directory
+#define LIBRARY_ROOTS (LIBRARY_ROOT_MAX + 3) ///< Most roots with the defaults
+#define LIBRARY_RESTART 16 ///< Directories between two whole paths
+#define LIBRARY_MAGIC "MPVRLIB" ///< First bytes of a snapshot
+#define LIBRARY_VERSION 1 ///< Layout of the snapshots
+#define LIBRARY_ORDER 0x01020304 ///< Byte order mark of the snapshots
+
+#ifndef _WIN32
+/**
+ * @brief Changes of a directory which update the index
+ * 
+ * A file is indexed once it has been written and closed, so that an upload
+ * does not show up before it is complete.
+ */
+#define LIBRARY_EVENTS (IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | \
+                        IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | \
+                        IN_MOVE_SELF | IN_ONLYDIR)
+#endif
+
+
+/**
+ * @brief Media file of the library
+ */
+struct RemoteLibraryFile {
+    uint32_t dir; ///< The directory
+    uint32_t name; ///< Offset of the name in the strings
+    uint32_t folded; ///< Offset of the name in lower case in the strings
+    uint16_t length; ///< The number of bytes of the name
+    uint8_t type; ///< LISTING_VIDEO or LISTING_AUDIO
+};
+
+/**
+ * @brief Media file created since the index was built
+ */
+struct RemoteLibraryAdded {
+    struct RemoteLibraryAdded *next; ///< Next file added to the directory
+    uint32_t slot; ///< Position in the files added to the index
+    uint16_t dir_length; ///< The number of bytes of the directory
+    uint16_t length; ///< The number of bytes of the name
+    uint8_t type; ///< LISTING_VIDEO or LISTING_AUDIO
+    char path[]; ///< The path followed by the name in lower case
+};
+
+/**
+ * @brief Index of all the media files under the library roots
+ * 
+ * The files and their trigrams never change once the index is built. The
+ * files deleted and created since are kept aside under the lock until the
+ * index is built again from them.
+ * 
+ * The index is laid out as its snapshot so that it is mapped as is. The
+ * directories are front coded, each path keeping only what differs from
+ * the previous one but for a whole path every LIBRARY_RESTART directories.
+ */
+struct RemoteLibraryIndex {
+    char *strings; ///< The names one after another
+    size_t strings_length; ///< The number of bytes of the strings used
+    size_t strings_capacity; ///< The number of bytes of the strings
+    struct RemoteLibraryFile *files; ///< The files grouped by directory
+    size_t file_count; ///< The number of files
+    size_t file_capacity; ///< The number of files allocated
+    uint8_t *dirs; ///< The front coded paths of the directories
+    size_t dirs_length; ///< The number of bytes of the paths used
+    size_t dirs_capacity; ///< The number of bytes of the paths
+    uint32_t *restarts; ///< Offset of every whole path in the paths
+    size_t dir_count; ///< The number of directories
+    char *last_dir; ///< The path of the last directory while building
+    uint32_t *keys; ///< Trigram of each slot or 0 if the slot is free
+    uint32_t *starts; ///< Offset of the files of each slot in the postings
+    uint32_t *counts; ///< The number of files of each slot
+    size_t slots; ///< The number of slots which is a power of 2
+    size_t used; ///< The number of slots used
+    uint32_t *postings; ///< The files holding each trigram in order
+    size_t posting_count; ///< The number of postings
+    uint8_t *removed; ///< Whether each file has been deleted since or NULL
+    size_t removed_count; ///< The number of files deleted since
+    struct RemoteLibraryAdded **added; ///< The files created since
+    size_t added_count; ///< The number of files created since
+    size_t added_capacity; ///< The number of files created allocated
+    void *mapping; ///< The snapshot mapped or NULL
+    size_t mapping_size; ///< The number of bytes mapped
+    int refs; ///< The number of searches using the index and the library
+};
+
+/**
+ * @brief Header of a snapshot of the index
+ * 
+ * The sections follow at the offsets given, aligned on 8 bytes.
+ */
+struct RemoteLibraryHeader {
+    char magic[8]; ///< LIBRARY_MAGIC
+    uint32_t version; ///< LIBRARY_VERSION
+    uint32_t order; ///< LIBRARY_ORDER as written
+    uint64_t file_count; ///< The number of files
+    uint64_t dir_count; ///< The number of directories
+    uint64_t strings_length; ///< The number of bytes of the names
+    uint64_t dirs_length; ///< The number of bytes of the paths
+    uint64_t slots; ///< The number of slots of the trigrams
+    uint64_t posting_count; ///< The number of postings
+    uint64_t files; ///< Offset of the files
+    uint64_t strings; ///< Offset of the names
+    uint64_t dirs; ///< Offset of the paths
+    uint64_t restarts; ///< Offset of the whole paths
+    uint64_t parents; ///< Offset of the parent of each directory
+    uint64_t firsts; ///< Offset of the first file of each directory
+    uint64_t stamps; ///< Offset of the stamp of each directory
+    uint64_t keys; ///< Offset of the trigram of each slot
+    uint64_t starts; ///< Offset of the postings of each slot
+    uint64_t counts; ///< Offset of the number of postings of each slot
+    uint64_t postings; ///< Offset of the postings
+    uint64_t size; ///< The number of bytes of the snapshot
+};
+
+/**
+ * @brief Directory of the library, only used by the library thread
+ */
+struct RemoteLibraryDir {
+    char *path; ///< The path or NULL if the record is free
+    uint32_t name; ///< Offset of the name in the path
+    uint32_t parent; ///< The parent or LIBRARY_NONE for a root
+    uint32_t child; ///< The first subdirectory or LIBRARY_NONE
+    uint32_t sibling; ///< The next subdirectory or the next free record
+    uint32_t first; ///< The first of its files in the index
+    uint32_t count; ///< The number of its files in the index
+    struct RemoteLibraryAdded *added; ///< Its files created since
+    uint32_t number; ///< The directory in the index
+    int64_t stamp; ///< Modification time when read last or 0
+    int watch; ///< Watch descriptor of the directory or -1
+};
+
+/**
+ * @brief Directory watched for changes
+ */
+struct RemoteLibraryWatch {
+    int watch; ///< The watch descriptor
+    uint32_t dir; ///< The directory or LIBRARY_NONE once unwatched
+};
+
+/**
+ * @brief Entries read from a directory
+ */
+struct RemoteLibraryEntries {
+    char *names; ///< Each name after a 'd' for directories or a 'f'
+    size_t length; ///< The number of bytes of the names used
+    size_t capacity; ///< The number of bytes of the names
+    char **sorted; ///< The entries, in the order of their names once sorted
+    size_t count; ///< The number of entries
+};
+
+/**
+ * @brief File to index right away
+ */
+struct RemoteLibraryPath {
+    struct RemoteLibraryPath *next; ///< The next file
+    char path[]; ///< The path of the file
+};
+
+/**
+ * @brief Match of a search
+ */
+struct RemoteLibraryMatch {
+    uint32_t file; ///< The file
+    int score; ///< How well the name matches
+};
+
+
+static remote_mutex_t libraryLock;
+static remote_cond_t libraryWake;
+static int libraryInitialized = 0;
+static int libraryRunning = 0;
+static volatile int libraryStopping = 0;
+static remote_thread_t libraryThread;
+static struct RemoteLibraryIndex *libraryIndex = NULL;
+static struct RemoteLibraryPath *libraryPending = NULL;
+static char *libraryRoots[LIBRARY_ROOT_MAX];
+static int libraryRootCount = 0;
+
+// Only used by the library thread
+static struct RemoteLibraryDir *libraryDirs = NULL;
+static size_t libraryDirCount = 0;
+static size_t libraryDirCapacity = 0;
+static uint32_t libraryFreeDir = LIBRARY_NONE;
+static uint32_t libraryRootDirs[LIBRARY_ROOTS];
+static int libraryRootDirCount = 0;
+static struct RemoteLibraryWatch *libraryWatches = NULL;
+static size_t libraryWatchCount = 0;
+static size_t libraryWatchCapacity = 0;
+
+#ifndef _WIN32
+static int libraryNotify = -1;
+static int libraryWakePipe[2] = {-1, -1};
+#endif
+
+
+static void free_index(struct RemoteLibraryIndex *index) {
+    for(size_t i=0; i<index->added_count; i++)
+        free(index->added[i]);
+    free(index->added);
+    free(index->removed);
+    free(index->last_dir);
+    if(index->mapping != NULL) {
+        #ifdef _WIN32
+        UnmapViewOfFile(index->mapping);
+        #else
+        munmap(index->mapping, index->mapping_size);
+        #endif
+    }
+    else {
+        free(index->strings);
+        free(index->files);
+        free(index->dirs);
+        free(index->restarts);
+        free(index->keys);
+        free(index->starts);
+        free(index->counts);
+        free(index->postings);
+    }
+    free(index);
+}
+
+
+static struct RemoteLibraryIndex *acquire_index() {
+    remote_mutex_lock(&libraryLock);
+    struct RemoteLibraryIndex *index = libraryIndex;
+    if(index != NULL)
+        index->refs++;
+    remote_mutex_unlock(&libraryLock);
+    return index;
+}
+
+
+static void release_index(struct RemoteLibraryIndex *index) {
+    remote_mutex_lock(&libraryLock);
+    int unused = (--index->refs == 0);
+    remote_mutex_unlock(&libraryLock);
+    if(unused)
+        free_index(index);
+}
+
+
+// Swaps a new index in
+static void publish_index(struct RemoteLibraryIndex *index) {
+    remote_mutex_lock(&libraryLock);
+    struct RemoteLibraryIndex *old = libraryIndex;
+    index->refs = 1;
+    libraryIndex = index;
+    int unused = (old != NULL && --old->refs == 0);
+    remote_mutex_unlock(&libraryLock);
+    if(unused)
+        free_index(old);
+}
+
+
+
+
+// Copies a string to the index, returns UINT32_MAX if out of memory
+static uint32_t add_string(struct RemoteLibraryIndex *index, const char *str,
+                           size_t len)
+{
+    if(index->strings_length + len + 1 > index->strings_capacity) {
+        size_t n = (index->strings_capacity > 0) ?
+                   index->strings_capacity : 65536;
+        while(index->strings_length + len + 1 > n)
+            n *= 2;
+        if(n > UINT32_MAX)
+            return UINT32_MAX;
+        char *strings = realloc(index->strings, n);
+        if(strings == NULL)
+            return UINT32_MAX;
+        index->strings = strings;
+        index->strings_capacity = n;
+    }
+    uint32_t offset = (uint32_t) index->strings_length;
+    memcpy(index->strings + offset, str, len);
+    index->strings[offset + len] = '\0';
+    index->strings_length += len + 1;
+    return offset;
+}
+
+
+static int add_file(struct RemoteLibraryIndex *index, uint32_t dir,
+                    const char *name, int type)
+{
+    if(index->file_count == index->file_capacity) {
+        size_t n = (index->file_capacity > 0) ?
+                   index->file_capacity * 2 : 1024;
+        void *files = realloc(index->files,
+                              n * sizeof(struct RemoteLibraryFile));
+        if(files == NULL)
+            return 1;
+        index->files = files;
+        index->file_capacity = n;
+    }
+    size_t len = strlen(name);
+    if(len >= PATH_MAX)
+        return 0;
+    
+    // Keeps the name in lower case for matching
+    char folded[PATH_MAX];
+    for(size_t i=0; i<len; i++)
+        folded[i] = tolower((unsigned char) name[i]);
+    uint32_t name_offset = add_string(index, name, len);
+    uint32_t folded_offset = add_string(index, folded, len);
+    if(name_offset == UINT32_MAX || folded_offset == UINT32_MAX)
+        return 1;
+    
+    struct RemoteLibraryFile *file = &index->files[index->file_count++];
+    file->dir = dir;
+    file->name = name_offset;
+    file->folded = folded_offset;
+    file->length = (uint16_t) len;
+    file->type = (uint8_t) type;
+    return 0;
+}
+
+
+static size_t write_varint(uint8_t *p, size_t value) {
+    size_t n = 0;
+    while(value >= 0x80) {
+        p[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    p[n++] = (uint8_t) value;
+    return n;
+}
+
+
+// Reads a number up to the end of the paths, which gives SIZE_MAX
+static size_t read_varint(const uint8_t **p, const uint8_t *end) {
+    size_t value = 0;
+    for(int shift=0; shift<28; shift+=7) {
+        if(*p == end)
+            return SIZE_MAX;
+        uint8_t byte = *(*p)++;
+        value |= (size_t) (byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            break;
+    }
+    return value;
+}
+
+
+// Adds the path of the next directory keeping only what differs from the
+// previous one, returns LIBRARY_NONE if out of memory
+static uint32_t add_dir(struct RemoteLibraryIndex *index, const char *path) {
+    size_t len = strlen(path);
+    if(index->last_dir == NULL) {
+        index->last_dir = malloc(PATH_MAX);
+        if(index->last_dir == NULL)
+            return LIBRARY_NONE;
+    }
+    if(len >= PATH_MAX || index->dir_count >= LIBRARY_NONE)
+        return LIBRARY_NONE;
+    if(index->dirs_length + len + 8 > index->dirs_capacity) {
+        size_t n = (index->dirs_capacity > 0) ? index->dirs_capacity : 16384;
+        while(index->dirs_length + len + 8 > n)
+            n *= 2;
+        uint8_t *dirs = realloc(index->dirs, n);
+        if(dirs == NULL)
+            return LIBRARY_NONE;
+        index->dirs = dirs;
+        index->dirs_capacity = n;
+    }
+    
+    size_t shared = 0;
+    if(index->dir_count % LIBRARY_RESTART == 0) {
+        size_t n = index->dir_count / LIBRARY_RESTART + 1;
+        uint32_t *restarts = realloc(index->restarts, n * sizeof(uint32_t));
+        if(restarts == NULL || index->dirs_length > UINT32_MAX)
+            return LIBRARY_NONE;
+        index->restarts = restarts;
+        index->restarts[n-1] = (uint32_t) index->dirs_length;
+    }
+    else {
+        while(shared < len && index->last_dir[shared] == path[shared])
+            shared++;
+    }
+    uint8_t *p = index->dirs + index->dirs_length;
+    p += write_varint(p, shared);
+    p += write_varint(p, len - shared);
+    memcpy(p, path + shared, len - shared);
+    index->dirs_length = (p - index->dirs) + len - shared;
+    memcpy(index->last_dir, path, len + 1);
+    return (uint32_t) index->dir_count++;
+}
+
+
+// Decodes the path of a directory from the last whole path before it, an
+// empty path if the snapshot holds it out of bounds
+static void get_dir(const struct RemoteLibraryIndex *index, uint32_t dir,
+                    char *path)
+{
+    path[0] = '\0';
+    if(dir >= index->dir_count ||
+       index->restarts[dir / LIBRARY_RESTART] >= index->dirs_length)
+        return;
+    const uint8_t *p = index->dirs + index->restarts[dir / LIBRARY_RESTART];
+    const uint8_t *end = index->dirs + index->dirs_length;
+    size_t len = 0;
+    for(uint32_t d=dir-dir%LIBRARY_RESTART; d<=dir; d++) {
+        size_t shared = read_varint(&p, end);
+        size_t rest = read_varint(&p, end);
+        if(shared == SIZE_MAX || rest == SIZE_MAX || shared > len ||
+           shared + rest >= PATH_MAX || rest > (size_t) (end - p))
+            break;
+        memcpy(path + shared, p, rest);
+        p += rest;
+        len = shared + rest;
+    }
+    path[len] = '\0';
+}
+
+
+static int is_removed(const struct RemoteLibraryIndex *index, size_t f) {
+    return index->removed != NULL && index->removed[f];
+}
+
+
+// Gives the name of a file in the index, empty if the snapshot holds it
+// out of bounds
+static const char *file_name(const struct RemoteLibraryIndex *index,
+                             const struct RemoteLibraryFile *file)
+{
+    return (file->name < index->strings_length) ?
+           index->strings + file->name : "";
+}
+
+
+// Flags a file deleted, has to be called with the lock held
+static void mark_removed(struct RemoteLibraryIndex *index, size_t f) {
+    if(index->removed == NULL) {
+        index->removed = calloc(index->file_count, sizeof(uint8_t));
+        if(index->removed == NULL)
+            return;
+    }
+    index->removed[f] = 1;
+    index->removed_count++;
+}
+
+
+
+
+static int compare_trigrams(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*) a;
+    uint32_t y = *(const uint32_t*) b;
+    return (x > y) - (x < y);
+}
+
+
+// Lists the distinct trigrams of a string in lower case
+static size_t trigrams_of(const char *str, size_t len, uint32_t *trigrams) {
+    if(len < 3)
+        return 0;
+    size_t n = 0;
+    for(size_t i=0; i+2<len; i++) {
+        trigrams[n++] = ((uint32_t) (unsigned char) str[i] << 16) |
+                        ((uint32_t) (unsigned char) str[i+1] << 8) |
+                        (uint32_t) (unsigned char) str[i+2];
+    }
+    qsort(trigrams, n, sizeof(uint32_t), compare_trigrams);
+    size_t distinct = 1;
+    for(size_t i=1; i<n; i++) {
+        if(trigrams[i] != trigrams[distinct-1])
+            trigrams[distinct++] = trigrams[i];
+    }
+    return distinct;
+}
+
+
+// Finds the slot of a trigram or the free slot where it belongs, giving up
+// after every slot of a full table of a snapshot
+static size_t find_slot(const uint32_t *keys, size_t slots, uint32_t key) {
+    uint32_t hash = key * 2654435761u;
+    size_t slot = (hash ^ (hash >> 16)) & (slots - 1);
+    for(size_t n=1; n<slots && keys[slot] != 0 && keys[slot] != key; n++)
+        slot = (slot + 1) & (slots - 1);
+    return slot;
+}
+
+
+static int grow_table(struct RemoteLibraryIndex *index) {
+    size_t slots = index->slots * 2;
+    uint32_t *keys = calloc(slots, sizeof(uint32_t));
+    uint32_t *counts = calloc(slots, sizeof(uint32_t));
+    if(keys == NULL || counts == NULL) {
+        free(keys);
+        free(counts);
+        return 1;
+    }
+    for(size_t i=0; i<index->slots; i++) {
+        if(index->keys[i] == 0)
+            continue;
+        size_t slot = find_slot(keys, slots, index->keys[i]);
+        keys[slot] = index->keys[i];
+        counts[slot] = index->counts[i];
+    }
+    free(index->keys);
+    free(index->counts);
+    index->keys = keys;
+    index->counts = counts;
+    index->slots = slots;
+    return 0;
+}
+
+
+// Indexes the files by the trigrams of their names in two passes, one
+// counting the files of each trigram and one filling their lists
+static int build_trigrams(struct RemoteLibraryIndex *index) {
+    uint32_t trigrams[PATH_MAX];
+    index->slots = LIBRARY_TABLE_MIN;
+    index->used = 0;
+    index->keys = calloc(index->slots, sizeof(uint32_t));
+    index->counts = calloc(index->slots, sizeof(uint32_t));
+    if(index->keys == NULL || index->counts == NULL)
+        return 1;
+    
+    size_t total = 0;
+    for(size_t f=0; f<index->file_count; f++) {
+        const struct RemoteLibraryFile *file = &index->files[f];
+        size_t n = trigrams_of(index->strings + file->folded, file->length,
+                               trigrams);
+        for(size_t i=0; i<n; i++) {
+            size_t slot = find_slot(index->keys, index->slots, trigrams[i]);
+            if(index->keys[slot] == 0) {
+                if((index->used + 1) * 2 > index->slots) {
+                    if(grow_table(index) != 0)
+                        return 1;
+                    slot = find_slot(index->keys, index->slots,
+                                     trigrams[i]);
+                }
+                index->keys[slot] = trigrams[i];
+                index->used++;
+            }
+            index->counts[slot]++;
+        }
+        total += n;
+    }
+    
+    index->starts = malloc(index->slots * sizeof(uint32_t));
+    index->postings = malloc((total > 0 ? total : 1) * sizeof(uint32_t));
+    uint32_t *fill = malloc(index->slots * sizeof(uint32_t));
+    if(index->starts == NULL || index->postings == NULL || fill == NULL) {
+        free(fill);
+        return 1;
+    }
+    index->posting_count = total;
+    uint32_t start = 0;
+    for(size_t i=0; i<index->slots; i++) {
+        index->starts[i] = start;
+        fill[i] = start;
+        start += index->counts[i];
+    }
+    for(size_t f=0; f<index->file_count; f++) {
+        const struct RemoteLibraryFile *file = &index->files[f];
+        size_t n = trigrams_of(index->strings + file->folded, file->length,
+                               trigrams);
+        for(size_t i=0; i<n; i++) {
+            size_t slot = find_slot(index->keys, index->slots, trigrams[i]);
+            index->postings[fill[slot]++] = (uint32_t) f;
+        }
+    }
+    free(fill);
+    return 0;
+}
+
+
+
+
+static int directory_stamp(const char *path, int64_t *stamp) {
+    #ifdef _WIN32
+    struct __stat64 st;
+    if(_stat64(path, &st) != 0 || !(st.st_mode & _S_IFDIR))
+        return 1;
+    *stamp = (int64_t) st.st_mtime;
+    #else
+    struct stat st;
+    if(stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+        return 1;
+    *stamp = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    #endif
+    return 0;
+}
+
+
+static int add_entry(struct RemoteLibraryEntries *entries, char kind,
+                     const char *name)
+{
+    size_t len = strlen(name);
+    if(entries->length + len + 2 > entries->capacity) {
+        size_t n = (entries->capacity > 0) ? entries->capacity : 4096;
+        while(entries->length + len + 2 > n)
+            n *= 2;
+        char *names = realloc(entries->names, n);
+        if(names == NULL)
+            return 1;
+        entries->names = names;
+        entries->capacity = n;
+    }
+    entries->names[entries->length] = kind;
+    memcpy(entries->names + entries->length + 1, name, len + 1);
+    entries->length += len + 2;
+    entries->count++;
+    return 0;
+}
+
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(*(char* const*) a + 1, *(char* const*) b + 1);
+}
+
+
+// Reads the media files and the subdirectories of a directory, skipping
+// the hidden entries and the links to directories which could loop,
+// returns 1 if the directory cannot be read
+static int read_entries(const char *path,
+                        struct RemoteLibraryEntries *entries)
+{
+    size_t path_length = strlen(path);
+    int failed = 0;
+    entries->length = 0;
+    entries->count = 0;
+    
+    #ifdef _WIN32
+    WIN32_FIND_DATA ffd;
+    TCHAR szDir[PATH_MAX];
+    _stprintf(szDir, "%s\\*", path);
+    HANDLE hFind = FindFirstFile(szDir, &ffd);
+    if(hFind == INVALID_HANDLE_VALUE)
+        return 1;
+    do {
+        const char *name = ffd.cFileName;
+        int is_dir = (ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
+        int is_link = (ffd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT);
+    #else
+    DIR *d = opendir(path);
+    if(d == NULL)
+        return 1;
+    struct dirent *entry;
+    while((entry = readdir(d)) != NULL) {
+        const char *name = entry->d_name;
+        int is_dir = (entry->d_type == DT_DIR);
+        int is_link = (entry->d_type == DT_LNK);
+        if(entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            if(fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+            is_dir = S_ISDIR(st.st_mode);
+            is_link = S_ISLNK(st.st_mode);
+        }
+    #endif
+        if(name[0] == '.' || (is_dir && is_link) ||
+           path_length + 1 + strlen(name) >= PATH_MAX)
+            continue;
+        if(!is_dir && remote_http_listing_type(name) == 0)
+            continue;
+        if(add_entry(entries, is_dir ? 'd' : 'f', name) != 0) {
+            failed = 1;
+            break;
+        }
+    #ifdef _WIN32
+    } while(FindNextFile(hFind, &ffd) != 0);
+    FindClose(hFind);
+    #else
+    }
+    closedir(d);
+    #endif
+    
+    if(failed)
+        return 1;
+    char **sorted = realloc(entries->sorted,
+                            (entries->count + 1) * sizeof(char*));
+    if(sorted == NULL)
+        return 1;
+    entries->sorted = sorted;
+    char *p = entries->names;
+    for(size_t i=0; i<entries->count; i++) {
+        sorted[i] = p;
+        p += strlen(p + 1) + 2;
+    }
+    return 0;
+}
+
+
+// Finds a sorted entry by its name, returns its kind or 0
+static char find_entry(const struct RemoteLibraryEntries *entries,
+                       const char *name)
+{
+    size_t low = 0, high = entries->count;
+    while(low < high) {
+        size_t middle = low + (high - low) / 2;
+        int c = strcmp(entries->sorted[middle] + 1, name);
+        if(c == 0)
+            return entries->sorted[middle][0];
+        if(c < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return 0;
+}
+
+
+
+
+// Finds the position of a watch descriptor or where it belongs
+static size_t find_watch_slot(int watch) {
+    size_t low = 0, high = libraryWatchCount;
+    while(low < high) {
+        size_t middle = low + (high - low) / 2;
+        if(libraryWatches[middle].watch < watch)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+
+static uint32_t find_watch(int watch) {
+    size_t i = find_watch_slot(watch);
+    if(i < libraryWatchCount && libraryWatches[i].watch == watch)
+        return libraryWatches[i].dir;
+    return LIBRARY_NONE;
+}
+
+
+// Stops watching a directory, whose watch may be gone with it already
+static void unwatch_directory(uint32_t d, int gone) {
+    int watch = libraryDirs[d].watch;
+    if(watch < 0)
+        return;
+    size_t i = find_watch_slot(watch);
+    if(i < libraryWatchCount && libraryWatches[i].dir == d)
+        libraryWatches[i].dir = LIBRARY_NONE;
+    #ifndef _WIN32
+    if(!gone)
+        inotify_rm_watch(libraryNotify, watch);
+    #else
+    (void) gone;
+    #endif
+    libraryDirs[d].watch = -1;
+}
+
+
+// Watches a directory for changes where supported, returns 1 if its watch
+// has changed since its entries may have changed with it
+static int watch_directory(uint32_t d) {
+    #ifdef _WIN32
+    (void) d;
+    return 0;
+    #else
+    if(libraryNotify < 0)
+        return 0;
+    int watch = inotify_add_watch(libraryNotify, libraryDirs[d].path,
+                                  LIBRARY_EVENTS);
+    if(watch == libraryDirs[d].watch)
+        return 0;
+    
+    // Another file system has been mounted on the directory
+    int changed = (libraryDirs[d].watch >= 0);
+    unwatch_directory(d, 0);
+    if(watch < 0 || find_watch(watch) != LIBRARY_NONE)
+        return changed;
+    
+    size_t i = find_watch_slot(watch);
+    if(i == libraryWatchCount || libraryWatches[i].watch != watch) {
+        if(libraryWatchCount == libraryWatchCapacity) {
+            size_t n = (libraryWatchCapacity > 0) ?
+                       libraryWatchCapacity * 2 : 256;
+            void *watches = realloc(libraryWatches,
+                                    n * sizeof(struct RemoteLibraryWatch));
+            if(watches == NULL) {
+                inotify_rm_watch(libraryNotify, watch);
+                return changed;
+            }
+            libraryWatches = watches;
+            libraryWatchCapacity = n;
+        }
+        memmove(libraryWatches + i + 1, libraryWatches + i,
+                (libraryWatchCount - i) * sizeof(struct RemoteLibraryWatch));
+        libraryWatches[i].watch = watch;
+        libraryWatchCount++;
+    }
+    libraryWatches[i].dir = d;
+    libraryDirs[d].watch = watch;
+    return changed;
+    #endif
+}
+
+
+// Adds a directory, returns LIBRARY_NONE if out of memory
+static uint32_t new_directory(uint32_t parent, const char *name) {
+    size_t len = strlen(name);
+    size_t parent_length = 0;
+    if(parent != LIBRARY_NONE)
+        parent_length = strlen(libraryDirs[parent].path) + 1;
+    char *path = malloc(parent_length + len + 1);
+    if(path == NULL)
+        return LIBRARY_NONE;
+    if(parent != LIBRARY_NONE) {
+        memcpy(path, libraryDirs[parent].path, parent_length - 1);
+        path[parent_length - 1] = '/';
+    }
+    memcpy(path + parent_length, name, len + 1);
+    
+    uint32_t d = libraryFreeDir;
+    if(d != LIBRARY_NONE)
+        libraryFreeDir = libraryDirs[d].sibling;
+    else {
+        if(libraryDirCount == libraryDirCapacity) {
+            size_t n = (libraryDirCapacity > 0) ?
+                       libraryDirCapacity * 2 : 256;
+            void *dirs = realloc(libraryDirs,
+                                 n * sizeof(struct RemoteLibraryDir));
+            if(dirs == NULL) {
+                free(path);
+                return LIBRARY_NONE;
+            }
+            libraryDirs = dirs;
+            libraryDirCapacity = n;
+        }
+        d = (uint32_t) libraryDirCount++;
+    }
+    
+    struct RemoteLibraryDir *dir = &libraryDirs[d];
+    dir->path = path;
+    dir->name = (uint32_t) parent_length;
+    dir->parent = parent;
+    dir->child = LIBRARY_NONE;
+    dir->sibling = LIBRARY_NONE;
+    dir->first = 0;
+    dir->count = 0;
+    dir->added = NULL;
+    dir->number = LIBRARY_NONE;
+    dir->stamp = 0;
+    dir->watch = -1;
+    if(parent != LIBRARY_NONE) {
+        dir->sibling = libraryDirs[parent].child;
+        libraryDirs[parent].child = d;
+    }
+    return d;
+}
+
+
+// Finds a subdirectory by the first len bytes of a name
+static uint32_t find_child(uint32_t d, const char *name, size_t len) {
+    uint32_t c = libraryDirs[d].child;
+    while(c != LIBRARY_NONE) {
+        const char *n = libraryDirs[c].path + libraryDirs[c].name;
+        if(strncmp(n, name, len) == 0 && n[len] == '\0')
+            return c;
+        c = libraryDirs[c].sibling;
+    }
+    return LIBRARY_NONE;
+}
+
+
+// Finds the deepest directory known on a path
+static uint32_t find_directory(const char *path, int *exact) {
+    for(int r=0; r<libraryRootDirCount; r++) {
+        uint32_t d = libraryRootDirs[r];
+        size_t len = strlen(libraryDirs[d].path);
+        if(strncmp(path, libraryDirs[d].path, len) != 0 ||
+           (path[len] != '\0' && path[len] != '/'))
+            continue;
+        
+        const char *p = path + len;
+        while(*p == '/') {
+            const char *name = p + 1;
+            const char *end = strchr(name, '/');
+            if(end == NULL)
+                end = name + strlen(name);
+            uint32_t c = find_child(d, name, end - name);
+            if(c == LIBRARY_NONE)
+                break;
+            d = c;
+            p = end;
+        }
+        *exact = (*p == '\0');
+        return d;
+    }
+    return LIBRARY_NONE;
+}
+
+
+
+
+// Whether a directory holds a file in the index
+static int has_file(uint32_t d, const char *name) {
+    const struct RemoteLibraryIndex *index = libraryIndex;
+    const struct RemoteLibraryDir *dir = &libraryDirs[d];
+    for(uint32_t f=dir->first; f<dir->first+dir->count; f++) {
+        if(!is_removed(index, f) &&
+           strcmp(file_name(index, &index->files[f]), name) == 0)
+            return 1;
+    }
+    for(const struct RemoteLibraryAdded *a=dir->added; a!=NULL; a=a->next) {
+        if(strcmp(a->path + a->dir_length + 1, name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+
+// Adds a file created since the index was built, returns 1 if out of
+// memory
+static int add_created(uint32_t d, const char *name, int type) {
+    struct RemoteLibraryIndex *index = libraryIndex;
+    struct RemoteLibraryDir *dir = &libraryDirs[d];
+    size_t dir_length = strlen(dir->path);
+    size_t len = strlen(name);
+    if(dir_length + 1 + len >= PATH_MAX)
+        return 0;
+    struct RemoteLibraryAdded *added = malloc(
+        sizeof(struct RemoteLibraryAdded) + dir_length + 2 * len + 3
+    );
+    if(added == NULL)
+        return 1;
+    added->dir_length = (uint16_t) dir_length;
+    added->length = (uint16_t) len;
+    added->type = (uint8_t) type;
+    memcpy(added->path, dir->path, dir_length);
+    added->path[dir_length] = '/';
+    memcpy(added->path + dir_length + 1, name, len + 1);
+    char *folded = added->path + dir_length + len + 2;
+    for(size_t i=0; i<len; i++)
+        folded[i] = tolower((unsigned char) name[i]);
+    folded[len] = '\0';
+    
+    remote_mutex_lock(&libraryLock);
+    if(index->added_count == index->added_capacity) {
+        size_t n = (index->added_capacity > 0) ?
+                   index->added_capacity * 2 : 64;
+        void *list = realloc(index->added,
+                             n * sizeof(struct RemoteLibraryAdded*));
+        if(list == NULL) {
+            remote_mutex_unlock(&libraryLock);
+            free(added);
+            return 1;
+        }
+        index->added = list;
+        index->added_capacity = n;
+    }
+    added->slot = (uint32_t) index->added_count;
+    index->added[index->added_count++] = added;
+    remote_mutex_unlock(&libraryLock);
+    
+    added->next = dir->added;
+    dir->added = added;
+    return 0;
+}
+
+
+// Drops a file created since the index was built, has to be called with
+// the lock held
+static void drop_created(struct RemoteLibraryAdded *added) {
+    struct RemoteLibraryIndex *index = libraryIndex;
+    struct RemoteLibraryAdded *last = index->added[--index->added_count];
+    index->added[added->slot] = last;
+    last->slot = added->slot;
+    free(added);
+}
+
+
+// Removes a file from a directory
+static void remove_file(uint32_t d, const char *name) {
+    struct RemoteLibraryIndex *index = libraryIndex;
+    struct RemoteLibraryDir *dir = &libraryDirs[d];
+    for(uint32_t f=dir->first; f<dir->first+dir->count; f++) {
+        if(!is_removed(index, f) &&
+           strcmp(file_name(index, &index->files[f]), name) == 0) {
+            remote_mutex_lock(&libraryLock);
+            mark_removed(index, f);
+            remote_mutex_unlock(&libraryLock);
+            return;
+        }
+    }
+    for(struct RemoteLibraryAdded **a=&dir->added; *a!=NULL; a=&(*a)->next)
+    {
+        if(strcmp((*a)->path + (*a)->dir_length + 1, name) == 0) {
+            struct RemoteLibraryAdded *added = *a;
+            *a = added->next;
+            remote_mutex_lock(&libraryLock);
+            drop_created(added);
+            remote_mutex_unlock(&libraryLock);
+            return;
+        }
+    }
+}
+
+
+// Removes the files of a directory missing from its sorted entries, or all
+// of them without entries
+static void remove_files(uint32_t d,
+                         const struct RemoteLibraryEntries *entries)
+{
+    struct RemoteLibraryIndex *index = libraryIndex;
+    struct RemoteLibraryDir *dir = &libraryDirs[d];
+    remote_mutex_lock(&libraryLock);
+    for(uint32_t f=dir->first; f<dir->first+dir->count; f++) {
+        if(is_removed(index, f))
+            continue;
+        if(entries != NULL &&
+           find_entry(entries, file_name(index, &index->files[f])) == 'f')
+            continue;
+        mark_removed(index, f);
+    }
+    struct RemoteLibraryAdded **a = &dir->added;
+    while(*a != NULL) {
+        struct RemoteLibraryAdded *added = *a;
+        if(entries != NULL &&
+           find_entry(entries, added->path + added->dir_length + 1) == 'f') {
+            a = &added->next;
+            continue;
+        }
+        *a = added->next;
+        drop_created(added);
+    }
+    remote_mutex_unlock(&libraryLock);
+}
+
+
+static void free_subtree(uint32_t d, int gone);
+
+
+// Removes the files and the subdirectories of a directory
+static void clear_directory(uint32_t d, int gone) {
+    remove_files(d, NULL);
+    uint32_t c = libraryDirs[d].child;
+    libraryDirs[d].child = LIBRARY_NONE;
+    while(c != LIBRARY_NONE) {
+        uint32_t next = libraryDirs[c].sibling;
+        free_subtree(c, gone);
+        c = next;
+    }
+}
+
+
+// Removes a directory already out of the list of its parent
+static void free_subtree(uint32_t d, int gone) {
+    clear_directory(d, gone);
+    unwatch_directory(d, gone);
+    free(libraryDirs[d].path);
+    libraryDirs[d].path = NULL;
+    libraryDirs[d].sibling = libraryFreeDir;
+    libraryFreeDir = d;
+}
+
+
+// Removes a subdirectory with all its content
+static void remove_directory(uint32_t d, int gone) {
+    uint32_t *c = &libraryDirs[libraryDirs[d].parent].child;
+    while(*c != d)
+        c = &libraryDirs[*c].sibling;
+    *c = libraryDirs[d].sibling;
+    free_subtree(d, gone);
+}
+
+
+static void free_directories() {
+    for(size_t d=0; d<libraryDirCount; d++)
+        free(libraryDirs[d].path);
+    free(libraryDirs);
+    free(libraryWatches);
+    libraryDirs = NULL;
+    libraryDirCount = 0;
+    libraryDirCapacity = 0;
+    libraryFreeDir = LIBRARY_NONE;
+    libraryRootDirCount = 0;
+    libraryWatches = NULL;
+    libraryWatchCount = 0;
+    libraryWatchCapacity = 0;
+}
+
+
+
+
+// Lists the roots with their variables expanded, the default folders
+// unless roots are given, and the uploads
+static int expand_roots(char (*roots)[PATH_MAX]) {
+    static const char *defaults[] = {"${Videos}", "${Music}", "uploads"};
+    int count = 0;
+    for(int i=0; i<libraryRootCount; i++)
+        remote_environment_process_variables(libraryRoots[i], roots[count++]);
+    if(count == 0) {
+        remote_environment_process_variables(defaults[0], roots[count++]);
+        remote_environment_process_variables(defaults[1], roots[count++]);
+        #ifndef _WIN32
+        const char *user = getenv("USER");
+        if(user != NULL)
+            snprintf(roots[count++], PATH_MAX, "/media/%s", user);
+        #endif
+    }
+    remote_environment_process_variables(defaults[2], roots[count++]);
+    
+    // Drops the variables which could not be expanded
+    int n = 0;
+    for(int i=0; i<count; i++) {
+        if(roots[i][0] != '\0' && n++ != i)
+            memcpy(roots[n-1], roots[i], PATH_MAX);
+    }
+    return n;
+}
+
+
+
+
+static const char *get_snapshot_file() {
+    static char path[PATH_MAX];
+    static int done = 0;
+    if(done)
+        return path;
+    #ifdef _WIN32
+    SHGetSpecialFolderPathA(NULL, path, CSIDL_LOCAL_APPDATA, 0);
+    strcat(path, "/MPV Remote");
+    CreateDirectory(path, NULL);
+    #else
+    const char *home = getenv("HOME");
+    snprintf(path, PATH_MAX-32, "%s/.cache", home != NULL ? home : ".");
+    mkdir(path, 0700);
+    strcat(path, "/mpv-remote");
+    mkdir(path, 0700);
+    #endif
+    strcat(path, "/library.index");
+    done = 1;
+    return path;
+}
+
+
+// Gives the offset of the next section of a snapshot
+static uint64_t place_section(uint64_t *offset, size_t size) {
+    uint64_t start = *offset;
+    *offset = (start + size + 7) & ~(uint64_t) 7;
+    return start;
+}
+
+
+// Writes a section of a snapshot padded to 8 bytes, returns 1 on failure
+static int write_section(FILE *fp, const void *data, size_t size) {
+    static const char padding[8] = {0};
+    if(size > 0 && fwrite(data, 1, size, fp) != size)
+        return 1;
+    size_t pad = (8 - size % 8) % 8;
+    return (pad > 0 && fwrite(padding, 1, pad, fp) != pad);
+}
+
+
+// Writes the index with its directories to start from them next time,
+// replacing the former snapshot only once complete
+static void save_snapshot(const struct RemoteLibraryIndex *index) {
+    size_t dir_count = index->dir_count;
+    size_t restart_count = (dir_count + LIBRARY_RESTART - 1) /
+                           LIBRARY_RESTART;
+    uint32_t *parents = calloc(dir_count + 1, sizeof(uint32_t));
+    uint32_t *firsts = calloc(dir_count + 1, sizeof(uint32_t));
+    int64_t *stamps = calloc(dir_count + 1, sizeof(int64_t));
+    if(parents == NULL || firsts == NULL || stamps == NULL) {
+        free(parents);
+        free(firsts);
+        free(stamps);
+        return;
+    }
+    
+    // The directories are numbered in the order of their files
+    for(size_t d=0; d<libraryDirCount; d++) {
+        const struct RemoteLibraryDir *dir = &libraryDirs[d];
+        if(dir->path == NULL || dir->number >= dir_count)
+            continue;
+        parents[dir->number] = (dir->parent == LIBRARY_NONE) ? LIBRARY_NONE
+                               : libraryDirs[dir->parent].number;
+        firsts[dir->number] = dir->first;
+        stamps[dir->number] = dir->stamp;
+    }
+    firsts[dir_count] = (uint32_t) index->file_count;
+    size_t posting_count = 0;
+    for(size_t i=0; i<index->slots; i++)
+        posting_count += index->counts[i];
+    
+    struct RemoteLibraryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LIBRARY_MAGIC, sizeof(header.magic));
+    header.version = LIBRARY_VERSION;
+    header.order = LIBRARY_ORDER;
+    header.file_count = index->file_count;
+    header.dir_count = dir_count;
+    header.strings_length = index->strings_length;
+    header.dirs_length = index->dirs_length;
+    header.slots = index->slots;
+    header.posting_count = posting_count;
+    uint64_t offset = 0;
+    place_section(&offset, sizeof(header));
+    size_t files_size = index->file_count * sizeof(struct RemoteLibraryFile);
+    header.files = place_section(&offset, files_size);
+    header.strings = place_section(&offset, index->strings_length);
+    header.dirs = place_section(&offset, index->dirs_length);
+    header.restarts = place_section(&offset,
+                                    restart_count * sizeof(uint32_t));
+    header.parents = place_section(&offset, dir_count * sizeof(uint32_t));
+    header.firsts = place_section(&offset,
+                                  (dir_count + 1) * sizeof(uint32_t));
+    header.stamps = place_section(&offset, dir_count * sizeof(int64_t));
+    header.keys = place_section(&offset, index->slots * sizeof(uint32_t));
+    header.starts = place_section(&offset, index->slots * sizeof(uint32_t));
+    header.counts = place_section(&offset, index->slots * sizeof(uint32_t));
+    header.postings = place_section(&offset,
+                                    posting_count * sizeof(uint32_t));
+    header.size = offset;
+    
+    char temp[PATH_MAX];
+    snprintf(temp, PATH_MAX, "%s.tmp", get_snapshot_file());
+    FILE *fp = fopen(temp, "wb");
+    int failed = (fp == NULL);
+    if(!failed) {
+        failed = write_section(fp, &header, sizeof(header)) ||
+                 write_section(fp, index->files, files_size) ||
+                 write_section(fp, index->strings, index->strings_length) ||
+                 write_section(fp, index->dirs, index->dirs_length) ||
+                 write_section(fp, index->restarts,
+                               restart_count * sizeof(uint32_t)) ||
+                 write_section(fp, parents, dir_count * sizeof(uint32_t)) ||
+                 write_section(fp, firsts,
+                               (dir_count + 1) * sizeof(uint32_t)) ||
+                 write_section(fp, stamps, dir_count * sizeof(int64_t)) ||
+                 write_section(fp, index->keys,
+                               index->slots * sizeof(uint32_t)) ||
+                 write_section(fp, index->starts,
+                               index->slots * sizeof(uint32_t)) ||
+                 write_section(fp, index->counts,
+                               index->slots * sizeof(uint32_t)) ||
+                 write_section(fp, index->postings,
+                               posting_count * sizeof(uint32_t));
+        failed = (fclose(fp) != 0) || failed;
+    }
+    #ifdef _WIN32
+    if(failed || !MoveFileExA(temp, get_snapshot_file(),
+                              MOVEFILE_REPLACE_EXISTING))
+        remove(temp);
+    #else
+    if(failed || rename(temp, get_snapshot_file()) != 0)
+        remove(temp);
+    #endif
+    free(parents);
+    free(firsts);
+    free(stamps);
+}
+
+
+// Whether a section of count elements of a snapshot lies within it
+static int has_section(const struct RemoteLibraryHeader *header,
+                       uint64_t offset, uint64_t count, size_t size)
+{
+    return offset % 8 == 0 && offset <= header->size &&
+           count <= (header->size - offset) / size;
+}
+
+
+// Maps the snapshot of the index read only, returns NULL if there is none
+// or it cannot be used
+static struct RemoteLibraryIndex *load_snapshot() {
+    void *mapping = NULL;
+    size_t size = 0;
+    #ifdef _WIN32
+    HANDLE file = CreateFileA(get_snapshot_file(), GENERIC_READ,
+                              FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+        return NULL;
+    LARGE_INTEGER file_size;
+    if(GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        size = (size_t) file_size.QuadPart;
+        HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0,
+                                        NULL);
+        if(map != NULL) {
+            mapping = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(map);
+        }
+    }
+    CloseHandle(file);
+    if(mapping == NULL)
+        return NULL;
+    #else
+    int fd = open(get_snapshot_file(), O_RDONLY);
+    if(fd < 0)
+        return NULL;
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size > 0) {
+        size = (size_t) st.st_size;
+        mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if(mapping == NULL || mapping == MAP_FAILED)
+        return NULL;
+    #endif
+    
+    // Only the header and the bounds of the sections are checked so that
+    // it loads in constant time, the records being checked where they are
+    // used
+    struct RemoteLibraryIndex *index = NULL;
+    const struct RemoteLibraryHeader *header = mapping;
+    uint8_t *base = mapping;
+    if(size >= sizeof(struct RemoteLibraryHeader) &&
+       memcmp(header->magic, LIBRARY_MAGIC, sizeof(header->magic)) == 0 &&
+       header->version == LIBRARY_VERSION &&
+       header->order == LIBRARY_ORDER && header->size == size &&
+       header->file_count < UINT32_MAX && header->dir_count < UINT32_MAX &&
+       header->slots > 0 && (header->slots & (header->slots - 1)) == 0 &&
+       has_section(header, header->files, header->file_count,
+                   sizeof(struct RemoteLibraryFile)) &&
+       has_section(header, header->strings, header->strings_length, 1) &&
+       has_section(header, header->dirs, header->dirs_length, 1) &&
+       has_section(header, header->restarts,
+                   (header->dir_count + LIBRARY_RESTART - 1) /
+                   LIBRARY_RESTART, sizeof(uint32_t)) &&
+       has_section(header, header->parents, header->dir_count,
+                   sizeof(uint32_t)) &&
+       has_section(header, header->firsts, header->dir_count + 1,
+                   sizeof(uint32_t)) &&
+       has_section(header, header->stamps, header->dir_count,
+                   sizeof(int64_t)) &&
+       has_section(header, header->keys, header->slots, sizeof(uint32_t)) &&
+       has_section(header, header->starts, header->slots,
+                   sizeof(uint32_t)) &&
+       has_section(header, header->counts, header->slots,
+                   sizeof(uint32_t)) &&
+       has_section(header, header->postings, header->posting_count,
+                   sizeof(uint32_t)) &&
+       (header->strings_length == 0 ||
+        base[header->strings + header->strings_length - 1] == '\0'))
+        index = calloc(1, sizeof(struct RemoteLibraryIndex));
+    if(index == NULL) {
+        #ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        #else
+        munmap(mapping, size);
+        #endif
+        return NULL;
+    }
+    
+    index->mapping = mapping;
+    index->mapping_size = size;
+    index->files = (struct RemoteLibraryFile*) (base + header->files);
+    index->file_count = index->file_capacity = header->file_count;
+    index->strings = (char*) (base + header->strings);
+    index->strings_length = index->strings_capacity = header->strings_length;
+    index->dirs = base + header->dirs;
+    index->dirs_length = index->dirs_capacity = header->dirs_length;
+    index->restarts = (uint32_t*) (base + header->restarts);
+    index->dir_count = header->dir_count;
+    index->keys = (uint32_t*) (base + header->keys);
+    index->starts = (uint32_t*) (base + header->starts);
+    index->counts = (uint32_t*) (base + header->counts);
+    index->slots = header->slots;
+    index->postings = (uint32_t*) (base + header->postings);
+    index->posting_count = header->posting_count;
+    return index;
+}
+
+
+// Builds the directories back from the snapshot of the index, each record
+// being the directory of the same number, returns 1 if they do not match
+// the roots
+static int load_directories(const struct RemoteLibraryIndex *index) {
+    const struct RemoteLibraryHeader *header = index->mapping;
+    const uint8_t *base = index->mapping;
+    const uint32_t *parents = (const uint32_t*) (base + header->parents);
+    const uint32_t *firsts = (const uint32_t*) (base + header->firsts);
+    const int64_t *stamps = (const int64_t*) (base + header->stamps);
+    char path[PATH_MAX];
+    for(size_t n=0; n<index->dir_count && !libraryStopping; n++) {
+        uint32_t parent = parents[n];
+        if((parent != LIBRARY_NONE && parent >= n) ||
+           firsts[n] > firsts[n+1] || firsts[n+1] > index->file_count)
+            return 1;
+        get_dir(index, (uint32_t) n, path);
+        
+        // A path has to be right under the one of its parent
+        const char *name = path;
+        if(parent != LIBRARY_NONE) {
+            const char *parent_path = libraryDirs[parent].path;
+            size_t len = strlen(parent_path);
+            if(strncmp(path, parent_path, len) != 0 || path[len] != '/')
+                return 1;
+            name = path + len + 1;
+        }
+        else if(libraryRootDirCount == LIBRARY_ROOTS)
+            return 1;
+        uint32_t d = new_directory(parent, name);
+        if(d != n)
+            return 1;
+        libraryDirs[d].number = d;
+        libraryDirs[d].first = firsts[n];
+        libraryDirs[d].count = firsts[n+1] - firsts[n];
+        libraryDirs[d].stamp = stamps[n];
+        if(parent == LIBRARY_NONE)
+            libraryRootDirs[libraryRootDirCount++] = d;
+    }
+    
+    // The roots crawled have to be the ones expected now, but for those
+    // found under another root
+    char (*roots)[PATH_MAX] = malloc(LIBRARY_ROOTS * PATH_MAX);
+    if(roots == NULL || libraryStopping) {
+        free(roots);
+        return 1;
+    }
+    int count = expand_roots(roots);
+    int r = 0;
+    for(int i=0; i<count; i++) {
+        int exact = 0;
+        if(r < libraryRootDirCount &&
+           strcmp(roots[i], libraryDirs[libraryRootDirs[r]].path) == 0)
+            r++;
+        else if(find_directory(roots[i], &exact) == LIBRARY_NONE || !exact)
+            break;
+    }
+    free(roots);
+    return (r != libraryRootDirCount);
+}
+
+
+
+
+// Reads the directories under a directory into the index being built or
+// as files created since the index was built, returns 1 if out of memory
+// or stopping
+static int crawl_directory(uint32_t top, struct RemoteLibraryIndex *index) {
+    struct RemoteLibraryEntries entries = {0};
+    uint32_t *stack = malloc(64 * sizeof(uint32_t));
+    size_t depth = 0, capacity = 64;
+    int failed = (stack == NULL);
+    if(!failed)
+        stack[depth++] = top;
+    
+    while(depth > 0 && !failed) {
+        if(libraryStopping) {
+            failed = 1;
+            break;
+        }
+        
+        // Watches the directory before reading it so that no change is
+        // missed in between
+        uint32_t d = stack[--depth];
+        watch_directory(d);
+        
+        // Even a directory which cannot be read is kept in the index so
+        // that the snapshot holds all of them
+        uint32_t number = 0;
+        if(index != NULL) {
+            number = add_dir(index, libraryDirs[d].path);
+            if(number == LIBRARY_NONE) {
+                failed = 1;
+                break;
+            }
+            libraryDirs[d].number = number;
+            libraryDirs[d].first = (uint32_t) index->file_count;
+            libraryDirs[d].count = 0;
+        }
+        if(directory_stamp(libraryDirs[d].path, &libraryDirs[d].stamp) != 0
+           || read_entries(libraryDirs[d].path, &entries) != 0)
+            continue;
+        
+        for(size_t i=0; i<entries.count && !failed; i++) {
+            const char *name = entries.sorted[i] + 1;
+            if(entries.sorted[i][0] == 'f') {
+                int type = remote_http_listing_type(name);
+                if(index != NULL)
+                    failed = add_file(index, number, name, type);
+                else
+                    failed = add_created(d, name, type);
+                continue;
+            }
+            if(depth == capacity) {
+                uint32_t *s = realloc(stack,
+                                      capacity * 2 * sizeof(uint32_t));
+                if(s == NULL) {
+                    failed = 1;
+                    break;
+                }
+                stack = s;
+                capacity *= 2;
+            }
+            uint32_t c = new_directory(d, name);
+            if(c == LIBRARY_NONE)
+                failed = 1;
+            else
+                stack[depth++] = c;
+        }
+        if(index != NULL) {
+            libraryDirs[d].count = (uint32_t) index->file_count -
+                                   libraryDirs[d].first;
+        }
+    }
+    free(stack);
+    free(entries.names);
+    free(entries.sorted);
+    return failed;
+}
+
+
+// Brings a directory up to date if it has changed since it was read last,
+// crawling its new subdirectories
+static void sync_directory(uint32_t d, int force) {
+    // Watches the directory before checking it so that no change is missed
+    // in between
+    if(watch_directory(d))
+        force = 1;
+    int64_t stamp;
+    if(directory_stamp(libraryDirs[d].path, &stamp) != 0) {
+        if(libraryDirs[d].parent != LIBRARY_NONE)
+            remove_directory(d, 0);
+        else {
+            clear_directory(d, 0);
+            unwatch_directory(d, 0);
+            libraryDirs[d].stamp = 0;
+        }
+        return;
+    }
+    if(stamp == libraryDirs[d].stamp && !force)
+        return;
+    
+    struct RemoteLibraryEntries entries = {0};
+    if(read_entries(libraryDirs[d].path, &entries) != 0) {
+        free(entries.names);
+        free(entries.sorted);
+        return;
+    }
+    libraryDirs[d].stamp = stamp;
+    qsort(entries.sorted, entries.count, sizeof(char*), compare_entries);
+    
+    // Drops what is gone
+    remove_files(d, &entries);
+    uint32_t c = libraryDirs[d].child;
+    while(c != LIBRARY_NONE) {
+        uint32_t next = libraryDirs[c].sibling;
+        if(find_entry(&entries,
+                      libraryDirs[c].path + libraryDirs[c].name) != 'd')
+            remove_directory(c, 0);
+        c = next;
+    }
+    
+    // Adds what is new
+    for(size_t i=0; i<entries.count && !libraryStopping; i++) {
+        const char *name = entries.sorted[i] + 1;
+        if(entries.sorted[i][0] == 'd') {
+            if(find_child(d, name, strlen(name)) != LIBRARY_NONE)
+                continue;
+            c = new_directory(d, name);
+            if(c == LIBRARY_NONE || crawl_directory(c, NULL) != 0)
+                break;
+        }
+        else if(!has_file(d, name)) {
+            if(add_created(d, name, remote_http_listing_type(name)) != 0)
+                break;
+        }
+    }
+    free(entries.names);
+    free(entries.sorted);
+}
+
+
+// Checks the directories which may have changed unnoticed, or all of them
+// when notifications have been lost, only reading the ones changed
+static void sync_directories(int all) {
+    size_t count = libraryDirCount;
+    for(size_t d=0; d<count && !libraryStopping; d++) {
+        const struct RemoteLibraryDir *dir = &libraryDirs[d];
+        if(dir->path == NULL)
+            continue;
+        
+        // A drive may have been mounted on the roots or right under them
+        int top = (dir->parent == LIBRARY_NONE ||
+                   libraryDirs[dir->parent].parent == LIBRARY_NONE);
+        if(all || top || dir->watch < 0)
+            sync_directory((uint32_t) d, 0);
+    }
+}
+
+
+// Crawls all the roots into a new index
+static struct RemoteLibraryIndex *crawl_library() {
+    struct RemoteLibraryIndex *index;
+    index = calloc(1, sizeof(struct RemoteLibraryIndex));
+    char (*roots)[PATH_MAX] = malloc(LIBRARY_ROOTS * PATH_MAX);
+    int failed = (index == NULL || roots == NULL);
+    
+    int count = failed ? 0 : expand_roots(roots);
+    for(int i=0; i<count && !failed; i++) {
+        int exact = 0;
+        if(find_directory(roots[i], &exact) != LIBRARY_NONE && exact)
+            continue;
+        uint32_t d = new_directory(LIBRARY_NONE, roots[i]);
+        if(d != LIBRARY_NONE)
+            libraryRootDirs[libraryRootDirCount++] = d;
+        failed = (d == LIBRARY_NONE || crawl_directory(d, index) != 0);
+    }
+    if(!failed)
+        failed = build_trigrams(index);
+    free(roots);
+    if(failed) {
+        if(index != NULL)
+            free_index(index);
+        return NULL;
+    }
+    return index;
+}
+
+
+// Builds the index again with the files created and deleted since it was
+// built, without reading any directory
+static void compact_index() {
+    const struct RemoteLibraryIndex *old = libraryIndex;
+    struct RemoteLibraryIndex *index;
+    index = calloc(1, sizeof(struct RemoteLibraryIndex));
+    uint32_t *firsts = calloc(libraryDirCount + 1, sizeof(uint32_t));
+    uint32_t *counts = calloc(libraryDirCount + 1, sizeof(uint32_t));
+    uint32_t *numbers = malloc((libraryDirCount + 1) * sizeof(uint32_t));
+    uint32_t *stack = malloc((libraryDirCount + 1) * sizeof(uint32_t));
+    int failed = (index == NULL || firsts == NULL || counts == NULL ||
+                  numbers == NULL || stack == NULL);
+    for(size_t d=0; d<libraryDirCount && !failed; d++)
+        numbers[d] = LIBRARY_NONE;
+    
+    // The directories are numbered in pre-order like the crawl does, since
+    // the records freed are reused, so that every parent comes before its
+    // subdirectories in the snapshot
+    for(int r=0; r<libraryRootDirCount && !failed; r++) {
+        size_t depth = 0;
+        stack[depth++] = libraryRootDirs[r];
+        while(depth > 0 && !failed) {
+            uint32_t d = stack[--depth];
+            const struct RemoteLibraryDir *dir = &libraryDirs[d];
+            numbers[d] = add_dir(index, dir->path);
+            failed = (numbers[d] == LIBRARY_NONE);
+            firsts[d] = (uint32_t) index->file_count;
+            for(uint32_t f=dir->first; f<dir->first+dir->count && !failed;
+                f++)
+            {
+                const struct RemoteLibraryFile *file = &old->files[f];
+                if(!is_removed(old, f)) {
+                    failed = add_file(index, numbers[d],
+                                      file_name(old, file), file->type);
+                }
+            }
+            for(const struct RemoteLibraryAdded *a=dir->added;
+                a!=NULL && !failed; a=a->next)
+            {
+                failed = add_file(index, numbers[d],
+                                  a->path + a->dir_length + 1, a->type);
+            }
+            counts[d] = (uint32_t) index->file_count - firsts[d];
+            for(uint32_t c=dir->child; c!=LIBRARY_NONE;
+                c=libraryDirs[c].sibling)
+                stack[depth++] = c;
+        }
+    }
+    free(stack);
+    if(!failed)
+        failed = build_trigrams(index);
+    if(failed) {
+        if(index != NULL)
+            free_index(index);
+        free(firsts);
+        free(counts);
+        free(numbers);
+        return;
+    }
+    
+    // The files created are freed with the former index
+    publish_index(index);
+    for(size_t d=0; d<libraryDirCount; d++) {
+        libraryDirs[d].first = firsts[d];
+        libraryDirs[d].count = counts[d];
+        libraryDirs[d].number = numbers[d];
+        libraryDirs[d].added = NULL;
+    }
+    free(firsts);
+    free(counts);
+    free(numbers);
+    save_snapshot(index);
+}
+
+
+// Indexes the files given right away
+static void add_pending() {
+    remote_mutex_lock(&libraryLock);
+    struct RemoteLibraryPath *pending = libraryPending;
+    libraryPending = NULL;
+    remote_mutex_unlock(&libraryLock);
+    
+    while(pending != NULL) {
+        struct RemoteLibraryPath *next = pending->next;
+        char *slash = strrchr(pending->path, '/');
+        int type = remote_http_listing_type(pending->path);
+        if(slash != NULL && type != 0) {
+            *slash = '\0';
+            int exact = 0;
+            uint32_t d = find_directory(pending->path, &exact);
+            
+            // A directory not known or not watched is read again
+            if(d != LIBRARY_NONE) {
+                if(!exact || libraryDirs[d].watch < 0)
+                    sync_directory(d, 1);
+                else if(!has_file(d, slash + 1))
+                    add_created(d, slash + 1, type);
+            }
+        }
+        free(pending);
+        pending = next;
+    }
+}
+
+
+#ifndef _WIN32
+// Applies a change notified in a directory
+static void apply_event(const struct inotify_event *event, int *overflow) {
+    if(event->mask & IN_Q_OVERFLOW) {
+        *overflow = 1;
+        return;
+    }
+    uint32_t d = find_watch(event->wd);
+    if(d == LIBRARY_NONE)
+        return;
+    
+    // The watch is gone with the directory or its file system
+    if(event->mask & IN_IGNORED) {
+        unwatch_directory(d, 1);
+        return;
+    }
+    if(event->mask & IN_UNMOUNT) {
+        clear_directory(d, 1);
+        libraryDirs[d].stamp = 0;
+        return;
+    }
+    if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        if(libraryDirs[d].parent == LIBRARY_NONE) {
+            clear_directory(d, 0);
+            unwatch_directory(d, 0);
+            libraryDirs[d].stamp = 0;
+        }
+        return;
+    }
+    if(event->len == 0 || event->name[0] == '.')
+        return;
+    
+    const char *name = event->name;
+    if(event->mask & IN_ISDIR) {
+        uint32_t c = find_child(d, name, strlen(name));
+        if(event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            if(c != LIBRARY_NONE)
+                remove_directory(c, (event->mask & IN_DELETE) != 0);
+        }
+        else if(c != LIBRARY_NONE)
+            sync_directory(c, 0);
+        else if(strlen(libraryDirs[d].path) + 1 + strlen(name) < PATH_MAX) {
+            c = new_directory(d, name);
+            if(c != LIBRARY_NONE)
+                crawl_directory(c, NULL);
+        }
+        return;
+    }
+    
+    int type = remote_http_listing_type(name);
+    if(type == 0)
+        return;
+    if(event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        remove_file(d, name);
+        return;
+    }
+    
+    // Only a link is complete as soon as it is created
+    if(event->mask & IN_CREATE) {
+        char path[PATH_MAX];
+        struct stat st;
+        snprintf(path, PATH_MAX, "%s/%s", libraryDirs[d].path, name);
+        if(lstat(path, &st) != 0 || !S_ISLNK(st.st_mode))
+            return;
+    }
+    if(!has_file(d, name))
+        add_created(d, name, type);
+}
+
+
+// Applies all the changes notified, returns 1 if some have been lost
+static int read_events() {
+    char buffer[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    int overflow = 0;
+    while(!libraryStopping) {
+        ssize_t len = read(libraryNotify, buffer, sizeof(buffer));
+        if(len <= 0)
+            break;
+        for(char *p=buffer; p<buffer+len; ) {
+            struct inotify_event *event = (struct inotify_event*) p;
+            apply_event(event, &overflow);
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return overflow;
+}
+#endif
+
+
+// Waits for changes or stopping, returns 1 if changes have been notified
+static int wait_changes(long timeout) {
+    #ifndef _WIN32
+    if(libraryNotify >= 0) {
+        struct pollfd fds[2] = {
+            {libraryNotify, POLLIN, 0},
+            {libraryWakePipe[0], POLLIN, 0}
+        };
+        if(poll(fds, 2, (int) timeout) <= 0)
+            return 0;
+        if(fds[1].revents != 0) {
+            char wake[64];
+            if(read(libraryWakePipe[0], wake, sizeof(wake)) < 0)
+                return 0;
+        }
+        return (fds[0].revents != 0);
+    }
+    #endif
+    remote_mutex_lock(&libraryLock);
+    if(!libraryStopping && libraryPending == NULL)
+        remote_cond_timedwait(&libraryWake, &libraryLock, timeout);
+    remote_mutex_unlock(&libraryLock);
+    return 0;
+}
+
+
+// Wakes the library thread up, has to be called with the lock held
+static void wake_library() {
+    remote_cond_broadcast(&libraryWake);
+    #ifndef _WIN32
+    if(libraryNotify >= 0) {
+        char wake = 0;
+        if(write(libraryWakePipe[1], &wake, 1) != 1)
+            return;
+    }
+    #endif
+}
+
+
+// Crawls the roots once then keeps the index up to date with the changes
+// notified, checking the directories not watched from time to time
+static void *library_loop(void *arg) {
+    (void) arg;
+    
+    // Searches the snapshot right away while checking what has changed
+    // since it was written
+    int ready = 0;
+    struct RemoteLibraryIndex *snapshot = load_snapshot();
+    if(snapshot != NULL) {
+        publish_index(snapshot);
+        if(load_directories(snapshot) == 0) {
+            sync_directories(1);
+            ready = 1;
+        }
+        else
+            free_directories();
+    }
+    while(!libraryStopping && !ready) {
+        struct RemoteLibraryIndex *index = crawl_library();
+        if(index != NULL) {
+            publish_index(index);
+            save_snapshot(index);
+            ready = 1;
+        }
+        else {
+            free_directories();
+            wait_changes(LIBRARY_RESCAN * 1000L);
+        }
+    }
+    
+    time_t checked = time(NULL);
+    while(!libraryStopping) {
+        // Merges the changes into the index before they slow the searches
+        const struct RemoteLibraryIndex *index = libraryIndex;
+        size_t limit = index->file_count / 8;
+        if(limit < LIBRARY_DELTA_MIN)
+            limit = LIBRARY_DELTA_MIN;
+        if(limit > LIBRARY_DELTA_MAX)
+            limit = LIBRARY_DELTA_MAX;
+        if(index->added_count + index->removed_count > limit)
+            compact_index();
+        
+        long elapsed = (long) (time(NULL) - checked);
+        long timeout = (elapsed < LIBRARY_RESCAN) ?
+                       (LIBRARY_RESCAN - elapsed) * 1000L : 0;
+        int notified = wait_changes(timeout);
+        if(libraryStopping)
+            break;
+        
+        int overflow = 0;
+        #ifndef _WIN32
+        if(notified)
+            overflow = read_events();
+        #else
+        (void) notified;
+        #endif
+        add_pending();
+        if(overflow)
+            sync_directories(1);
+        else if(time(NULL) - checked >= LIBRARY_RESCAN) {
+            sync_directories(0);
+            checked = time(NULL);
+        }
+    }
+    return NULL;
+}
+
+
+
+
+// Intersects two sorted lists of files into the first one
+static size_t intersect(uint32_t *a, size_t na, const uint32_t *b,
+                        size_t nb)
+{
+    size_t i = 0, j = 0, n = 0;
+    while(i < na && j < nb) {
+        if(a[i] < b[j])
+            i++;
+        else if(a[i] > b[j])
+            j++;
+        else {
+            a[n++] = a[i++];
+            j++;
+        }
+    }
+    return n;
+}
+
+
+static int compare_lists(const void *a, const void *b) {
+    const uint32_t *x = a, *y = b;
+    return (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+
+static int compare_matches(const void *a, const void *b) {
+    const struct RemoteLibraryMatch *x = a, *y = b;
+    if(x->score != y->score)
+        return (x->score < y->score) ? 1 : -1;
+    return (x->file > y->file) - (x->file < y->file);
+}
+
+
+// Scores a name holding every word, returns -1 if a word is missing
+static int score_name(const char *folded, size_t length,
+                      char **words, int word_count)
+{
+    int score = 0;
+    for(int i=0; i<word_count; i++) {
+        const char *p = strstr(folded, words[i]);
+        if(p == NULL)
+            return -1;
+        if(p == folded)
+            score += 1000;
+        else if(!isalnum((unsigned char) p[-1]))
+            score += 500;
+    }
+    return score + 256 - (int) (length < 256 ? length : 256);
+}
+
+
+// Finds the files holding every word, the matches are to free
+static struct RemoteLibraryMatch *search_index(
+    const struct RemoteLibraryIndex *index,
+    char **words,
+    int word_count,
+    int types,
+    size_t *match_count
+)
+{
+    // Gathers the list of files of every trigram of the query
+    uint32_t trigrams[LIBRARY_QUERY_MAX];
+    uint32_t lists[LIBRARY_QUERY_MAX][2];
+    size_t list_count = 0;
+    *match_count = 0;
+    for(int w=0; w<word_count; w++) {
+        size_t n = trigrams_of(words[w], strlen(words[w]), trigrams);
+        for(size_t i=0; i<n && list_count<LIBRARY_QUERY_MAX; i++) {
+            // A slot of the snapshot pointing past the postings matches
+            // nothing
+            size_t slot = find_slot(index->keys, index->slots, trigrams[i]);
+            if(index->keys[slot] != trigrams[i] ||
+               (uint64_t) index->starts[slot] + index->counts[slot] >
+               index->posting_count)
+                return NULL;
+            lists[list_count][0] = index->starts[slot];
+            lists[list_count][1] = index->counts[slot];
+            list_count++;
+        }
+    }
+    
+    // Intersects the shortest lists first
+    uint32_t *candidates = NULL;
+    size_t candidate_count = index->file_count;
+    if(list_count > 0) {
+        qsort(lists, list_count, sizeof(lists[0]), compare_lists);
+        candidate_count = lists[0][1];
+        candidates = malloc((candidate_count + 1) * sizeof(uint32_t));
+        if(candidates == NULL)
+            return NULL;
+        memcpy(candidates, index->postings + lists[0][0],
+               candidate_count * sizeof(uint32_t));
+        for(size_t i=1; i<list_count && candidate_count>0; i++) {
+            candidate_count = intersect(candidates, candidate_count,
+                                        index->postings + lists[i][0],
+                                        lists[i][1]);
+        }
+    }
+    
+    // Checks and scores the candidates since the trigrams may be apart
+    struct RemoteLibraryMatch *matches = malloc(
+        (candidate_count + 1) * sizeof(struct RemoteLibraryMatch)
+    );
+    if(matches == NULL) {
+        free(candidates);
+        return NULL;
+    }
+    size_t n = 0;
+    for(size_t i=0; i<candidate_count; i++) {
+        uint32_t f = (candidates != NULL) ? candidates[i] : (uint32_t) i;
+        if(f >= index->file_count)
+            continue;
+        const struct RemoteLibraryFile *file = &index->files[f];
+        if(!(file->type & types) || file->folded >= index->strings_length)
+            continue;
+        int score = score_name(index->strings + file->folded, file->length,
+                               words, word_count);
+        if(score < 0)
+            continue;
+        matches[n].file = f;
+        matches[n].score = score;
+        n++;
+    }
+    free(candidates);
+    qsort(matches, n, sizeof(struct RemoteLibraryMatch), compare_matches);
+    *match_count = n;
+    return matches;
+}
+
+
+// Finds the files created since the index was built holding every word,
+// has to be called with the lock held, the matches are to free
+static struct RemoteLibraryMatch *search_created(
+    const struct RemoteLibraryIndex *index,
+    char **words,
+    int word_count,
+    int types,
+    size_t *match_count
+)
+{
+    *match_count = 0;
+    if(index->added_count == 0)
+        return NULL;
+    struct RemoteLibraryMatch *matches = malloc(
+        index->added_count * sizeof(struct RemoteLibraryMatch)
+    );
+    if(matches == NULL)
+        return NULL;
+    size_t n = 0;
+    for(size_t i=0; i<index->added_count; i++) {
+        const struct RemoteLibraryAdded *added = index->added[i];
+        if(!(added->type & types))
+            continue;
+        const char *folded = added->path + added->dir_length +
+                             added->length + 2;
+        int score = score_name(folded, added->length, words, word_count);
+        if(score < 0)
+            continue;
+        matches[n].file = (uint32_t) i;
+        matches[n].score = score;
+        n++;
+    }
+    qsort(matches, n, sizeof(struct RemoteLibraryMatch), compare_matches);
+    *match_count = n;
+    return matches;
+}
+
+
+
+
+/**
+ * @brief Adds a directory to index
+ * 
+ * Has to be called before the library starts. The variables such as
+ * ${Videos} are expanded when the library starts. Without any root,
+ * ${Videos}, ${Music} and the removable drives are indexed. The uploads
+ * are always indexed.
+ * 
+ * @param root The directory
+ */
+void remote_http_library_add_root(const char *root) {
+    if(libraryRootCount == LIBRARY_ROOT_MAX)
+        return;
+    char *copy = malloc(strlen(root) + 1);
+    if(copy == NULL)
+        return;
+    strcpy(copy, root);
+    libraryRoots[libraryRootCount++] = copy;
+}
+
+/**
+ * @brief Starts indexing the library in the background
+ * 
+ * The directories are watched for changes where supported.
+ */
+void remote_http_library_start() {
+    if(!libraryInitialized) {
+        remote_mutex_init(&libraryLock);
+        remote_cond_init(&libraryWake);
+        libraryInitialized = 1;
+    }
+    if(libraryRunning)
+        return;
+    libraryStopping = 0;
+    
+    #ifndef _WIN32
+    libraryNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(libraryNotify >= 0 && pipe(libraryWakePipe) != 0) {
+        close(libraryNotify);
+        libraryNotify = -1;
+    }
+    #endif
+    libraryRunning = (remote_thread_create(&libraryThread, library_loop,
+                                           NULL) == 0);
+}
+
+/**
+ * @brief Stops indexing the library and drops the index
+ */
+void remote_http_library_stop() {
+    if(!libraryRunning)
+        return;
+    remote_mutex_lock(&libraryLock);
+    libraryStopping = 1;
+    wake_library();
+    remote_mutex_unlock(&libraryLock);
+    remote_thread_join(libraryThread);
+    libraryRunning = 0;
+    
+    // Closing the descriptor removes all the watches
+    free_directories();
+    #ifndef _WIN32
+    if(libraryNotify >= 0) {
+        close(libraryWakePipe[0]);
+        close(libraryWakePipe[1]);
+        close(libraryNotify);
+        libraryNotify = -1;
+    }
+    #endif
+    
+    remote_mutex_lock(&libraryLock);
+    struct RemoteLibraryIndex *index = libraryIndex;
+    struct RemoteLibraryPath *pending = libraryPending;
+    libraryIndex = NULL;
+    libraryPending = NULL;
+    int unused = (index != NULL && --index->refs == 0);
+    remote_mutex_unlock(&libraryLock);
+    if(unused)
+        free_index(index);
+    while(pending != NULL) {
+        struct RemoteLibraryPath *next = pending->next;
+        free(pending);
+        pending = next;
+    }
+}
+
+/**
+ * @brief Indexes a file right away
+ * 
+ * The file shows up in the searches without waiting for a change of its
+ * directory to be noticed.
+ * 
+ * @param path The path of the file under a library root
+ */
+void remote_http_library_add_file(const char *path) {
+    if(!libraryRunning)
+        return;
+    size_t len = strlen(path);
+    struct RemoteLibraryPath *pending = malloc(
+        sizeof(struct RemoteLibraryPath) + len + 1
+    );
+    if(pending == NULL)
+        return;
+    memcpy(pending->path, path, len + 1);
+    remote_mutex_lock(&libraryLock);
+    pending->next = libraryPending;
+    libraryPending = pending;
+    wake_library();
+    remote_mutex_unlock(&libraryLock);
+}
+
+/**
+ * @brief Searches the library for the files matching a query in JSON
+ * 
+ * Every word of the query has to appear in the name of a file, ignoring
+ * the case of ASCII letters. The matches at the start of the name or of a
+ * word in it and the shorter names come first.
+ * 
+ * @param query The words looked for
+ * @param types Type bits of the files listed
+ * @param limit The most matches listed
+ * @param len The number of bytes of the JSON text
+ * 
+ * @return The JSON text to free or NULL if out of memory
+ */
+char *remote_http_library_search(const char *query, int types, size_t limit,
+                                 size_t *len)
+{
+    // Splits the query in lower case into its words
+    char folded[LIBRARY_QUERY_MAX];
+    char *words[LIBRARY_WORDS];
+    int word_count = 0;
+    size_t n = 0;
+    for(; query[n] != '\0' && n < LIBRARY_QUERY_MAX - 1; n++)
+        folded[n] = tolower((unsigned char) query[n]);
+    folded[n] = '\0';
+    for(char *p=folded; *p!='\0' && word_count<LIBRARY_WORDS; ) {
+        while(*p == ' ' || *p == '\t')
+            *p++ = '\0';
+        if(*p == '\0')
+            break;
+        words[word_count++] = p;
+        while(*p != '\0' && *p != ' ' && *p != '\t')
+            p++;
+    }
+    
+    struct RemoteJsonWriter writer;
+    remote_http_json_init(&writer, LIBRARY_REPLY_SIZE);
+    remote_http_json_begin_object(&writer);
+    
+    // The index itself never changes so it is searched without the lock
+    struct RemoteLibraryIndex *index = acquire_index();
+    struct RemoteLibraryMatch *matches = NULL;
+    size_t match_count = 0;
+    if(index != NULL && word_count > 0) {
+        matches = search_index(index, words, word_count, types,
+                               &match_count);
+    }
+    
+    // Merges the files created since and skips the files deleted since
+    remote_mutex_lock(&libraryLock);
+    struct RemoteLibraryMatch *created = NULL;
+    size_t created_count = 0;
+    if(index != NULL && word_count > 0) {
+        created = search_created(index, words, word_count, types,
+                                 &created_count);
+    }
+    size_t total = 0, i = 0, j = 0;
+    remote_http_json_key(&writer, "results");
+    remote_http_json_begin_array(&writer);
+    while(i < match_count || j < created_count) {
+        if(i < match_count && is_removed(index, matches[i].file)) {
+            i++;
+            continue;
+        }
+        char path[PATH_MAX];
+        const char *name;
+        int type;
+        if(j == created_count ||
+           (i < match_count && matches[i].score >= created[j].score)) {
+            const struct RemoteLibraryFile *file;
+            file = &index->files[matches[i++].file];
+            name = file_name(index, file);
+            type = file->type;
+            if(total < limit) {
+                char dir[PATH_MAX];
+                get_dir(index, file->dir, dir);
+                snprintf(path, PATH_MAX, "%s/%s", dir, name);
+            }
+        }
+        else {
+            const struct RemoteLibraryAdded *added;
+            added = index->added[created[j++].file];
+            name = added->path + added->dir_length + 1;
+            type = added->type;
+            if(total < limit)
+                strcpy(path, added->path);
+        }
+        if(total++ >= limit)
+            continue;
+        
+        remote_http_json_begin_object(&writer);
+        remote_http_json_member(&writer, "name", name);
+        remote_http_json_member(&writer, "path", path);
+        remote_http_json_member(&writer, "type",
+                                type == LISTING_VIDEO ? "video" : "audio");
+        remote_http_json_end_object(&writer);
+    }
+    remote_http_json_end_array(&writer);
+    remote_http_json_key(&writer, "total");
+    remote_http_json_int(&writer, (int64_t) total);
+    remote_http_json_key(&writer, "indexed");
+    remote_http_json_int(&writer, (index == NULL) ? 0 :
+                         (int64_t) (index->file_count +
+                                    index->added_count -
+                                    index->removed_count));
+    remote_mutex_unlock(&libraryLock);
+    remote_http_json_key(&writer, "ready");
+    remote_http_json_bool(&writer, index != NULL);
+    remote_http_json_end_object(&writer);
+    
+    free(matches);
+    free(created);
+    if(index != NULL)
+        release_index(index);
+    return remote_http_json_finish(&writer, len);
+}
@@ -0,0 +1,100 @@
+/**
+ * @file library.h
+ * @brief Media library index searched through GET /search
+ * 
+ * A crawler thread walks the library roots in the background and indexes
+ * every media file found, classified like the directory listings. The
+ * names are indexed by their trigrams so that a search only looks at the
+ * files holding every trigram of the query instead of all of them. A new
+ * index is built aside and swapped in once complete, so searching never
+ * waits for the crawler.
+ * 
+ * The roots are crawled once. On Linux every directory is then watched
+ * with inotify and the files created, moved and deleted are kept aside the
+ * index, which is only built again from memory once they add up. When
+ * notifications are lost, only the directories whose modification time
+ * has changed are read again. The directories which cannot be watched are
+ * checked that way from time to time.
+ * 
+ * Each index built is written to a snapshot laid out as the index in
+ * memory. On the next start the snapshot is mapped read only and searched
+ * right away, so that starting takes the same time whatever the size of
+ * the library, while the directories changed since are read again in the
+ * background.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_LIBRARY_H__
+#define __MPV_REMOTE_HTTP_LIBRARY_H__ ///< Header guard
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIBRARY_ROOT_MAX 16 ///< Maximum number of library roots
+#define LIBRARY_RESCAN 900 ///< Seconds between checks of unwatched directories
+#define LIBRARY_LIMIT 50 ///< Matches returned by default
+#define LIBRARY_LIMIT_MAX 500 ///< Most matches returned
+#define LIBRARY_WORDS 8 ///< Words of a query looked for
+
+
+/**
+ * @brief Adds a directory to index
+ * 
+ * Has to be called before the library starts. The variables such as
+ * ${Videos} are expanded when the library starts. Without any root,
+ * ${Videos}, ${Music} and the removable drives are indexed. The uploads
+ * are always indexed.
+ * 
+ * @param root The directory
+ */
+void remote_http_library_add_root(const char *root);
+
+/**
+ * @brief Starts indexing the library in the background
+ */
+void remote_http_library_start();
+
+/**
+ * @brief Stops indexing the library and drops the index
+ */
+void remote_http_library_stop();
+
+/**
+ * @brief Indexes a file right away
+ * 
+ * The file shows up in the searches without waiting for a change of its
+ * directory to be noticed.
+ * 
+ * @param path The path of the file under a library root
+ */
+void remote_http_library_add_file(const char *path);
+
+/**
+ * @brief Searches the library for the files matching a query in JSON
+ * 
+ * Every word of the query has to appear in the name of a file, ignoring
+ * the case of ASCII letters. The matches at the start of the name or of a
+ * word in it and the shorter names come first.
+ * 
+ * @param query The words looked for
+ * @param types Type bits of the files listed
+ * @param limit The most matches listed
+ * @param len The number of bytes of the JSON text
+ * 
+ * @return The JSON text to free or NULL if out of memory
+ */
+char *remote_http_library_search(const char *query, int types, size_t limit,
+                                 size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,894 @@
+/**
+ * @file listing.c
+ * @brief Sorted and paginated directory listings for GET /browse
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "listing.h"
+
+#include "../../libremote/thread.h"
+#include "jsonwriter.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <tchar.h>
+#define PATH_MAX _MAX_PATH
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define LISTING_REPLY_SIZE 16384 ///< First buffer of a page
+#define LISTING_CURSOR_SIZE (PATH_MAX + 48) ///< Longest cursor
+
+#ifndef _WIN32
+/**
+ * @brief Changes of a directory which drop its listing
+ */
+#define LISTING_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                        IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | \
+                        IN_MOVE_SELF | IN_ONLYDIR)
+#endif
+
+
+/**
+ * @brief File or directory of a listing
+ */
+struct RemoteListingEntry {
+    const char *name; ///< The name in the names of the listing
+    uint64_t size; ///< The number of bytes of a file
+    int64_t mtime; ///< Modification time in seconds since the epoch
+    int type; ///< LISTING_DIRECTORY, LISTING_VIDEO or LISTING_AUDIO
+};
+
+/**
+ * @brief Directory read once for all its pages
+ */
+struct RemoteListing {
+    char *path; ///< The directory
+    int64_t stamp; ///< Modification time of the directory when read
+    struct RemoteListingEntry *entries; ///< The entries in readdir order
+    size_t count; ///< The number of entries
+    char *names; ///< The names of all the entries one after another
+    size_t type_count[3]; ///< The number of directories, videos and audios
+    struct RemoteListingEntry **orders[LISTING_SORT_COUNT]; ///< Sorted
+    remote_mutex_t lock; ///< Guards the sorting
+    size_t bytes; ///< The memory taken by the listing
+    int watch; ///< Watch notifying the changes of the directory or -1
+    int loading; ///< The directory is being read
+    int refs; ///< The number of pages being written from the listing
+    int stale; ///< Dropped from the cache and freed once unused
+    struct RemoteListing *prev; ///< More recently used listing
+    struct RemoteListing *next; ///< Less recently used listing
+};
+
+
+static remote_mutex_t listingLock;
+static int listingInitialized = 0;
+static struct RemoteListing *listingHead = NULL;
+static struct RemoteListing *listingTail = NULL;
+static size_t listingBytes = 0;
+
+#ifndef _WIN32
+static int listingNotify = -1;
+static int listingWake[2] = {-1, -1};
+static remote_thread_t listingThread;
+#endif
+
+
+/**
+ * @brief Classifies a file by the extension of its name
+ * 
+ * @param name The name of the file
+ * 
+ * @return LISTING_VIDEO, LISTING_AUDIO or 0 if it is not a media file
+ */
+int remote_http_listing_type(const char *name) {
+    static const char *video_ext[] = {
+        "mp4", "mov", "wmv", "flv", "avi", "avchd", "webm", "mkv"
+    };
+    static const char *audio_ext[] = {
+        "m4a", "flac", "mp3", "wav", "mwa", "aac"
+    };
+    
+    const char *ext = strrchr(name, '.');
+    if(ext == NULL)
+        return 0;
+    ext += 1;
+    for(int i=0; i<8; i++) {
+        if(strncmp(ext, video_ext[i], 5) == 0)
+            return LISTING_VIDEO;
+    }
+    for(int i=0; i<6; i++) {
+        if(strncmp(ext, audio_ext[i], 5) == 0)
+            return LISTING_AUDIO;
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses a type parameter
+ * 
+ * @param type Comma separated "directory", "video" and "audio", may be NULL
+ * 
+ * @return The type bits or LISTING_ALL if none is given
+ */
+int remote_http_listing_types(const char *type) {
+    int types = 0;
+    while(type != NULL && *type != '\0') {
+        size_t len = strcspn(type, ",");
+        if(len == 9 && strncmp(type, "directory", 9) == 0)
+            types |= LISTING_DIRECTORY;
+        else if(len == 5 && strncmp(type, "video", 5) == 0)
+            types |= LISTING_VIDEO;
+        else if(len == 5 && strncmp(type, "audio", 5) == 0)
+            types |= LISTING_AUDIO;
+        type += len;
+        if(*type == ',')
+            type++;
+    }
+    return (types != 0) ? types : LISTING_ALL;
+}
+
+
+// Counts the entries of the given types
+static size_t count_types(const struct RemoteListing *listing, int types) {
+    size_t count = 0;
+    for(int i=0; i<3; i++) {
+        if(types & (1 << i))
+            count += listing->type_count[i];
+    }
+    return count;
+}
+
+
+// Compares the names with their runs of digits as numbers so that
+// "Episode 2" comes before "Episode 10"
+static int natural_compare(const char *a, const char *b) {
+    while(*a != '\0' && *b != '\0') {
+        if(isdigit((unsigned char) *a) && isdigit((unsigned char) *b)) {
+            while(*a == '0')
+                a++;
+            while(*b == '0')
+                b++;
+            size_t la = 0, lb = 0;
+            while(isdigit((unsigned char) a[la]))
+                la++;
+            while(isdigit((unsigned char) b[lb]))
+                lb++;
+            if(la != lb)
+                return (la < lb) ? -1 : 1;
+            int c = memcmp(a, b, la);
+            if(c != 0)
+                return c;
+            a += la;
+            b += lb;
+            continue;
+        }
+        int ca = tolower((unsigned char) *a);
+        int cb = tolower((unsigned char) *b);
+        if(ca != cb)
+            return ca - cb;
+        a++;
+        b++;
+    }
+    return (unsigned char) *a - (unsigned char) *b;
+}
+
+
+static int compare_entries(const struct RemoteListingEntry *x,
+                           const struct RemoteListingEntry *y, int sort)
+{
+    if(sort == LISTING_SORT_MTIME && x->mtime != y->mtime)
+        return (x->mtime < y->mtime) ? -1 : 1;
+    if(sort == LISTING_SORT_SIZE && x->size != y->size)
+        return (x->size < y->size) ? -1 : 1;
+    
+    // The names break the ties so that every entry has its own place
+    int c = natural_compare(x->name, y->name);
+    if(c != 0)
+        return c;
+    return strcmp(x->name, y->name);
+}
+
+
+static int compare_names(const void *a, const void *b) {
+    return compare_entries(*(struct RemoteListingEntry * const *) a,
+                           *(struct RemoteListingEntry * const *) b,
+                           LISTING_SORT_NAME);
+}
+
+static int compare_mtimes(const void *a, const void *b) {
+    return compare_entries(*(struct RemoteListingEntry * const *) a,
+                           *(struct RemoteListingEntry * const *) b,
+                           LISTING_SORT_MTIME);
+}
+
+static int compare_sizes(const void *a, const void *b) {
+    return compare_entries(*(struct RemoteListingEntry * const *) a,
+                           *(struct RemoteListingEntry * const *) b,
+                           LISTING_SORT_SIZE);
+}
+
+
+
+
+static void free_listing(struct RemoteListing *listing) {
+    for(int i=0; i<LISTING_SORT_COUNT; i++)
+        free(listing->orders[i]);
+    remote_mutex_destroy(&listing->lock);
+    free(listing->entries);
+    free(listing->names);
+    free(listing->path);
+    free(listing);
+}
+
+
+// Reads the modification time of a directory
+static int directory_stamp(const char *path, int64_t *stamp) {
+    #ifdef _WIN32
+    struct __stat64 st;
+    if(_stat64(path, &st) != 0 || !(st.st_mode & _S_IFDIR))
+        return 1;
+    *stamp = (int64_t) st.st_mtime;
+    #else
+    struct stat st;
+    if(stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+        return 1;
+    *stamp = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    #endif
+    return 0;
+}
+
+
+// Appends an entry whose name is kept as an offset until the names stop
+// moving
+static int add_entry(struct RemoteListing *listing, size_t *capacity,
+                     size_t **offsets, size_t *names_length,
+                     size_t *names_capacity, const char *name, int type,
+                     uint64_t size, int64_t mtime)
+{
+    if(listing->count == *capacity) {
+        size_t n = (*capacity > 0) ? *capacity * 2 : 256;
+        void *entries = realloc(listing->entries,
+                                n * sizeof(struct RemoteListingEntry));
+        if(entries == NULL)
+            return 1;
+        listing->entries = entries;
+        void *o = realloc(*offsets, n * sizeof(size_t));
+        if(o == NULL)
+            return 1;
+        *offsets = o;
+        *capacity = n;
+    }
+    size_t len = strlen(name) + 1;
+    if(*names_length + len > *names_capacity) {
+        size_t n = (*names_capacity > 0) ? *names_capacity : 4096;
+        while(*names_length + len > n)
+            n *= 2;
+        char *names = realloc(listing->names, n);
+        if(names == NULL)
+            return 1;
+        listing->names = names;
+        *names_capacity = n;
+    }
+    memcpy(listing->names + *names_length, name, len);
+    (*offsets)[listing->count] = *names_length;
+    *names_length += len;
+    
+    struct RemoteListingEntry *entry = &listing->entries[listing->count++];
+    entry->size = size;
+    entry->mtime = mtime;
+    entry->type = type;
+    if(type == LISTING_DIRECTORY)
+        listing->type_count[0]++;
+    else if(type == LISTING_VIDEO)
+        listing->type_count[1]++;
+    else
+        listing->type_count[2]++;
+    return 0;
+}
+
+
+// Reads and classifies the media files and the directories of a directory
+static int read_entries(struct RemoteListing *listing) {
+    const char *path = listing->path;
+    size_t capacity = 0, names_length = 0, names_capacity = 0;
+    size_t *offsets = NULL;
+    int failed = 0;
+    
+    #ifdef _WIN32
+    WIN32_FIND_DATA ffd;
+    TCHAR szDir[PATH_MAX];
+    _stprintf(szDir, "%s\\*", path);
+    HANDLE hFind = FindFirstFile(szDir, &ffd);
+    if(hFind == INVALID_HANDLE_VALUE)
+        return 1;
+    do {
+        const char *name = ffd.cFileName;
+        if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+        int type;
+        if(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            type = LISTING_DIRECTORY;
+        else
+            type = remote_http_listing_type(name);
+        if(type == 0)
+            continue;
+        
+        // The file times count 100 ns from 1601
+        uint64_t size = ((uint64_t) ffd.nFileSizeHigh << 32) |
+                        ffd.nFileSizeLow;
+        uint64_t time = ((uint64_t) ffd.ftLastWriteTime.dwHighDateTime
+                         << 32) | ffd.ftLastWriteTime.dwLowDateTime;
+        int64_t mtime = ((int64_t) time - 116444736000000000LL) / 10000000;
+        failed = add_entry(listing, &capacity, &offsets, &names_length,
+                           &names_capacity, name, type, size, mtime);
+    } while(!failed && FindNextFile(hFind, &ffd) != 0);
+    FindClose(hFind);
+    #else
+    DIR *d = opendir(path);
+    if(d == NULL)
+        return 1;
+    struct dirent *dir;
+    while(!failed && (dir = readdir(d)) != NULL) {
+        const char *name = dir->d_name;
+        if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+        
+        // Only the entries listed are looked up
+        int type = 0;
+        if(dir->d_type == DT_DIR)
+            type = LISTING_DIRECTORY;
+        else if(dir->d_type != DT_UNKNOWN && dir->d_type != DT_LNK) {
+            type = remote_http_listing_type(name);
+            if(type == 0)
+                continue;
+        }
+        struct stat st;
+        if(fstatat(dirfd(d), name, &st, 0) != 0)
+            continue;
+        if(type == 0) {
+            type = S_ISDIR(st.st_mode) ? LISTING_DIRECTORY
+                                       : remote_http_listing_type(name);
+            if(type == 0)
+                continue;
+        }
+        uint64_t size = (type == LISTING_DIRECTORY) ? 0 : st.st_size;
+        failed = add_entry(listing, &capacity, &offsets, &names_length,
+                           &names_capacity, name, type, size,
+                           (int64_t) st.st_mtime);
+    }
+    closedir(d);
+    #endif
+    
+    if(!failed) {
+        for(size_t i=0; i<listing->count; i++)
+            listing->entries[i].name = listing->names + offsets[i];
+        listing->bytes += capacity * sizeof(struct RemoteListingEntry) +
+                          names_capacity;
+    }
+    free(offsets);
+    return failed;
+}
+
+
+
+
+static void link_listing(struct RemoteListing *listing) {
+    listing->prev = NULL;
+    listing->next = listingHead;
+    if(listingHead != NULL)
+        listingHead->prev = listing;
+    listingHead = listing;
+    if(listingTail == NULL)
+        listingTail = listing;
+    listingBytes += listing->bytes;
+}
+
+
+static void unlink_listing(struct RemoteListing *listing) {
+    if(listing->prev != NULL)
+        listing->prev->next = listing->next;
+    else
+        listingHead = listing->next;
+    if(listing->next != NULL)
+        listing->next->prev = listing->prev;
+    else
+        listingTail = listing->prev;
+    listing->prev = NULL;
+    listing->next = NULL;
+    listingBytes -= listing->bytes;
+}
+
+
+// Removes the watch of a listing unless another listing shares it
+static void release_watch(struct RemoteListing *listing) {
+    #ifndef _WIN32
+    if(listing->watch < 0)
+        return;
+    int shared = 0;
+    for(struct RemoteListing *l=listingHead; l!=NULL; l=l->next) {
+        if(l != listing && l->watch == listing->watch)
+            shared = 1;
+    }
+    if(!shared)
+        inotify_rm_watch(listingNotify, listing->watch);
+    #endif
+    listing->watch = -1;
+}
+
+
+// Takes a listing out of the cache, has to be called with the lock held
+static void drop_listing(struct RemoteListing *listing) {
+    unlink_listing(listing);
+    listing->stale = 1;
+    release_watch(listing);
+    if(listing->refs == 0)
+        free_listing(listing);
+}
+
+
+// Evicts the least recently used listings beyond the memory budget
+static void trim_listings() {
+    while(listingBytes > LISTING_BUDGET && listingTail != NULL)
+        drop_listing(listingTail);
+}
+
+
+#ifndef _WIN32
+// Drops the listings of the directories which have changed
+static void *watch_listings(void *arg) {
+    (void) arg;
+    char buffer[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {
+        {listingNotify, POLLIN, 0},
+        {listingWake[0], POLLIN, 0}
+    };
+    
+    while(1) {
+        if(poll(fds, 2, -1) < 0) {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(fds[1].revents != 0)
+            break;
+        ssize_t len = read(listingNotify, buffer, sizeof(buffer));
+        if(len <= 0)
+            continue;
+        
+        remote_mutex_lock(&listingLock);
+        for(char *p=buffer; p<buffer+len; ) {
+            struct inotify_event *event = (struct inotify_event*) p;
+            struct RemoteListing *l = listingHead;
+            while(l != NULL) {
+                struct RemoteListing *next = l->next;
+                if((event->mask & IN_Q_OVERFLOW) || l->watch == event->wd)
+                    drop_listing(l);
+                l = next;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+        remote_mutex_unlock(&listingLock);
+    }
+    return NULL;
+}
+#endif
+
+
+// Takes the listing of a directory from the cache or reads it
+static struct RemoteListing *open_listing(const char *path) {
+    // Without change notifications the directory is checked every time
+    int64_t stamp = 0;
+    #ifdef _WIN32
+    int notified = 0;
+    #else
+    int notified = (listingNotify >= 0);
+    #endif
+    if(!notified && directory_stamp(path, &stamp) != 0)
+        return NULL;
+    
+    remote_mutex_lock(&listingLock);
+    for(struct RemoteListing *l=listingHead; l!=NULL; l=l->next) {
+        if(l->loading || strcmp(l->path, path) != 0)
+            continue;
+        if(notified || l->stamp == stamp) {
+            l->refs++;
+            unlink_listing(l);
+            link_listing(l);
+            remote_mutex_unlock(&listingLock);
+            return l;
+        }
+        drop_listing(l);
+        break;
+    }
+    
+    // The listing is cached while it is read so that a change meanwhile
+    // drops it
+    struct RemoteListing *listing = calloc(1, sizeof(struct RemoteListing));
+    char *copy = malloc(strlen(path) + 1);
+    if(listing == NULL || copy == NULL) {
+        remote_mutex_unlock(&listingLock);
+        free(listing);
+        free(copy);
+        return NULL;
+    }
+    strcpy(copy, path);
+    listing->path = copy;
+    listing->stamp = stamp;
+    listing->bytes = sizeof(struct RemoteListing) + strlen(path) + 1;
+    listing->watch = -1;
+    listing->loading = 1;
+    listing->refs = 1;
+    remote_mutex_init(&listing->lock);
+    #ifndef _WIN32
+    if(notified) {
+        listing->watch = inotify_add_watch(listingNotify, path,
+                                           LISTING_EVENTS);
+    }
+    #endif
+    link_listing(listing);
+    remote_mutex_unlock(&listingLock);
+    
+    // Reads the directory without holding up the other pages
+    size_t bytes = listing->bytes;
+    int failed = read_entries(listing);
+    
+    remote_mutex_lock(&listingLock);
+    listing->loading = 0;
+    if(!listing->stale) {
+        listingBytes += listing->bytes - bytes;
+        if(failed || (notified && listing->watch < 0))
+            drop_listing(listing);
+        else {
+            // Replaces the listing of the same directory read meanwhile
+            struct RemoteListing *l = listingHead;
+            while(l != NULL) {
+                struct RemoteListing *next = l->next;
+                if(l != listing && !l->loading &&
+                   strcmp(l->path, path) == 0)
+                {
+                    drop_listing(l);
+                }
+                l = next;
+            }
+            trim_listings();
+        }
+    }
+    if(failed) {
+        listing->refs--;
+        int unused = (listing->refs == 0);
+        remote_mutex_unlock(&listingLock);
+        if(unused)
+            free_listing(listing);
+        return NULL;
+    }
+    remote_mutex_unlock(&listingLock);
+    return listing;
+}
+
+
+static void close_listing(struct RemoteListing *listing) {
+    remote_mutex_lock(&listingLock);
+    listing->refs--;
+    int unused = (listing->refs == 0 && listing->stale);
+    remote_mutex_unlock(&listingLock);
+    if(unused)
+        free_listing(listing);
+}
+
+
+// Sorts the listing the first time an order is asked for
+static struct RemoteListingEntry **listing_order(
+    struct RemoteListing *listing,
+    int sort
+)
+{
+    static int (*const compare[LISTING_SORT_COUNT])(const void*,
+                                                    const void*) = {
+        compare_names, compare_mtimes, compare_sizes
+    };
+    
+    remote_mutex_lock(&listing->lock);
+    if(listing->orders[sort] == NULL && listing->count > 0) {
+        struct RemoteListingEntry **order = malloc(
+            listing->count * sizeof(struct RemoteListingEntry*)
+        );
+        if(order != NULL) {
+            for(size_t i=0; i<listing->count; i++)
+                order[i] = &listing->entries[i];
+            qsort(order, listing->count, sizeof(struct RemoteListingEntry*),
+                  compare[sort]);
+            listing->orders[sort] = order;
+            
+            // The order counts in the memory budget of the cache
+            size_t bytes = listing->count * sizeof(struct RemoteListingEntry*);
+            remote_mutex_lock(&listingLock);
+            listing->bytes += bytes;
+            if(!listing->stale) {
+                listingBytes += bytes;
+                trim_listings();
+            }
+            remote_mutex_unlock(&listingLock);
+        }
+    }
+    struct RemoteListingEntry **order = listing->orders[sort];
+    remote_mutex_unlock(&listing->lock);
+    return order;
+}
+
+
+
+
+// Reads the sort key of the last entry of the previous page
+static int parse_cursor(const char *cursor, struct RemoteListingEntry *key) {
+    char *end;
+    key->mtime = strtoll(cursor, &end, 10);
+    if(*end != '.')
+        return 1;
+    key->size = strtoull(end + 1, &end, 10);
+    if(*end != '.')
+        return 1;
+    key->name = end + 1;
+    return 0;
+}
+
+
+static void write_cursor(char *cursor, const struct RemoteListingEntry *e) {
+    snprintf(cursor, LISTING_CURSOR_SIZE, "%lld.%llu.%s",
+             (long long) e->mtime, (unsigned long long) e->size, e->name);
+}
+
+
+static void write_entry(struct RemoteJsonWriter *writer,
+                        const struct RemoteListingEntry *entry)
+{
+    const char *type = "directory";
+    if(entry->type == LISTING_VIDEO)
+        type = "video";
+    else if(entry->type == LISTING_AUDIO)
+        type = "audio";
+    
+    remote_http_json_begin_object(writer);
+    remote_http_json_member(writer, "name", entry->name);
+    remote_http_json_member(writer, "type", type);
+    remote_http_json_key(writer, "size");
+    remote_http_json_int(writer, (int64_t) entry->size);
+    remote_http_json_key(writer, "mtime");
+    remote_http_json_int(writer, entry->mtime);
+    remote_http_json_end_object(writer);
+}
+
+
+// Position in the order asked for
+static inline struct RemoteListingEntry *entry_at(
+    struct RemoteListingEntry **order,
+    size_t count,
+    int descending,
+    size_t p
+)
+{
+    return order[descending ? count - 1 - p : p];
+}
+
+
+// Writes the page of a sorted listing
+static void write_page(struct RemoteJsonWriter *writer,
+                       struct RemoteListing *listing,
+                       struct RemoteListingEntry **order,
+                       const struct RemoteListingQuery *query)
+{
+    size_t count = (order != NULL) ? listing->count : 0;
+    int sort = query->sort;
+    int desc = query->descending;
+    int sign = desc ? -1 : 1;
+    
+    // Finds the first entry after the cursor by bisection
+    size_t p = 0;
+    struct RemoteListingEntry key;
+    if(query->cursor != NULL && parse_cursor(query->cursor, &key) == 0) {
+        size_t hi = count;
+        while(p < hi) {
+            size_t mid = p + (hi - p) / 2;
+            struct RemoteListingEntry *entry;
+            entry = entry_at(order, count, desc, mid);
+            if(sign * compare_entries(entry, &key, sort) > 0)
+                hi = mid;
+            else
+                p = mid + 1;
+        }
+    }
+    
+    // Skips the offset and copies the page
+    size_t skipped = 0, listed = 0;
+    const struct RemoteListingEntry *last = NULL;
+    remote_http_json_key(writer, "files");
+    remote_http_json_begin_array(writer);
+    for(; p<count; p++) {
+        const struct RemoteListingEntry *entry;
+        entry = entry_at(order, count, desc, p);
+        if(!(entry->type & query->types))
+            continue;
+        if(skipped < query->offset) {
+            skipped++;
+            continue;
+        }
+        if(query->limit > 0 && listed == query->limit)
+            break;
+        write_entry(writer, entry);
+        if(query->visit != NULL && entry->type == LISTING_VIDEO)
+            query->visit(query->visit_data, entry->name);
+        last = entry;
+        listed++;
+    }
+    remote_http_json_end_array(writer);
+    
+    remote_http_json_key(writer, "total");
+    remote_http_json_int(writer, (int64_t) count_types(listing,
+                                                       query->types));
+    
+    // Tells where the next page starts if there is one
+    for(; p<count && last != NULL; p++) {
+        if(entry_at(order, count, desc, p)->type & query->types) {
+            char cursor[LISTING_CURSOR_SIZE];
+            write_cursor(cursor, last);
+            remote_http_json_member(writer, "next", cursor);
+            break;
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Prepares the listings before the server threads start
+ * 
+ * Starts watching the directories listed for changes where supported.
+ */
+void remote_http_listing_start() {
+    if(!listingInitialized) {
+        remote_mutex_init(&listingLock);
+        listingInitialized = 1;
+    }
+    
+    #ifndef _WIN32
+    if(listingNotify >= 0)
+        return;
+    listingNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(listingNotify < 0)
+        return;
+    if(pipe(listingWake) != 0) {
+        close(listingNotify);
+        listingNotify = -1;
+        return;
+    }
+    if(remote_thread_create(&listingThread, watch_listings, NULL) != 0) {
+        close(listingWake[0]);
+        close(listingWake[1]);
+        close(listingNotify);
+        listingNotify = -1;
+    }
+    #endif
+}
+
+/**
+ * @brief Drops the listings kept
+ * 
+ * Has to be called once no worker runs.
+ */
+void remote_http_listing_stop() {
+    if(!listingInitialized)
+        return;
+    
+    #ifndef _WIN32
+    if(listingNotify >= 0) {
+        char wake = 0;
+        if(write(listingWake[1], &wake, 1) == 1)
+            remote_thread_join(listingThread);
+    }
+    #endif
+    
+    remote_mutex_lock(&listingLock);
+    while(listingHead != NULL)
+        drop_listing(listingHead);
+    remote_mutex_unlock(&listingLock);
+    
+    // Closing the descriptor removes all the watches
+    #ifndef _WIN32
+    if(listingNotify >= 0) {
+        close(listingWake[0]);
+        close(listingWake[1]);
+        close(listingNotify);
+        listingNotify = -1;
+    }
+    #endif
+}
+
+/**
+ * @brief Parses the parameters of GET /browse
+ * 
+ * Unknown values keep their defaults which list everything by name.
+ * 
+ * @param query The query
+ * @param sort "name", "mtime" or "size", may be NULL
+ * @param order "asc" or "desc", may be NULL
+ * @param type Comma separated "directory", "video" and "audio", may be NULL
+ * @param offset The number of entries skipped, may be NULL
+ * @param limit The most entries listed, may be NULL
+ */
+void remote_http_listing_query(struct RemoteListingQuery *query,
+                               const char *sort, const char *order,
+                               const char *type, const char *offset,
+                               const char *limit)
+{
+    query->sort = LISTING_SORT_NAME;
+    if(sort != NULL && strcmp(sort, "mtime") == 0)
+        query->sort = LISTING_SORT_MTIME;
+    else if(sort != NULL && strcmp(sort, "size") == 0)
+        query->sort = LISTING_SORT_SIZE;
+    query->descending = (order != NULL && strcmp(order, "desc") == 0);
+    
+    query->types = remote_http_listing_types(type);
+    query->offset = (offset != NULL) ? strtoul(offset, NULL, 10) : 0;
+    query->limit = (limit != NULL) ? strtoul(limit, NULL, 10) : 0;
+    query->cursor = NULL;
+    query->visit = NULL;
+    query->visit_data = NULL;
+}
+
+/**
+ * @brief Lists a page of a directory in JSON
+ * 
+ * A directory which cannot be read is listed empty.
+ * 
+ * @param path The directory
+ * @param query The page asked for
+ * @param len The number of bytes of the JSON text
+ * 
+ * @return The JSON text to free or NULL if out of memory
+ */
+char *remote_http_listing_json(const char *path,
+                               const struct RemoteListingQuery *query,
+                               size_t *len)
+{
+    struct RemoteJsonWriter writer;
+    remote_http_json_init(&writer, LISTING_REPLY_SIZE);
+    remote_http_json_begin_object(&writer);
+    
+    struct RemoteListing *listing = open_listing(path);
+    if(listing == NULL) {
+        remote_http_json_key(&writer, "files");
+        remote_http_json_begin_array(&writer);
+        remote_http_json_end_array(&writer);
+        remote_http_json_key(&writer, "total");
+        remote_http_json_int(&writer, 0);
+    }
+    else {
+        struct RemoteListingEntry **order;
+        order = listing_order(listing, query->sort);
+        write_page(&writer, listing, order, query);
+        close_listing(listing);
+    }
+    
+    remote_http_json_end_object(&writer);
+    return remote_http_json_finish(&writer, len);
+}
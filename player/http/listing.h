@@ -0,0 +1,135 @@
+/**
+ * @file listing.h
+ * @brief Sorted and paginated directory listings for GET /browse
+ * 
+ * A directory is read once into a listing which keeps the name, the type,
+ * the size and the modification time of its media files and directories.
+ * The listing is sorted once per order and kept for the next pages, which
+ * then only copy their part of it. A page ends with a cursor holding the
+ * sort key of its last entry, so the next page starts right after it even
+ * if the directory changed in between.
+ * 
+ * The listings are kept for the directories browsed again within a memory
+ * budget, evicting the least recently used ones. On Linux a listing stays
+ * valid until inotify reports a change of its directory, so browsing back
+ * and forth does not touch the disk. Elsewhere the modification time of
+ * the directory is checked on every request.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_LISTING_H__
+#define __MPV_REMOTE_HTTP_LISTING_H__ ///< Header guard
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LISTING_BUDGET (8 << 20) ///< Memory the listings kept may take
+
+#define LISTING_SORT_NAME 0 ///< Natural order of the names
+#define LISTING_SORT_MTIME 1 ///< Order of the modification times
+#define LISTING_SORT_SIZE 2 ///< Order of the sizes
+#define LISTING_SORT_COUNT 3 ///< The number of orders
+
+#define LISTING_DIRECTORY 1 ///< Type bit of the directories
+#define LISTING_VIDEO 2 ///< Type bit of the video files
+#define LISTING_AUDIO 4 ///< Type bit of the audio files
+#define LISTING_ALL 7 ///< Type bits of every entry
+
+
+/**
+ * @brief Called with each video of a page in the order listed
+ * 
+ * @param data Data given with the query
+ * @param name The name of the video
+ */
+typedef void (*remote_http_listing_visitor)(void *data, const char *name);
+
+/**
+ * @brief Part of a listing asked for
+ */
+struct RemoteListingQuery {
+    int sort; ///< LISTING_SORT_NAME, LISTING_SORT_MTIME or LISTING_SORT_SIZE
+    int descending; ///< Reverses the order
+    int types; ///< Type bits of the entries listed
+    size_t offset; ///< The number of entries skipped after the cursor
+    size_t limit; ///< The most entries listed or 0 for all of them
+    const char *cursor; ///< Cursor of the previous page or NULL
+    remote_http_listing_visitor visit; ///< Told the videos listed or NULL
+    void *visit_data; ///< Data given to the visitor
+};
+
+
+/**
+ * @brief Prepares the listings before the server threads start
+ */
+void remote_http_listing_start();
+
+/**
+ * @brief Drops the listings kept
+ * 
+ * Has to be called once no worker runs.
+ */
+void remote_http_listing_stop();
+
+/**
+ * @brief Classifies a file by the extension of its name
+ * 
+ * @param name The name of the file
+ * 
+ * @return LISTING_VIDEO, LISTING_AUDIO or 0 if it is not a media file
+ */
+int remote_http_listing_type(const char *name);
+
+/**
+ * @brief Parses a type parameter
+ * 
+ * @param type Comma separated "directory", "video" and "audio", may be NULL
+ * 
+ * @return The type bits or LISTING_ALL if none is given
+ */
+int remote_http_listing_types(const char *type);
+
+/**
+ * @brief Parses the parameters of GET /browse
+ * 
+ * Unknown values keep their defaults which list everything by name.
+ * 
+ * @param query The query
+ * @param sort "name", "mtime" or "size", may be NULL
+ * @param order "asc" or "desc", may be NULL
+ * @param type Comma separated "directory", "video" and "audio", may be NULL
+ * @param offset The number of entries skipped, may be NULL
+ * @param limit The most entries listed, may be NULL
+ */
+void remote_http_listing_query(struct RemoteListingQuery *query,
+                               const char *sort, const char *order,
+                               const char *type, const char *offset,
+                               const char *limit);
+
+/**
+ * @brief Lists a page of a directory in JSON
+ * 
+ * A directory which cannot be read is listed empty.
+ * 
+ * @param path The directory
+ * @param query The page asked for
+ * @param len The number of bytes of the JSON text
+ * 
+ * @return The JSON text to free or NULL if out of memory
+ */
+char *remote_http_listing_json(const char *path,
+                               const struct RemoteListingQuery *query,
+                               size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
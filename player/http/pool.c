@@ -0,0 +1,174 @@
+/**
+ * @file pool.c
+ * @brief Pooled HTTP connections and their request memory
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "pool.h"
+
+#include "../../libremote/thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 8 ///< Alignment of the request memory allocations
+
+
+/**
+ * @brief Request memory allocated beyond the block of a connection
+ */
+struct RemoteArenaChunk {
+    struct RemoteArenaChunk *next; ///< Next chunk
+};
+
+
+static remote_mutex_t poolLock;
+static int poolInitialized = 0;
+static struct RemoteConnection *poolFree = NULL;
+static int poolCount = 0;
+
+
+/**
+ * @brief Prepares the pool before the server threads start
+ */
+void remote_http_pool_init() {
+    if(poolInitialized)
+        return;
+    remote_mutex_init(&poolLock);
+    poolInitialized = 1;
+}
+
+/**
+ * @brief Takes a connection from the pool
+ * 
+ * The fields of the connection are left for the caller to initialize
+ * apart from the request memory which is empty.
+ * 
+ * @return The connection or NULL if out of memory
+ */
+struct RemoteConnection *remote_http_pool_acquire() {
+    struct RemoteConnection *con_info = NULL;
+    remote_mutex_lock(&poolLock);
+    if(poolFree != NULL) {
+        con_info = poolFree;
+        poolFree = con_info->next_free;
+        poolCount--;
+    }
+    remote_mutex_unlock(&poolLock);
+    
+    // The block of request memory follows the connection
+    if(con_info == NULL) {
+        con_info = malloc(sizeof(struct RemoteConnection) + ARENA_SIZE);
+        if(con_info == NULL)
+            return NULL;
+        con_info->arena = (char*) (con_info + 1);
+    }
+    con_info->arena_used = 0;
+    con_info->arena_chunks = NULL;
+    con_info->next_free = NULL;
+    return con_info;
+}
+
+/**
+ * @brief Returns a connection to the pool
+ * 
+ * Everything allocated from its request memory is released.
+ * 
+ * @param con_info The connection
+ */
+void remote_http_pool_release(struct RemoteConnection *con_info) {
+    while(con_info->arena_chunks != NULL) {
+        struct RemoteArenaChunk *chunk = con_info->arena_chunks;
+        con_info->arena_chunks = chunk->next;
+        free(chunk);
+    }
+    con_info->arena_used = 0;
+    
+    remote_mutex_lock(&poolLock);
+    if(poolCount < POOL_MAX) {
+        con_info->next_free = poolFree;
+        poolFree = con_info;
+        poolCount++;
+        con_info = NULL;
+    }
+    remote_mutex_unlock(&poolLock);
+    free(con_info);
+}
+
+/**
+ * @brief Allocates from the request memory of a connection
+ * 
+ * The memory lives until the request completes.
+ * 
+ * @param con_info The connection
+ * @param size The number of bytes
+ * 
+ * @return The memory or NULL if out of memory
+ */
+void *remote_http_alloc(struct RemoteConnection *con_info, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    if(size <= ARENA_SIZE - con_info->arena_used) {
+        void *ptr = con_info->arena + con_info->arena_used;
+        con_info->arena_used += size;
+        return ptr;
+    }
+    
+    // Whatever does not fit in the block gets its own chunk
+    size_t head = (sizeof(struct RemoteArenaChunk) + ARENA_ALIGN - 1) &
+                  ~(size_t) (ARENA_ALIGN - 1);
+    struct RemoteArenaChunk *chunk = malloc(head + size);
+    if(chunk == NULL)
+        return NULL;
+    chunk->next = con_info->arena_chunks;
+    con_info->arena_chunks = chunk;
+    return (char*) chunk + head;
+}
+
+/**
+ * @brief Copies a string to the request memory of a connection
+ * 
+ * @param con_info The connection
+ * @param str The string
+ * 
+ * @return The copy or NULL if out of memory
+ */
+char *remote_http_strdup(struct RemoteConnection *con_info, const char *str) {
+    size_t len = strlen(str);
+    char *copy = remote_http_alloc(con_info, len+1);
+    if(copy != NULL)
+        memcpy(copy, str, len+1);
+    return copy;
+}
+
+/**
+ * @brief Sets a parameter from a piece of a POST value
+ * 
+ * The post processor may deliver a long value in several pieces. The
+ * piece at offset 0 starts the value and the others are appended to it.
+ * 
+ * @param con_info The connection
+ * @param param The parameter
+ * @param data The piece of the value
+ * @param off Offset of the piece in the value
+ * @param size Length of the piece
+ * 
+ * @return 0 on success and 1 if out of memory
+ */
+int remote_http_set_param(struct RemoteConnection *con_info, char **param,
+                          const char *data, uint64_t off, size_t size)
+{
+    size_t len = (off > 0 && *param != NULL) ? strlen(*param) : 0;
+    char *value = remote_http_alloc(con_info, len + size + 1);
+    if(value == NULL)
+        return 1;
+    if(len > 0)
+        memcpy(value, *param, len);
+    memcpy(value + len, data, size);
+    value[len + size] = '\0';
+    *param = value;
+    return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file pool.h
+ * @brief Pooled HTTP connections and their request memory
+ * 
+ * The connection objects are reused instead of being allocated for every
+ * request. Each carries a small block of request memory for the URL, the
+ * parameters, the header values and the short replies, which grows in
+ * chunks when needed and is reset when the request completes.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_POOL_H__
+#define __MPV_REMOTE_HTTP_POOL_H__ ///< Header guard
+
+#include "con_type.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POOL_MAX 64 ///< Maximum number of idle connections kept
+
+
+/**
+ * @brief Prepares the pool before the server threads start
+ */
+void remote_http_pool_init();
+
+/**
+ * @brief Takes a connection from the pool
+ * 
+ * The fields of the connection are left for the caller to initialize
+ * apart from the request memory which is empty.
+ * 
+ * @return The connection or NULL if out of memory
+ */
+struct RemoteConnection *remote_http_pool_acquire();
+
+/**
+ * @brief Returns a connection to the pool
+ * 
+ * Everything allocated from its request memory is released.
+ * 
+ * @param con_info The connection
+ */
+void remote_http_pool_release(struct RemoteConnection *con_info);
+
+/**
+ * @brief Allocates from the request memory of a connection
+ * 
+ * The memory lives until the request completes.
+ * 
+ * @param con_info The connection
+ * @param size The number of bytes
+ * 
+ * @return The memory or NULL if out of memory
+ */
+void *remote_http_alloc(struct RemoteConnection *con_info, size_t size);
+
+/**
+ * @brief Copies a string to the request memory of a connection
+ * 
+ * @param con_info The connection
+ * @param str The string
+ * 
+ * @return The copy or NULL if out of memory
+ */
+char *remote_http_strdup(struct RemoteConnection *con_info, const char *str);
+
+/**
+ * @brief Sets a parameter from a piece of a POST value
+ * 
+ * The post processor may deliver a long value in several pieces. The
+ * piece at offset 0 starts the value and the others are appended to it.
+ * 
+ * @param con_info The connection
+ * @param param The parameter
+ * @param data The piece of the value
+ * @param off Offset of the piece in the value
+ * @param size Length of the piece
+ * 
+ * @return 0 on success and 1 if out of memory
+ */
+int remote_http_set_param(struct RemoteConnection *con_info, char **param,
+                          const char *data, uint64_t off, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -9,19 +9,48 @@
 
 
 #include "../../libremote/libremote.h"
+#include "../player.h"
 #include "auth.h"
+#include "library.h"
+#include "pool.h"
+#include "route.h"
+#include "worker.h"
 
 #include <string.h>
 #include <stdlib.h>
 
 #ifdef _WIN32
+#include <io.h>
 #define PATH_MAX _MAX_PATH
 #else
 #include <linux/limits.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 
+// Writes the uploaded file through to the disk on a worker
+static void finish_upload(struct RemoteConnection *con_info, const char *arg) {
+    (void) arg;
+    int failed = (fflush(con_info->fp) != 0);
+    #ifdef _WIN32
+    failed |= (_commit(_fileno(con_info->fp)) != 0);
+    #else
+    failed |= (fsync(fileno(con_info->fp)) != 0);
+    #endif
+    failed |= (fclose(con_info->fp) != 0);
+    con_info->fp = NULL;
+    if(failed) {
+        con_info->reply = NULL;
+        con_info->reply_length = 0;
+        con_info->content_type = "";
+        con_info->status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+    }
+    else if(con_info->job_data != NULL)
+        remote_http_library_add_file(con_info->job_data);
+}
+
+
 int remote_http_handle_post(
     struct MHD_Connection *connection,
     const char *url,
@@ -30,33 +59,22 @@ int remote_http_handle_post(
     void **con_cls
 )
 {
+    (void) url;
     struct RemoteConnection *con_info = *con_cls;
-    int match = 0;
+    const struct RemoteRoute *route = con_info->route;
     
-    static const char* listedURL1[] = {
-        "/command", "/upload", "/authenticate", "/change-password"
-    };
-
-    for(int i=0; i<4; i++) {
-        if(strcmp(url, listedURL1[i]) == 0) {
-            match = 1;
-            break;
-        }
-    }
-    if(!match) {
+    // The upload has been finished by a worker
+    if(con_info->job_state == JOB_DONE)
+        return MHD_NO;
+    
+    if(route == NULL) {
         con_info->status = MHD_HTTP_NOT_FOUND;
         return MHD_NO;
     }
-
-    // The requested URL requires no authentication
-    match = (strcmp(url, "/authenticate") == 0);
-
-    // If the requested URL requires authentication
-    if(!match) {
-        if(!remote_http_is_authenticated(con_info)) {
-            con_info->status = MHD_HTTP_UNAUTHORIZED;
-            return MHD_NO;
-        }
+    if((route->flags & ROUTE_AUTH) && !remote_http_is_authenticated(con_info))
+    {
+        con_info->status = MHD_HTTP_UNAUTHORIZED;
+        return MHD_NO;
     }
     
     // Processes the request
@@ -66,12 +84,108 @@ int remote_http_handle_post(
         *upload_data_size = 0;
         return MHD_YES;
     }
-    else
-        return MHD_NO;
+    
+    // Answers once all the fields have been read
+    if(route->handler != NULL)
+        route->handler(connection, con_info);
+    return (con_info->job_state == JOB_RUNNING) ? MHD_YES : MHD_NO;
+}
+
+
+/**
+ * @brief Answers POST /command by sending the command to the player
+ * 
+ * The command goes to the target playback context, directly through its
+ * client handle if possible and through the command file otherwise.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_post_command(struct MHD_Connection *connection,
+                              struct RemoteConnection *con_info)
+{
+    (void) connection;
+    if(con_info->param1 == NULL)
+        return;
+    int target = remote_target_parse(con_info->param2,
+                                     remote_status_get_targets());
+    if(target < 0) {
+        con_info->status = MHD_HTTP_BAD_REQUEST;
+        return;
+    }
+    if(remote_player_client_command(target, con_info->param1) != 0) {
+        remote_target_select(target);
+        remote_command_write("%s", con_info->param1);
+    }
+    con_info->status = MHD_HTTP_OK;
+    
+    // Lets the client tell later status apart from the previous one
+    char clock[32];
+    snprintf(clock, 32, "%.6f", remote_status_clock());
+    remote_http_add_header(con_info, "X-Remote-Clock", clock);
+}
+
+/**
+ * @brief Answers POST /upload once the file has been received
+ * 
+ * The file is closed on a worker so that the server thread is not held up
+ * while it is written through to the disk.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_post_upload(struct MHD_Connection *connection,
+                             struct RemoteConnection *con_info)
+{
+    if(con_info->fp != NULL && con_info->status == MHD_HTTP_OK)
+        remote_http_worker_submit(connection, con_info, finish_upload, NULL);
+}
+
+/**
+ * @brief Answers POST /authenticate once the password has been read
+ * 
+ * The password may arrive in several pieces, so it is only checked once
+ * the whole body has been processed.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_post_authenticate(struct MHD_Connection *connection,
+                                   struct RemoteConnection *con_info)
+{
+    (void) connection;
+    if(con_info->param1 == NULL) {
+        con_info->status = MHD_HTTP_BAD_REQUEST;
+        return;
+    }
+    int auth = remote_http_authenticate(con_info, con_info->param1);
+    con_info->status = auth ? MHD_HTTP_OK : MHD_HTTP_UNAUTHORIZED;
+}
+
+/**
+ * @brief Answers POST /change-password once both passwords have been read
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+void remote_http_post_change_password(struct MHD_Connection *connection,
+                                      struct RemoteConnection *con_info)
+{
+    (void) connection;
+    if(con_info->param1 == NULL || con_info->param2 == NULL) {
+        con_info->status = MHD_HTTP_BAD_REQUEST;
+        return;
+    }
+    int auth = remote_http_change_password(con_info->param1,
+                                           con_info->param2);
+    con_info->status = auth ? MHD_HTTP_OK : MHD_HTTP_UNAUTHORIZED;
 }
 
 
-int remote_http_iterate_post(
+/**
+ * @brief Reads the fields of POST /authenticate
+ */
+int remote_http_iterate_authenticate(
     void *coninfo_cls,
     enum MHD_ValueKind kind,
     const char *key,
@@ -84,107 +198,167 @@ int remote_http_iterate_post(
 )
 {
     struct RemoteConnection* con_info = coninfo_cls;
-
-    if(strcmp(con_info->url, "/authenticate") == 0) {
-        if(strcmp(key, "password") == 0) {
-            int auth = remote_http_authenticate(con_info, data);
-            con_info->status = auth ? MHD_HTTP_OK : MHD_HTTP_UNAUTHORIZED;
-            return MHD_YES;
-        }
+    
+    if(strcmp(key, "password") == 0) {
+        return remote_http_set_param(con_info, &con_info->param1, data,
+                                     off, size) ? MHD_NO : MHD_YES;
     }
-    else if(strcmp(con_info->url, "/change-password") == 0) {
-        int rightKey = 0;
-        if(strcmp(key, "old-password") == 0) {
-            strcpy(con_info->param1, data);
-            rightKey = 1;
-        }
-        else if(strcmp(key, "password") == 0) {
-            strcpy(con_info->param2, data);
-            rightKey = 1;
-        }
+    
+    if(con_info->status == 0)
+        con_info->status = MHD_HTTP_BAD_REQUEST;
+    return MHD_YES;
+}
 
-        if(strlen(con_info->param1) && strlen(con_info->param2)) {
-            int auth = remote_http_change_password(
-                con_info->param1,
-                con_info->param2
-            );
-            con_info->status = auth ? MHD_HTTP_OK : MHD_HTTP_UNAUTHORIZED;
-            return MHD_YES;
-        }
-        else if(rightKey)
-            return MHD_YES;
+/**
+ * @brief Reads the fields of POST /change-password
+ */
+int remote_http_iterate_change_password(
+    void *coninfo_cls,
+    enum MHD_ValueKind kind,
+    const char *key,
+    const char *filename,
+    const char *content_type,
+    const char *transfer_encoding,
+    const char *data,
+    uint64_t off,
+    size_t size
+)
+{
+    struct RemoteConnection* con_info = coninfo_cls;
+    
+    if(strcmp(key, "old-password") == 0) {
+        return remote_http_set_param(con_info, &con_info->param1, data,
+                                     off, size) ? MHD_NO : MHD_YES;
+    }
+    else if(strcmp(key, "password") == 0) {
+        return remote_http_set_param(con_info, &con_info->param2, data,
+                                     off, size) ? MHD_NO : MHD_YES;
+    }
+    
+    if(con_info->status == 0)
+        con_info->status = MHD_HTTP_BAD_REQUEST;
+    return MHD_YES;
+}
 
+/**
+ * @brief Reads the fields of POST /command
+ */
+int remote_http_iterate_command(
+    void *coninfo_cls,
+    enum MHD_ValueKind kind,
+    const char *key,
+    const char *filename,
+    const char *content_type,
+    const char *transfer_encoding,
+    const char *data,
+    uint64_t off,
+    size_t size
+)
+{
+    struct RemoteConnection* con_info = coninfo_cls;
+    
+    if(strcmp(key, "command") == 0) {
+        return remote_http_set_param(con_info, &con_info->param1, data,
+                                     off, size) ? MHD_NO : MHD_YES;
     }
-    else if(strcmp(con_info->url, "/command") == 0) {
-        if(strcmp(key, "command") == 0) {
-            remote_command_write(data);
-            con_info->status = MHD_HTTP_OK;
-            return MHD_YES;
-        }
+    else if(strcmp(key, "target") == 0) {
+        return remote_http_set_param(con_info, &con_info->param2, data,
+                                     off, size) ? MHD_NO : MHD_YES;
     }
-    else if(strcmp(con_info->url, "/upload") == 0) {
-        if(strcmp(key, "blob") == 0) {
-            if(con_info->fp == NULL) {
-                if(filename == NULL) {
-                    con_info->status = MHD_HTTP_BAD_REQUEST;
-                    return MHD_YES;
-                }
-                #ifdef _WIN32
-                CreateDirectory("uploads", NULL);
-                #else
-                mkdir("uploads", 0700);
-                #endif
-
-                // Extract name, extension and file type from full name
-                char name[PATH_MAX], ext[6], type[12];
-                strcpy(ext, "");
-                strcpy(type, "");
-                char* ptr;
-                ptr = strrchr(filename, '.');
-                if(ptr != NULL) {
-                    strncpy(ext, ptr, 6);
-                    memcpy(name, filename, ptr-filename);
-                    name[ptr-filename] = '\0';
-                }
-                else
-                    strncpy(name, filename, PATH_MAX);
-                ptr = strrchr(content_type, '/');
-                if(ptr != NULL) {
-                    memcpy(type, content_type, ptr-content_type);
-                    type[ptr-content_type] = '\0';
-                }
-
-                // Checks if the media type is a video
-                if(strcmp(type, "video") != 0) {
-                    con_info->status = MHD_HTTP_UNSUPPORTED_MEDIA_TYPE;
-                    return MHD_YES;
-                }
-
-                char newfile[PATH_MAX];
-                char *json = malloc(PATH_MAX);
-                snprintf(newfile, PATH_MAX-1, "uploads/%s", filename);
-                snprintf(json, PATH_MAX-1, "{\"url\":\"%s\"}", newfile);
-                con_info->reply = json;
-                con_info->reply_length = strlen(json);
-                con_info->status = MHD_HTTP_OK;
-                strcpy(con_info->content_type, "application/json");
-                FILE *fp = fopen(newfile, "rb");
-
-                if(fp != NULL) {
-                    fclose(fp);
-                    return MHD_YES;
-                }
-                else
-                    con_info->fp = fopen(newfile, "wb");
-            }
+    
+    if(con_info->status == 0)
+        con_info->status = MHD_HTTP_BAD_REQUEST;
+    return MHD_YES;
+}
 
-            // Writes to the new file
-            if(size > 0) {
-                if(!fwrite(data, size, 1, con_info->fp))
-                    return MHD_NO;
+/**
+ * @brief Reads the fields of POST /upload and writes the uploaded file
+ */
+int remote_http_iterate_upload(
+    void *coninfo_cls,
+    enum MHD_ValueKind kind,
+    const char *key,
+    const char *filename,
+    const char *content_type,
+    const char *transfer_encoding,
+    const char *data,
+    uint64_t off,
+    size_t size
+)
+{
+    struct RemoteConnection* con_info = coninfo_cls;
+    
+    if(strcmp(key, "blob") == 0) {
+        if(con_info->fp == NULL) {
+            if(filename == NULL) {
+                con_info->status = MHD_HTTP_BAD_REQUEST;
+                return MHD_YES;
+            }
+            #ifdef _WIN32
+            CreateDirectory("uploads", NULL);
+            #else
+            mkdir("uploads", 0700);
+            #endif
+            
+            // Extract name, extension and file type from full name
+            char name[PATH_MAX], ext[6], type[12];
+            strcpy(ext, "");
+            strcpy(type, "");
+            char* ptr;
+            ptr = strrchr(filename, '.');
+            if(ptr != NULL) {
+                strncpy(ext, ptr, 6);
+                memcpy(name, filename, ptr-filename);
+                name[ptr-filename] = '\0';
+            }
+            else
+                strncpy(name, filename, PATH_MAX);
+            ptr = strrchr(content_type, '/');
+            if(ptr != NULL) {
+                memcpy(type, content_type, ptr-content_type);
+                type[ptr-content_type] = '\0';
+            }
+            
+            // Checks if the media type is a video
+            if(strcmp(type, "video") != 0) {
+                con_info->status = MHD_HTTP_UNSUPPORTED_MEDIA_TYPE;
+                return MHD_YES;
+            }
+            
+            char newfile[PATH_MAX];
+            char *json = remote_http_alloc(con_info, PATH_MAX);
+            if(json == NULL)
+                return MHD_NO;
+            snprintf(newfile, PATH_MAX-1, "uploads/%s", filename);
+            snprintf(json, PATH_MAX-1, "{\"url\":\"%s\"}", newfile);
+            con_info->reply = json;
+            con_info->reply_length = strlen(json);
+            con_info->reply_persistent = 1;
+            con_info->status = MHD_HTTP_OK;
+            con_info->content_type = "application/json";
+            FILE *fp = fopen(newfile, "rb");
+            
+            if(fp != NULL) {
+                fclose(fp);
+                return MHD_YES;
+            }
+            
+            // Keeps the path to index the file once it is written
+            con_info->fp = fopen(newfile, "wb");
+            if(con_info->fp != NULL) {
+                con_info->job_data = remote_http_alloc(con_info,
+                                                       strlen(newfile) + 1);
+                if(con_info->job_data != NULL)
+                    strcpy(con_info->job_data, newfile);
             }
-            return MHD_YES;
         }
+        
+        // Writes to the new file
+        if(size > 0) {
+            if(!fwrite(data, size, 1, con_info->fp))
+                return MHD_NO;
+        }
+        return MHD_YES;
     }
     
     if(con_info->status == 0)
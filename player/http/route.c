@@ -0,0 +1,106 @@
+/**
+ * @file route.c
+ * @brief Routes of the HTTP services
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "route.h"
+
+#include "assets.h"
+
+#include <stdint.h>
+#include <string.h>
+
+
+static const struct RemoteRoute routes[] = {
+    {GET_METHOD, "/", remote_http_get_page, NULL,
+     0, "text/html", PAGE_CACHE_CONTROL},
+    {GET_METHOD, "/index.html", remote_http_get_page, NULL,
+     0, "text/html", PAGE_CACHE_CONTROL},
+    {GET_METHOD, "/settings.html", remote_http_get_page, NULL,
+     0, "text/html", PAGE_CACHE_CONTROL},
+    {GET_METHOD, "/browse", remote_http_get_browse, NULL,
+     ROUTE_AUTH, "application/json", "no-cache"},
+    {GET_METHOD, "/thumbnail", remote_http_get_thumbnail, NULL,
+     ROUTE_AUTH, "image/png", "private, max-age=300"},
+    {GET_METHOD, "/thumbnails", remote_http_get_thumbnails, NULL,
+     ROUTE_AUTH, "application/octet-stream", "no-cache"},
+    {GET_METHOD, "/events", remote_http_get_events, NULL,
+     ROUTE_AUTH, "text/event-stream", "no-cache"},
+    {GET_METHOD, "/control", remote_http_get_control, NULL,
+     ROUTE_AUTH, "", NULL},
+    {GET_METHOD, "/stream", remote_http_get_stream, NULL,
+     ROUTE_AUTH, "", NULL},
+    {GET_METHOD, "/search", remote_http_get_search, NULL,
+     ROUTE_AUTH, "application/json", "no-store"},
+    {GET_METHOD, "/property", remote_http_get_property, NULL,
+     ROUTE_AUTH, "application/json", "no-store"},
+    {GET_METHOD, "/is-authenticated", remote_http_get_is_authenticated, NULL,
+     0, "", "no-store"},
+    {GET_METHOD, "/status", remote_http_get_status, NULL,
+     0, "application/json", "no-store"},
+    {POST_METHOD, "/command", remote_http_post_command,
+     remote_http_iterate_command, ROUTE_AUTH, "", NULL},
+    {POST_METHOD, "/upload", remote_http_post_upload,
+     remote_http_iterate_upload, ROUTE_AUTH, "", NULL},
+    {POST_METHOD, "/authenticate", remote_http_post_authenticate,
+     remote_http_iterate_authenticate, 0, "", NULL},
+    {POST_METHOD, "/change-password", remote_http_post_change_password,
+     remote_http_iterate_change_password, ROUTE_AUTH, "", NULL},
+};
+
+static const struct RemoteRoute *routeTable[ROUTE_TABLE_SIZE];
+
+
+// FNV-1a over the method and the path
+static uint32_t hash_route(int method, const char *path) {
+    uint32_t hash = 2166136261u ^ (uint32_t) method;
+    hash *= 16777619u;
+    while(*path != '\0') {
+        hash ^= (unsigned char) *path++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+/**
+ * @brief Hashes the route table
+ * 
+ * Has to be called before the web server starts.
+ */
+void remote_http_routes_init() {
+    memset(routeTable, 0, sizeof(routeTable));
+    for(size_t i=0; i<sizeof(routes)/sizeof(routes[0]); i++) {
+        uint32_t slot = hash_route(routes[i].method, routes[i].path);
+        slot %= ROUTE_TABLE_SIZE;
+        while(routeTable[slot] != NULL)
+            slot = (slot + 1) % ROUTE_TABLE_SIZE;
+        routeTable[slot] = &routes[i];
+    }
+}
+
+/**
+ * @brief Looks up the route of a request
+ * 
+ * @param method GET_METHOD or POST_METHOD
+ * @param path URL path starting with a slash
+ * 
+ * @return The route or NULL if there is no such service
+ */
+const struct RemoteRoute *remote_http_find_route(int method,
+                                                 const char *path)
+{
+    uint32_t slot = hash_route(method, path) % ROUTE_TABLE_SIZE;
+    while(routeTable[slot] != NULL) {
+        const struct RemoteRoute *route = routeTable[slot];
+        if(route->method == method && strcmp(route->path, path) == 0)
+            return route;
+        slot = (slot + 1) % ROUTE_TABLE_SIZE;
+    }
+    return NULL;
+}
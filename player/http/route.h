@@ -0,0 +1,225 @@
+/**
+ * @file route.h
+ * @brief Routes of the HTTP services
+ * 
+ * Every service is declared once in the route table with its handler, the
+ * authentication it requires, the content type of its reply and how the
+ * reply may be cached. The table is hashed on start so that a request
+ * finds its route with a single lookup.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_ROUTE_H__
+#define __MPV_REMOTE_HTTP_ROUTE_H__ ///< Header guard
+
+#include "con_type.h"
+
+#include <microhttpd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ROUTE_AUTH 1 ///< Only the authenticated user may use the route
+#define ROUTE_TABLE_SIZE 64 ///< Slots of the hashed route table
+
+
+/**
+ * @brief Answers a request once its body has been received
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ */
+typedef void (*remote_http_route_handler)(struct MHD_Connection *connection,
+                                          struct RemoteConnection *con_info);
+
+/**
+ * @brief Reads a field of a POST request
+ * 
+ * Same as MHD_PostDataIterator with the connection as the closure.
+ */
+typedef int (*remote_http_post_iterator)(
+    void *coninfo_cls,
+    enum MHD_ValueKind kind,
+    const char *key,
+    const char *filename,
+    const char *content_type,
+    const char *transfer_encoding,
+    const char *data,
+    uint64_t off,
+    size_t size
+);
+
+/**
+ * @brief HTTP service
+ */
+struct RemoteRoute {
+    int method; ///< GET_METHOD or POST_METHOD
+    const char *path; ///< URL path starting with a slash
+    remote_http_route_handler handler; ///< Answers the request, may be NULL
+    remote_http_post_iterator iterator; ///< Reads the POST fields
+    int flags; ///< ROUTE_AUTH or 0
+    const char *content_type; ///< Content type of the reply, may be empty
+    const char *cache_control; ///< Cache-Control of the reply or NULL
+};
+
+
+/**
+ * @brief Hashes the route table
+ * 
+ * Has to be called before the web server starts.
+ */
+void remote_http_routes_init();
+
+/**
+ * @brief Looks up the route of a request
+ * 
+ * @param method GET_METHOD or POST_METHOD
+ * @param path URL path starting with a slash
+ * 
+ * @return The route or NULL if there is no such service
+ */
+const struct RemoteRoute *remote_http_find_route(int method,
+                                                 const char *path);
+
+
+/**
+ * @brief Answers GET / with the main page and GET /settings.html
+ */
+void remote_http_get_page(struct MHD_Connection *connection,
+                          struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers GET /browse with the listing of a directory
+ */
+void remote_http_get_browse(struct MHD_Connection *connection,
+                            struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers GET /thumbnail with a frame of a video
+ */
+void remote_http_get_thumbnail(struct MHD_Connection *connection,
+                               struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers GET /thumbnails with the thumbnails of a page as a sprite
+ */
+void remote_http_get_thumbnails(struct MHD_Connection *connection,
+                                struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers GET /events with the event stream of a playback context
+ */
+void remote_http_get_events(struct MHD_Connection *connection,
+                            struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers GET /control by upgrading to a WebSocket
+ */
+void remote_http_get_control(struct MHD_Connection *connection,
+                             struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers GET /stream with a media file
+ */
+void remote_http_get_stream(struct MHD_Connection *connection,
+                            struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers GET /search with the library files matching a query
+ */
+void remote_http_get_search(struct MHD_Connection *connection,
+                            struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers GET /property with a property read from the player
+ */
+void remote_http_get_property(struct MHD_Connection *connection,
+                              struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers GET /is-authenticated with 200 or 401
+ */
+void remote_http_get_is_authenticated(struct MHD_Connection *connection,
+                                      struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers GET /status with the status of a playback context
+ */
+void remote_http_get_status(struct MHD_Connection *connection,
+                            struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers POST /command by sending the command to the player
+ */
+void remote_http_post_command(struct MHD_Connection *connection,
+                              struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers POST /upload once the file has been received
+ */
+void remote_http_post_upload(struct MHD_Connection *connection,
+                             struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers POST /authenticate once the password has been read
+ */
+void remote_http_post_authenticate(struct MHD_Connection *connection,
+                                   struct RemoteConnection *con_info);
+
+/**
+ * @brief Answers POST /change-password once both passwords have been read
+ */
+void remote_http_post_change_password(struct MHD_Connection *connection,
+                                      struct RemoteConnection *con_info);
+
+/**
+ * @brief Reads the fields of POST /command
+ */
+int remote_http_iterate_command(void *coninfo_cls, enum MHD_ValueKind kind,
+                                const char *key, const char *filename,
+                                const char *content_type,
+                                const char *transfer_encoding,
+                                const char *data, uint64_t off, size_t size);
+
+/**
+ * @brief Reads the fields of POST /upload and writes the uploaded file
+ */
+int remote_http_iterate_upload(void *coninfo_cls, enum MHD_ValueKind kind,
+                               const char *key, const char *filename,
+                               const char *content_type,
+                               const char *transfer_encoding,
+                               const char *data, uint64_t off, size_t size);
+
+/**
+ * @brief Reads the fields of POST /authenticate
+ */
+int remote_http_iterate_authenticate(void *coninfo_cls,
+                                     enum MHD_ValueKind kind,
+                                     const char *key, const char *filename,
+                                     const char *content_type,
+                                     const char *transfer_encoding,
+                                     const char *data, uint64_t off,
+                                     size_t size);
+
+/**
+ * @brief Reads the fields of POST /change-password
+ */
+int remote_http_iterate_change_password(void *coninfo_cls,
+                                        enum MHD_ValueKind kind,
+                                        const char *key,
+                                        const char *filename,
+                                        const char *content_type,
+                                        const char *transfer_encoding,
+                                        const char *data, uint64_t off,
+                                        size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
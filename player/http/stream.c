@@ -0,0 +1,220 @@
+/**
+ * @file stream.c
+ * @brief Streams the media files to the clients
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "stream.h"
+#include "listing.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define open _open
+#define close _close
+#define fstat _fstat64
+#define stat _stat64
+#define strcasecmp _stricmp
+#define O_NONBLOCK 0
+#else
+#include <strings.h>
+#include <unistd.h>
+#define O_BINARY 0
+#endif
+
+
+struct MediaMimeType {
+    const char *ext;
+    const char *content_type;
+};
+
+static const struct MediaMimeType mimetypes[] = {
+    {"mp4", "video/mp4"},
+    {"m4v", "video/mp4"},
+    {"mov", "video/quicktime"},
+    {"wmv", "video/x-ms-wmv"},
+    {"flv", "video/x-flv"},
+    {"avi", "video/x-msvideo"},
+    {"webm", "video/webm"},
+    {"mkv", "video/x-matroska"},
+    {"m4a", "audio/mp4"},
+    {"flac", "audio/flac"},
+    {"mp3", "audio/mpeg"},
+    {"wav", "audio/wav"},
+    {"aac", "audio/aac"},
+    {"ogg", "audio/ogg"},
+    {"opus", "audio/ogg"},
+};
+
+
+static const char *find_content_type(const char *path) {
+    const char *ext = strrchr(path, '.');
+    if(ext != NULL) {
+        ext++;
+        for(size_t i=0; i<sizeof(mimetypes)/sizeof(mimetypes[0]); i++) {
+            if(strcasecmp(ext, mimetypes[i].ext) == 0)
+                return mimetypes[i].content_type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+
+/**
+ * Parses a single range "bytes=first-last", "bytes=first-" or "bytes=-n".
+ * Returns 0 for a valid range, 1 for a header to be ignored like multiple
+ * ranges, and -1 for a range outside the file.
+ */
+static int parse_range(const char *header, uint64_t size,
+                       uint64_t *first, uint64_t *last)
+{
+    if(strncmp(header, "bytes=", 6) != 0 || strchr(header, ',') != NULL)
+        return 1;
+    const char *p = header + 6;
+    char *end;
+    
+    if(*p == '-') {
+        uint64_t suffix = strtoull(p+1, &end, 10);
+        if(end == p+1 || *end != '\0')
+            return 1;
+        if(suffix == 0 || size == 0)
+            return -1;
+        *first = (suffix >= size) ? 0 : size - suffix;
+        *last = size - 1;
+        return 0;
+    }
+    
+    *first = strtoull(p, &end, 10);
+    if(end == p || *end != '-')
+        return 1;
+    p = end + 1;
+    if(*p == '\0')
+        *last = size - 1;
+    else {
+        *last = strtoull(p, &end, 10);
+        if(*end != '\0' || *last < *first)
+            return 1;
+        if(*last >= size)
+            *last = size - 1;
+    }
+    if(*first >= size)
+        return -1;
+    return 0;
+}
+
+
+static void format_http_date(time_t t, char *dest, size_t size) {
+    struct tm tm;
+    #ifdef _WIN32
+    gmtime_s(&tm, &t);
+    #else
+    gmtime_r(&t, &tm);
+    #endif
+    strftime(dest, size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+
+/**
+ * @brief Answers a request for a media file
+ * 
+ * Honors the Range and If-Range headers. Sets the file descriptor of the
+ * connection which the response takes over, or an error status. Answers
+ * 404 for anything but a regular media file.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ * @param path Path of the file on the server
+ */
+void remote_http_answer_stream(struct MHD_Connection *connection,
+                               struct RemoteConnection *con_info,
+                               const char *path)
+{
+    // Only the media files of the listings are served and nothing but a
+    // regular file is opened, so that a FIFO cannot block the thread
+    struct stat st;
+    if(remote_http_listing_type(path) == 0 || stat(path, &st) != 0 ||
+       (st.st_mode & S_IFMT) != S_IFREG)
+    {
+        con_info->status = MHD_HTTP_NOT_FOUND;
+        return;
+    }
+    int fd = open(path, O_RDONLY | O_BINARY | O_NONBLOCK);
+    if(fd < 0) {
+        con_info->status = MHD_HTTP_NOT_FOUND;
+        return;
+    }
+    if(fstat(fd, &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG) {
+        close(fd);
+        con_info->status = MHD_HTTP_NOT_FOUND;
+        return;
+    }
+    uint64_t size = (uint64_t) st.st_size;
+    
+    // Validators identify the version of the file for resuming
+    char etag[48];
+    char modified[40];
+    snprintf(etag, 48, "\"%" PRIx64 "-%" PRIx64 "\"", size,
+             (uint64_t) st.st_mtime);
+    format_http_date(st.st_mtime, modified, 40);
+    remote_http_add_header(con_info, "Accept-Ranges", "bytes");
+    remote_http_add_header(con_info, "ETag", etag);
+    remote_http_add_header(con_info, "Last-Modified", modified);
+    con_info->content_type = find_content_type(path);
+    
+    // Serves the whole file unless a range of the same version is asked
+    uint64_t first = 0;
+    uint64_t last = size - 1;
+    int partial = 0;
+    const char *range = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        MHD_HTTP_HEADER_RANGE
+    );
+    const char *ifRange = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        MHD_HTTP_HEADER_IF_RANGE
+    );
+    if(range != NULL && (ifRange == NULL || strcmp(ifRange, etag) == 0 ||
+                         strcmp(ifRange, modified) == 0))
+    {
+        uint64_t rangeFirst, rangeLast;
+        int res = parse_range(range, size, &rangeFirst, &rangeLast);
+        if(res < 0) {
+            char contentRange[48];
+            snprintf(contentRange, 48, "bytes */%" PRIu64, size);
+            remote_http_add_header(con_info, "Content-Range", contentRange);
+            close(fd);
+            con_info->content_type = "";
+            con_info->status = MHD_HTTP_RANGE_NOT_SATISFIABLE;
+            return;
+        }
+        if(res == 0) {
+            first = rangeFirst;
+            last = rangeLast;
+            partial = 1;
+        }
+    }
+    
+    if(partial) {
+        char contentRange[80];
+        snprintf(contentRange, 80, "bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64,
+                 first, last, size);
+        remote_http_add_header(con_info, "Content-Range", contentRange);
+    }
+    con_info->stream_fd = fd;
+    con_info->stream_offset = first;
+    con_info->stream_length = (size == 0) ? 0 : last - first + 1;
+    con_info->status = partial ? MHD_HTTP_PARTIAL_CONTENT : MHD_HTTP_OK;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file stream.h
+ * @brief Streams the media files to the clients
+ * 
+ * Serves a file straight from its descriptor so that the web server can
+ * hand it to the kernel with sendfile() instead of buffering it. Single
+ * byte ranges are supported for seeking and resuming downloads.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_STREAM_H__
+#define __MPV_REMOTE_HTTP_STREAM_H__ ///< Header guard
+
+#include "con_type.h"
+
+#include <microhttpd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Answers a request for a media file
+ * 
+ * Honors the Range and If-Range headers. Sets the file descriptor of the
+ * connection which the response takes over, or an error status. Answers
+ * 404 for anything but a regular media file.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ * @param path Path of the file on the server
+ */
+void remote_http_answer_stream(struct MHD_Connection *connection,
+                               struct RemoteConnection *con_info,
+                               const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
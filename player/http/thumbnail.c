@@ -0,0 +1,1584 @@
+/**
+ * @file thumbnail.c
+ * @brief Thumbnails of the videos served by GET /thumbnail
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "thumbnail.h"
+
+#include "../../libremote/libremote.h"
+#include "../../libremote/thread.h"
+#include "etag.h"
+#include "jsonwriter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Shlobj.h>
+#include <io.h>
+#define PATH_MAX _MAX_PATH
+#define open _open
+#define close _close
+#define read _read
+#else
+#include <dirent.h>
+#include <linux/limits.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define O_BINARY 0
+#endif
+
+#ifdef HAVE_LIBAV
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+#endif
+
+#define THUMBNAIL_COMMAND_SIZE (2 * PATH_MAX + 256) ///< Longest command line
+#define THUMBNAIL_PACKETS 1024 ///< Most packets read for a key frame
+#define THUMBNAIL_MAP_SIZE 8192 ///< Bytes allocated at first for a sprite map
+#define THUMBNAIL_FORMAT_MASK 3 ///< Bits of a key naming the format
+
+
+/**
+ * @brief Thumbnail kept on disk
+ */
+struct RemoteThumbnail {
+    uint64_t key; ///< The entity tag which names the file and its format
+    uint64_t size; ///< The number of bytes of the file
+    int64_t used; ///< When the thumbnail was used last, to sort them
+    struct RemoteThumbnail *chain; ///< Next thumbnail of the bucket
+    struct RemoteThumbnail *prev; ///< More recently used thumbnail
+    struct RemoteThumbnail *next; ///< Less recently used thumbnail
+};
+
+/**
+ * @brief Thumbnail being rendered, which the other threads wait for
+ */
+struct RemoteThumbnailRender {
+    uint64_t key; ///< The thumbnail
+    struct RemoteThumbnailRender *next; ///< Next thumbnail being rendered
+};
+
+/**
+ * @brief Video queued to render its thumbnail ahead
+ */
+struct RemoteThumbnailJob {
+    struct RemoteThumbnailJob *next; ///< Next video to render
+    struct RemoteThumbnailVariant variant; ///< The variant to render
+    size_t dir_length; ///< The number of bytes of the directory
+    char path[]; ///< The path of the video
+};
+
+/**
+ * @brief Thumbnail kept of a video of a page, mapped in its sprite
+ */
+struct RemoteThumbnailPiece {
+    size_t name; ///< The offset of the name of the video in the batch
+    uint64_t key; ///< The thumbnail
+    uint64_t size; ///< The number of bytes of the thumbnail when mapped
+};
+
+/**
+ * @brief Videos of a page to render the thumbnails of ahead
+ */
+struct RemoteThumbnailBatch {
+    char *directory; ///< The directory browsed
+    struct RemoteThumbnailVariant variant; ///< The variant to render
+    char *names; ///< The names of the videos one after another
+    size_t length; ///< The number of bytes of the names used
+    size_t capacity; ///< The number of bytes of the names
+    struct RemoteThumbnailPiece *pieces; ///< The thumbnails mapped
+    size_t piece_count; ///< The number of thumbnails mapped
+    char *map; ///< The JSON map of the sprite
+    size_t map_length; ///< The number of bytes of the map
+};
+
+
+static const char *const thumbnailExtensions[THUMBNAIL_FORMATS] = {
+    ".png", ".jpg", ".webp"
+};
+static const char *const thumbnailTypes[THUMBNAIL_FORMATS] = {
+    "image/png", "image/jpeg", "image/webp"
+};
+static int thumbnailEncoders[THUMBNAIL_FORMATS] = {1, 0, 0};
+
+static remote_mutex_t thumbnailLock;
+static int thumbnailInitialized = 0;
+static struct RemoteThumbnail *thumbnailBuckets[THUMBNAIL_BUCKETS];
+static struct RemoteThumbnail *thumbnailHead = NULL;
+static struct RemoteThumbnail *thumbnailTail = NULL;
+static uint64_t thumbnailBytes = 0;
+static char thumbnailDirectory[PATH_MAX];
+static struct RemoteThumbnailRender *thumbnailRenders = NULL;
+static remote_cond_t thumbnailRendered;
+static int renderCount = 0;
+static int renderWaiting = 0;
+static remote_cond_t renderFree;
+
+// Videos to render ahead, the directory browsed last first
+static remote_cond_t queueWake;
+static remote_thread_t queueThread;
+static int queueRunning = 0;
+static int queueStopping = 0;
+static struct RemoteThumbnailJob *queueHead = NULL;
+static struct RemoteThumbnailJob *queueJob = NULL;
+static char *queueDirs[THUMBNAIL_QUEUE_DIRS];
+
+
+
+
+// Finds the directory of the thumbnails, creating it if needed
+static void find_directory() {
+    char *path = thumbnailDirectory;
+    #ifdef _WIN32
+    SHGetSpecialFolderPathA(NULL, path, CSIDL_LOCAL_APPDATA, 0);
+    strcat(path, "/MPV Remote");
+    CreateDirectory(path, NULL);
+    strcat(path, "/thumbnails");
+    CreateDirectory(path, NULL);
+    #else
+    const char *home = getenv("HOME");
+    snprintf(path, PATH_MAX-32, "%s/.cache", home != NULL ? home : ".");
+    mkdir(path, 0700);
+    strcat(path, "/mpv-remote");
+    mkdir(path, 0700);
+    strcat(path, "/thumbnails");
+    mkdir(path, 0700);
+    #endif
+}
+
+
+// The low bits of the key tell the extension of the file
+static void thumbnail_path(uint64_t key, char *path) {
+    snprintf(path, PATH_MAX, "%s/%016llx%s", thumbnailDirectory,
+             (unsigned long long) key,
+             thumbnailExtensions[key & THUMBNAIL_FORMAT_MASK]);
+}
+
+
+// Reads the key of a thumbnail from the name of its file or its tag,
+// returns 1 if it is not one
+static int parse_key(const char *name, uint64_t *key) {
+    uint64_t value = 0;
+    for(int i=0; i<16; i++) {
+        char c = name[i];
+        int digit;
+        if(c >= '0' && c <= '9')
+            digit = c - '0';
+        else if(c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else
+            return 1;
+        value = (value << 4) | (uint64_t) digit;
+    }
+    *key = value;
+    return 0;
+}
+
+
+
+
+static struct RemoteThumbnail **find_thumbnail(uint64_t key) {
+    struct RemoteThumbnail **t = &thumbnailBuckets[key % THUMBNAIL_BUCKETS];
+    while(*t != NULL && (*t)->key != key)
+        t = &(*t)->chain;
+    return t;
+}
+
+
+static void link_thumbnail(struct RemoteThumbnail *thumbnail) {
+    thumbnail->prev = NULL;
+    thumbnail->next = thumbnailHead;
+    if(thumbnailHead != NULL)
+        thumbnailHead->prev = thumbnail;
+    thumbnailHead = thumbnail;
+    if(thumbnailTail == NULL)
+        thumbnailTail = thumbnail;
+    thumbnailBytes += thumbnail->size;
+}
+
+
+static void unlink_thumbnail(struct RemoteThumbnail *thumbnail) {
+    if(thumbnail->prev != NULL)
+        thumbnail->prev->next = thumbnail->next;
+    else
+        thumbnailHead = thumbnail->next;
+    if(thumbnail->next != NULL)
+        thumbnail->next->prev = thumbnail->prev;
+    else
+        thumbnailTail = thumbnail->prev;
+    thumbnail->prev = NULL;
+    thumbnail->next = NULL;
+    thumbnailBytes -= thumbnail->size;
+}
+
+
+// Forgets a thumbnail, deleting its file if asked, has to be called with
+// the lock held
+static void drop_thumbnail(struct RemoteThumbnail *thumbnail, int delete) {
+    struct RemoteThumbnail **t = find_thumbnail(thumbnail->key);
+    *t = thumbnail->chain;
+    unlink_thumbnail(thumbnail);
+    if(delete) {
+        char path[PATH_MAX];
+        thumbnail_path(thumbnail->key, path);
+        remove(path);
+    }
+    free(thumbnail);
+}
+
+
+// Evicts the least recently used thumbnails beyond the disk budget
+static void trim_thumbnails() {
+    while(thumbnailBytes > THUMBNAIL_BUDGET && thumbnailTail != NULL)
+        drop_thumbnail(thumbnailTail, 1);
+}
+
+
+// Keeps a thumbnail as the most recently used one, has to be called with
+// the lock held
+static void keep_thumbnail(uint64_t key, uint64_t size, int64_t used) {
+    struct RemoteThumbnail *thumbnail = *find_thumbnail(key);
+    if(thumbnail != NULL)
+        unlink_thumbnail(thumbnail);
+    else {
+        thumbnail = malloc(sizeof(struct RemoteThumbnail));
+        if(thumbnail == NULL)
+            return;
+        thumbnail->key = key;
+        thumbnail->chain = thumbnailBuckets[key % THUMBNAIL_BUCKETS];
+        thumbnailBuckets[key % THUMBNAIL_BUCKETS] = thumbnail;
+    }
+    thumbnail->size = size;
+    thumbnail->used = used;
+    link_thumbnail(thumbnail);
+}
+
+
+static int compare_used(const void *a, const void *b) {
+    const struct RemoteThumbnail *x = a;
+    const struct RemoteThumbnail *y = b;
+    return (x->used > y->used) - (x->used < y->used);
+}
+
+
+// Adds a file of the directory to the thumbnails found, deleting the ones
+// left unfinished and the ones named by an older version
+static void find_file(const char *name, struct RemoteThumbnail **found,
+                      size_t *count, size_t *capacity)
+{
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "%s/%s", thumbnailDirectory, name);
+    uint64_t key;
+    int named = (parse_key(name, &key) == 0);
+    if(!named || (key & THUMBNAIL_FORMAT_MASK) >= THUMBNAIL_FORMATS ||
+       strcmp(name + 16, thumbnailExtensions[key & THUMBNAIL_FORMAT_MASK]))
+    {
+        if(named || strstr(name, ".tmp") != NULL)
+            remove(path);
+        return;
+    }
+    
+    #ifdef _WIN32
+    struct __stat64 st;
+    if(_stat64(path, &st) != 0)
+        return;
+    #else
+    struct stat st;
+    if(stat(path, &st) != 0)
+        return;
+    #endif
+    if(*count == *capacity) {
+        size_t n = (*capacity > 0) ? *capacity * 2 : 256;
+        void *f = realloc(*found, n * sizeof(struct RemoteThumbnail));
+        if(f == NULL)
+            return;
+        *found = f;
+        *capacity = n;
+    }
+    
+    // Reading a file updates its access time at least once a day
+    struct RemoteThumbnail *thumbnail = &(*found)[(*count)++];
+    thumbnail->key = key;
+    thumbnail->size = (uint64_t) st.st_size;
+    thumbnail->used = (int64_t) st.st_atime;
+    if(thumbnail->used < (int64_t) st.st_mtime)
+        thumbnail->used = (int64_t) st.st_mtime;
+}
+
+
+// Finds the thumbnails kept by the former runs in the order of their use
+static void find_thumbnails() {
+    struct RemoteThumbnail *found = NULL;
+    size_t count = 0, capacity = 0;
+    #ifdef _WIN32
+    char pattern[PATH_MAX];
+    snprintf(pattern, PATH_MAX, "%s/*", thumbnailDirectory);
+    WIN32_FIND_DATAA data;
+    HANDLE hFind = FindFirstFileA(pattern, &data);
+    if(hFind != INVALID_HANDLE_VALUE) {
+        do {
+            find_file(data.cFileName, &found, &count, &capacity);
+        } while(FindNextFileA(hFind, &data));
+        FindClose(hFind);
+    }
+    #else
+    DIR *dir = opendir(thumbnailDirectory);
+    if(dir != NULL) {
+        struct dirent *entry;
+        while((entry = readdir(dir)) != NULL) {
+            if(entry->d_name[0] != '.')
+                find_file(entry->d_name, &found, &count, &capacity);
+        }
+        closedir(dir);
+    }
+    #endif
+    
+    if(count > 0)
+        qsort(found, count, sizeof(struct RemoteThumbnail), compare_used);
+    for(size_t i=0; i<count; i++)
+        keep_thumbnail(found[i].key, found[i].size, found[i].used);
+    trim_thumbnails();
+    free(found);
+}
+
+
+
+
+#ifdef HAVE_LIBAV
+static AVCodecContext *open_decoder(const AVStream *stream) {
+    const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if(codec == NULL)
+        return NULL;
+    AVCodecContext *decoder = avcodec_alloc_context3(codec);
+    if(decoder == NULL)
+        return NULL;
+    
+    // Only the key frames are decoded, on the calling thread since threads
+    // would only delay the first frame
+    decoder->thread_count = 1;
+    decoder->skip_frame = AVDISCARD_NONKEY;
+    if(avcodec_parameters_to_context(decoder, stream->codecpar) < 0 ||
+       avcodec_open2(decoder, codec, NULL) < 0)
+        avcodec_free_context(&decoder);
+    return decoder;
+}
+
+
+// Decodes the first key frame from the position sought, returns 1 if none
+// is found soon enough
+static int decode_frame(AVFormatContext *format, int stream,
+                        AVCodecContext *decoder, AVFrame *frame)
+{
+    AVPacket *packet = av_packet_alloc();
+    if(packet == NULL)
+        return 1;
+    int failed = 1;
+    for(int i=0; i<THUMBNAIL_PACKETS && failed; i++) {
+        int res = av_read_frame(format, packet);
+        if(res < 0) {
+            // Drains the frame held by the decoder at the end of the file
+            avcodec_send_packet(decoder, NULL);
+            failed = (avcodec_receive_frame(decoder, frame) != 0);
+            break;
+        }
+        if(packet->stream_index == stream &&
+           avcodec_send_packet(decoder, packet) == 0)
+            failed = (avcodec_receive_frame(decoder, frame) != 0);
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    return failed;
+}
+
+
+static const AVCodec *find_encoder(int format) {
+    if(format == THUMBNAIL_JPEG)
+        return avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    // The animated WebP encoder would only give the image once flushed
+    if(format == THUMBNAIL_WEBP)
+        return avcodec_find_encoder_by_name("libwebp");
+    return avcodec_find_encoder(AV_CODEC_ID_PNG);
+}
+
+
+// Sets up the encoder of a variant, returns the options to free
+static AVDictionary *setup_encoder(AVCodecContext *encoder,
+                                   const struct RemoteThumbnailVariant *v)
+{
+    AVDictionary *options = NULL;
+    encoder->width = v->width;
+    encoder->height = v->height;
+    encoder->time_base = (AVRational) {1, 1};
+    if(v->format == THUMBNAIL_JPEG) {
+        // The quality maps onto the scale of 31 to 2 of ffmpeg
+        encoder->pix_fmt = AV_PIX_FMT_YUVJ420P;
+        encoder->color_range = AVCOL_RANGE_JPEG;
+        encoder->flags |= AV_CODEC_FLAG_QSCALE;
+        encoder->global_quality = FF_QP2LAMBDA *
+                                  (31 - (v->quality - 1) * 29 / 99);
+    }
+    else if(v->format == THUMBNAIL_WEBP) {
+        encoder->pix_fmt = AV_PIX_FMT_YUV420P;
+        av_dict_set_int(&options, "quality", v->quality, 0);
+    }
+    else
+        encoder->pix_fmt = AV_PIX_FMT_RGB24;
+    return options;
+}
+
+
+// Scales a frame down and encodes it in the variant, returns the image to
+// free or NULL on failure
+static uint8_t *encode_frame(const AVFrame *frame,
+                             const struct RemoteThumbnailVariant *variant,
+                             size_t *len)
+{
+    const AVCodec *codec = find_encoder(variant->format);
+    AVCodecContext *encoder = codec ? avcodec_alloc_context3(codec) : NULL;
+    AVFrame *scaled = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    AVDictionary *options = NULL;
+    if(encoder != NULL)
+        options = setup_encoder(encoder, variant);
+    struct SwsContext *scaler = NULL;
+    if(encoder != NULL) {
+        scaler = sws_getContext(
+            frame->width, frame->height, frame->format,
+            variant->width, variant->height, encoder->pix_fmt,
+            SWS_BILINEAR, NULL, NULL, NULL
+        );
+    }
+    uint8_t *image = NULL;
+    
+    if(encoder != NULL && scaled != NULL && packet != NULL &&
+       scaler != NULL)
+    {
+        scaled->width = variant->width;
+        scaled->height = variant->height;
+        scaled->format = encoder->pix_fmt;
+        scaled->quality = encoder->global_quality;
+        if(avcodec_open2(encoder, codec, &options) == 0 &&
+           av_frame_get_buffer(scaled, 0) == 0)
+        {
+            sws_scale(scaler, (const uint8_t* const*) frame->data,
+                      frame->linesize, 0, frame->height, scaled->data,
+                      scaled->linesize);
+            if(avcodec_send_frame(encoder, scaled) == 0 &&
+               avcodec_receive_packet(encoder, packet) == 0)
+            {
+                image = malloc(packet->size);
+                if(image != NULL) {
+                    memcpy(image, packet->data, packet->size);
+                    *len = (size_t) packet->size;
+                }
+            }
+        }
+    }
+    av_dict_free(&options);
+    sws_freeContext(scaler);
+    av_packet_free(&packet);
+    av_frame_free(&scaled);
+    avcodec_free_context(&encoder);
+    return image;
+}
+
+
+// Decodes a key frame from the middle of a video in process, returns the
+// image to free or NULL on failure
+static uint8_t *render_frame(const char *file,
+                             const struct RemoteThumbnailVariant *variant,
+                             size_t *len)
+{
+    AVFormatContext *format = NULL;
+    if(avformat_open_input(&format, file, NULL, NULL) != 0)
+        return NULL;
+    AVCodecContext *decoder = NULL;
+    AVFrame *frame = av_frame_alloc();
+    uint8_t *image = NULL;
+    int stream = -1;
+    if(frame != NULL && avformat_find_stream_info(format, NULL) >= 0) {
+        stream = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1,
+                                     NULL, 0);
+    }
+    if(stream >= 0)
+        decoder = open_decoder(format->streams[stream]);
+    
+    if(decoder != NULL) {
+        // Starts from the key frame before the middle, or from the start
+        // if the file cannot seek
+        if(format->duration > 0) {
+            int64_t middle = format->duration / 2;
+            if(format->start_time != AV_NOPTS_VALUE)
+                middle += format->start_time;
+            av_seek_frame(format, -1, middle, AVSEEK_FLAG_BACKWARD);
+        }
+        if(decode_frame(format, stream, decoder, frame) == 0)
+            image = encode_frame(frame, variant, len);
+    }
+    avcodec_free_context(&decoder);
+    av_frame_free(&frame);
+    avformat_close_input(&format);
+    return image;
+}
+
+
+static void find_encoders() {
+    for(int i=0; i<THUMBNAIL_FORMATS; i++)
+        thumbnailEncoders[i] = (find_encoder(i) != NULL);
+}
+
+
+static int write_thumbnail(const char *file,
+                           const struct RemoteThumbnailVariant *variant,
+                           const char *temp)
+{
+    size_t len = 0;
+    uint8_t *image = render_frame(file, variant, &len);
+    if(image == NULL)
+        return 1;
+    FILE *fp = fopen(temp, "wb");
+    int failed = (fp == NULL || fwrite(image, 1, len, fp) != len);
+    if(fp != NULL)
+        failed = (fclose(fp) != 0) || failed;
+    free(image);
+    return failed;
+}
+#else
+#ifdef _WIN32
+// Appends an argument quoted the way the C runtime splits the command line,
+// returns 1 if it does not fit
+static int quote_argument(char *line, size_t *len, size_t size,
+                          const char *arg)
+{
+    size_t n = *len;
+    if(n + 3 > size)
+        return 1;
+    if(n > 0)
+        line[n++] = ' ';
+    line[n++] = '"';
+    for(const char *p=arg; ; p++) {
+        // Backslashes are doubled only before a quote or the closing one
+        size_t slashes = 0;
+        while(*p == '\\') {
+            slashes++;
+            p++;
+        }
+        size_t count = (*p == '"' || *p == '\0') ? 2 * slashes : slashes;
+        if(n + count + 4 > size)
+            return 1;
+        memset(line + n, '\\', count);
+        n += count;
+        if(*p == '\0')
+            break;
+        if(*p == '"')
+            line[n++] = '\\';
+        line[n++] = *p;
+    }
+    line[n++] = '"';
+    line[n] = '\0';
+    *len = n;
+    return 0;
+}
+#endif
+
+
+// Runs a program with its arguments as given, without any shell, keeping
+// the start of its output if asked, returns its exit code or -1
+static int run_program(const char *const *argv, char *output, size_t size)
+{
+    size_t len = 0;
+    if(output != NULL)
+        output[0] = '\0';
+    #ifdef _WIN32
+    char *line = malloc(THUMBNAIL_COMMAND_SIZE);
+    if(line == NULL)
+        return -1;
+    line[0] = '\0';
+    for(int i=0; argv[i] != NULL; i++) {
+        if(quote_argument(line, &len, THUMBNAIL_COMMAND_SIZE, argv[i]) != 0) {
+            free(line);
+            return -1;
+        }
+    }
+    
+    SECURITY_ATTRIBUTES sa = {sizeof(sa), NULL, TRUE};
+    HANDLE null = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &sa,
+                              OPEN_EXISTING, 0, NULL);
+    HANDLE reader = NULL, writer = NULL;
+    if(null == INVALID_HANDLE_VALUE ||
+       (output != NULL && !CreatePipe(&reader, &writer, &sa, 0)))
+    {
+        if(null != INVALID_HANDLE_VALUE)
+            CloseHandle(null);
+        free(line);
+        return -1;
+    }
+    if(reader != NULL)
+        SetHandleInformation(reader, HANDLE_FLAG_INHERIT, 0);
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    memset(&si, 0, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = NULL;
+    si.hStdOutput = (writer != NULL) ? writer : null;
+    si.hStdError = null;
+    BOOL started = CreateProcessA(NULL, line, NULL, NULL, TRUE,
+                                  CREATE_NO_WINDOW, NULL, NULL, &si, &pi);
+    free(line);
+    CloseHandle(null);
+    if(writer != NULL)
+        CloseHandle(writer);
+    if(!started) {
+        if(reader != NULL)
+            CloseHandle(reader);
+        return -1;
+    }
+    
+    // Reads the output to its end so that the program never blocks on it
+    if(reader != NULL) {
+        char buf[256];
+        DWORD n;
+        while(ReadFile(reader, buf, sizeof(buf), &n, NULL) && n > 0) {
+            size_t keep = (len + n < size) ? n : size - 1 - len;
+            memcpy(output + len, buf, keep);
+            len += keep;
+        }
+        output[len] = '\0';
+        CloseHandle(reader);
+    }
+    DWORD code = 1;
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    GetExitCodeProcess(pi.hProcess, &code);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    return (int) code;
+    #else
+    // Everything the child needs is opened before the fork, and closed on
+    // exec so that the programs started by other threads do not hold the
+    // pipe open
+    int null = open("/dev/null", O_RDWR | O_CLOEXEC);
+    int fds[2] = {-1, -1};
+    if(null < 0 || (output != NULL && pipe(fds) != 0)) {
+        if(null >= 0)
+            close(null);
+        return -1;
+    }
+    if(fds[0] >= 0) {
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    }
+    pid_t pid = fork();
+    if(pid == 0) {
+        dup2(null, STDIN_FILENO);
+        dup2((fds[1] >= 0) ? fds[1] : null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execvp(argv[0], (char *const *) argv);
+        _exit(127);
+    }
+    close(null);
+    if(fds[1] >= 0)
+        close(fds[1]);
+    if(pid < 0) {
+        if(fds[0] >= 0)
+            close(fds[0]);
+        return -1;
+    }
+    
+    // Reads the output to its end so that the program never blocks on it
+    if(fds[0] >= 0) {
+        char buf[256];
+        ssize_t n;
+        while((n = read(fds[0], buf, sizeof(buf))) != 0) {
+            if(n < 0) {
+                if(errno == EINTR)
+                    continue;
+                break;
+            }
+            size_t keep = (len + n < size) ? (size_t) n : size - 1 - len;
+            memcpy(output + len, buf, keep);
+            len += keep;
+        }
+        output[len] = '\0';
+        close(fds[0]);
+    }
+    int status;
+    while(waitpid(pid, &status, 0) < 0) {
+        if(errno != EINTR)
+            return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    #endif
+}
+
+
+// Asks ffmpeg for the encoders of JPEG and WebP, which it prints nothing
+// about when they are missing
+static void find_encoders() {
+    static const char *const encoders[THUMBNAIL_FORMATS] = {
+        NULL, "encoder=mjpeg", "encoder=libwebp"
+    };
+    for(int i=1; i<THUMBNAIL_FORMATS; i++) {
+        const char *argv[] = {
+            "ffmpeg", "-hide_banner", "-h", encoders[i], NULL
+        };
+        char output[64];
+        run_program(argv, output, sizeof(output));
+        thumbnailEncoders[i] = (strncmp(output, "Encoder ", 8) == 0);
+    }
+}
+
+
+// Renders the thumbnail with the ffmpeg programs when the libraries are
+// not linked, passing the paths as arguments so that no shell parses them
+static int write_thumbnail(const char *file,
+                           const struct RemoteThumbnailVariant *variant,
+                           const char *temp)
+{
+    const char *probe[] = {
+        "ffprobe", "-v", "quiet", "-show_entries", "format=duration",
+        "-of", "csv=p=0", "-i", file, NULL
+    };
+    char output[32];
+    if(run_program(probe, output, sizeof(output)) != 0 || output[0] == '\0')
+        return 1;
+    double duration = atof(output);
+    
+    // The quality maps onto the scale of 31 to 2 of mjpeg
+    char seek[32], filter[64], quality[16];
+    snprintf(seek, 32, "%lf", duration / 2);
+    snprintf(filter, 64, "select=eq(pict_type\\,I),scale=%d:%d",
+             variant->width, variant->height);
+    const char *argv[20] = {
+        "ffmpeg", "-y", "-ss", seek, "-i", file, "-vf", filter,
+        "-vframes", "1", "-f", "image2", "-c:v"
+    };
+    int n = 13;
+    if(variant->format == THUMBNAIL_JPEG) {
+        snprintf(quality, 16, "%d", 31 - (variant->quality - 1) * 29 / 99);
+        argv[n++] = "mjpeg";
+        argv[n++] = "-q:v";
+        argv[n++] = quality;
+    }
+    else if(variant->format == THUMBNAIL_WEBP) {
+        snprintf(quality, 16, "%d", variant->quality);
+        argv[n++] = "libwebp";
+        argv[n++] = "-quality";
+        argv[n++] = quality;
+    }
+    else
+        argv[n++] = "png";
+    argv[n++] = temp;
+    argv[n] = NULL;
+    return (run_program(argv, NULL, 0) != 0);
+}
+#endif
+
+
+// Renders a frame from the middle of a video into a file, replacing it only
+// once complete, returns 1 on failure
+static int render_thumbnail(const char *file,
+                            const struct RemoteThumbnailVariant *variant,
+                            const char *path)
+{
+    // Every rendering gets its own file as they may run on several threads
+    char temp[PATH_MAX];
+    #ifdef _WIN32
+    if(GetTempFileNameA(thumbnailDirectory, "tmp", 0, temp) == 0)
+        return 1;
+    #else
+    snprintf(temp, PATH_MAX, "%s.tmp-XXXXXX", path);
+    int fd = mkstemp(temp);
+    if(fd < 0)
+        return 1;
+    close(fd);
+    #endif
+    int failed = write_thumbnail(file, variant, temp);
+    
+    // ffmpeg leaves the file empty when the video cannot be decoded
+    struct stat st;
+    if(!failed)
+        failed = (stat(temp, &st) != 0 || st.st_size == 0);
+    #ifdef _WIN32
+    if(!failed)
+        failed = !MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING);
+    #else
+    if(!failed)
+        failed = (rename(temp, path) != 0);
+    #endif
+    if(failed)
+        remove(temp);
+    return failed;
+}
+
+
+// Whether a thumbnail is being rendered, has to be called with the lock
+// held
+static int is_rendering(uint64_t key) {
+    for(const struct RemoteThumbnailRender *r=thumbnailRenders; r!=NULL;
+        r=r->next)
+    {
+        if(r->key == key)
+            return 1;
+    }
+    return 0;
+}
+
+
+// Opens a thumbnail kept, returns -1 if it is not there
+static int open_thumbnail(const char *path, uint64_t *size) {
+    int fd = open(path, O_RDONLY | O_BINARY);
+    if(fd < 0)
+        return -1;
+    #ifdef _WIN32
+    struct __stat64 st;
+    int res = _fstat64(fd, &st);
+    #else
+    struct stat st;
+    int res = fstat(fd, &st);
+    #endif
+    if(res != 0 || st.st_size == 0) {
+        close(fd);
+        return -1;
+    }
+    *size = (uint64_t) st.st_size;
+    return fd;
+}
+
+
+// Forgets a thumbnail kept whose file is gone
+static void forget_thumbnail(uint64_t key) {
+    remote_mutex_lock(&thumbnailLock);
+    struct RemoteThumbnail *thumbnail = *find_thumbnail(key);
+    if(thumbnail != NULL)
+        drop_thumbnail(thumbnail, 0);
+    remote_mutex_unlock(&thumbnailLock);
+}
+
+
+// Reads a whole thumbnail opened, returns 1 if it is cut short
+static int read_thumbnail(int fd, char *data, uint64_t size) {
+    uint64_t done = 0;
+    while(done < size) {
+        size_t chunk = (size - done > (1 << 20)) ? (1 << 20)
+                                                 : (size_t) (size - done);
+        int n = (int) read(fd, data + done, chunk);
+        if(n <= 0)
+            return 1;
+        done += (uint64_t) n;
+    }
+    return 0;
+}
+
+
+
+// Opens the thumbnail of a video, rendering it in one of the slots if it is
+// not kept, ahead for the queue
+static int open_rendered(const char *file,
+                         const struct RemoteThumbnailVariant *variant,
+                         const char *etag, uint64_t *size, int ahead)
+{
+    uint64_t key;
+    if(etag[0] != '"' || parse_key(etag + 1, &key) != 0)
+        return -1;
+    char path[PATH_MAX];
+    thumbnail_path(key, path);
+    
+    // Only one thread renders a thumbnail while the others wait for it
+    struct RemoteThumbnailRender render = {key, NULL};
+    while(1) {
+        remote_mutex_lock(&thumbnailLock);
+        while(is_rendering(key))
+            remote_cond_wait(&thumbnailRendered, &thumbnailLock);
+        struct RemoteThumbnail *thumbnail = *find_thumbnail(key);
+        if(thumbnail == NULL) {
+            render.next = thumbnailRenders;
+            thumbnailRenders = &render;
+            
+            // The renders share a few slots so that playback keeps its
+            // cores, the requests going before the videos rendered ahead
+            if(!ahead)
+                renderWaiting++;
+            while(renderCount >= THUMBNAIL_RENDERS ||
+                  (ahead && renderWaiting > 0))
+                remote_cond_wait(&renderFree, &thumbnailLock);
+            if(!ahead)
+                renderWaiting--;
+            renderCount++;
+            remote_mutex_unlock(&thumbnailLock);
+            break;
+        }
+        keep_thumbnail(key, thumbnail->size, (int64_t) time(NULL));
+        remote_mutex_unlock(&thumbnailLock);
+        
+        // A thumbnail kept is served as it is unless its file is gone
+        int fd = open_thumbnail(path, size);
+        if(fd >= 0)
+            return fd;
+        forget_thumbnail(key);
+    }
+    
+    // The file is opened before the budget may evict it
+    int fd = -1;
+    if(render_thumbnail(file, variant, path) == 0)
+        fd = open_thumbnail(path, size);
+    remote_mutex_lock(&thumbnailLock);
+    if(fd >= 0) {
+        keep_thumbnail(key, *size, (int64_t) time(NULL));
+        trim_thumbnails();
+    }
+    struct RemoteThumbnailRender **r = &thumbnailRenders;
+    while(*r != &render)
+        r = &(*r)->next;
+    *r = render.next;
+    renderCount--;
+    remote_cond_broadcast(&renderFree);
+    remote_cond_broadcast(&thumbnailRendered);
+    remote_mutex_unlock(&thumbnailLock);
+    return fd;
+}
+
+
+
+// Whether a video queued is in a directory
+static int is_job_of(const struct RemoteThumbnailJob *job,
+                     const char *directory)
+{
+    return strlen(directory) == job->dir_length &&
+           strncmp(directory, job->path, job->dir_length) == 0;
+}
+
+
+// Drops the videos queued of the directories no longer browsed, has to be
+// called with the lock held
+static void cancel_jobs() {
+    struct RemoteThumbnailJob **j = &queueHead;
+    while(*j != NULL) {
+        struct RemoteThumbnailJob *job = *j;
+        int kept = 0;
+        for(int i=0; i<THUMBNAIL_QUEUE_DIRS && queueDirs[i]!=NULL; i++)
+            kept |= is_job_of(job, queueDirs[i]);
+        if(kept)
+            j = &job->next;
+        else {
+            *j = job->next;
+            free(job);
+        }
+    }
+}
+
+
+// Whether a video queued is one of a batch
+static int is_job_for(const struct RemoteThumbnailJob *job,
+                      const struct RemoteThumbnailBatch *batch,
+                      const char *name)
+{
+    return is_job_of(job, batch->directory) &&
+           strcmp(job->path + job->dir_length + 1, name) == 0 &&
+           memcmp(&job->variant, &batch->variant, sizeof(job->variant)) == 0;
+}
+
+
+// Whether the thumbnail of a video of a batch is still to be rendered
+// ahead, has to be called with the lock held
+static int is_pending(const struct RemoteThumbnailBatch *batch,
+                      const struct RemoteThumbnailPiece *piece)
+{
+    if(!queueRunning || queueStopping || *find_thumbnail(piece->key) != NULL)
+        return 0;
+    if(is_rendering(piece->key))
+        return 1;
+    const char *name = batch->names + piece->name;
+    if(queueJob != NULL && is_job_for(queueJob, batch, name))
+        return 1;
+    for(const struct RemoteThumbnailJob *job=queueHead; job!=NULL;
+        job=job->next)
+    {
+        if(is_job_for(job, batch, name))
+            return 1;
+    }
+    return 0;
+}
+
+
+// Writes the map of the thumbnails of a batch which tags the sprite too
+static int write_map(struct RemoteThumbnailBatch *batch, char *etag) {
+    struct RemoteJsonWriter writer;
+    remote_http_json_init(&writer, THUMBNAIL_MAP_SIZE);
+    remote_http_json_begin_object(&writer);
+    remote_http_json_member(&writer, "type",
+                            thumbnailTypes[batch->variant.format]);
+    remote_http_json_key(&writer, "thumbnails");
+    remote_http_json_begin_array(&writer);
+    uint64_t offset = 0;
+    for(size_t i=0; i<batch->piece_count; i++) {
+        const struct RemoteThumbnailPiece *piece = &batch->pieces[i];
+        char tag[ETAG_SIZE];
+        snprintf(tag, ETAG_SIZE, "\"%016llx\"",
+                 (unsigned long long) piece->key);
+        remote_http_json_begin_object(&writer);
+        remote_http_json_member(&writer, "name", batch->names + piece->name);
+        remote_http_json_key(&writer, "offset");
+        remote_http_json_int(&writer, (int64_t) offset);
+        remote_http_json_key(&writer, "length");
+        remote_http_json_int(&writer, (int64_t) piece->size);
+        remote_http_json_member(&writer, "etag", tag);
+        remote_http_json_end_object(&writer);
+        offset += piece->size;
+    }
+    remote_http_json_end_array(&writer);
+    remote_http_json_end_object(&writer);
+    
+    // The map names every thumbnail by its tag
+    free(batch->map);
+    batch->map = remote_http_json_finish(&writer, &batch->map_length);
+    if(batch->map == NULL)
+        return 1;
+    remote_http_etag(batch->map, batch->map_length, etag);
+    return 0;
+}
+
+
+// Renders the thumbnails queued one at a time
+static void *render_queue(void *arg) {
+    (void) arg;
+    
+    // Rendering ahead yields to the playback and the requests
+    #ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+    #else
+    setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), 19);
+    #endif
+    
+    remote_mutex_lock(&thumbnailLock);
+    while(1) {
+        while(queueHead == NULL && !queueStopping)
+            remote_cond_wait(&queueWake, &thumbnailLock);
+        if(queueStopping)
+            break;
+        struct RemoteThumbnailJob *job = queueHead;
+        queueHead = job->next;
+        queueJob = job;
+        remote_mutex_unlock(&thumbnailLock);
+        
+        char etag[ETAG_SIZE];
+        uint64_t size;
+        if(remote_http_thumbnail_tag(job->path, &job->variant, etag) == 0) {
+            int fd = open_rendered(job->path, &job->variant, etag, &size,
+                                   1);
+            if(fd >= 0)
+                close(fd);
+        }
+        
+        // The sprites waiting for the video learn it is done either way
+        remote_mutex_lock(&thumbnailLock);
+        queueJob = NULL;
+        remote_cond_broadcast(&thumbnailRendered);
+        free(job);
+    }
+    remote_mutex_unlock(&thumbnailLock);
+    return NULL;
+}
+
+
+
+
+/**
+ * @brief Finds the thumbnails kept and starts rendering the ones queued
+ * 
+ * Has to be called before the server threads start.
+ */
+void remote_http_thumbnail_start() {
+    if(!thumbnailInitialized) {
+        remote_mutex_init(&thumbnailLock);
+        remote_cond_init(&thumbnailRendered);
+        remote_cond_init(&renderFree);
+        remote_cond_init(&queueWake);
+        thumbnailInitialized = 1;
+    }
+    find_directory();
+    find_encoders();
+    remote_mutex_lock(&thumbnailLock);
+    find_thumbnails();
+    remote_mutex_unlock(&thumbnailLock);
+    
+    if(queueRunning)
+        return;
+    queueStopping = 0;
+    queueRunning = (remote_thread_create(&queueThread, render_queue,
+                                         NULL) == 0);
+}
+
+/**
+ * @brief Stops rendering ahead and forgets the thumbnails kept, which stay
+ *        on disk
+ * 
+ * Has to be called once no worker runs.
+ */
+void remote_http_thumbnail_stop() {
+    if(!thumbnailInitialized)
+        return;
+    
+    // Waits for the thumbnail being rendered ahead
+    if(queueRunning) {
+        remote_mutex_lock(&thumbnailLock);
+        queueStopping = 1;
+        remote_cond_broadcast(&queueWake);
+        remote_mutex_unlock(&thumbnailLock);
+        remote_thread_join(queueThread);
+        queueRunning = 0;
+    }
+    
+    remote_mutex_lock(&thumbnailLock);
+    while(queueHead != NULL) {
+        struct RemoteThumbnailJob *job = queueHead;
+        queueHead = job->next;
+        free(job);
+    }
+    for(int i=0; i<THUMBNAIL_QUEUE_DIRS; i++) {
+        free(queueDirs[i]);
+        queueDirs[i] = NULL;
+    }
+    while(thumbnailHead != NULL)
+        drop_thumbnail(thumbnailHead, 0);
+    remote_mutex_unlock(&thumbnailLock);
+}
+
+/**
+ * @brief Parses the parameters of a thumbnail into a variant
+ * 
+ * The width is rounded up to THUMBNAIL_WIDTH_STEP and the quality to
+ * THUMBNAIL_QUALITY_STEP. PNG is picked instead of a format which cannot
+ * be encoded.
+ * 
+ * @param variant Receives the variant
+ * @param width The width parameter or NULL
+ * @param format The format parameter, png, jpeg or webp, or NULL
+ * @param quality The quality parameter or NULL
+ */
+void remote_http_thumbnail_variant(struct RemoteThumbnailVariant *variant,
+                                   const char *width, const char *format,
+                                   const char *quality)
+{
+    int w = (width != NULL) ? atoi(width) : THUMBNAIL_WIDTH;
+    w = (w + THUMBNAIL_WIDTH_STEP - 1) / THUMBNAIL_WIDTH_STEP;
+    w *= THUMBNAIL_WIDTH_STEP;
+    if(w < THUMBNAIL_WIDTH_STEP)
+        w = THUMBNAIL_WIDTH_STEP;
+    else if(w > THUMBNAIL_WIDTH)
+        w = THUMBNAIL_WIDTH;
+    variant->width = w;
+    variant->height = w * THUMBNAIL_HEIGHT / THUMBNAIL_WIDTH;
+    
+    variant->format = THUMBNAIL_PNG;
+    if(format != NULL && (strcmp(format, "jpeg") == 0 ||
+                          strcmp(format, "jpg") == 0))
+        variant->format = THUMBNAIL_JPEG;
+    else if(format != NULL && strcmp(format, "webp") == 0)
+        variant->format = THUMBNAIL_WEBP;
+    if(!thumbnailEncoders[variant->format])
+        variant->format = THUMBNAIL_PNG;
+    
+    int q = (quality != NULL) ? atoi(quality) : THUMBNAIL_QUALITY;
+    q = (q + THUMBNAIL_QUALITY_STEP - 1) / THUMBNAIL_QUALITY_STEP;
+    q *= THUMBNAIL_QUALITY_STEP;
+    if(q < THUMBNAIL_QUALITY_STEP)
+        q = THUMBNAIL_QUALITY_STEP;
+    else if(q > 100)
+        q = 100;
+    variant->quality = (variant->format != THUMBNAIL_PNG) ? q : 0;
+}
+
+/**
+ * @brief Tells the content type of a format
+ * 
+ * @param format One of the THUMBNAIL_* formats
+ * 
+ * @return The content type
+ */
+const char *remote_http_thumbnail_type(int format) {
+    return thumbnailTypes[format];
+}
+
+/**
+ * @brief Computes the entity tag of a variant of the thumbnail of a video
+ * 
+ * The tag is the hash of the path, the size and the modification time of
+ * the video and of the variant, whose low bits are the format.
+ * 
+ * @param file The video
+ * @param variant The variant
+ * @param etag Receives the tag, at least ETAG_SIZE bytes
+ * 
+ * @return 0 on success or 1 if the video cannot be found
+ */
+int remote_http_thumbnail_tag(const char *file,
+                              const struct RemoteThumbnailVariant *variant,
+                              char *etag)
+{
+    #ifdef _WIN32
+    struct __stat64 st;
+    if(_stat64(file, &st) != 0 || !(st.st_mode & _S_IFREG))
+        return 1;
+    #else
+    struct stat st;
+    if(stat(file, &st) != 0 || !S_ISREG(st.st_mode))
+        return 1;
+    #endif
+    
+    char key[PATH_MAX + 96];
+    int len = snprintf(key, PATH_MAX + 96, "%s\n%llu\n%lld\n%dx%d\n%d\n%d",
+                       file, (unsigned long long) st.st_size,
+                       (long long) st.st_mtime, variant->width,
+                       variant->height, variant->format, variant->quality);
+    if(len < 0 || len >= PATH_MAX + 96)
+        return 1;
+    remote_http_etag(key, (size_t) len, etag);
+    
+    uint64_t hash;
+    parse_key(etag + 1, &hash);
+    hash = (hash & ~(uint64_t) THUMBNAIL_FORMAT_MASK) |
+           (uint64_t) variant->format;
+    snprintf(etag, ETAG_SIZE, "\"%016llx\"", (unsigned long long) hash);
+    return 0;
+}
+
+/**
+ * @brief Opens the thumbnail of a video, rendering it if it is not kept
+ * 
+ * @param file The video
+ * @param variant The variant
+ * @param etag The entity tag of the variant
+ * @param size Receives the number of bytes of the thumbnail
+ * 
+ * @return The file descriptor of the thumbnail to close or -1 if the
+ *         video has no thumbnail
+ */
+int remote_http_thumbnail_open(const char *file,
+                               const struct RemoteThumbnailVariant *variant,
+                               const char *etag, uint64_t *size)
+{
+    return open_rendered(file, variant, etag, size, 0);
+}
+
+/**
+ * @brief Starts gathering the videos of a page
+ * 
+ * @param directory The directory browsed
+ * @param variant The variant of the thumbnails
+ * 
+ * @return The batch to queue or NULL if out of memory
+ */
+struct RemoteThumbnailBatch *remote_http_thumbnail_batch(
+    const char *directory,
+    const struct RemoteThumbnailVariant *variant
+)
+{
+    struct RemoteThumbnailBatch *batch;
+    batch = calloc(1, sizeof(struct RemoteThumbnailBatch));
+    if(batch == NULL)
+        return NULL;
+    batch->directory = strdup(directory);
+    if(batch->directory == NULL) {
+        free(batch);
+        return NULL;
+    }
+    batch->variant = *variant;
+    return batch;
+}
+
+/**
+ * @brief Adds a video to a batch, as a visitor of the listings
+ * 
+ * @param batch The batch, may be NULL
+ * @param name The name of the video in the directory
+ */
+void remote_http_thumbnail_add(void *batch, const char *name) {
+    struct RemoteThumbnailBatch *b = batch;
+    if(b == NULL)
+        return;
+    size_t len = strlen(name) + 1;
+    if(b->length + len > b->capacity) {
+        size_t n = (b->capacity > 0) ? b->capacity * 2 : 4096;
+        while(b->length + len > n)
+            n *= 2;
+        char *names = realloc(b->names, n);
+        if(names == NULL)
+            return;
+        b->names = names;
+        b->capacity = n;
+    }
+    memcpy(b->names + b->length, name, len);
+    b->length += len;
+}
+
+/**
+ * @brief Queues the videos of a batch ahead of the other directories
+ * 
+ * The videos go after the ones of the same directory queued before. The
+ * videos of the directories browsed before the last THUMBNAIL_QUEUE_DIRS
+ * ones are dropped from the queue.
+ * 
+ * @param batch The batch which is freed, may be NULL
+ */
+void remote_http_thumbnail_queue(struct RemoteThumbnailBatch *batch) {
+    if(batch == NULL)
+        return;
+    
+    // Prepares the jobs in the order listed outside the lock
+    size_t dir_length = strlen(batch->directory);
+    struct RemoteThumbnailJob *first = NULL, **last = &first;
+    size_t count = 0;
+    for(size_t i=0; i<batch->length && count<THUMBNAIL_QUEUE_MAX;) {
+        const char *name = batch->names + i;
+        size_t len = strlen(name);
+        i += len + 1;
+        struct RemoteThumbnailJob *job;
+        job = malloc(sizeof(struct RemoteThumbnailJob) + dir_length + len +
+                     2);
+        if(job == NULL)
+            break;
+        job->variant = batch->variant;
+        memcpy(job->path, batch->directory, dir_length);
+        job->path[dir_length] = '/';
+        memcpy(job->path + dir_length + 1, name, len + 1);
+        job->dir_length = dir_length;
+        job->next = NULL;
+        *last = job;
+        last = &job->next;
+        count++;
+    }
+    
+    remote_mutex_lock(&thumbnailLock);
+    int running = queueRunning && !queueStopping;
+    if(running) {
+        // The directory becomes the last one browsed
+        int i = 0;
+        while(i < THUMBNAIL_QUEUE_DIRS - 1 && queueDirs[i] != NULL &&
+              strcmp(queueDirs[i], batch->directory) != 0)
+            i++;
+        char *directory = queueDirs[i];
+        if(directory == NULL || strcmp(directory, batch->directory) != 0) {
+            free(directory);
+            directory = batch->directory;
+            batch->directory = NULL;
+        }
+        memmove(queueDirs + 1, queueDirs, i * sizeof(char*));
+        queueDirs[0] = directory;
+        cancel_jobs();
+        
+        // The videos of the directory queued before stay first, followed
+        // by those of the page not queued yet and the other directories
+        struct RemoteThumbnailJob *earlier = NULL, **tail = &earlier;
+        struct RemoteThumbnailJob **j = &queueHead;
+        while(*j != NULL) {
+            struct RemoteThumbnailJob *job = *j;
+            if(is_job_of(job, directory)) {
+                *j = job->next;
+                *tail = job;
+                tail = &job->next;
+            }
+            else
+                j = &job->next;
+        }
+        *tail = NULL;
+        j = &first;
+        while(*j != NULL) {
+            struct RemoteThumbnailJob *job = *j;
+            const struct RemoteThumbnailJob *e = earlier;
+            while(e != NULL && (strcmp(e->path, job->path) != 0 ||
+                                memcmp(&e->variant, &job->variant,
+                                       sizeof(job->variant)) != 0))
+                e = e->next;
+            if(e != NULL) {
+                *j = job->next;
+                free(job);
+            }
+            else
+                j = &job->next;
+        }
+        *j = queueHead;
+        *tail = first;
+        queueHead = earlier;
+        
+        // Keeps the queue within its limit from its end
+        j = &queueHead;
+        for(size_t n=0; *j!=NULL && n<THUMBNAIL_QUEUE_MAX; n++)
+            j = &(*j)->next;
+        while(*j != NULL) {
+            struct RemoteThumbnailJob *job = *j;
+            *j = job->next;
+            free(job);
+        }
+        remote_cond_signal(&queueWake);
+    }
+    remote_mutex_unlock(&thumbnailLock);
+    
+    while(!running && first != NULL) {
+        struct RemoteThumbnailJob *job = first;
+        first = job->next;
+        free(job);
+    }
+    free(batch->directory);
+    free(batch->names);
+    free(batch->pieces);
+    free(batch->map);
+    free(batch);
+}
+
+/**
+ * @brief Maps the thumbnails kept of the videos of a batch for a sprite
+ * 
+ * The map tells the content type of the thumbnails and lists the name, the
+ * offset from the first byte after the map, the length and the entity tag
+ * of each thumbnail. The videos of the batch still queued or rendering are
+ * waited for up to a time, so that a page browsed for the first time gets
+ * its thumbnails in the sprite too. The thumbnails are not read, so that
+ * a revalidation is answered by the entity tag alone.
+ * 
+ * @param batch The batch
+ * @param ms The most milliseconds to wait for the renders
+ * @param etag Receives the entity tag of the sprite, at least ETAG_SIZE
+ *             bytes
+ * 
+ * @return 0 on success or 1 if out of memory
+ */
+int remote_http_thumbnail_map(struct RemoteThumbnailBatch *batch, long ms,
+                              char *etag)
+{
+    free(batch->pieces);
+    batch->piece_count = 0;
+    batch->pieces = malloc(THUMBNAIL_SPRITE_MAX *
+                           sizeof(struct RemoteThumbnailPiece));
+    if(batch->pieces == NULL)
+        return 1;
+    
+    // The tags are computed outside the lock since they look up the videos
+    size_t count = 0;
+    for(size_t i=0; i<batch->length && count<THUMBNAIL_SPRITE_MAX;) {
+        const char *name = batch->names + i;
+        size_t offset = i;
+        i += strlen(name) + 1;
+        char file[PATH_MAX];
+        int ret = snprintf(file, PATH_MAX, "%s/%s", batch->directory, name);
+        if(ret < 0 || ret >= PATH_MAX)
+            continue;
+        char tag[ETAG_SIZE];
+        uint64_t key;
+        if(remote_http_thumbnail_tag(file, &batch->variant, tag) != 0 ||
+           parse_key(tag + 1, &key) != 0)
+            continue;
+        batch->pieces[count].name = offset;
+        batch->pieces[count].key = key;
+        batch->pieces[count].size = 0;
+        count++;
+    }
+    
+    double deadline = remote_status_clock() + ms / 1000.0;
+    remote_mutex_lock(&thumbnailLock);
+    while(1) {
+        int pending = 0;
+        for(size_t i=0; i<count && !pending; i++)
+            pending = is_pending(batch, &batch->pieces[i]);
+        double left = deadline - remote_status_clock();
+        if(!pending || left <= 0)
+            break;
+        remote_cond_timedwait(&thumbnailRendered, &thumbnailLock,
+                              (long) (left * 1000) + 1);
+    }
+    
+    // Only the thumbnails kept are mapped, as recently used
+    int64_t now = (int64_t) time(NULL);
+    for(size_t i=0; i<count; i++) {
+        struct RemoteThumbnailPiece piece = batch->pieces[i];
+        const struct RemoteThumbnail *thumbnail = *find_thumbnail(piece.key);
+        if(thumbnail == NULL)
+            continue;
+        piece.size = thumbnail->size;
+        keep_thumbnail(piece.key, piece.size, now);
+        batch->pieces[batch->piece_count++] = piece;
+    }
+    remote_mutex_unlock(&thumbnailLock);
+    return write_map(batch, etag);
+}
+
+/**
+ * @brief Packs the thumbnails mapped of a batch into a sprite
+ * 
+ * The sprite starts with the map, then a line feed and the thumbnails one
+ * after another. The thumbnails gone since they were mapped are left out
+ * of the map, which changes the entity tag.
+ * 
+ * @param batch The batch mapped by remote_http_thumbnail_map()
+ * @param etag The entity tag of the sprite, updated if the map changes
+ * @param len Receives the number of bytes of the sprite
+ * 
+ * @return The sprite to free or NULL if out of memory
+ */
+char *remote_http_thumbnail_sprite(struct RemoteThumbnailBatch *batch,
+                                   char *etag, size_t *len)
+{
+    if(batch->map == NULL)
+        return NULL;
+    uint64_t length = 0;
+    for(size_t i=0; i<batch->piece_count; i++)
+        length += batch->pieces[i].size;
+    size_t map_length = batch->map_length;
+    if(length > SIZE_MAX - map_length - 1)
+        return NULL;
+    char *sprite = malloc(map_length + 1 + (size_t) length);
+    if(sprite == NULL)
+        return NULL;
+    
+    // The thumbnails are read after the room of the map
+    char *images = sprite + map_length + 1;
+    size_t offset = 0, kept = 0;
+    for(size_t i=0; i<batch->piece_count; i++) {
+        const struct RemoteThumbnailPiece *piece = &batch->pieces[i];
+        char path[PATH_MAX];
+        thumbnail_path(piece->key, path);
+        uint64_t size;
+        int fd = open_thumbnail(path, &size);
+        if(fd < 0) {
+            forget_thumbnail(piece->key);
+            continue;
+        }
+        int cut = size != piece->size ||
+                  read_thumbnail(fd, images + offset, size);
+        close(fd);
+        if(cut)
+            continue;
+        batch->pieces[kept++] = *piece;
+        offset += (size_t) size;
+    }
+    
+    // The thumbnails gone are left out of a map written again, which is
+    // shorter so the ones read move ahead
+    if(kept < batch->piece_count) {
+        batch->piece_count = kept;
+        if(write_map(batch, etag) != 0) {
+            free(sprite);
+            return NULL;
+        }
+        memmove(sprite + batch->map_length + 1, images, offset);
+    }
+    memcpy(sprite, batch->map, batch->map_length);
+    sprite[batch->map_length] = '\n';
+    *len = batch->map_length + 1 + offset;
+    return sprite;
+}
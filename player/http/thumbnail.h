@@ -0,0 +1,219 @@
+/**
+ * @file thumbnail.h
+ * @brief Thumbnails of the videos served by GET /thumbnail
+ * 
+ * A thumbnail is rendered once and kept on disk under a name derived from
+ * the path, the size and the modification time of its video, so that it
+ * is found again across restarts and rendered again once the video
+ * changes. The same key is the entity tag of the thumbnail. The
+ * thumbnails kept take at most a disk budget, evicting the least recently
+ * used ones.
+ * 
+ * A thumbnail may be asked for in a smaller size and in JPEG or WebP, each
+ * variant being kept under its own key. The sizes and qualities are
+ * rounded to a few steps so that the variants of a video stay few. PNG is
+ * rendered instead of a format whose encoder is missing.
+ * 
+ * The videos of the pages browsed are queued to render their thumbnails
+ * ahead on a single thread of low priority, in the order listed and the
+ * directory browsed last first, so that playback is not slowed down. The
+ * videos of the directories no longer browsed are dropped from the queue.
+ * The thumbnails requested and the videos queued share a few render slots.
+ * 
+ * The thumbnails kept of a page can be packed into a single sprite with a
+ * map of their offsets, so that a page costs one request instead of one
+ * per video.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_THUMBNAIL_H__
+#define __MPV_REMOTE_HTTP_THUMBNAIL_H__ ///< Header guard
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define THUMBNAIL_BUDGET (64 << 20) ///< Disk space the thumbnails may take
+#define THUMBNAIL_BUCKETS 4096 ///< Buckets of the thumbnails kept
+#define THUMBNAIL_QUEUE_MAX 1024 ///< Most videos queued to render ahead
+#define THUMBNAIL_QUEUE_DIRS 2 ///< Directories whose videos stay queued
+#define THUMBNAIL_RENDERS 2 ///< Most thumbnails rendered at once
+#define THUMBNAIL_SPRITE_MAX 256 ///< Most thumbnails packed in a sprite
+#define THUMBNAIL_SPRITE_WAIT 3000 ///< Milliseconds a sprite waits to render
+#define THUMBNAIL_WIDTH 320 ///< Width of the largest thumbnails in pixels
+#define THUMBNAIL_HEIGHT 180 ///< Height of the largest thumbnails in pixels
+#define THUMBNAIL_WIDTH_STEP 64 ///< The widths are multiples of it
+#define THUMBNAIL_QUALITY 80 ///< Quality of JPEG and WebP by default
+#define THUMBNAIL_QUALITY_STEP 10 ///< The qualities are multiples of it
+
+#define THUMBNAIL_PNG 0 ///< Lossless PNG, always available
+#define THUMBNAIL_JPEG 1 ///< JPEG at a quality
+#define THUMBNAIL_WEBP 2 ///< WebP at a quality
+#define THUMBNAIL_FORMATS 3 ///< Number of formats
+
+
+/**
+ * @brief Size and format of a thumbnail
+ */
+struct RemoteThumbnailVariant {
+    int width; ///< Width in pixels
+    int height; ///< Height in pixels, keeping the ratio of 16:9
+    int format; ///< One of the THUMBNAIL_* formats
+    int quality; ///< Quality from 1 to 100 of JPEG and WebP, 0 for PNG
+};
+
+/**
+ * @brief Videos of a page to render the thumbnails of ahead
+ */
+struct RemoteThumbnailBatch;
+
+
+/**
+ * @brief Finds the thumbnails kept and starts rendering the ones queued
+ * 
+ * Has to be called before the server threads start.
+ */
+void remote_http_thumbnail_start();
+
+/**
+ * @brief Stops rendering ahead and forgets the thumbnails kept, which stay
+ *        on disk
+ * 
+ * Has to be called once no worker runs.
+ */
+void remote_http_thumbnail_stop();
+
+/**
+ * @brief Parses the parameters of a thumbnail into a variant
+ * 
+ * Without any parameter the variant is the largest PNG.
+ * 
+ * @param variant Receives the variant
+ * @param width The width parameter or NULL
+ * @param format The format parameter, png, jpeg or webp, or NULL
+ * @param quality The quality parameter or NULL
+ */
+void remote_http_thumbnail_variant(struct RemoteThumbnailVariant *variant,
+                                   const char *width, const char *format,
+                                   const char *quality);
+
+/**
+ * @brief Tells the content type of a format
+ * 
+ * @param format One of the THUMBNAIL_* formats
+ * 
+ * @return The content type
+ */
+const char *remote_http_thumbnail_type(int format);
+
+/**
+ * @brief Computes the entity tag of a variant of the thumbnail of a video
+ * 
+ * @param file The video
+ * @param variant The variant
+ * @param etag Receives the tag, at least ETAG_SIZE bytes
+ * 
+ * @return 0 on success or 1 if the video cannot be found
+ */
+int remote_http_thumbnail_tag(const char *file,
+                              const struct RemoteThumbnailVariant *variant,
+                              char *etag);
+
+/**
+ * @brief Opens the thumbnail of a video, rendering it if it is not kept
+ * 
+ * At most THUMBNAIL_RENDERS thumbnails are rendered at once, the thumbnails
+ * requested going before the videos queued to render ahead.
+ * 
+ * @param file The video
+ * @param variant The variant
+ * @param etag The entity tag of the variant
+ * @param size Receives the number of bytes of the thumbnail
+ * 
+ * @return The file descriptor of the thumbnail to close or -1 if the
+ *         video has no thumbnail
+ */
+int remote_http_thumbnail_open(const char *file,
+                               const struct RemoteThumbnailVariant *variant,
+                               const char *etag, uint64_t *size);
+
+/**
+ * @brief Starts gathering the videos of a page
+ * 
+ * @param directory The directory browsed
+ * @param variant The variant of the thumbnails
+ * 
+ * @return The batch to queue or NULL if out of memory
+ */
+struct RemoteThumbnailBatch *remote_http_thumbnail_batch(
+    const char *directory,
+    const struct RemoteThumbnailVariant *variant
+);
+
+/**
+ * @brief Adds a video to a batch, as a visitor of the listings
+ * 
+ * @param batch The batch, may be NULL
+ * @param name The name of the video in the directory
+ */
+void remote_http_thumbnail_add(void *batch, const char *name);
+
+/**
+ * @brief Queues the videos of a batch ahead of the other directories
+ * 
+ * The videos go after the ones of the same directory queued before. The
+ * videos of the directories browsed before the last THUMBNAIL_QUEUE_DIRS
+ * ones are dropped from the queue.
+ * 
+ * @param batch The batch which is freed, may be NULL
+ */
+void remote_http_thumbnail_queue(struct RemoteThumbnailBatch *batch);
+
+/**
+ * @brief Maps the thumbnails kept of the videos of a batch for a sprite
+ * 
+ * The map tells the content type of the thumbnails and lists the name, the
+ * offset from the first byte after the map, the length and the entity tag
+ * of each thumbnail. The videos of the batch still queued or rendering are
+ * waited for up to a time, so that a page browsed for the first time gets
+ * its thumbnails in the sprite too. The thumbnails are not read, so that
+ * a revalidation is answered by the entity tag alone.
+ * 
+ * @param batch The batch
+ * @param ms The most milliseconds to wait for the renders
+ * @param etag Receives the entity tag of the sprite, at least ETAG_SIZE
+ *             bytes
+ * 
+ * @return 0 on success or 1 if out of memory
+ */
+int remote_http_thumbnail_map(struct RemoteThumbnailBatch *batch, long ms,
+                              char *etag);
+
+/**
+ * @brief Packs the thumbnails mapped of a batch into a sprite
+ * 
+ * The sprite starts with the map, then a line feed and the thumbnails one
+ * after another. The thumbnails gone since they were mapped are left out
+ * of the map, which changes the entity tag.
+ * 
+ * @param batch The batch mapped by remote_http_thumbnail_map()
+ * @param etag The entity tag of the sprite, updated if the map changes
+ * @param len Receives the number of bytes of the sprite
+ * 
+ * @return The sprite to free or NULL if out of memory
+ */
+char *remote_http_thumbnail_sprite(struct RemoteThumbnailBatch *batch,
+                                   char *etag, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,634 @@
+/**
+ * @file websocket.c
+ * @brief Remote control channel over WebSocket
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "websocket.h"
+
+#include "../../libremote/libremote.h"
+#include "../../libremote/thread.h"
+#include "../player.h"
+#include "events.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#define strncasecmp _strnicmp
+#define SHUT_RDWR SD_BOTH
+#define MSG_NOSIGNAL 0
+#else
+#include <strings.h>
+#include <sys/socket.h>
+#endif
+
+#include <json.h>
+
+#define WEBSOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define OPCODE_CONTINUATION 0x0
+#define OPCODE_TEXT 0x1
+#define OPCODE_BINARY 0x2
+#define OPCODE_CLOSE 0x8
+#define OPCODE_PING 0x9
+#define OPCODE_PONG 0xA
+
+
+/**
+ * @brief Control connection of a client
+ */
+struct WebSocketSession {
+    MHD_socket sock; ///< The upgraded socket
+    struct MHD_UpgradeResponseHandle *urh; ///< Handle to close the socket
+    int target; ///< Target ID of the playback context
+    remote_thread_t thread; ///< Thread sending the status
+    remote_thread_t reader; ///< Thread receiving the commands
+    remote_mutex_t sendLock; ///< Keeps the frames of both threads whole
+    volatile int closed; ///< Either side has ended the connection
+    int used; ///< The slot holds a session
+    int started; ///< The client has been handed the upgraded socket
+    double created; ///< Clock reading of the handshake
+    volatile int done; ///< The session has ended and can be joined
+};
+
+
+static struct WebSocketSession sessions[WEBSOCKET_MAX];
+static remote_mutex_t sessionLock;
+static int sessionInitialized = 0;
+
+
+
+
+/**
+ * Computes the SHA-1 digest of the data. Only the handshake needs it so a
+ * plain implementation keeps the program free of a crypto dependency.
+ */
+static void sha1(const unsigned char *data, size_t len, unsigned char *out) {
+    uint32_t h[5] = {
+        0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+    };
+    uint64_t bits = (uint64_t) len * 8;
+    size_t total = ((len + 8) / 64 + 1) * 64;
+    
+    for(size_t offset=0; offset<total; offset+=64) {
+        unsigned char block[64];
+        for(size_t i=0; i<64; i++) {
+            size_t pos = offset + i;
+            if(pos < len)
+                block[i] = data[pos];
+            else if(pos == len)
+                block[i] = 0x80;
+            else if(pos >= total - 8)
+                block[i] = (unsigned char) (bits >> ((total - 1 - pos) * 8));
+            else
+                block[i] = 0;
+        }
+        
+        uint32_t w[80];
+        for(int i=0; i<16; i++) {
+            w[i] = (uint32_t) block[i*4] << 24 |
+                   (uint32_t) block[i*4+1] << 16 |
+                   (uint32_t) block[i*4+2] << 8 |
+                   (uint32_t) block[i*4+3];
+        }
+        for(int i=16; i<80; i++) {
+            uint32_t v = w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16];
+            w[i] = (v << 1) | (v >> 31);
+        }
+        
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for(int i=0; i<80; i++) {
+            uint32_t f, k;
+            if(i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if(i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if(i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = (b << 30) | (b >> 2);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    
+    for(int i=0; i<20; i++)
+        out[i] = (unsigned char) (h[i/4] >> (24 - (i % 4) * 8));
+}
+
+
+static void base64_encode(const unsigned char *data, size_t len, char *out) {
+    static const char table[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t j = 0;
+    for(size_t i=0; i<len; i+=3) {
+        uint32_t v = (uint32_t) data[i] << 16;
+        if(i+1 < len)
+            v |= (uint32_t) data[i+1] << 8;
+        if(i+2 < len)
+            v |= data[i+2];
+        out[j++] = table[(v >> 18) & 63];
+        out[j++] = table[(v >> 12) & 63];
+        out[j++] = (i+1 < len) ? table[(v >> 6) & 63] : '=';
+        out[j++] = (i+2 < len) ? table[v & 63] : '=';
+    }
+    out[j] = '\0';
+}
+
+
+
+
+static int send_all(MHD_socket sock, const char *data, size_t len) {
+    while(len > 0) {
+        int sent = send(sock, data, (int) len, MSG_NOSIGNAL);
+        if(sent <= 0)
+            return 1;
+        data += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+
+static int send_frame(struct WebSocketSession *session, int opcode,
+                      const char *data, size_t len)
+{
+    // Frames from the server are never masked
+    unsigned char head[10];
+    size_t headLen = 2;
+    head[0] = 0x80 | opcode;
+    if(len < 126)
+        head[1] = (unsigned char) len;
+    else if(len <= 0xFFFF) {
+        head[1] = 126;
+        head[2] = (unsigned char) (len >> 8);
+        head[3] = (unsigned char) len;
+        headLen = 4;
+    }
+    else {
+        head[1] = 127;
+        for(int i=0; i<8; i++)
+            head[2+i] = (unsigned char) ((uint64_t) len >> ((7 - i) * 8));
+        headLen = 10;
+    }
+    
+    remote_mutex_lock(&session->sendLock);
+    int ret = send_all(session->sock, (const char*) head, headLen);
+    if(ret == 0 && len > 0)
+        ret = send_all(session->sock, data, len);
+    remote_mutex_unlock(&session->sendLock);
+    if(ret != 0)
+        session->closed = 1;
+    return ret;
+}
+
+
+static void send_close(struct WebSocketSession *session, int code) {
+    char payload[2] = {(char) (code >> 8), (char) code};
+    send_frame(session, OPCODE_CLOSE, payload, 2);
+    session->closed = 1;
+}
+
+
+
+
+// Runs a command of the client and acknowledges it
+static void handle_message(struct WebSocketSession *session,
+                           const char *msg)
+{
+    struct json_object *root = json_tokener_parse(msg);
+    struct json_object *id = NULL;
+    struct json_object *command = NULL;
+    int ok = 0;
+    
+    if(root != NULL && json_object_is_type(root, json_type_object)) {
+        json_object_object_get_ex(root, "id", &id);
+        json_object_object_get_ex(root, "command", &command);
+    }
+    if(command != NULL && json_object_is_type(command, json_type_string)) {
+        const char *line = json_object_get_string(command);
+        if(remote_player_client_command(session->target, line) != 0) {
+            remote_target_select(session->target);
+            remote_command_write("%s", line);
+        }
+        ok = 1;
+    }
+    
+    struct json_object *ack = json_object_new_object();
+    json_object_object_add(ack, "type", json_object_new_string("ack"));
+    json_object_object_add(ack, "id", json_object_get(id));
+    json_object_object_add(ack, "ok", json_object_new_boolean(ok));
+    json_object_object_add(ack, "clock",
+                           json_object_new_double(remote_status_clock()));
+    const char *reply = json_object_to_json_string_ext(
+        ack,
+        JSON_C_TO_STRING_PLAIN
+    );
+    send_frame(session, OPCODE_TEXT, reply, strlen(reply));
+    json_object_put(ack);
+    json_object_put(root);
+}
+
+
+// Receives the frames of the client until either side closes
+static void *read_loop(void *arg) {
+    struct WebSocketSession *session = arg;
+    unsigned char buffer[WEBSOCKET_MESSAGE_MAX + 16];
+    size_t length = 0;
+    char *message = malloc(WEBSOCKET_MESSAGE_MAX + 1);
+    size_t messageLength = 0;
+    int fragmented = 0;
+    
+    while(!session->closed && message != NULL) {
+        // Parses every whole frame already received
+        while(length >= 2) {
+            int fin = buffer[0] & 0x80;
+            int opcode = buffer[0] & 0x0F;
+            int masked = buffer[1] & 0x80;
+            uint64_t payloadLen = buffer[1] & 0x7F;
+            size_t headLen = 2;
+            if(payloadLen == 126) {
+                if(length < 4)
+                    break;
+                payloadLen = (uint64_t) buffer[2] << 8 | buffer[3];
+                headLen = 4;
+            }
+            else if(payloadLen == 127) {
+                if(length < 10)
+                    break;
+                payloadLen = 0;
+                for(int i=0; i<8; i++)
+                    payloadLen = payloadLen << 8 | buffer[2+i];
+                headLen = 10;
+            }
+            if(!masked) {
+                send_close(session, 1002);
+                break;
+            }
+            if(payloadLen > WEBSOCKET_MESSAGE_MAX) {
+                send_close(session, 1009);
+                break;
+            }
+            if(length < headLen + 4 + payloadLen)
+                break;
+            
+            unsigned char *mask = buffer + headLen;
+            unsigned char *payload = mask + 4;
+            for(uint64_t i=0; i<payloadLen; i++)
+                payload[i] ^= mask[i % 4];
+            
+            if(opcode == OPCODE_CLOSE) {
+                send_close(session, 1000);
+                break;
+            }
+            else if(opcode == OPCODE_PING) {
+                send_frame(session, OPCODE_PONG, (const char*) payload,
+                           (size_t) payloadLen);
+            }
+            else if(opcode == OPCODE_TEXT || opcode == OPCODE_BINARY ||
+                    opcode == OPCODE_CONTINUATION)
+            {
+                if(opcode != OPCODE_CONTINUATION)
+                    messageLength = 0;
+                else if(!fragmented) {
+                    send_close(session, 1002);
+                    break;
+                }
+                if(messageLength + payloadLen > WEBSOCKET_MESSAGE_MAX) {
+                    send_close(session, 1009);
+                    break;
+                }
+                memcpy(message + messageLength, payload, payloadLen);
+                messageLength += payloadLen;
+                fragmented = !fin;
+                if(fin) {
+                    message[messageLength] = '\0';
+                    handle_message(session, message);
+                }
+            }
+            
+            size_t frameLen = headLen + 4 + (size_t) payloadLen;
+            memmove(buffer, buffer + frameLen, length - frameLen);
+            length -= frameLen;
+        }
+        if(session->closed)
+            break;
+        
+        int received = recv(session->sock, (char*) buffer + length,
+                            (int) (sizeof(buffer) - length), 0);
+        if(received <= 0)
+            break;
+        length += received;
+    }
+    
+    free(message);
+    session->closed = 1;
+    remote_http_events_wake();
+    return NULL;
+}
+
+
+// Sends the changed members of the status, or all of them at first
+static void send_status(struct WebSocketSession *session,
+                        struct json_object **last, const char *json)
+{
+    struct json_object *status = json_tokener_parse(json);
+    if(status == NULL)
+        return;
+    
+    struct json_object *delta = status;
+    if(*last != NULL) {
+        delta = json_object_new_object();
+        json_object_object_foreach(status, key, value) {
+            struct json_object *old;
+            if(!json_object_object_get_ex(*last, key, &old) ||
+               !json_object_equal(old, value))
+            {
+                json_object_object_add(delta, key, json_object_get(value));
+            }
+        }
+        json_object_object_foreach(*last, oldKey, oldValue) {
+            (void) oldValue;
+            if(!json_object_object_get_ex(status, oldKey, NULL))
+                json_object_object_add(delta, oldKey, NULL);
+        }
+    }
+    
+    if(delta == status || json_object_object_length(delta) > 0) {
+        struct json_object *msg = json_object_new_object();
+        json_object_object_add(msg, "type", json_object_new_string("status"));
+        json_object_object_add(msg, "clock",
+                               json_object_new_double(remote_status_clock()));
+        json_object_object_add(msg, "status", json_object_get(delta));
+        const char *content = json_object_to_json_string_ext(
+            msg,
+            JSON_C_TO_STRING_PLAIN
+        );
+        send_frame(session, OPCODE_TEXT, content, strlen(content));
+        json_object_put(msg);
+    }
+    if(delta != status)
+        json_object_put(delta);
+    json_object_put(*last);
+    *last = status;
+}
+
+
+static void *session_loop(void *arg) {
+    struct WebSocketSession *session = arg;
+    int reading = (remote_thread_create(&session->reader, read_loop,
+                                        session) == 0);
+    if(!reading)
+        session->closed = 1;
+    
+    struct json_object *last = NULL;
+    uint64_t seq = 0;
+    double lastWrite = remote_status_clock();
+    while(!session->closed) {
+        char *json;
+        int ret = remote_http_events_wait(session->target, &seq, &json,
+                                          WEBSOCKET_PING * 1000L);
+        if(ret < 0) {
+            send_close(session, 1001);
+            break;
+        }
+        double now = remote_status_clock();
+        if(ret > 0) {
+            send_status(session, &last, json);
+            free(json);
+            lastWrite = now;
+        }
+        else if(now - lastWrite >= WEBSOCKET_PING) {
+            send_frame(session, OPCODE_PING, NULL, 0);
+            lastWrite = now;
+        }
+    }
+    json_object_put(last);
+    
+    // Wakes the reader before handing the socket back to the server
+    session->closed = 1;
+    shutdown(session->sock, SHUT_RDWR);
+    if(reading)
+        remote_thread_join(session->reader);
+    MHD_upgrade_action(session->urh, MHD_UPGRADE_ACTION_CLOSE);
+    session->done = 1;
+    return NULL;
+}
+
+
+static void on_upgrade(void *cls, struct MHD_Connection *connection,
+                       void *con_cls, const char *extra_in,
+                       size_t extra_in_size, MHD_socket sock,
+                       struct MHD_UpgradeResponseHandle *urh)
+{
+    (void) connection;
+    (void) con_cls;
+    (void) extra_in;
+    struct WebSocketSession *session = cls;
+    session->sock = sock;
+    session->urh = urh;
+    session->started = 1;
+    
+    // A client does not send before the handshake is answered
+    if(extra_in_size > 0 ||
+       remote_thread_create(&session->thread, session_loop, session) != 0)
+    {
+        MHD_upgrade_action(urh, MHD_UPGRADE_ACTION_CLOSE);
+        remote_mutex_lock(&sessionLock);
+        remote_mutex_destroy(&session->sendLock);
+        session->used = 0;
+        remote_mutex_unlock(&sessionLock);
+    }
+}
+
+
+// Takes a free slot, joining the sessions which have ended and dropping
+// the handshakes which never reached the client
+static struct WebSocketSession *acquire_session() {
+    struct WebSocketSession *slot = NULL;
+    double now = remote_status_clock();
+    remote_mutex_lock(&sessionLock);
+    for(int i=0; i<WEBSOCKET_MAX; i++) {
+        struct WebSocketSession *session = &sessions[i];
+        if(session->used && session->done)
+            remote_thread_join(session->thread);
+        if(session->used && (session->done ||
+                             (!session->started && now - session->created >
+                              WEBSOCKET_PING)))
+        {
+            remote_mutex_destroy(&session->sendLock);
+            session->used = 0;
+        }
+        if(!session->used && slot == NULL)
+            slot = session;
+    }
+    if(slot != NULL) {
+        memset(slot, 0, sizeof(struct WebSocketSession));
+        remote_mutex_init(&slot->sendLock);
+        slot->used = 1;
+        slot->created = now;
+    }
+    remote_mutex_unlock(&sessionLock);
+    return slot;
+}
+
+
+// Finds whether a comma separated header value lists the token
+static int has_token(const char *value, const char *token) {
+    size_t len = strlen(token);
+    while(value != NULL && *value != '\0') {
+        while(*value == ' ' || *value == ',')
+            value++;
+        size_t itemLen = strcspn(value, ",");
+        while(itemLen > 0 && value[itemLen-1] == ' ')
+            itemLen--;
+        if(itemLen == len && strncasecmp(value, token, len) == 0)
+            return 1;
+        value = strchr(value, ',');
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Answers a request to open a control connection
+ * 
+ * Validates the WebSocket handshake and sets the upgrade response of the
+ * connection, or an error status.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ * @param target Target ID of the playback context to be controlled
+ */
+void remote_http_answer_websocket(struct MHD_Connection *connection,
+                                  struct RemoteConnection *con_info,
+                                  int target)
+{
+    if(!sessionInitialized) {
+        con_info->status = MHD_HTTP_SERVICE_UNAVAILABLE;
+        return;
+    }
+    if(target < 0 || target >= REMOTE_TARGET_MAX) {
+        con_info->status = MHD_HTTP_NOT_FOUND;
+        return;
+    }
+    
+    const char *upgrade = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        MHD_HTTP_HEADER_UPGRADE
+    );
+    const char *conn = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        MHD_HTTP_HEADER_CONNECTION
+    );
+    const char *version = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        "Sec-WebSocket-Version"
+    );
+    const char *key = MHD_lookup_connection_value(
+        connection,
+        MHD_HEADER_KIND,
+        "Sec-WebSocket-Key"
+    );
+    if(!has_token(upgrade, "websocket") || !has_token(conn, "upgrade") ||
+       key == NULL || strlen(key) > 64)
+    {
+        con_info->status = MHD_HTTP_BAD_REQUEST;
+        return;
+    }
+    if(version == NULL || strcmp(version, "13") != 0) {
+        remote_http_add_header(con_info, "Sec-WebSocket-Version", "13");
+        con_info->status = MHD_HTTP_UPGRADE_REQUIRED;
+        return;
+    }
+    
+    char source[128];
+    unsigned char digest[20];
+    char accept[32];
+    snprintf(source, 128, "%s%s", key, WEBSOCKET_GUID);
+    sha1((const unsigned char*) source, strlen(source), digest);
+    base64_encode(digest, 20, accept);
+    
+    struct WebSocketSession *session = acquire_session();
+    if(session == NULL) {
+        con_info->status = MHD_HTTP_SERVICE_UNAVAILABLE;
+        return;
+    }
+    session->target = target;
+    con_info->response = MHD_create_response_for_upgrade(on_upgrade,
+                                                         session);
+    if(con_info->response == NULL) {
+        remote_mutex_lock(&sessionLock);
+        remote_mutex_destroy(&session->sendLock);
+        session->used = 0;
+        remote_mutex_unlock(&sessionLock);
+        con_info->status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+        return;
+    }
+    remote_http_add_header(con_info, MHD_HTTP_HEADER_UPGRADE, "websocket");
+    remote_http_add_header(con_info, "Sec-WebSocket-Accept", accept);
+    con_info->status = MHD_HTTP_SWITCHING_PROTOCOLS;
+}
+
+/**
+ * @brief Prepares the control connections before the server threads start
+ */
+void remote_http_websocket_start() {
+    if(sessionInitialized)
+        return;
+    remote_mutex_init(&sessionLock);
+    sessionInitialized = 1;
+}
+
+/**
+ * @brief Closes every control connection
+ * 
+ * Has to be called after remote_http_events_stop() and before the web
+ * server stops since the server cannot stop with upgraded connections.
+ */
+void remote_http_websocket_stop() {
+    if(!sessionInitialized)
+        return;
+    remote_http_events_wake();
+    remote_mutex_lock(&sessionLock);
+    for(int i=0; i<WEBSOCKET_MAX; i++) {
+        struct WebSocketSession *session = &sessions[i];
+        if(!session->used)
+            continue;
+        if(session->started) {
+            session->closed = 1;
+            remote_thread_join(session->thread);
+        }
+        remote_mutex_destroy(&session->sendLock);
+        session->used = 0;
+    }
+    remote_mutex_unlock(&sessionLock);
+}
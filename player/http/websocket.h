@@ -0,0 +1,69 @@
+/**
+ * @file websocket.h
+ * @brief Remote control channel over WebSocket
+ * 
+ * A client upgrading /control to the WebSocket protocol sends its commands
+ * as text messages and receives an acknowledgement for each of them along
+ * with the changes of the status, all on one connection:
+ * 
+ *     -> {"id":1,"command":"seek 30"}
+ *     <- {"type":"ack","id":1,"ok":true,"clock":12.5}
+ *     <- {"type":"status","clock":12.6,"status":{"time":30}}
+ * 
+ * The first status message carries the whole status and the later ones
+ * only the members which have changed, removed members being null.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_WEBSOCKET_H__
+#define __MPV_REMOTE_HTTP_WEBSOCKET_H__ ///< Header guard
+
+#include "con_type.h"
+
+#include <microhttpd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WEBSOCKET_MAX 16 ///< Maximum number of control connections
+#define WEBSOCKET_MESSAGE_MAX 4096 ///< Maximum size of a received message
+#define WEBSOCKET_PING 30 ///< Seconds between the pings to an idle client
+
+
+/**
+ * @brief Answers a request to open a control connection
+ * 
+ * Validates the WebSocket handshake and sets the upgrade response of the
+ * connection, or an error status.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ * @param target Target ID of the playback context to be controlled
+ */
+void remote_http_answer_websocket(struct MHD_Connection *connection,
+                                  struct RemoteConnection *con_info,
+                                  int target);
+
+/**
+ * @brief Prepares the control connections before the server threads start
+ */
+void remote_http_websocket_start();
+
+/**
+ * @brief Closes every control connection
+ * 
+ * Has to be called after remote_http_events_stop() and before the web
+ * server stops since the server cannot stop with upgraded connections.
+ */
+void remote_http_websocket_stop();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * @file worker.c
+ * @brief Runs the slow parts of the HTTP requests on worker threads
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#include "worker.h"
+
+#include "../../libremote/thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * @brief Queued work of a suspended connection
+ */
+struct WorkerJob {
+    struct MHD_Connection *connection; ///< The suspended connection
+    struct RemoteConnection *con_info; ///< The connection
+    remote_http_job func; ///< Work preparing the reply
+    char *arg; ///< Copy of the argument
+    struct WorkerJob *next; ///< Next job in the queue
+};
+
+
+static remote_mutex_t queueLock;
+static remote_cond_t queueCond;
+static remote_thread_t workers[WORKER_MAX];
+static unsigned int workerCount = 0;
+static int queueInitialized = 0;
+static int queueClosing = 0;
+static struct WorkerJob *queueHead = NULL;
+static struct WorkerJob *queueTail = NULL;
+
+
+static void finish_job(struct WorkerJob *job) {
+    job->con_info->job_state = JOB_DONE;
+    MHD_resume_connection(job->connection);
+    free(job->arg);
+    free(job);
+}
+
+
+static void *work_loop(void *arg) {
+    (void) arg;
+    remote_mutex_lock(&queueLock);
+    while(1) {
+        while(queueHead == NULL && !queueClosing)
+            remote_cond_wait(&queueCond, &queueLock);
+        if(queueClosing)
+            break;
+        struct WorkerJob *job = queueHead;
+        queueHead = job->next;
+        if(queueHead == NULL)
+            queueTail = NULL;
+        remote_mutex_unlock(&queueLock);
+        
+        job->func(job->con_info, job->arg);
+        finish_job(job);
+        remote_mutex_lock(&queueLock);
+    }
+    remote_mutex_unlock(&queueLock);
+    return NULL;
+}
+
+
+/**
+ * @brief Starts the worker threads
+ * 
+ * Has to be called before the web server starts.
+ * 
+ * @param count Number of worker threads
+ */
+void remote_http_worker_start(unsigned int count) {
+    if(workerCount > 0)
+        return;
+    if(!queueInitialized) {
+        remote_mutex_init(&queueLock);
+        remote_cond_init(&queueCond);
+        queueInitialized = 1;
+    }
+    if(count > WORKER_MAX)
+        count = WORKER_MAX;
+    
+    remote_mutex_lock(&queueLock);
+    queueClosing = 0;
+    for(unsigned int i=0; i<count; i++) {
+        if(remote_thread_create(&workers[i], work_loop, NULL) != 0)
+            break;
+        workerCount++;
+    }
+    remote_mutex_unlock(&queueLock);
+}
+
+/**
+ * @brief Stops the worker threads
+ * 
+ * Waits for the running jobs and answers the queued ones with an error.
+ * Has to be called before the web server stops so that no connection is
+ * left suspended.
+ */
+void remote_http_worker_stop() {
+    if(workerCount == 0)
+        return;
+    remote_mutex_lock(&queueLock);
+    queueClosing = 1;
+    remote_cond_broadcast(&queueCond);
+    remote_mutex_unlock(&queueLock);
+    for(unsigned int i=0; i<workerCount; i++)
+        remote_thread_join(workers[i]);
+    
+    remote_mutex_lock(&queueLock);
+    workerCount = 0;
+    while(queueHead != NULL) {
+        struct WorkerJob *job = queueHead;
+        queueHead = job->next;
+        job->con_info->status = MHD_HTTP_SERVICE_UNAVAILABLE;
+        finish_job(job);
+    }
+    queueTail = NULL;
+    remote_mutex_unlock(&queueLock);
+}
+
+/**
+ * @brief Hands the reply of a connection to a worker
+ * 
+ * Has to be called from the access handler. The connection is suspended
+ * and the handler returns MHD_YES without a response. Once the job is
+ * done, the connection resumes and the access handler is called again
+ * with the job state of the connection being JOB_DONE. If no worker runs,
+ * the job is done on the calling thread.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ * @param job Work preparing the reply
+ * @param arg Argument of the job which is copied, may be NULL
+ */
+void remote_http_worker_submit(struct MHD_Connection *connection,
+                               struct RemoteConnection *con_info,
+                               remote_http_job job, const char *arg)
+{
+    struct WorkerJob *item = NULL;
+    if(queueInitialized)
+        item = calloc(1, sizeof(struct WorkerJob));
+    if(item != NULL && arg != NULL) {
+        item->arg = malloc(strlen(arg)+1);
+        if(item->arg == NULL) {
+            free(item);
+            item = NULL;
+        }
+        else
+            strcpy(item->arg, arg);
+    }
+    if(item == NULL) {
+        job(con_info, arg);
+        return;
+    }
+    item->connection = connection;
+    item->con_info = con_info;
+    item->func = job;
+    
+    remote_mutex_lock(&queueLock);
+    if(queueClosing || workerCount == 0) {
+        remote_mutex_unlock(&queueLock);
+        free(item->arg);
+        free(item);
+        job(con_info, arg);
+        return;
+    }
+    
+    // Suspends first so that a fast job cannot resume the connection early
+    con_info->job_state = JOB_RUNNING;
+    MHD_suspend_connection(connection);
+    if(queueTail != NULL)
+        queueTail->next = item;
+    else
+        queueHead = item;
+    queueTail = item;
+    remote_cond_signal(&queueCond);
+    remote_mutex_unlock(&queueLock);
+}
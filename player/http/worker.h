@@ -0,0 +1,79 @@
+/**
+ * @file worker.h
+ * @brief Runs the slow parts of the HTTP requests on worker threads
+ * 
+ * A handler which would block on the disk or on a child process suspends
+ * its connection and hands the work to a worker. The connection resumes
+ * once the reply is ready and the server thread only sends it, so the
+ * server threads are always free for the other requests.
+ * 
+ * @copyright Copyright (c) 2021 Khant Kyaw Khaung
+ * 
+ * @license{This project is released under the GPL License.}
+ */
+
+
+#ifndef __MPV_REMOTE_HTTP_WORKER_H__
+#define __MPV_REMOTE_HTTP_WORKER_H__ ///< Header guard
+
+#include "con_type.h"
+
+#include <microhttpd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WORKER_MAX 32 ///< Maximum number of worker threads
+
+
+/**
+ * @brief Work preparing the reply of a connection
+ * 
+ * @param con_info The connection whose reply or status is set
+ * @param arg Argument given to remote_http_worker_submit()
+ */
+typedef void (*remote_http_job)(struct RemoteConnection *con_info,
+                                const char *arg);
+
+/**
+ * @brief Starts the worker threads
+ * 
+ * Has to be called before the web server starts.
+ * 
+ * @param count Number of worker threads
+ */
+void remote_http_worker_start(unsigned int count);
+
+/**
+ * @brief Stops the worker threads
+ * 
+ * Waits for the running jobs and answers the queued ones with an error.
+ * Has to be called before the web server stops so that no connection is
+ * left suspended.
+ */
+void remote_http_worker_stop();
+
+/**
+ * @brief Hands the reply of a connection to a worker
+ * 
+ * Has to be called from the access handler. The connection is suspended
+ * and the handler returns MHD_YES without a response. Once the job is
+ * done, the connection resumes and the access handler is called again
+ * with the job state of the connection being JOB_DONE. If no worker runs,
+ * the job is done on the calling thread.
+ * 
+ * @param connection The connection to the client
+ * @param con_info The connection
+ * @param job Work preparing the reply
+ * @param arg Argument of the job which is copied, may be NULL
+ */
+void remote_http_worker_submit(struct MHD_Connection *connection,
+                               struct RemoteConnection *con_info,
+                               remote_http_job job, const char *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
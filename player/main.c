@@ -16,6 +16,7 @@
 #include "http/http.h"
 
 #include "../libremote/libremote.h"
+#include "../libremote/thread.h"
 
 #include <signal.h>
 #include <stdarg.h>
@@ -34,6 +35,9 @@
 #define sleep(X) usleep((X)*1000)
 #endif
 
+#define STATUS_HEARTBEAT 5.0 ///< Seconds between the periodic status pushes
+#define KILL_TIMEOUT 3.0 ///< Seconds to wait for a player to exit
+
 
 static char *helpMessage =
 "Usage:\n"
@@ -46,11 +50,28 @@ static char *helpMessage =
 "        -k, --kill   Kill the running process\n"
 "    \n"
 "    options:\n"
-"        -f           Force command\n";
+"        -f           Force command\n"
+"        -n [count]   Number of playback contexts, one per display\n"
+"        -t [target]  Target playback context of a command\n"
+"        --http-threads [count]      Threads serving the web page\n"
+"        --http-connections [count]  Maximum number of HTTP connections\n"
+"        --http-timeout [seconds]    Idle time before closing a connection\n"
+"        --library [directory]       Media folder indexed for the search,\n"
+"                                    may be given several times\n";
+
 
+/**
+ * @brief Playback context running on its own thread
+ */
+struct PlayerContext {
+    int target; ///< Target ID addressing the context
+    mpv_handle *mpv; ///< MPV Player context while a media is open
+    remote_thread_t thread; ///< Thread running the context
+};
 
-static mpv_handle *ctx = NULL;
-static int killRequest = 0;
+static struct PlayerContext contexts[REMOTE_TARGET_MAX];
+static int contextCount = 1;
+static volatile int killRequest = 0;
 
 
 static void log_error(int code, const char *msg, ...) {
@@ -80,132 +101,74 @@ static void log_mpv_error(int code) {
 
 
 static void play_exit() {
-    if(ctx != NULL)
-        mpv_terminate_destroy(ctx);
-    log_error(0, "Stopped MPV remote player\n");
-    remote_status_set_paused(0);
-    remote_status_set_loaded(0);
-    remote_status_set_running(0);
-    remote_status_push();
+    for(int i=contextCount-1; i>=0; i--) {
+        remote_target_select(i);
+        if(contexts[i].mpv != NULL) {
+            mpv_terminate_destroy(contexts[i].mpv);
+            contexts[i].mpv = NULL;
+        }
+        if(i == 0)
+            log_error(0, "Stopped MPV remote player\n");
+        remote_status_set_paused(0);
+        remote_status_set_loaded(0);
+        remote_status_set_running(0);
+        remote_status_push();
+    }
 }
 
 
 static void exit_signal_callback(int signum) {
-    remote_http_stop_daemon();
-    play_exit();
-    exit(signum);
+    (void) signum;
+    killRequest = 1;
 }
 
 
+/**
+ * Asks the running player to quit and waits for the process to exit.
+ * A player not responding to the kill command is terminated if forced.
+ */
+static int stop_running_player(int force) {
+    remote_log_seek_end();
+    remote_command_write("kill");
+    int res = remote_instance_wait_exit(KILL_TIMEOUT);
+    if(res != 0 && force) {
+        printf("Media player is not responding, terminating it\n");
+        if(remote_instance_terminate() == 0)
+            res = remote_instance_wait_exit(KILL_TIMEOUT);
+    }
+    const char *log = remote_log_read();
+    if(log != NULL)
+        printf("%s", log);
+    return res;
+}
 
 
-int main(int argc, char *argv[]) {
-    if(argc < 2) {
-        printf("%s", helpMessage);
-        return 1;
-    }
-    
-    // Prints help message
-    if(strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
-        printf("%s", helpMessage);
-        return 0;
-    }
-    
-    // Prints version info
-    if(strcmp(argv[1], "--version") == 0) {
-        printf("mpv-remote %s\n", REMOTE_VERSION_STRING);
-        return 0;
-    }
-    
-    remote_status_pull();
-    
-    // Sends command to the active process
-    if(strcmp(argv[1], "-k") == 0 || strcmp(argv[1], "--kill") == 0) {
-        if(!remote_status_get_running()) {
-            printf("No active process to kill\n");
-            return 1;
-        }
-        remote_log_seek_end();
-        remote_command_write("kill");
-        int res = remote_log_wait_response(1.5);
-        if(res != 0) {
-            printf("Please open the task manager and kill the process\n");
-            remote_status_set_default();
-            remote_status_push();
-        }
-        return res;
-    }
-    else if(strcmp(argv[1], "--command") == 0) {
-        if(argc >= 3) {
-            char cmd[256];
-            strcpy(cmd, argv[2]);
-            for(int i=3; i<argc; i++) {
-                strcat(cmd, " ");
-                strcat(cmd, argv[i]);
-            }
-            remote_log_seek_end();
-            remote_command_write(cmd);
-            int res = remote_log_wait_response(1.0);
-            return res;
-        }
-        else {
-            printf("No input command line");
-            return 1;
-        }
-    }
-    
-    // Starts the process
-    if(strcmp(argv[1], "-s") != 0 && strcmp(argv[1], "--start") != 0) {
-        printf("%s", helpMessage);
-        return 1;
-    }
-    if(remote_status_get_running()) {
-        if(argc >= 3 && strcmp(argv[2], "-f") == 0) {
-            printf("Force start attempting to kill blocking processes\n");
-            remote_log_seek_end();
-            remote_command_write("kill");
-            remote_log_wait_response(1.5);
-        }
-        else {
-            printf("Another MPV remote player process is already running\n");
-            return 1;
-        }
-    }
-    remote_log_clear();
-    
-    // Opens HTTP port
-    if(remote_http_start_daemon() != 0) {
-        printf("Failed to run HTTP services\n");
-        return 1;
-    }
-    
-    // Reset status JSON
-    remote_status_set_default();
-    remote_status_set_running(1);
-    remote_status_push();
-    remote_command_read();
-    
-    printf("Running MPV remote player\n");
-    
-    #ifndef _WIN32
-    signal(SIGHUP, exit_signal_callback);
-    #endif
-    signal(SIGINT, exit_signal_callback);
-    signal(SIGTERM, exit_signal_callback);
+
+
+/**
+ * Waits for the media open commands sent to one target and plays them.
+ * Every playback context runs this loop on its own thread.
+ */
+static void *play_context(void *arg) {
+    struct PlayerContext *context = arg;
+    remote_target_select(context->target);
     
     // Loops until a media open command is sent
     while(!killRequest) {
-        sleep(1000);
+        sleep(100);
         int cmd = remote_command_read();
         if(cmd == REMOTE_COMMAND_OPEN) {
             void **options = remote_command_get_options();
             char url[PATH_MAX];
             remote_environment_process_variables(options[0], url);
             remote_status_set_url(url);
+            remote_status_set_progress(REMOTE_PROGRESS_RESOLVE, 0);
+            remote_status_push();
             int type = remote_status_get_media_type();
             if(type == REMOTE_MEDIA_LOCAL) {
                 FILE *fp = fopen(url, "r");
                 if(fp == NULL) {
+                    remote_status_set_progress(REMOTE_PROGRESS_FAILED, 0);
                     log_error(1, "Media `%s` does not exist\n", url);
                     continue;
                 }
@@ -215,12 +178,14 @@ int main(int argc, char *argv[]) {
             // Creates the context
             mpv_handle *ctx = mpv_create();
             if(!ctx) {
+                remote_status_set_progress(REMOTE_PROGRESS_FAILED, 0);
                 log_error(1, "Failed creating context\n");
                 continue;
             }
             int res;
-            res = remote_player_enable_preset_options(ctx);
+            res = remote_player_enable_preset_options(ctx, context->target);
             if(res != 0) {
+                remote_status_set_progress(REMOTE_PROGRESS_FAILED, 0);
                 log_mpv_error(res);
                 mpv_terminate_destroy(ctx);
                 continue;
@@ -234,19 +199,32 @@ int main(int argc, char *argv[]) {
             // Initializes the context
             res = mpv_initialize(ctx);
             if(res != 0) {
+                remote_status_set_progress(REMOTE_PROGRESS_FAILED, 0);
                 log_mpv_error(res);
                 mpv_terminate_destroy(ctx);
                 continue;
             }
             
+            // Reports the speed changes as playback clock discontinuities
+            mpv_observe_property(ctx, 0, "speed", MPV_FORMAT_DOUBLE);
+            
+            // Follows the opening stages and the cache fill
+            mpv_hook_add(ctx, 0, "on_load", 50);
+            mpv_hook_add(ctx, 0, "on_preloaded", 50);
+            mpv_observe_property(ctx, 0, "cache-buffering-state",
+                                 MPV_FORMAT_INT64);
+            
             // Sets MPV file loading command
             const char *play_cmd[] = {"loadfile", url, NULL};
             res = mpv_command(ctx, play_cmd);
             if(res != 0) {
+                remote_status_set_progress(REMOTE_PROGRESS_FAILED, 0);
                 log_mpv_error(res);
                 mpv_terminate_destroy(ctx);
                 continue;
             }
+            context->mpv = ctx;
+            remote_player_client_attach(ctx, context->target);
             remote_status_set_error(0, "");
             remote_status_push();
             
@@ -254,10 +232,11 @@ int main(int argc, char *argv[]) {
              * Plays the requested media.
              * Handles commands and events.
              */
-            double waitTime = 0;
-            while(1) {
+            double openTime = remote_status_clock();
+            double lastPush = openTime;
+            while(!killRequest) {
                 mpv_event* event = mpv_wait_event(ctx, 0.1);
-                remote_player_event_process(ctx, event);
+                int changed = remote_player_event_process(ctx, event);
                 if(event->event_id == MPV_EVENT_SHUTDOWN ||
                    event->event_id == MPV_EVENT_END_FILE)
                 {
@@ -270,11 +249,11 @@ int main(int argc, char *argv[]) {
                     if(type == REMOTE_MEDIA_HTTP)
                         timeout = 30.0;
                     
-                    if(waitTime > timeout) {
+                    if(remote_status_clock() - openTime > timeout) {
+                        remote_status_set_progress(REMOTE_PROGRESS_FAILED, 0);
                         log_error(1, "Error loading media `%s`\n", url);
                         break;
                     }
-                    waitTime += 0.1;
                 }
                 
                 // Reads and proceeds the command given by the remote
@@ -286,7 +265,7 @@ int main(int argc, char *argv[]) {
                 else if(cmd == REMOTE_COMMAND_OPEN) {
                     paused = (int*) options[1];
                     if(*paused)
-                        remote_command_write("open \"%s\" --paused", (char*) options[0]);
+                        remote_command_write("open \"%s\" --pause", (char*) options[0]);
                     else
                         remote_command_write("open \"%s\"", (char*) options[0]);
                     break;
@@ -296,10 +275,26 @@ int main(int argc, char *argv[]) {
                     break;
                 }
                 
-                remote_status_push();
+                // Pushes the changes and corrects the clock drift
+                double now = remote_status_clock();
+                if(!changed && now - lastPush >= STATUS_HEARTBEAT) {
+                    if(remote_status_get_loaded())
+                        remote_player_sync_time(ctx);
+                    changed = 1;
+                }
+                if(changed) {
+                    remote_status_push();
+                    lastPush = now;
+                }
             }
+            remote_player_client_detach(context->target);
+            context->mpv = NULL;
             mpv_terminate_destroy(ctx);
-            ctx = NULL;
+            int stage = remote_status_get_progress(NULL, NULL);
+            if(stage == REMOTE_PROGRESS_FIRST_FRAME)
+                remote_status_set_progress(REMOTE_PROGRESS_NONE, 0);
+            else if(stage != REMOTE_PROGRESS_FAILED)
+                remote_status_set_progress(REMOTE_PROGRESS_FAILED, 0);
             remote_status_set_loaded(0);
             remote_status_push();
             remote_log_write("Finished playing the media\n");
@@ -308,6 +303,160 @@ int main(int argc, char *argv[]) {
             killRequest = 1;
         }
     }
+    return NULL;
+}
+
+
+
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        printf("%s", helpMessage);
+        return 1;
+    }
+    
+    // Prints help message
+    if(strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+        printf("%s", helpMessage);
+        return 0;
+    }
+    
+    // Prints version info
+    if(strcmp(argv[1], "--version") == 0) {
+        printf("mpv-remote %s\n", REMOTE_VERSION_STRING);
+        return 0;
+    }
+    
+    remote_status_pull();
+    
+    // Sends command to the active process
+    if(strcmp(argv[1], "-k") == 0 || strcmp(argv[1], "--kill") == 0) {
+        if(!remote_instance_is_running()) {
+            printf("No active process to kill\n");
+            return 1;
+        }
+        int force = (argc >= 3 && strcmp(argv[2], "-f") == 0);
+        int res = stop_running_player(force);
+        if(res != 0)
+            printf("Please open the task manager and kill the process\n");
+        return res;
+    }
+    else if(strcmp(argv[1], "--command") == 0) {
+        int first = 2;
+        if(argc >= 4 && strcmp(argv[2], "-t") == 0) {
+            int target = remote_target_parse(argv[3],
+                                             remote_status_get_targets());
+            if(target < 0) {
+                printf("No playback context `%s` is running\n", argv[3]);
+                return 1;
+            }
+            remote_target_select(target);
+            first = 4;
+        }
+        if(argc > first) {
+            char cmd[256];
+            strcpy(cmd, argv[first]);
+            for(int i=first+1; i<argc; i++) {
+                strcat(cmd, " ");
+                strcat(cmd, argv[i]);
+            }
+            remote_log_seek_end();
+            remote_command_write(cmd);
+            int res = remote_log_wait_response(1.0);
+            return res;
+        }
+        else {
+            printf("No input command line");
+            return 1;
+        }
+    }
+    
+    // Starts the process
+    if(strcmp(argv[1], "-s") != 0 && strcmp(argv[1], "--start") != 0) {
+        printf("%s", helpMessage);
+        return 1;
+    }
+    int force = 0;
+    for(int i=2; i<argc; i++) {
+        if(strcmp(argv[i], "-f") == 0)
+            force = 1;
+        else if(strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            contextCount = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--http-threads") == 0 && i+1 < argc)
+            remote_http_set_threading(atoi(argv[++i]), 0, 0);
+        else if(strcmp(argv[i], "--http-connections") == 0 && i+1 < argc)
+            remote_http_set_threading(0, atoi(argv[++i]), 0);
+        else if(strcmp(argv[i], "--http-timeout") == 0 && i+1 < argc)
+            remote_http_set_threading(0, 0, atoi(argv[++i]));
+        else if(strcmp(argv[i], "--library") == 0 && i+1 < argc)
+            remote_http_add_library_root(argv[++i]);
+    }
+    if(contextCount < 1 || contextCount > REMOTE_TARGET_MAX) {
+        printf("The number of playback contexts must be from 1 to %d\n",
+               REMOTE_TARGET_MAX);
+        return 1;
+    }
+    if(remote_instance_is_running()) {
+        if(force) {
+            printf("Force start attempting to kill blocking processes\n");
+            stop_running_player(1);
+        }
+        else {
+            printf("Another MPV remote player process is already running\n");
+            return 1;
+        }
+    }
+    if(remote_instance_lock() != 0) {
+        printf("Another MPV remote player process is already running\n");
+        return 1;
+    }
+    remote_log_clear();
+    remote_player_client_init();
+    
+    // Opens HTTP port
+    if(remote_http_start_daemon() != 0) {
+        printf("Failed to run HTTP services\n");
+        remote_instance_unlock();
+        return 1;
+    }
+    
+    // Reset status JSON of every playback context
+    for(int i=0; i<contextCount; i++) {
+        remote_target_select(i);
+        remote_status_set_default();
+        remote_status_set_targets(contextCount);
+        remote_status_set_running(1);
+        remote_status_push();
+        remote_command_read();
+    }
+    remote_target_select(0);
+    
+    printf("Running MPV remote player\n");
+    
+    #ifndef _WIN32
+    signal(SIGHUP, exit_signal_callback);
+    #endif
+    signal(SIGINT, exit_signal_callback);
+    signal(SIGTERM, exit_signal_callback);
+    
+    // Runs every playback context on its own thread
+    for(int i=0; i<contextCount; i++) {
+        contexts[i].target = i;
+        contexts[i].mpv = NULL;
+        if(remote_thread_create(&contexts[i].thread, play_context,
+                                &contexts[i]) != 0)
+        {
+            printf("Failed to run the playback context %d\n", i);
+            killRequest = 1;
+            contextCount = i;
+            break;
+        }
+    }
+    for(int i=0; i<contextCount; i++)
+        remote_thread_join(contexts[i].thread);
+    
+    remote_http_stop_daemon();
     play_exit();
+    remote_instance_unlock();
     return 0;
 }
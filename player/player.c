@@ -15,6 +15,7 @@
 #include "player.h"
 
 #include "../libremote/libremote.h"
+#include "../libremote/thread.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,17 +32,30 @@
 #include <mpv/client.h>
 
 
+/**
+ * @brief Client handle of the HTTP server for a playback context
+ */
+struct PlayerClient {
+    mpv_handle *mpv; ///< Client handle while a media is open
+    remote_mutex_t lock; ///< Held while the handle is in use
+};
+
+static struct PlayerClient clients[REMOTE_TARGET_MAX];
+
+
 /**
  * @brief Enables the libmpv context options suitable for the system
  * 
  * Sets up the options selected for the remote media playing system.
- * The selections are just hard coded.
+ * The selections are just hard coded. When more than one playback context
+ * runs, each of them goes full screen on the display numbered by its target.
  * 
  * @param ctx MPV Player context
+ * @param target Target ID of the playback context
  * 
  * @return Error code
  */
-int remote_player_enable_preset_options(mpv_handle *ctx) {
+int remote_player_enable_preset_options(mpv_handle *ctx, int target) {
     int res;
     int flagVal;
     
@@ -49,6 +63,13 @@ int remote_player_enable_preset_options(mpv_handle *ctx) {
     flagVal = 1;
     mpv_set_option(ctx, "fs", MPV_FORMAT_FLAG, &flagVal);
     
+    // Puts each playback context on its own display
+    if(remote_status_get_targets() > 1) {
+        int64_t screen = target;
+        mpv_set_option(ctx, "screen", MPV_FORMAT_INT64, &screen);
+        mpv_set_option(ctx, "fs-screen", MPV_FORMAT_INT64, &screen);
+    }
+    
     // Enables GPU hardware decoding
     res = mpv_set_option_string(ctx, "hwdec", "auto");
     if(res != 0)
@@ -67,16 +88,51 @@ int remote_player_enable_preset_options(mpv_handle *ctx) {
     return 0;
 }
 
+/**
+ * @brief Samples the playback time and speed of the media
+ * 
+ * @param ctx MPV Player context
+ */
+void remote_player_sync_time(mpv_handle *ctx) {
+    double time;
+    if(mpv_get_property(ctx, "time-pos", MPV_FORMAT_DOUBLE, &time) == 0)
+        remote_status_set_time(time);
+    double speed;
+    if(mpv_get_property(ctx, "speed", MPV_FORMAT_DOUBLE, &speed) == 0)
+        remote_status_set_speed(speed);
+}
+
 /**
  * @brief Process the MPV event
  * 
+ * The playback time is only sampled when the playback clock has a
+ * discontinuity like a seek, a pause or a speed change. In between, the
+ * readers extrapolate it from the sampled time and the speed. While a
+ * media is being opened, the events also advance the progress stages.
+ * 
  * @param ctx MPV Player context
  * @param event MPV Player event
+ * 
+ * @return 1 if the status has changed and 0 otherwise
  */
-void remote_player_event_process(mpv_handle *ctx, mpv_event *event) {
-    static double time;
+int remote_player_event_process(mpv_handle *ctx, mpv_event *event) {
+    int stage = remote_status_get_progress(NULL, NULL);
     
-    if(event->event_id == MPV_EVENT_FILE_LOADED) {
+    if(event->event_id == MPV_EVENT_START_FILE) {
+        remote_status_set_progress(REMOTE_PROGRESS_RESOLVE, 0);
+        return 1;
+    }
+    else if(event->event_id == MPV_EVENT_HOOK) {
+        // The URL resolution hooks like youtube-dl run before these
+        mpv_event_hook *hook = event->data;
+        if(strcmp(hook->name, "on_load") == 0)
+            remote_status_set_progress(REMOTE_PROGRESS_CONNECT, 0);
+        else if(strcmp(hook->name, "on_preloaded") == 0)
+            remote_status_set_progress(REMOTE_PROGRESS_PROBE, 0);
+        mpv_hook_continue(ctx, hook->id);
+        return 1;
+    }
+    else if(event->event_id == MPV_EVENT_FILE_LOADED) {
         char *name;
         name = mpv_get_property_string(ctx, "media-title");
         double duration;
@@ -84,24 +140,56 @@ void remote_player_event_process(mpv_handle *ctx, mpv_event *event) {
         remote_status_set_name(name);
         remote_status_set_duration(duration);
         remote_status_set_loaded(1);
+        remote_status_set_progress(REMOTE_PROGRESS_CACHE, 0);
+        remote_player_sync_time(ctx);
         remote_log_write("Playing media `%s`\n", name);
+        mpv_free(name);
+        return 1;
     }
     else if(event->event_id == MPV_EVENT_PAUSE) {
         if(!remote_status_get_paused()) {
             remote_log_write("Paused the media\n");
+            remote_player_sync_time(ctx);
             remote_status_set_paused(1);
+            return 1;
         }
     }
     else if(event->event_id == MPV_EVENT_UNPAUSE) {
         if(remote_status_get_paused()) {
             remote_log_write("Resumed the media\n");
+            remote_player_sync_time(ctx);
             remote_status_set_paused(0);
+            return 1;
         }
     }
-    else if(remote_status_get_loaded()) {
-        mpv_get_property(ctx, "time-pos", MPV_FORMAT_DOUBLE, &time);
-        remote_status_set_time(time);
+    else if(event->event_id == MPV_EVENT_PLAYBACK_RESTART) {
+        if(remote_status_get_loaded()) {
+            if(stage != REMOTE_PROGRESS_FIRST_FRAME)
+                remote_status_set_progress(REMOTE_PROGRESS_FIRST_FRAME, 100);
+            remote_player_sync_time(ctx);
+            return 1;
+        }
+    }
+    else if(event->event_id == MPV_EVENT_PROPERTY_CHANGE) {
+        mpv_event_property *prop = event->data;
+        if(strcmp(prop->name, "speed") == 0 && remote_status_get_loaded()) {
+            remote_player_sync_time(ctx);
+            return 1;
+        }
+        else if(strcmp(prop->name, "cache-buffering-state") == 0 &&
+                stage == REMOTE_PROGRESS_CACHE &&
+                prop->format == MPV_FORMAT_INT64)
+        {
+            int percent;
+            remote_status_get_progress(&percent, NULL);
+            int64_t fill = *(int64_t*) prop->data;
+            if(fill != percent) {
+                remote_status_set_progress(REMOTE_PROGRESS_CACHE, (int) fill);
+                return 1;
+            }
+        }
     }
+    return 0;
 }
 
 /**
@@ -128,12 +216,128 @@ void remote_player_command_process(mpv_handle *ctx, int cmd, void **options) {
         }
     }
     else if(cmd == REMOTE_COMMAND_MOVE) {
+        // mpv seeks from its own position since the status record may be
+        // written by the playback thread meanwhile
         double *moveTime = (double*) options[0];
-        double time = remote_status_get_time() + *moveTime;
-        mpv_set_property(ctx, "time-pos", MPV_FORMAT_DOUBLE, &time);
+        char offset[32];
+        snprintf(offset, 32, "%.3f", *moveTime);
+        const char *args[] = {"seek", offset, "relative+exact", NULL};
+        mpv_command(ctx, args);
     }
     else if(cmd == REMOTE_COMMAND_SEEK) {
         double *requestedTime = (double*) options[0];
         mpv_set_property(ctx, "time-pos", MPV_FORMAT_DOUBLE, requestedTime);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Prepares the table of the client handles
+ * 
+ * Has to be called once before any playback context starts.
+ */
+void remote_player_client_init() {
+    for(int i=0; i<REMOTE_TARGET_MAX; i++) {
+        clients[i].mpv = NULL;
+        remote_mutex_init(&clients[i].lock);
+    }
+}
+
+/**
+ * @brief Creates the client handle of the HTTP server for a context
+ * 
+ * The extra handle shares the core of the playback context so the web
+ * server can read properties and send safe commands directly from its
+ * own threads. Its events are disabled since nobody waits on them.
+ * 
+ * @param ctx MPV Player context
+ * @param target Target ID of the playback context
+ */
+void remote_player_client_attach(mpv_handle *ctx, int target) {
+    if(target < 0 || target >= REMOTE_TARGET_MAX)
+        return;
+    mpv_handle *client = mpv_create_client(ctx, "http");
+    if(client == NULL)
+        return;
+    for(int i=MPV_EVENT_NONE+1; i<=MPV_EVENT_HOOK; i++)
+        mpv_request_event(client, i, 0);
+    
+    remote_mutex_lock(&clients[target].lock);
+    clients[target].mpv = client;
+    remote_mutex_unlock(&clients[target].lock);
+}
+
+/**
+ * @brief Destroys the client handle of a context
+ * 
+ * Waits for the calls in progress on the handle. Has to be called before
+ * the playback context itself is destroyed.
+ * 
+ * @param target Target ID of the playback context
+ */
+void remote_player_client_detach(int target) {
+    if(target < 0 || target >= REMOTE_TARGET_MAX)
+        return;
+    remote_mutex_lock(&clients[target].lock);
+    if(clients[target].mpv != NULL) {
+        mpv_destroy(clients[target].mpv);
+        clients[target].mpv = NULL;
+    }
+    remote_mutex_unlock(&clients[target].lock);
+}
+
+/**
+ * @brief Sends a command to a context through its client handle
+ * 
+ * Only the commands which do not change the lifecycle of the context,
+ * pausing, moving and seeking, are sent directly. Opening, stopping and
+ * killing stay with the main loop of the context.
+ * 
+ * @param target Target ID of the playback context
+ * @param line Command string
+ * 
+ * @return 0 if the command was sent and 1 if it has to go through the file
+ */
+int remote_player_client_command(int target, const char *line) {
+    if(target < 0 || target >= REMOTE_TARGET_MAX)
+        return 1;
+    int cmd = remote_command_parse(line);
+    if(cmd != REMOTE_COMMAND_PAUSE && cmd != REMOTE_COMMAND_MOVE &&
+       cmd != REMOTE_COMMAND_SEEK)
+    {
+        return 1;
+    }
+    
+    int res = 1;
+    remote_mutex_lock(&clients[target].lock);
+    if(clients[target].mpv != NULL) {
+        remote_target_select(target);
+        void **options = remote_command_get_options();
+        remote_player_command_process(clients[target].mpv, cmd, options);
+        res = 0;
+    }
+    remote_mutex_unlock(&clients[target].lock);
+    return res;
+}
+
+/**
+ * @brief Reads a property of a context through its client handle
+ * 
+ * @param target Target ID of the playback context
+ * @param name Property name
+ * @param format Format of the data
+ * @param data Receives the value like mpv_get_property()
+ * 
+ * @return MPV error code, MPV_ERROR_UNINITIALIZED if no media is open
+ */
+int remote_player_client_get_property(int target, const char *name,
+                                      mpv_format format, void *data)
+{
+    if(target < 0 || target >= REMOTE_TARGET_MAX)
+        return MPV_ERROR_INVALID_PARAMETER;
+    int res = MPV_ERROR_UNINITIALIZED;
+    remote_mutex_lock(&clients[target].lock);
+    if(clients[target].mpv != NULL)
+        res = mpv_get_property(clients[target].mpv, name, format, data);
+    remote_mutex_unlock(&clients[target].lock);
+    return res;
+}
@@ -25,21 +25,37 @@ extern "C" {
  * @brief Enables the libmpv context options suitable for the system
  * 
  * Sets up the options selected for the remote media playing system.
- * The selections are just hard coded.
+ * The selections are just hard coded. When more than one playback context
+ * runs, each of them goes full screen on the display numbered by its target.
  * 
  * @param ctx MPV Player context
+ * @param target Target ID of the playback context
  * 
  * @return Error code
  */
-int remote_player_enable_preset_options(mpv_handle *ctx);
+int remote_player_enable_preset_options(mpv_handle *ctx, int target);
+
+/**
+ * @brief Samples the playback time and speed of the media
+ * 
+ * @param ctx MPV Player context
+ */
+void remote_player_sync_time(mpv_handle *ctx);
 
 /**
  * @brief Process the MPV event
  * 
+ * The playback time is only sampled when the playback clock has a
+ * discontinuity like a seek, a pause or a speed change. In between, the
+ * readers extrapolate it from the sampled time and the speed. While a
+ * media is being opened, the events also advance the progress stages.
+ * 
  * @param ctx MPV Player context
  * @param event MPV Player event
+ * 
+ * @return 1 if the status has changed and 0 otherwise
  */
-void remote_player_event_process(mpv_handle *ctx, mpv_event *event);
+int remote_player_event_process(mpv_handle *ctx, mpv_event *event);
 
 /**
  * @brief Process the remote command
@@ -50,6 +66,62 @@ void remote_player_event_process(mpv_handle *ctx, mpv_event *event);
  */
 void remote_player_command_process(mpv_handle *ctx, int cmd, void **options);
 
+/**
+ * @brief Prepares the table of the client handles
+ * 
+ * Has to be called once before any playback context starts.
+ */
+void remote_player_client_init();
+
+/**
+ * @brief Creates the client handle of the HTTP server for a context
+ * 
+ * The extra handle shares the core of the playback context so the web
+ * server can read properties and send safe commands directly from its
+ * own threads. Its events are disabled since nobody waits on them.
+ * 
+ * @param ctx MPV Player context
+ * @param target Target ID of the playback context
+ */
+void remote_player_client_attach(mpv_handle *ctx, int target);
+
+/**
+ * @brief Destroys the client handle of a context
+ * 
+ * Waits for the calls in progress on the handle. Has to be called before
+ * the playback context itself is destroyed.
+ * 
+ * @param target Target ID of the playback context
+ */
+void remote_player_client_detach(int target);
+
+/**
+ * @brief Sends a command to a context through its client handle
+ * 
+ * Only the commands which do not change the lifecycle of the context,
+ * pausing, moving and seeking, are sent directly. Opening, stopping and
+ * killing stay with the main loop of the context.
+ * 
+ * @param target Target ID of the playback context
+ * @param line Command string
+ * 
+ * @return 0 if the command was sent and 1 if it has to go through the file
+ */
+int remote_player_client_command(int target, const char *line);
+
+/**
+ * @brief Reads a property of a context through its client handle
+ * 
+ * @param target Target ID of the playback context
+ * @param name Property name
+ * @param format Format of the data
+ * @param data Receives the value like mpv_get_property()
+ * 
+ * @return MPV error code, MPV_ERROR_UNINITIALIZED if no media is open
+ */
+int remote_player_client_get_property(int target, const char *name,
+                                      mpv_format format, void *data);
+
 /**
  * @brief Translates the url with variable names to the actual file path
  * 
@@ -22,8 +22,11 @@
 #ifdef _WIN32
 #include <Windows.h>
 #define PATH_MAX _MAX_PATH
+#define sleep(X) Sleep(X)
 #else
+#include <unistd.h>
 #include <linux/limits.h>
+#define sleep(X) usleep((X)*1000)
 #endif
 
 static char *helpMessageBrief =
@@ -35,6 +38,7 @@ static char *helpMessage =
 "Usage:\n"
 "    mpv-remote [url]\n"
 "    mpv-remote [command] [args]\n"
+"    mpv-remote -t [target] [url|command] [args]\n"
 "    \n"
 "    url:\n"
 "        Supports files from local and web. For local files, use relative or\n"
@@ -47,10 +51,81 @@ static char *helpMessage =
 "        --status           Prints the media player status\n"
 "        -p, --pause        Pauses or resumes the current media\n"
 "        -m, --move [time]  Rewinds or skips the current media in seconds\n"
-"        -s, --stop         Stops the current media\n";
+"        -s, --stop         Stops the current media\n"
+"    \n"
+"    target:\n"
+"        ID of the playback context to control when the media player runs\n"
+"        more than one of them. Defaults to 0.\n";
+
+
+/**
+ * @brief Follows the loading progress of a newly opened media
+ * 
+ * Prints the log of the display program along with every loading stage
+ * it reports until the first frame is shown or the loading fails.
+ * 
+ * @param timeout Maximum time to wait in seconds
+ * 
+ * @return 0 if the media started playing and 1 otherwise
+ */
+static int wait_media_loading(double timeout) {
+    double start = remote_status_clock();
+    int lastStage = REMOTE_PROGRESS_NONE;
+    int lastPercent = -1;
+    
+    while(remote_status_clock() - start < timeout) {
+        sleep(100);
+        const char *log = remote_log_read();
+        if(log != NULL)
+            printf("%s", log);
+        
+        remote_status_pull();
+        if(!remote_status_get_running()) {
+            printf("The media player has stopped\n");
+            return 1;
+        }
+        
+        // Ignores the stage left over from the previous media
+        int percent;
+        double timestamp;
+        int stage = remote_status_get_progress(&percent, &timestamp);
+        if(timestamp < start)
+            continue;
+        
+        if(stage == REMOTE_PROGRESS_FAILED)
+            return 1;
+        if(stage == REMOTE_PROGRESS_FIRST_FRAME)
+            return 0;
+        
+        if(stage != lastStage ||
+           (stage == REMOTE_PROGRESS_CACHE && percent != lastPercent))
+        {
+            if(stage == REMOTE_PROGRESS_CACHE)
+                printf("Loading: %s %d%%\n",
+                       remote_status_progress_name(stage), percent);
+            else
+                printf("Loading: %s\n", remote_status_progress_name(stage));
+            lastStage = stage;
+            lastPercent = percent;
+        }
+    }
+    
+    printf("Media player is not responding\n");
+    return 1;
+}
 
 
 int main(int argc, char *argv[]) {
+    // Takes the target playback context
+    const char *target = NULL;
+    if(argc >= 3 && (strcmp(argv[1], "-t") == 0 ||
+                     strcmp(argv[1], "--target") == 0))
+    {
+        target = argv[2];
+        argc -= 2;
+        argv += 2;
+    }
+    
     if(argc < 2) {
         printf("%s", helpMessageBrief);
         return 1;
@@ -68,6 +143,18 @@ int main(int argc, char *argv[]) {
         return 0;
     }
     
+    // Selects the target once the number of contexts is read from the
+    // status of the context 0
+    if(target != NULL) {
+        remote_status_pull();
+        int t = remote_target_parse(target, remote_status_get_targets());
+        if(t < 0) {
+            printf("No playback context `%s` is running\n", target);
+            return 1;
+        }
+        remote_target_select(t);
+    }
+    
     // Prints the player status
     if(strcmp(argv[1], "--status") == 0) {
         remote_status_pull();
@@ -161,6 +248,7 @@ int main(int argc, char *argv[]) {
         else {
             remote_command_write("open \"%s\"", url);
         }
+        return wait_media_loading(timeout);
     }
     
     // Waits for any response from the display program